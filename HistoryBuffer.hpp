@@ -0,0 +1,136 @@
+/// @file HistoryBuffer.hpp
+/// @brief Fixed-capacity, contiguous history of the most recent samples.
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <vector>
+
+/// @brief Circular history of the last `size()` samples, ordered from the newest to the oldest.
+///
+/// The buffer is a drop-in replacement for a `std::deque` used with `pop_back()` + `push_front()`
+/// pairs. Every sample is stored twice (at the head and `size()` elements after it), so the whole
+/// history is always available as one contiguous, newest-first range. This keeps the memory layout
+/// cache friendly and lets dot products run over plain pointers, without per-sample allocations.
+///
+/// @tparam T type of stored samples
+/// @tparam Allocator allocator of the storage
+template <typename T, typename Allocator = std::allocator<T>> class HistoryBuffer {
+private:
+    /// Storage of size `2 * m_size`, the second half mirrors the first one.
+    std::vector<T, Allocator> m_data{};
+    /// Number of stored samples.
+    std::size_t m_size{};
+    /// Index of the newest sample in the first half of #m_data.
+    std::size_t m_head{};
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    using const_iterator = const T *;
+
+    /// Construct an empty history.
+    constexpr HistoryBuffer() = default;
+    /// @brief Construct an empty history using `alloc`.
+    /// @param alloc allocator of the storage
+    constexpr explicit HistoryBuffer(const Allocator &alloc)
+        : m_data(alloc)
+    {
+    }
+    /// @brief Construct a history of `n` value-initialized samples.
+    /// @param n number of samples
+    /// @param alloc allocator of the storage
+    constexpr explicit HistoryBuffer(std::size_t n, const Allocator &alloc = Allocator{})
+        : m_data(2 * n, alloc)
+        , m_size{ n }
+    {
+    }
+    /// @brief Construct a history from a newest-first range of samples.
+    /// @param first iterator to the newest sample
+    /// @param last end iterator
+    /// @param alloc allocator of the storage
+    template <std::input_iterator It>
+    constexpr HistoryBuffer(It first, It last, const Allocator &alloc = Allocator{})
+        : m_data(alloc)
+    {
+        assign(first, last);
+    }
+
+    /// Number of stored samples.
+    constexpr std::size_t size() const noexcept { return m_size; }
+    /// Check if the history is empty.
+    constexpr bool empty() const noexcept { return m_size == 0; }
+    /// Pointer to the newest sample; the following `size() - 1` elements are older samples.
+    constexpr const T *data() const noexcept { return m_data.data() + m_head; }
+    /// Iterator to the newest sample.
+    constexpr const_iterator begin() const noexcept { return data(); }
+    /// End iterator (after the oldest sample).
+    constexpr const_iterator end() const noexcept { return data() + m_size; }
+    /// Contiguous, newest-first view of the history.
+    constexpr std::span<const T> view() const noexcept { return { data(), m_size }; }
+    /// @brief Access sample `i` steps older than the newest one.
+    /// @param i age of the sample, must be smaller than size()
+    constexpr const T &operator[](std::size_t i) const noexcept { return data()[i]; }
+    /// Newest sample.
+    constexpr const T &front() const noexcept { return data()[0]; }
+    /// Oldest sample.
+    constexpr const T &back() const noexcept { return data()[m_size - 1]; }
+
+    /// @brief Insert a new sample and drop the oldest one.
+    ///
+    /// Pushing into an empty history leaves it with a single sample, the same way
+    /// `push_front()` without a preceding `pop_back()` would on a `std::deque`.
+    ///
+    /// @param value the newest sample
+    constexpr void push_front(const T &value)
+    {
+        if (m_size == 0) [[unlikely]] {
+            resize(1);
+            m_data[0] = m_data[1] = value;
+            return;
+        }
+        m_head = m_head == 0 ? m_size - 1 : m_head - 1;
+        m_data[m_head] = value;
+        m_data[m_head + m_size] = value;
+    }
+    /// @brief Change the number of samples.
+    ///
+    /// Existing samples are preserved (newest first), new (oldest) ones are value-initialized.
+    ///
+    /// @param n new number of samples
+    constexpr void resize(std::size_t n)
+    {
+        if (n == m_size)
+            return;
+        std::vector<T, Allocator> resized(2 * n, m_data.get_allocator());
+        const auto kept = std::min(n, m_size);
+        std::copy_n(data(), kept, resized.begin());
+        std::copy_n(resized.begin(), n, resized.begin() + static_cast<std::ptrdiff_t>(n));
+        m_data = std::move(resized);
+        m_size = n;
+        m_head = 0;
+    }
+    /// @brief Replace the contents with a newest-first range of samples.
+    /// @param first iterator to the newest sample
+    /// @param last end iterator
+    template <std::input_iterator It> constexpr void assign(It first, It last)
+    {
+        std::vector<T> values(first, last);
+        m_size = values.size();
+        m_head = 0;
+        m_data.resize(2 * m_size);
+        std::ranges::copy(values, m_data.begin());
+        std::ranges::copy(values, m_data.begin() + static_cast<std::ptrdiff_t>(m_size));
+    }
+    /// @brief Set all samples to `value`.
+    /// @param value value to fill the history with
+    constexpr void fill(const T &value) { std::ranges::fill(m_data, value); }
+
+    /// Compare the stored samples (in order), ignoring the internal layout.
+    friend constexpr bool operator==(const HistoryBuffer &a, const HistoryBuffer &b)
+    {
+        return std::ranges::equal(a.view(), b.view());
+    }
+};
@@ -1,4 +1,5 @@
 #include "ModelARX.h"
+#include "arx_kernel.hpp"
 #include "util.hpp"
 #include <algorithm>
 #include <array>
@@ -13,15 +14,36 @@
 
 double ModelARX::get_random()
 {
-    const auto r = m_distribution(m_mt);
+    double r;
+    if (m_legacy_noise) {
+        // The legacy stream always draws, like the implementation which wrote it did
+        r = (*m_legacy_noise)(m_noise_mean, m_noise_stddev);
+    } else {
+        // With finite normal samples mean + 0.0 * z == mean, so the draw can be skipped
+        r = m_noise_stddev == 0.0
+            ? m_noise_mean
+            : m_noise_mean + m_noise_stddev * philox_normal(m_init_seed, m_n_generated);
+    }
     m_n_generated++;
     return r;
 }
 
+void ModelARX::draw_noise(std::span<double> noise)
+{
+    if (m_legacy_noise) {
+        for (auto &v : noise)
+            v = (*m_legacy_noise)(m_noise_mean, m_noise_stddev);
+    } else if (m_noise_stddev == 0.0) {
+        std::ranges::fill(noise, m_noise_mean);
+    } else {
+        philox_fill_normal(m_init_seed, m_n_generated, noise, m_noise_mean, m_noise_stddev);
+    }
+    m_n_generated += noise.size();
+}
+
 ModelARX::ModelARX(std::vector<double> &&coeff_a, std::vector<double> &&coeff_b,
                    const int32_t delay, const double stddev)
-    : m_init_seed{ std::random_device{}() }
-    , m_mt{ static_cast<decltype(m_mt)::result_type>(m_init_seed) }
+    : m_init_seed{ philox_stream_key() }
 {
     set_coeff_a(std::move(coeff_a));
     set_coeff_b(std::move(coeff_b));
@@ -29,18 +51,86 @@ ModelARX::ModelARX(std::vector<double> &&coeff_a, std::vector<double> &&coeff_b,
     set_stddev(stddev);
 }
 
+ModelARX::ModelARX(std::span<const uint8_t> data)
+    : ModelARX{ data, nullptr }
+{
+}
+
+ModelARX::ModelARX(std::span<const uint8_t> data, std::pmr::memory_resource *arena)
+    : m_coeff_a{ arena != nullptr ? arena : std::pmr::get_default_resource() }
+    , m_coeff_b{ m_coeff_a.get_allocator() }
+    , m_in_signal_mem{ m_coeff_a.get_allocator() }
+    , m_out_signal_mem{ m_coeff_a.get_allocator() }
+    , m_delay_mem{ m_coeff_a.get_allocator() }
+{
+    if (data.size() < sizeof(raw_data_t) + prefix_size + sizeof(uint32_t))
+        throw std::runtime_error{ "Data size is smaller than constant-length part" };
+
+    ByteReader reader{ data };
+    // skip the length
+    reader.take(sizeof(uint32_t));
+    if (!prefix_match(unique_name, reader.take(prefix_size)))
+        throw std::runtime_error{
+            "ModelARX serialized data does not start with the expected prefix"
+        };
+
+    const auto raw_data = reader.get<raw_data_t>();
+    const auto unversioned_size{ (raw_data.n_coeff_a + raw_data.n_coeff_b + raw_data.in_n
+                                  + raw_data.out_n + raw_data.delay_n)
+                                     * 8
+                                 + sizeof(raw_data_t) + prefix_size + sizeof(uint32_t) };
+    // Version 0 dumps have no version field, so they are recognized by their size
+    const bool versioned = data.size() == unversioned_size + sizeof(uint64_t);
+    const auto expected_size = versioned ? data.size() : unversioned_size;
+    if (data.size() != expected_size)
+        throw std::runtime_error{
+#if __cpp_lib_format >= 201907L
+            std::format("Data size ({} bytes) does not match the expected size ({} bytes)",
+                        data.size(), expected_size)
+#else
+            "Data size does not match the expected size"
+#endif
+        };
+
+    const auto version = versioned ? reader.get<uint64_t>() : 0;
+    if (version > format_version)
+        throw std::runtime_error{ "ModelARX serialized data has an unsupported format version" };
+
+    // Buffers are allocated in the serialization order, so they are adjacent in an arena
+    const auto coeff_a = reader.get_vector<double>(raw_data.n_coeff_a);
+    m_coeff_a.assign(coeff_a.begin(), coeff_a.end());
+    const auto coeff_b = reader.get_vector<double>(raw_data.n_coeff_b);
+    m_coeff_b.assign(coeff_b.begin(), coeff_b.end());
+    const auto in_signal = reader.get_vector<double>(raw_data.in_n);
+    m_in_signal_mem.assign(in_signal.begin(), in_signal.end());
+    const auto out_signal = reader.get_vector<double>(raw_data.out_n);
+    m_out_signal_mem.assign(out_signal.begin(), out_signal.end());
+    const auto delayed = reader.get_vector<double>(raw_data.delay_n);
+    m_delay_mem.assign(delayed.begin(), delayed.end());
+
+    m_transport_delay = static_cast<uint32_t>(raw_data.delay_n);
+    m_noise_mean = raw_data.dist_mean;
+    m_noise_stddev = raw_data.dist_stddev;
+    // The noise generator is counter-based, so restoring its state is just setting the counter.
+    // Version 0 used a Mersenne Twister, whose stream must be replayed.
+    m_init_seed = raw_data.init_seed;
+    m_n_generated = raw_data.n_generated;
+    if (version == 0)
+        m_legacy_noise.emplace(m_init_seed, m_n_generated, m_noise_mean, m_noise_stddev);
+}
+
 void ModelARX::set_coeff_a(std::vector<double> &&coefficients) noexcept
 {
     const auto a_elems{ coefficients.size() };
     m_out_signal_mem.resize(a_elems);
-    m_coeff_a = coefficients;
+    m_coeff_a.assign(coefficients.begin(), coefficients.end());
 }
 
 void ModelARX::set_coeff_b(std::vector<double> &&coefficients) noexcept
 {
     const auto b_elems{ coefficients.size() };
     m_in_signal_mem.resize(b_elems);
-    m_coeff_b = coefficients;
+    m_coeff_b.assign(coefficients.begin(), coefficients.end());
 }
 
 void ModelARX::set_transport_delay(const int32_t delay)
@@ -56,85 +146,109 @@ void ModelARX::set_stddev(const double stddev)
     if (!std::isfinite(stddev) || stddev < 0.0) {
         throw std::runtime_error{ "Standard deviation must be finite and nonnegative" };
     }
-    m_distribution.param(typename decltype(m_distribution)::param_type{ 0.0, stddev });
+    m_noise_mean = 0.0;
+    m_noise_stddev = stddev;
+}
+
+void ModelARX::reseed(std::uint64_t seed)
+{
+    m_legacy_noise.reset();
+    m_init_seed = seed;
+    m_n_generated = 0;
 }
 
-double ModelARX::symuluj(double u)
+double ModelARX::symuluj(double u) { return step(u, get_random()); }
+
+double ModelARX::step(double u, double noise)
 {
-    if (m_in_signal_mem.size())
-        m_in_signal_mem.pop_back();
-    m_in_signal_mem.push_front(m_delay_mem.back());
-    m_delay_mem.pop_back();
+    const double delayed{ m_delay_mem.back() };
     m_delay_mem.push_front(u);
-    const auto b_poly{ std::inner_product(m_coeff_b.begin(), m_coeff_b.end(),
-                                          m_in_signal_mem.begin(), 0.0) };
-    const auto a_poly{ std::inner_product(m_coeff_a.begin(), m_coeff_a.end(),
-                                          m_out_signal_mem.begin(), 0.0) };
-    const double noise{ get_random() };
+    m_in_signal_mem.push_front(delayed);
+    // Histories are contiguous and newest-first, so the summation order is the same as it was with
+    // std::deque and the results are bit-identical (unless fast math is enabled)
+    const auto b_poly{ dot_product(m_coeff_b.data(), m_in_signal_mem.data(), m_coeff_b.size()) };
+    const auto a_poly{ dot_product(m_coeff_a.data(), m_out_signal_mem.data(), m_coeff_a.size()) };
     const auto y{ b_poly - a_poly + noise };
-    if (m_out_signal_mem.size())
-        m_out_signal_mem.pop_back();
     m_out_signal_mem.push_front(y);
     return y;
 }
 
-std::vector<uint8_t> ModelARX::dump() const
+void ModelARX::simulate_block(std::span<const double> in, std::span<double> out)
+{
+    check_block(in, out);
+    std::array<double, 256> noise_buffer;
+    for (std::size_t offset = 0; offset < in.size(); offset += noise_buffer.size()) {
+        const auto n = std::min(noise_buffer.size(), in.size() - offset);
+        const auto noise = std::span{ noise_buffer }.first(n);
+        draw_noise(noise);
+        for (std::size_t i = 0; i < n; ++i)
+            out[offset + i] = step(in[offset + i], noise[i]);
+    }
+}
+
+std::optional<double> ModelARX::steady_output(double u) const
+{
+    // Noise changes every output (the legacy stream changes its state even without noise) and
+    // empty histories grow in the first step
+    if (m_noise_stddev != 0.0 || m_legacy_noise || m_in_signal_mem.empty()
+        || m_out_signal_mem.empty())
+        return std::nullopt;
+    const auto is_u = [u](double x) { return same_bits(x, u); };
+    if (!std::ranges::all_of(m_delay_mem, is_u) || !std::ranges::all_of(m_in_signal_mem, is_u))
+        return std::nullopt;
+    // Input histories stay the same after the next step, so the output is computed as in step()
+    const auto b_poly{ dot_product(m_coeff_b.data(), m_in_signal_mem.data(), m_coeff_b.size()) };
+    const auto a_poly{ dot_product(m_coeff_a.data(), m_out_signal_mem.data(), m_coeff_a.size()) };
+    const auto y{ b_poly - a_poly + m_noise_mean };
+    if (!std::ranges::all_of(m_out_signal_mem, [y](double x) { return same_bits(x, y); }))
+        return std::nullopt;
+    return y;
+}
+
+void ModelARX::skip_steady([[maybe_unused]] double u, std::size_t n) { m_n_generated += n; }
+
+std::size_t ModelARX::dump_size() const noexcept
+{
+    const auto n_doubles = m_coeff_a.size() + m_coeff_b.size() + m_in_signal_mem.size()
+        + m_out_signal_mem.size() + m_delay_mem.size();
+    const auto version_size = m_legacy_noise ? 0 : sizeof(uint64_t);
+    return sizeof(uint32_t) + prefix_size + sizeof(raw_data_t) + version_size
+        + n_doubles * sizeof(double);
+}
+
+void ModelARX::write_dump(ByteWriter &out) const
 {
-    const std::size_t prefix_size = unique_name.size() * sizeof(decltype(unique_name)::value_type);
-    const uint64_t n_coeff_a{ m_coeff_a.size() };
-    const uint64_t n_coeff_b{ m_coeff_b.size() };
-    const uint64_t in_n{ m_in_signal_mem.size() };
-    const uint64_t out_n{ m_out_signal_mem.size() };
-    const uint64_t delay_n{ m_delay_mem.size() };
-    const double dist_mean{ m_distribution.mean() };
-    const double dist_stddev{ m_distribution.stddev() };
     // It's easier to deal with a whole struct instead of separate variables
-    const raw_data_t raw{ n_coeff_a, n_coeff_b, dist_mean,   dist_stddev,  in_n,
-                          out_n,     delay_n,   m_init_seed, m_n_generated };
-    // Prepare the output buffer and check some assumptions about its size
-    const std::size_t dump_size{ (n_coeff_a + n_coeff_b + in_n + out_n + delay_n) * 8 + sizeof(raw)
-                                 + prefix_size };
-    const auto len_b = to_bytes(static_cast<uint32_t>(dump_size));
+    const raw_data_t raw{ m_coeff_a.size(),        m_coeff_b.size(),       m_noise_mean,
+                          m_noise_stddev,          m_in_signal_mem.size(), m_out_signal_mem.size(),
+                          m_delay_mem.size(),      m_init_seed,            m_n_generated };
     static_assert(sizeof(raw) == 9U * 8U);
     static_assert(sizeof(double) == 8U);
-    std::vector<uint8_t> serialized(dump_size + sizeof(uint32_t));
-    // Write everything to the buffer
-    auto out_ptr{ serialized.data() };
-    std::memcpy(out_ptr, len_b.data(), sizeof(uint32_t));
-    out_ptr += sizeof(uint32_t);
-    std::memcpy(out_ptr, unique_name.data(), prefix_size);
-    out_ptr += prefix_size;
-    std::memcpy(out_ptr, reinterpret_cast<const uint8_t *>(&raw), sizeof(raw));
-    out_ptr += sizeof(raw);
-    std::memcpy(out_ptr, reinterpret_cast<const uint8_t *>(m_coeff_a.data()), n_coeff_a * 8);
-    out_ptr += n_coeff_a * 8;
-    std::memcpy(out_ptr, reinterpret_cast<const uint8_t *>(m_coeff_b.data()), n_coeff_b * 8);
-    out_ptr += n_coeff_b * 8;
-    std::copy(m_in_signal_mem.begin(), m_in_signal_mem.end(), reinterpret_cast<double *>(out_ptr));
-    out_ptr += in_n * 8;
-    std::copy(m_out_signal_mem.begin(), m_out_signal_mem.end(),
-              reinterpret_cast<double *>(out_ptr));
-    out_ptr += out_n * 8;
-    std::copy(m_delay_mem.begin(), m_delay_mem.end(), reinterpret_cast<double *>(out_ptr));
-    out_ptr += delay_n * 8;
-    // Final size check
-    if (out_ptr != std::to_address(serialized.end()))
-        throw std::runtime_error{ "Serialization is broken" };
-
-    return serialized;
+    out.put(static_cast<uint32_t>(dump_size() - sizeof(uint32_t)));
+    out.put_range(unique_name);
+    out.put(raw);
+    // Models with legacy noise are written as version 0, so that they are restored the same way
+    if (!m_legacy_noise)
+        out.put(format_version);
+    out.put_range(m_coeff_a);
+    out.put_range(m_coeff_b);
+    out.put_range(m_in_signal_mem);
+    out.put_range(m_out_signal_mem);
+    out.put_range(m_delay_mem);
 }
 
 void ModelARX::reset()
 {
-    std::fill(m_in_signal_mem.begin(), m_in_signal_mem.end(), 0.0);
-    std::fill(m_out_signal_mem.begin(), m_out_signal_mem.end(), 0.0);
-    std::fill(m_delay_mem.begin(), m_delay_mem.end(), 0.0);
-    m_distribution.reset();
-    m_mt.seed(m_init_seed);
+    m_in_signal_mem.fill(0.0);
+    m_out_signal_mem.fill(0.0);
+    m_delay_mem.fill(0.0);
     m_n_generated = 0;
+    if (m_legacy_noise)
+        m_legacy_noise->restart(m_init_seed);
 }
 
 #ifdef LAB_TESTS
+#include <deque>
 #include <sstream>
 
 void Testy_ModelARX::test_ModelARX_brakPobudzenia()
@@ -362,6 +476,154 @@ void Testy_ModelARX::test_stream_op()
     std::cerr << (xx == yy ? "OK!\n" : "FAIL!\n");
 }
 
+void Testy_ModelARX::test_history_high_order()
+{
+    std::cerr << "ModelARX (order 64, delay 3) -> bit-identical history: ";
+    constexpr std::size_t order = 64;
+    constexpr std::size_t delay = 3;
+    std::vector<double> coeff_a(order);
+    std::vector<double> coeff_b(order);
+    for (std::size_t i = 0; i < order; ++i) {
+        coeff_a[i] = (i % 2 ? -0.3 : 0.4) / order;
+        coeff_b[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    // Reference implementation based on std::deque, as used before HistoryBuffer
+    std::deque<double> in(order), out(order), delayed(delay);
+    ModelARX model{ std::vector{ coeff_a }, std::vector{ coeff_b }, delay, 0.0 };
+    for (int t = 0; t < 1000; ++t) {
+        const double u = std::sin(t * 0.1) + (t % 7 == 0);
+        in.pop_back();
+        in.push_front(delayed.back());
+        delayed.pop_back();
+        delayed.push_front(u);
+        const auto y = std::inner_product(coeff_b.begin(), coeff_b.end(), in.begin(), 0.0)
+            - std::inner_product(coeff_a.begin(), coeff_a.end(), out.begin(), 0.0);
+        out.pop_back();
+        out.push_front(y);
+        if (model.symuluj(u) != y) {
+            std::cerr << "FAIL!\n";
+            return;
+        }
+    }
+    std::cerr << (std::ranges::equal(model.m_in_signal_mem, in)
+                          && std::ranges::equal(model.m_out_signal_mem, out)
+                          && std::ranges::equal(model.m_delay_mem, delayed)
+                      ? "OK!\n"
+                      : "FAIL!\n");
+}
+
+void Testy_ModelARX::test_simulate_block()
+{
+    std::cerr << "ModelARX -> simulate_block() matches symuluj(): ";
+    try {
+        ModelARX per_sample{ { -0.4, 0.1 }, { 0.6, 0.3 }, 2, 0.05 };
+        ModelARX block{ per_sample };
+        std::vector<double> inputs(100);
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            inputs[i] = std::cos(static_cast<double>(i) * 0.3);
+        std::vector<double> expected(inputs.size());
+        std::ranges::transform(inputs, expected.begin(),
+                               [&](double u) { return per_sample.symuluj(u); });
+        // In-place, split into two blocks
+        auto actual = inputs;
+        block.simulate_block(std::span{ actual }.first(37), std::span{ actual }.first(37));
+        block.simulate_block(std::span{ actual }.subspan(37), std::span{ actual }.subspan(37));
+        std::cerr << (actual == expected && block == per_sample ? "OK!\n" : "FAIL!\n");
+    } catch (...) {
+        std::cerr << "INTERUPTED! (niespodziwany wyjatek)\n";
+    }
+}
+
+void Testy_ModelARX::test_legacy_dump()
+{
+    std::cerr << "Serialization and deserialization -> version 0 dump with legacy noise: ";
+    try {
+        // Output of a model with B = {0} and no A is just the noise
+        ModelARX model{ {}, { 0.0 }, 1, 0.5 };
+        model.m_init_seed = 42;
+        model.m_n_generated = 1000;
+        // Version 0 dumps are the same, but without the version field after the constant part
+        auto dump = model.dump();
+        const auto version_at
+            = sizeof(uint32_t) + ModelARX::prefix_size + sizeof(ModelARX::raw_data_t);
+        dump.erase(dump.begin() + version_at, dump.begin() + version_at + sizeof(uint64_t));
+        const auto length = to_bytes(static_cast<uint32_t>(dump.size() - sizeof(uint32_t)));
+        std::ranges::copy(length, dump.begin());
+
+        std::mt19937_64 engine{ 42 };
+        std::normal_distribution<double> distribution{ 0.0, 0.5 };
+        for (int i = 0; i < 1000; ++i)
+            distribution(engine);
+        ModelARX restored{ dump };
+        ModelARX block{ restored };
+        std::vector<double> expected(300), actual(300);
+        for (auto &e : expected)
+            e = distribution(engine);
+        for (auto &a : actual)
+            a = restored.symuluj(1.0);
+        const bool replayed = restored.has_legacy_noise() && actual == expected;
+        std::vector<double> block_out(300, 1.0);
+        block.simulate_block(block_out, block_out);
+        // Models with legacy noise are dumped as version 0 again
+        const auto legacy_size = restored.dump_size();
+        const bool round_trip = block == restored && ModelARX{ restored.dump() } == restored;
+        restored.reseed(7);
+        const bool reseeded = !restored.has_legacy_noise()
+            && restored.dump_size() == legacy_size + sizeof(uint64_t);
+        // Unknown versions are rejected
+        auto future = model.dump();
+        future[version_at] = static_cast<uint8_t>(ModelARX::format_version + 1);
+        bool rejected = false;
+        try {
+            ModelARX{ future };
+        } catch (const std::runtime_error &) {
+            rejected = true;
+        }
+        std::cerr << (replayed && round_trip && reseeded && rejected ? "OK!\n" : "FAIL!\n");
+    } catch (...) {
+        std::cerr << "INTERUPTED! (niespodziwany wyjatek)\n";
+    }
+}
+
+void Testy_ModelARX::test_legacy_text()
+{
+    std::cerr << "Stream operators -> text without a version restores legacy noise: ";
+    try {
+        ModelARX model{ {}, { 0.0 }, 1, 0.5 };
+        model.m_init_seed = 42;
+        model.m_n_generated = 1000;
+        std::stringstream versioned;
+        versioned << model;
+        const auto text = versioned.str();
+        // Text written before the version was added is the same without the first line
+        std::stringstream legacy{ text.substr(text.find('\n') + 1) };
+        ModelARX restored{ { 0 }, { 1 }, 3, 9.5 };
+        legacy >> restored;
+
+        std::mt19937_64 engine{ 42 };
+        std::normal_distribution<double> distribution{ 0.0, 0.5 };
+        for (int i = 0; i < 1000; ++i)
+            distribution(engine);
+        bool replayed = restored.has_legacy_noise();
+        for (int i = 0; i < 100; ++i)
+            replayed = replayed && restored.symuluj(1.0) == distribution(engine);
+        // Versioned text keeps the counter-based noise and legacy models are written without it
+        ModelARX current{ { 0 }, { 1 }, 3, 9.5 };
+        versioned >> current;
+        std::stringstream legacy_out;
+        legacy_out << restored;
+        const bool round_trip = versioned && current == model && !current.has_legacy_noise()
+            && legacy_out.str().front() != 'v';
+        // Unknown versions are rejected
+        std::stringstream future{ "v" + std::to_string(ModelARX::format_version + 1) + "\n"
+                                  + text.substr(text.find('\n') + 1) };
+        future >> current;
+        std::cerr << (replayed && round_trip && future.fail() ? "OK!\n" : "FAIL!\n");
+    } catch (...) {
+        std::cerr << "INTERUPTED! (niespodziwany wyjatek)\n";
+    }
+}
+
 void Testy_ModelARX::run_tests()
 {
     test_ModelARX_brakPobudzenia();
@@ -375,6 +637,10 @@ void Testy_ModelARX::run_tests()
     test_dump_very_small();
     test_dump_file();
     test_stream_op();
+    test_history_high_order();
+    test_simulate_block();
+    test_legacy_dump();
+    test_legacy_text();
 }
 #endif
 
@@ -386,8 +652,11 @@ std::ostream &operator<<(std::ostream &os, const ModelARX &m)
     os.flags(std::ios::dec | std::ios::left | std::ios::fixed);
     os.precision(std::numeric_limits<double>::max_digits10);
     os.fill(' ');
-    // Format similar to the one used in OI and competitive programming
-    os << m.m_distribution.mean() << ' ' << m.m_distribution.stddev() << '\n'
+    // Format similar to the one used in OI and competitive programming. Models with legacy noise
+    // are written without the version, so that they are restored the same way.
+    if (!m.m_legacy_noise)
+        os << 'v' << ModelARX::format_version << '\n';
+    os << m.m_noise_mean << ' ' << m.m_noise_stddev << '\n'
        << m.m_init_seed << ' ' << m.m_n_generated << '\n'
        << m.m_coeff_a.size() << '\n';
     auto delim{ "" };
@@ -431,18 +700,32 @@ std::istream &operator>>(std::istream &is, ModelARX &m)
     uint64_t seed, n_generated;
     const auto flags = is.flags();
     is.flags(std::ios::dec | std::ios::skipws);
+    // Text written before the version was added starts with the mean
+    uint64_t version = 0;
+    if ((is >> std::ws).peek() == 'v') {
+        is.get();
+        is >> version;
+        if (version > ModelARX::format_version)
+            is.setstate(std::ios::failbit);
+    }
+    if (!is) {
+        is.flags(flags);
+        return is;
+    }
     is >> dist_mean >> dist_stddev >> seed >> n_generated;
-    m.m_distribution = decltype(m.m_distribution){ dist_mean, dist_stddev };
-    m.m_mt.seed(seed);
+    m.m_noise_mean = dist_mean;
+    m.m_noise_stddev = dist_stddev;
     m.m_init_seed = seed;
-    m.m_n_generated = 0;
-    while (m.m_n_generated < n_generated)
-        m.get_random();
+    m.m_n_generated = n_generated;
+    m.m_legacy_noise.reset();
     const auto read_container = [&is](auto &container) -> uint64_t {
         uint64_t num;
         is >> num;
-        container.resize(num);
-        std::copy_n(std::istream_iterator<double>(is), num, container.begin());
+        // std::istream_iterator reads a value when it's constructed, even if none is expected
+        std::vector<double> values(num);
+        for (auto &v : values)
+            is >> v;
+        container.assign(values.begin(), values.end());
         return num;
     };
     read_container(m.m_coeff_a);
@@ -451,6 +734,9 @@ std::istream &operator>>(std::istream &is, ModelARX &m)
     read_container(m.m_out_signal_mem);
     auto delay = read_container(m.m_delay_mem);
     m.m_transport_delay = static_cast<uint32_t>(delay);
+    if (version == 0)
+        m.m_legacy_noise.emplace(m.m_init_seed, m.m_n_generated, m.m_noise_mean,
+                                 m.m_noise_stddev);
     is.flags(flags);
     return is;
 }
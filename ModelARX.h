@@ -1,12 +1,13 @@
 #pragma once
 #include <cstdint>
 #include <cstring>
-#include <deque>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
 #include <memory>
-#include <random>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <vector>
 #include <version>
@@ -14,13 +15,19 @@
 #include <format>
 #endif
 
+#include "HistoryBuffer.hpp"
 #include "ObiektSISO.h"
+#include "legacy_noise.hpp"
+#include "philox.hpp"
 
 /// Autoregressive exogenous model implementation derived from ObiektSISO.
 class ModelARX : public ObiektSISO {
 public:
     /// Unique name/prefix used to distinguish types in deserialization.
     static constexpr std::string_view unique_name{ "mARX" };
+    /// @brief Version of the binary format written by models with Philox noise.
+    /// @details Dumps without the version field have version 0, see LegacyNoise.
+    static constexpr std::uint64_t format_version{ 1 };
 
 private:
     /// Size of the unique prefix.
@@ -28,25 +35,27 @@ private:
                                               * sizeof(decltype(unique_name)::value_type) };
 
     /// Polynomial A coefficients.
-    std::vector<double> m_coeff_a;
+    std::pmr::vector<double> m_coeff_a;
     /// Polynomial B coefficients.
-    std::vector<double> m_coeff_b;
+    std::pmr::vector<double> m_coeff_b;
     /// Delay of input samples.
     uint32_t m_transport_delay;
-    /// Distribution used for noise generation.
-    std::normal_distribution<double> m_distribution;
-    /// Queue of input samples after delay.
-    std::deque<double> m_in_signal_mem;
-    /// Queue of output samples.
-    std::deque<double> m_out_signal_mem;
-    /// Queue of input samples being delayed.
-    std::deque<double> m_delay_mem;
-    /// Initial seed of random number generator.
+    /// Mean of the normally distributed noise.
+    double m_noise_mean{};
+    /// Standard deviation of the normally distributed noise.
+    double m_noise_stddev{};
+    /// History of input samples after delay (newest first).
+    HistoryBuffer<double, std::pmr::polymorphic_allocator<double>> m_in_signal_mem;
+    /// History of output samples (newest first).
+    HistoryBuffer<double, std::pmr::polymorphic_allocator<double>> m_out_signal_mem;
+    /// History of input samples being delayed (newest first).
+    HistoryBuffer<double, std::pmr::polymorphic_allocator<double>> m_delay_mem;
+    /// Key (seed) of the counter-based (Philox) noise stream.
     std::uint64_t m_init_seed;
-    /// Number of random numbers generated since seeding the generator.
+    /// Number of random numbers generated since seeding, position in the noise stream.
     std::uint64_t m_n_generated{};
-    /// Mersenne Twister engine used as PRNG.
-    std::mt19937_64 m_mt;
+    /// Noise stream of a model loaded from a version 0 dump, used instead of the Philox stream.
+    std::optional<LegacyNoise> m_legacy_noise{};
 
     /// Helper structure containing class properties with known size for easier (de)serialization.
     struct raw_data_t {
@@ -54,9 +63,9 @@ private:
         uint64_t n_coeff_a;
         /// Size of ModelARX::m_coeff_b.
         uint64_t n_coeff_b;
-        /// Mean of ModelARX::m_distribution.
+        /// Copy of ModelARX::m_noise_mean.
         double dist_mean;
-        /// Standard deviation of ModelARX::m_distribution.
+        /// Copy of ModelARX::m_noise_stddev.
         double dist_stddev;
         /// Size of ModelARX::m_in_signal_mem.
         uint64_t in_n;
@@ -71,18 +80,40 @@ private:
     };
     static_assert(std::is_trivial_v<raw_data_t> && std::is_standard_layout_v<raw_data_t>);
 
-    /// Draw a random number from #m_mt using #m_distribution and increment #m_n_generated counter.
+    /// @brief Draw the noise sample at position #m_n_generated of the noise stream and increment
+    /// the counter.
     double get_random();
+    /// @brief Draw consecutive noise samples for a block and advance the counter.
+    /// @param noise output buffer, filled with the next `noise.size()` samples
+    void draw_noise(std::span<double> noise);
+    /// @brief Perform one simulation step with a given noise sample.
+    /// @param u input
+    /// @param noise noise added to the output
+    /// @return Simulated model's response
+    double step(double u, double noise);
+
+protected:
+    /// @brief Write a binary dump of the model. Format is platform-specific, for sure won't work
+    /// with different endianness
+    /// @param out writer over a buffer of dump_size() bytes
+    void write_dump(ByteWriter &out) const override;
 
 public:
     ModelARX() = delete;
-    /// @brief Deserializing constructor from vector of `uint8_t`.
+    /// @brief Deserializing constructor from a span of `uint8_t`.
+    ///
+    /// The data does not have to be aligned, so it may be a part of a larger buffer. Restoring the
+    /// noise is O(1), except for version 0 dumps, whose legacy noise stream is replayed.
     ///
-    /// Uses @link ModelARX::ModelARX(Iter, Iter)@endlink with the `data` vector's iterators.
+    /// @param data bytes representing serialized ModelARX
+    ModelARX(std::span<const uint8_t> data);
+    /// @brief Deserializing constructor, which allocates coefficients and histories in an arena.
     ///
-    /// @param data vector of bytes representing serialized ModelARX
-    ModelARX(const std::vector<uint8_t> &data)
-        : ModelARX{ data.cbegin(), data.cend() } {};
+    /// Copies of the model allocate their buffers with the default memory resource.
+    ///
+    /// @param data bytes representing serialized ModelARX
+    /// @param arena memory resource for the buffers, `nullptr` for the default one
+    ModelARX(std::span<const uint8_t> data, std::pmr::memory_resource *arena);
     /// @brief Deserializing constructor from a pair of iterators over `uint8_t`.
     /// @param start iterator to the beginning of the range
     /// @param end end iterator of the range
@@ -90,65 +121,9 @@ public:
         requires std::contiguous_iterator<Iter>
         && std::is_same_v<typename std::iterator_traits<Iter>::value_type, uint8_t>
     ModelARX(Iter start, Iter end)
+        : ModelARX{ std::span<const uint8_t>{ std::to_address(start),
+                                              static_cast<std::size_t>(end - start) } }
     {
-        const auto data_size{ std::distance(start, end) };
-        if (data_size
-            < static_cast<std::ptrdiff_t>(sizeof(raw_data_t) + prefix_size + sizeof(uint32_t)))
-            throw std::runtime_error{ "Data size is smaller than constant-length part" };
-
-        // skip the length
-        start += sizeof(uint32_t);
-        const uint8_t *s_ptr = &*start;
-        if (!prefix_match(unique_name, std::ranges::subrange{ start, end }))
-            throw std::runtime_error{
-                "ModelARX serialized data does not start with the expected prefix"
-            };
-
-        s_ptr += prefix_size;
-        raw_data_t raw_data;
-        std::memcpy(&raw_data, s_ptr, sizeof(raw_data_t));
-        const auto expected_size{ static_cast<std::ptrdiff_t>(
-            (raw_data.n_coeff_a + raw_data.n_coeff_b + raw_data.in_n + raw_data.out_n
-             + raw_data.delay_n)
-                * 8
-            + sizeof(raw_data_t) + prefix_size + sizeof(uint32_t)) };
-        if (data_size != expected_size)
-            throw std::runtime_error{
-#if __cpp_lib_format >= 201907L
-                std::format("Data size ({} bytes) does not match the expected size ({} bytes)",
-                            data_size, expected_size)
-#else
-                "Data size does not match the expected size"
-#endif
-            };
-
-        auto vec_start = reinterpret_cast<const double *>(s_ptr + sizeof(raw_data_t));
-        auto vec_end = vec_start + raw_data.n_coeff_a;
-        m_coeff_a = std::vector<double>(vec_start, vec_end);
-        vec_start = vec_end;
-        vec_end += raw_data.n_coeff_b;
-        m_coeff_b = std::vector<double>(vec_start, vec_end);
-        vec_start = vec_end;
-        vec_end += raw_data.in_n;
-        m_in_signal_mem = decltype(m_in_signal_mem)(vec_start, vec_end);
-        vec_start = vec_end;
-        vec_end += raw_data.out_n;
-        m_out_signal_mem = decltype(m_out_signal_mem)(vec_start, vec_end);
-        vec_start = vec_end;
-        vec_end += raw_data.delay_n;
-        m_delay_mem = decltype(m_delay_mem)(vec_start, vec_end);
-
-        m_transport_delay = static_cast<uint32_t>(raw_data.delay_n);
-        m_init_seed = raw_data.init_seed;
-        // Restore generator state by initializing it with original seed and skipping the same
-        // number of results. It may be inefficient, but the STL implementation of Mersenne Twister
-        // does not expose the internal state and I don't want to use implementation-specific
-        // solutions, which could break in other versions of libstdc++, libc++ and MSVC STL.
-        // m_mt.discard(m_n_generated) won't work, because the distribution has its own state...
-        m_mt = std::mt19937_64{ static_cast<decltype(m_mt)::result_type>(m_init_seed) };
-        m_distribution = decltype(m_distribution)(raw_data.dist_mean, raw_data.dist_stddev);
-        while (m_n_generated < raw_data.n_generated)
-            get_random();
     }
     /// @brief Regular constructor accepting basic parameters.
     /// @param coeff_a coefficients of the A polynomial
@@ -158,13 +133,17 @@ public:
     ModelARX(std::vector<double> &&coeff_a, std::vector<double> &&coeff_b, const int32_t delay = 1,
              const double stddev = 0.0);
     /// Polynomial A coefficents (#m_coeff_a) getter
-    constexpr const std::vector<double> &get_coeff_a() const noexcept { return m_coeff_a; }
+    constexpr std::span<const double> get_coeff_a() const noexcept { return m_coeff_a; }
     /// Polynomial B coefficents (#m_coeff_b) getter
-    constexpr const std::vector<double> &get_coeff_b() const noexcept { return m_coeff_b; }
+    constexpr std::span<const double> get_coeff_b() const noexcept { return m_coeff_b; }
     /// Transport delay (#m_transport_delay) getter
     constexpr uint32_t get_transport_delay() const noexcept { return m_transport_delay; }
     /// Noise standard deviation getter
-    double get_stddev() const { return m_distribution.stddev(); }
+    constexpr double get_stddev() const noexcept { return m_noise_stddev; }
+    /// Noise mean getter
+    constexpr double get_mean() const noexcept { return m_noise_mean; }
+    /// Check if the noise is drawn from the stream of a version 0 dump (see LegacyNoise).
+    constexpr bool has_legacy_noise() const noexcept { return m_legacy_noise.has_value(); }
     /// Polynomial A coefficents (#m_coeff_a) setter
     void set_coeff_a(std::vector<double> &&coefficients) noexcept;
     /// Polynomial B coefficents (#m_coeff_b) setter
@@ -173,26 +152,58 @@ public:
     void set_transport_delay(const int32_t delay);
     /// Noise standard deviation setter
     void set_stddev(const double stddev);
+    /// @brief Reseed the noise generator.
+    ///
+    /// Sets the noise stream key (#m_init_seed) and zeros RNG counter (#m_n_generated). A model
+    /// with legacy noise switches to a Philox stream. Signal histories are not changed.
+    ///
+    /// @param seed new seed
+    void reseed(std::uint64_t seed);
     /// @brief Simulate model's response to input `u`.
     /// @param u input
     /// @return Simulated model's response
     double symuluj(double u) override;
-    /// @brief Prepare a binary dump of the model. Format is platform-specific, for sure won't work
-    /// with different endianness
-    /// @return Byte buffer containing all data necessary to restore the object
-    std::vector<uint8_t> dump() const override;
+    /// @brief Simulate model's response to a block of inputs.
+    ///
+    /// Produces the same results as consecutive symuluj() calls, without virtual dispatch. Noise
+    /// for the block is drawn in batches.
+    ///
+    /// @param in inputs
+    /// @param out simulated model's responses, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    void simulate_block(std::span<const double> in, std::span<double> out) override;
+    /// @brief Output of the model in a steady state for a constant input.
+    ///
+    /// A model without noise is in a steady state when all delayed and past inputs are `u` and all
+    /// past outputs are equal to the output computed from them, i.e. it converged to a fixed point
+    /// (bit for bit, which a stable model near equilibrium usually reaches in floating point).
+    ///
+    /// @param u constant input
+    /// @return Output of symuluj(u) or `std::nullopt` if the model is not in a steady state.
+    std::optional<double> steady_output(double u) const override;
+    /// @brief Skip steps in a steady state, advancing only the noise stream counter.
+    /// @param u constant input, steady_output(u) must have a value
+    /// @param n number of skipped steps
+    void skip_steady(double u, std::size_t n) override;
+    std::size_t dump_size() const noexcept override;
     /// @brief Reset model's state
     ///
-    /// Fills all queues with `0`s, reseeds the PRNG, resets distribution state (#m_distribution)
-    /// and zeros RNG counter (#m_n_generated).
+    /// Fills all queues with `0`s and zeros RNG counter (#m_n_generated), which restarts the noise
+    /// stream (legacy streams too).
     void reset() override;
 
     friend bool operator==(const ModelARX &, const ModelARX &) = default;
     friend bool operator!=(const ModelARX &, const ModelARX &) = default;
-    /// Stream output operator, which writes full object state in text form.
+    /// @brief Stream output operator, which writes full object state in text form.
+    /// @details The text starts with the format version, except for models with legacy noise,
+    /// which are written without it (version 0), like dump().
     friend std::ostream &operator<<(std::ostream &os, const ModelARX &m);
-    /// Stream input operator, which can reconfigure the object to match provided the text form.
+    /// @brief Stream input operator, which reconfigures the object to match the text form.
+    /// @details Text without a version restores the legacy noise stream. Sets `failbit` if the
+    /// version is newer than #format_version.
     friend std::istream &operator>>(std::istream &is, ModelARX &m);
+    friend class BatchARX;
+    template <typename Regulator, typename Model> friend class FeedbackLoop;
 #ifdef LAB_TESTS
     friend class Testy_ModelARX;
 #endif
@@ -212,6 +223,10 @@ private:
     static void test_dump_very_small();
     static void test_dump_file();
     static void test_stream_op();
+    static void test_history_high_order();
+    static void test_simulate_block();
+    static void test_legacy_dump();
+    static void test_legacy_text();
 
 public:
     static void run_tests();
@@ -1,9 +1,33 @@
 #include "ObiektSISO.h"
 
-std::vector<std::pair<std::vector<std::uint8_t>,
-                      std::unique_ptr<ObiektSISO> (*)(const std::vector<std::uint8_t> &)>>
+constinit PrefixRegistry<component_ptr (*)(std::span<const std::uint8_t>,
+                                           std::pmr::memory_resource *)>
     siso_deserializers{};
 
+void ComponentDeleter::operator()(ObiektSISO *component) const noexcept
+{
+    if (m_in_arena)
+        std::destroy_at(component);
+    else
+        delete component;
+}
+
+std::unique_ptr<ObiektSISO> ObiektSISO::deserialize(std::span<const uint8_t> serialized)
+{
+    return std::unique_ptr<ObiektSISO>{ deserialize(serialized, nullptr).release() };
+}
+
+component_ptr ObiektSISO::deserialize(std::span<const uint8_t> serialized,
+                                      std::pmr::memory_resource *arena)
+{
+    // The name follows the length of the serialized object
+    if (serialized.size() >= sizeof(uint32_t)) {
+        if (const auto factory = siso_deserializers.find(serialized.subspan(sizeof(uint32_t))))
+            return factory(serialized, arena);
+    }
+    throw std::runtime_error{ "Serialized data does not match any known object." };
+}
+
 #ifdef LAB_TESTS
 #include <cmath>
 #include <iomanip>
@@ -2,29 +2,97 @@
 
 #pragma once
 #include "define_fixes.hpp"
+#include "prefix_registry.hpp"
 #include "util.hpp"
 #include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 class ObiektSISO;
 
-/// Vector of [prefix, deserializer function] pairs.
-extern std::vector<
-    std::pair<std::vector<uint8_t>, std::unique_ptr<ObiektSISO> (*)(const std::vector<uint8_t> &)>>
+/// @brief Deleter of components, which may be allocated in an arena.
+///
+/// Memory of components allocated in an arena (a `std::pmr::monotonic_buffer_resource`) is released
+/// by the arena all at once, so only their destructors are called. Other components were allocated
+/// with `new` and are deleted.
+class ComponentDeleter {
+    /// Whether the component was allocated in an arena.
+    bool m_in_arena{};
+
+public:
+    /// Deleter of components allocated with `new`.
+    constexpr ComponentDeleter() noexcept = default;
+    /// @brief Construct a deleter.
+    /// @param in_arena whether the component was allocated in an arena
+    constexpr explicit ComponentDeleter(bool in_arena) noexcept
+        : m_in_arena{ in_arena }
+    {
+    }
+    /// Conversion from the default deleter, so that `std::unique_ptr`s can be converted.
+    template <typename T> constexpr ComponentDeleter(std::default_delete<T>) noexcept { }
+    /// Check if the component was allocated in an arena.
+    constexpr bool in_arena() const noexcept { return m_in_arena; }
+    /// Destroy and (unless allocated in an arena) deallocate the component.
+    void operator()(ObiektSISO *component) const noexcept;
+};
+/// Owning pointer to a component, which may be allocated in an arena.
+using component_ptr = std::unique_ptr<ObiektSISO, ComponentDeleter>;
+
+/// @brief Construct a component in an arena or on the heap.
+///
+/// Components constructible with an additional `std::pmr::memory_resource *` argument get the arena
+/// to allocate their own buffers from.
+///
+/// @tparam T type of the component
+/// @param arena arena to allocate the component in, `nullptr` to allocate it with `new`
+/// @param args arguments of the component's constructor
+/// @return Owning pointer to the component.
+template <typename T, typename... Args>
+component_ptr make_component(std::pmr::memory_resource *arena, Args &&...args)
+{
+    if (arena == nullptr)
+        return component_ptr{ new T(std::forward<Args>(args)...) };
+    void *const memory = arena->allocate(sizeof(T), alignof(T));
+    try {
+        T *component;
+        if constexpr (std::is_constructible_v<T, Args..., std::pmr::memory_resource *>)
+            component = ::new (memory) T(std::forward<Args>(args)..., arena);
+        else
+            component = ::new (memory) T(std::forward<Args>(args)...);
+        return component_ptr{ component, ComponentDeleter{ true } };
+    } catch (...) {
+        arena->deallocate(memory, sizeof(T), alignof(T));
+        throw;
+    }
+}
+
+/// @brief Registry of deserializer functions, indexed by the unique names of the classes.
+/// @details The deserializers construct components in the given arena, or with `new` if it is
+/// `nullptr`.
+extern constinit PrefixRegistry<component_ptr (*)(std::span<const uint8_t>,
+                                                  std::pmr::memory_resource *)>
     siso_deserializers;
+/// @brief Deserializer of class `T` added to #siso_deserializers by #DESERIALIZABLE_SISO.
+template <typename T>
+component_ptr deserialize_component(std::span<const uint8_t> bin_data,
+                                    std::pmr::memory_resource *arena)
+{
+    return make_component<T>(arena, bin_data);
+}
 /// @brief Declare class @a class_name as deserializable and add its deserializer to
 /// #siso_deserializers.
-/// @details The class must have a `::unique_name` member.
+/// @details The class must have a `::unique_name` member. Names must be prefix-free, see
+/// PrefixRegistry::add(). The registration is an inline variable, so it runs once per program,
+/// not once per translation unit including the class.
 #define DESERIALIZABLE_SISO(class_name)                                                            \
-    namespace {                                                                                    \
-        [[maybe_unused]] const auto __add_serializable_generator__##class_name                     \
-            = siso_deserializers.emplace_back(                                                     \
-                std::ranges::to<std::vector<uint8_t>>(range_to_bytes(class_name::unique_name)),    \
-                [](const std::vector<uint8_t> &bin_data) -> std::unique_ptr<ObiektSISO> {          \
-                    return std::make_unique<class_name>(bin_data);                                 \
-                });                                                                                \
-    }
+    [[maybe_unused]] inline const bool __add_serializable_generator__##class_name                  \
+        = siso_deserializers.add(class_name::unique_name, &deserialize_component<class_name>)
 
 /// Abstract class describing an object with single input and single output.
 class ObiektSISO {
@@ -35,14 +103,91 @@ public:
     /// @param u simulation input
     /// @return simulation output
     virtual double symuluj(double u) = 0;
+    /// @brief Simulate a block of consecutive samples.
+    ///
+    /// Equivalent to calling symuluj() for every element of `in` in order and storing the results
+    /// in `out`, but derived classes can override it to avoid one virtual call per sample. `in` and
+    /// `out` may refer to the same memory (in-place simulation), but must not partially overlap.
+    ///
+    /// @param in simulation inputs
+    /// @param out simulation outputs, must have the same size as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    virtual void simulate_block(std::span<const double> in, std::span<double> out)
+    {
+        check_block(in, out);
+        for (std::size_t i = 0; i < in.size(); ++i)
+            out[i] = symuluj(in[i]);
+    }
+    /// @brief Output of the object in a steady state for a constant input.
+    ///
+    /// The object is in a steady state for input `u` if every following symuluj(u) call would
+    /// return the same output and leave the state bit-identical, except for what skip_steady()
+    /// updates. Objects which can't tell are never in a steady state.
+    ///
+    /// @param u constant input
+    /// @return Output of symuluj(u) or `std::nullopt` if the object is not in a steady state.
+    virtual std::optional<double> steady_output([[maybe_unused]] double u) const
+    {
+        return std::nullopt;
+    }
+    /// @brief Skip steps in a steady state.
+    ///
+    /// Leaves the object in the same state as `n` symuluj(u) calls would, without simulating them.
+    ///
+    /// @param u constant input, steady_output(u) must have a value
+    /// @param n number of skipped steps
+    virtual void skip_steady([[maybe_unused]] double u, [[maybe_unused]] std::size_t n) { }
+    /// @brief Size of the serialized object.
+    /// @return Exact number of bytes written by dump_to() and returned by dump().
+    virtual std::size_t dump_size() const = 0;
+    /// @brief Serialize the object into a caller-provided buffer without allocating.
+    /// @param out output buffer, the first dump_size() bytes are overwritten
+    /// @return The part of `out` after the serialized object.
+    /// @throws `std::runtime_error` if `out` is smaller than dump_size().
+    std::span<uint8_t> dump_to(std::span<uint8_t> out) const
+    {
+        const auto n = dump_size();
+        if (out.size() < n)
+            throw std::runtime_error{ "Serialization buffer is too small" };
+        ByteWriter writer{ out.first(n) };
+        write_dump(writer);
+        if (writer.remaining() != 0)
+            throw std::runtime_error{ "Serialization is broken" };
+        return out.subspan(n);
+    }
     /// @brief Serialize the object.
     /// @return A vector of bytes (`uint8_t`) from which the object can be reconstructed.
-    virtual std::vector<uint8_t> dump() const = 0;
+    std::vector<uint8_t> dump() const
+    {
+        std::vector<uint8_t> serialized(dump_size());
+        dump_to(serialized);
+        return serialized;
+    }
     virtual ~ObiektSISO() = default;
 
     /// @brief Deserialize `serialized` into an ObiektSISO derived class based on data prefix.
     ///
-    /// The serialized (target) class must be registered using #DESERIALIZABLE_SISO.
+    /// The serialized (target) class must be registered using #DESERIALIZABLE_SISO. Objects are
+    /// constructed directly from `serialized`, nested objects from subspans of it.
+    ///
+    /// @param serialized byte representation of an ObiektSISO derived class
+    /// @return A unique pointer owning a deserialized instance of an appropriate class
+    /// @throws `std::runtime_error` if the data does not match any registered class.
+    static std::unique_ptr<ObiektSISO> deserialize(std::span<const uint8_t> serialized);
+    /// @brief Deserialize `serialized` into a component allocated in an arena.
+    ///
+    /// Nested objects and buffers of the deserialized objects are allocated in the arena too, in
+    /// the order in which they are serialized.
+    ///
+    /// @param serialized byte representation of an ObiektSISO derived class
+    /// @param arena monotonic arena to allocate in, `nullptr` to allocate with `new`
+    /// @return An owning pointer to a deserialized instance of an appropriate class
+    /// @throws `std::runtime_error` if the data does not match any registered class.
+    static component_ptr deserialize(std::span<const uint8_t> serialized,
+                                     std::pmr::memory_resource *arena);
+    /// @brief Deserialize a range of bytes, see deserialize(std::span<const uint8_t>).
+    ///
+    /// Contiguous ranges of `uint8_t` are viewed as a span, other ranges are copied first.
     ///
     /// @tparam T type of input range over bytes
     /// @param serialized byte representation of an ObiektSISO derived class
@@ -52,20 +197,41 @@ public:
         requires ByteRepr<std::ranges::range_value_t<T>>
     static std::unique_ptr<ObiektSISO> deserialize(const T &serialized)
     {
-        for (const auto &[name, factory] : siso_deserializers) {
-#if __cpp_lib_ranges_starts_ends_with >= 202106L
-            if (std::ranges::starts_with(serialized | std::views::drop(sizeof(uint32_t)), name))
-#else
-            if (std::ranges::mismatch(serialized | std::views::drop(sizeof(uint32_t)), name).in2
-                == std::ranges::end(name))
-#endif
-                return factory(serialized | std::ranges::to<std::vector<uint8_t>>());
+        if constexpr (std::ranges::contiguous_range<T> && std::ranges::sized_range<T>
+                      && std::same_as<std::ranges::range_value_t<T>, uint8_t>) {
+            return deserialize(std::span<const uint8_t>{ std::ranges::data(serialized),
+                                                         std::ranges::size(serialized) });
+        } else {
+            const auto copy = serialized
+                | std::views::transform([](auto b) { return static_cast<uint8_t>(b); })
+                | std::ranges::to<std::vector<uint8_t>>();
+            return deserialize(std::span<const uint8_t>{ copy });
         }
-        throw std::runtime_error{ "Serialized data does not match any known object." };
     }
 
     friend bool operator==(const ObiektSISO &, const ObiektSISO &) = default;
     friend bool operator!=(const ObiektSISO &, const ObiektSISO &) = default;
+
+protected:
+    /// @brief Write exactly dump_size() bytes of the serialized object.
+    /// @param out writer over a buffer of dump_size() bytes
+    virtual void write_dump(ByteWriter &out) const = 0;
+    /// @brief Write a nested object, for use in write_dump() of containers.
+    /// @param object the nested object
+    /// @param out writer with at least `object.dump_size()` bytes left
+    static void write_nested(const ObiektSISO &object, ByteWriter &out)
+    {
+        object.write_dump(out);
+    }
+    /// @brief Check if input and output blocks have the same size.
+    /// @param in simulation inputs
+    /// @param out simulation outputs
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    static constexpr void check_block(std::span<const double> in, std::span<double> out)
+    {
+        if (in.size() != out.size())
+            throw std::runtime_error{ "Input and output blocks must have the same size" };
+    }
 };
 
 #ifdef LAB_TESTS
@@ -1,6 +1,7 @@
 #pragma once
 #include "ObiektSISO.h"
 #include <algorithm>
+#include <limits>
 #include <stdexcept>
 #include <utility>
 
@@ -90,6 +91,29 @@ public:
         return { point{ (m_min_val - m_b) / m_a, m_min_val },
                  point{ (m_max_val - m_b) / m_a, m_max_val } };
     }
+    /// @brief Construct an object which does not clamp its outputs.
+    /// @param a slope of the linear function
+    /// @param b offset of the linear function
+    /// @return An object simulating @f$f(u) = a \times u + b@f$.
+    static constexpr ObiektStatyczny unbounded(double a, double b = 0.0)
+    {
+        ObiektStatyczny o{};
+        o.m_max_val = std::numeric_limits<double>::infinity();
+        o.m_min_val = -std::numeric_limits<double>::infinity();
+        o.m_a = a;
+        o.m_b = b;
+        return o;
+    }
+    /// Slope of the linear function getter.
+    constexpr double get_a() const noexcept { return m_a; }
+    /// Offset of the linear function getter.
+    constexpr double get_b() const noexcept { return m_b; }
+    /// Check if the outputs are never clamped (both limits are infinite).
+    constexpr bool is_unbounded() const noexcept
+    {
+        return m_max_val == std::numeric_limits<double>::infinity()
+            && m_min_val == -std::numeric_limits<double>::infinity();
+    }
     /// @brief Simulate clamped linear function.
     ///
     /// @f[
@@ -102,11 +126,40 @@ public:
     {
         return std::min(m_max_val, std::max(m_min_val, m_a * u + m_b));
     }
-    constexpr std::vector<uint8_t> dump() const override
+    /// @brief Simulate the clamped linear function for a block of inputs.
+    /// @param in function inputs
+    /// @param out clamped and scaled outputs, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    constexpr void simulate_block(std::span<const double> in, std::span<double> out) override
     {
-        auto bytes = to_bytes(std::array{ m_max_val, m_min_val, m_a, m_b });
-        constexpr auto len_b = to_bytes(static_cast<uint32_t>(prefix_size + bytes.size()));
-        return concat_iterables(len_b, range_to_bytes(unique_name), bytes);
+        check_block(in, out);
+        std::ranges::transform(in, out.begin(), [this](double u) {
+            return std::min(m_max_val, std::max(m_min_val, m_a * u + m_b));
+        });
     }
+    /// @brief Output for a constant input.
+    ///
+    /// The object has no state, so it is in a steady state for any input.
+    ///
+    /// @param u constant input
+    /// @return The clamped and scaled `u`.
+    constexpr std::optional<double> steady_output(double u) const override
+    {
+        return std::min(m_max_val, std::max(m_min_val, m_a * u + m_b));
+    }
+    constexpr std::size_t dump_size() const noexcept override
+    {
+        return sizeof(uint32_t) + prefix_size + 4 * sizeof(double);
+    }
+
+protected:
+    constexpr void write_dump(ByteWriter &out) const override
+    {
+        out.put(static_cast<uint32_t>(dump_size() - sizeof(uint32_t)));
+        out.put_range(unique_name);
+        out.put(std::array{ m_max_val, m_min_val, m_a, m_b });
+    }
+
+    friend class BatchStatic;
 };
 DESERIALIZABLE_SISO(ObiektStatyczny);
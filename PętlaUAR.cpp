@@ -1,5 +1,45 @@
 #include "PętlaUAR.hpp"
 
+namespace {
+/// Shortest run of identical inputs for which the steady state is checked.
+constexpr std::size_t steady_min_run = 4;
+/// Maximal number of samples simulated between steady state checks within a run.
+constexpr std::size_t steady_max_stride = 256;
+}
+
+PętlaUAR::PętlaUAR(std::span<const uint8_t> serialized, std::pmr::memory_resource *arena)
+{
+    ByteReader reader{ serialized };
+    const auto data_len = reader.get<uint32_t>();
+    if (reader.remaining() < data_len)
+        throw std::runtime_error{ "Data size is smaller than expected" };
+    if (!prefix_match(unique_name, reader.take(prefix_size)))
+        throw std::runtime_error{ "PętlaUAR serialized data does not start with the expected prefix" };
+    m_closed = reader.get<uint8_t>() > 0_u8;
+    m_prev_result = reader.get<double>();
+    const auto n_elements = reader.get<uint64_t>();
+    // Every element takes at least its length
+    if (n_elements > reader.remaining() / sizeof(uint32_t))
+        throw std::runtime_error{ "Serialized data is too short" };
+    m_loop.reserve(static_cast<std::size_t>(n_elements));
+    for (std::uint64_t i = 0; i < n_elements; i++) {
+        const auto rest = serialized.last(reader.remaining());
+        const auto l = reader.get<uint32_t>();
+        reader.take(l);
+        m_loop.push_back(ObiektSISO::deserialize(rest.first(sizeof(uint32_t) + l), arena));
+    }
+}
+
+PętlaUAR PętlaUAR::with_arena(std::span<const uint8_t> serialized)
+{
+    // Deserialized objects take a bit more memory than their serialized data
+    auto arena = std::make_unique<std::pmr::monotonic_buffer_resource>(2 * serialized.size()
+                                                                       + 1024);
+    PętlaUAR loop{ serialized, arena.get() };
+    loop.m_arena = std::move(arena);
+    return loop;
+}
+
 void PętlaUAR::reset(double init_val)
 {
     set_init(init_val);
@@ -8,15 +48,125 @@ void PętlaUAR::reset(double init_val)
     }
 }
 
+void PętlaUAR::reset_profile() noexcept
+{
+#ifdef POLABS_PROFILING
+    m_profile.assign(m_loop.size(), {});
+#endif
+    for (auto &e : m_loop) {
+        if (const auto loop = dynamic_cast<PętlaUAR *>(e.get()))
+            loop->reset_profile();
+    }
+}
+
 double PętlaUAR::symuluj(double u)
 {
     m_prev_result = m_closed ? u - m_prev_result : u;
-    for (auto &e : m_loop) {
-        m_prev_result = e->symuluj(m_prev_result);
+    for (std::size_t i = 0; i < m_loop.size(); ++i) {
+        POLABS_PROFILE(profile_at(i), 1);
+        m_prev_result = m_loop[i]->symuluj(m_prev_result);
     }
     return m_prev_result;
 }
 
+void PętlaUAR::simulate_block(std::span<const double> in, std::span<double> out)
+{
+    check_block(in, out);
+    if (in.empty())
+        return;
+    if (!m_steady_skip) {
+        simulate_samples(in, out);
+        return;
+    }
+    // Within a run of identical inputs the steady state is checked after simulating 1, 2, 4, ...
+    // samples, so runs which never settle cost only a few checks
+    std::size_t i = 0, run_end = 0, stride = 1;
+    while (i < in.size()) {
+        const double u = in[i];
+        if (i == run_end) {
+            while (run_end < in.size() && same_bits(in[run_end], u))
+                ++run_end;
+            stride = 1;
+        }
+        const auto left = run_end - i;
+        if (left >= steady_min_run) {
+            if (const auto y = steady_output(u)) {
+                skip_steady(u, left);
+                std::ranges::fill(out.subspan(i, left), *y);
+                i = run_end;
+                continue;
+            }
+        }
+        const auto n = std::min(left, stride);
+        simulate_samples(in.subspan(i, n), out.subspan(i, n));
+        i += n;
+        stride = std::min(2 * stride, steady_max_stride);
+    }
+}
+
+std::optional<double> PętlaUAR::steady_output(double u) const
+{
+    std::optional<double> y{ m_closed ? u - m_prev_result : u };
+    for (const auto &e : m_loop) {
+        y = e->steady_output(*y);
+        if (!y)
+            return std::nullopt;
+    }
+    if (m_closed && !same_bits(*y, m_prev_result))
+        return std::nullopt;
+    return y;
+}
+
+void PętlaUAR::skip_steady(double u, std::size_t n)
+{
+    double y = m_closed ? u - m_prev_result : u;
+    for (auto &e : m_loop) {
+        const double next = *e->steady_output(y);
+        e->skip_steady(y, n);
+        y = next;
+    }
+    m_prev_result = y;
+}
+
+void PętlaUAR::simulate_samples(std::span<const double> in, std::span<double> out)
+{
+    if (m_closed) {
+        for (std::size_t i = 0; i < in.size(); ++i)
+            out[i] = PętlaUAR::symuluj(in[i]);
+        return;
+    }
+    if (m_loop.empty()) {
+        if (in.data() != out.data())
+            std::ranges::copy(in, out.begin());
+    } else {
+        // The first element reads from the input, the rest work in-place on the output
+        for (std::size_t i = 0; i < m_loop.size(); ++i) {
+            POLABS_PROFILE(profile_at(i), in.size());
+            if (i == 0)
+                m_loop[i]->simulate_block(in, out);
+            else
+                m_loop[i]->simulate_block(out, out);
+        }
+    }
+    m_prev_result = out.back();
+}
+
+ObiektSISO &find_component(ObiektSISO &root, std::span<const std::size_t> path)
+{
+    ObiektSISO *current = &root;
+    for (const auto index : path) {
+        const auto loop = dynamic_cast<PętlaUAR *>(current);
+        const auto graph = dynamic_cast<LoopGraph *>(current);
+        if (loop != nullptr && index < loop->size())
+            current = &loop->at(index);
+        else if (graph != nullptr && index < graph->size())
+            current = &graph->at(index);
+        else
+            throw std::runtime_error{ "Path does not point to a loop component" };
+    }
+    return *current;
+}
+
 #ifdef LAB_TESTS
 void UARTests::test_simple_pid_arx()
 {
@@ -58,9 +208,327 @@ void UARTests::test_uar_serialization()
     });
 }
 
+void UARTests::test_dump_to()
+{
+    using p = ObiektStatyczny::point;
+    it_should_not_throw("PętlaUAR dump_to() into an unaligned buffer", []() {
+        PętlaUAR loop{ false, -1.25 };
+        loop.push_back(std::make_unique<ObiektStatyczny>(p{ -2.0, -1.0 }, p{ 2.0, 1.0 }));
+        auto inner_loop = std::make_unique<PętlaUAR>();
+        inner_loop->push_back(std::make_unique<RegulatorPID>(0.2, 1.5, 3));
+        inner_loop->push_back(std::make_unique<ModelARX>(std::vector{ -0.4, 0.1 },
+                                                         std::vector{ 0.6 }, 3, 0.01));
+        loop.push_back(std::move(inner_loop));
+        for (int i = 0; i < 5; ++i)
+            loop.symuluj(1.0);
+
+        // The same bytes as separately built and concatenated parts
+        const auto &stat = dynamic_cast<const ObiektStatyczny &>(loop.at(0));
+        const auto &inner = loop.at(1);
+        const auto stat_bytes = to_bytes(std::array{ 1.0, -1.0, 0.5, 0.0 });
+        const auto expected = concat_iterables(
+            to_bytes(static_cast<uint32_t>(loop.dump_size() - 4)),
+            range_to_bytes(PętlaUAR::unique_name),
+            to_bytes(0_u8), to_bytes(loop.get_last_result()), to_bytes(uint64_t{ 2 }),
+            to_bytes(static_cast<uint32_t>(stat.dump_size() - 4)), range_to_bytes(ObiektStatyczny::unique_name),
+            stat_bytes, inner.dump());
+        const auto dump = loop.dump();
+        if (dump != expected || dump.size() != loop.dump_size())
+            throw std::runtime_error{ "dump() is not compatible with the format" };
+
+        std::vector<uint8_t> buffer(dump.size() + 8, 0xAB);
+        const auto written = std::span{ buffer }.subspan(3, dump.size());
+        const auto rest = loop.dump_to(std::span{ buffer }.subspan(3));
+        if (rest.size() != 5 || !std::ranges::equal(written, dump) || buffer[2] != 0xAB
+            || rest[0] != 0xAB)
+            throw std::runtime_error{ "dump_to() wrote wrong bytes" };
+        const auto restored = ObiektSISO::deserialize(written);
+        if (dynamic_cast<const PętlaUAR &>(*restored) != loop)
+            throw std::runtime_error{ "Loop restored from a subspan does not match" };
+    });
+    it_should_throw<std::runtime_error>("PętlaUAR dump_to() into a small buffer", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        std::vector<uint8_t> buffer(loop.dump_size() - 1);
+        loop.dump_to(buffer);
+    });
+}
+
+void UARTests::test_simulate_block()
+{
+    using p = ObiektStatyczny::point;
+    it_should_not_throw("PętlaUAR simulate_block() matches symuluj()", []() {
+        for (const bool closed : { true, false }) {
+            PętlaUAR loop{ closed, 0.5 };
+            loop.push_back(std::make_unique<RegulatorPID>(0.4, 2.0, 0.1));
+            loop.push_back(std::make_unique<ObiektStatyczny>(p{ -2.0, -1.5 }, p{ 2.0, 1.5 }));
+            loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 2));
+            auto inner_loop = std::make_unique<PętlaUAR>(false);
+            inner_loop->push_back(std::make_unique<RegulatorPID>(1.2));
+            loop.push_back(std::move(inner_loop));
+            PętlaUAR loop_block{ loop.dump() };
+
+            std::vector<double> inputs(64);
+            for (std::size_t i = 0; i < inputs.size(); ++i)
+                inputs[i] = static_cast<double>((i / 8) % 2);
+            std::vector<double> expected(inputs.size());
+            for (std::size_t i = 0; i < inputs.size(); ++i)
+                expected[i] = loop.symuluj(inputs[i]);
+            std::vector<double> actual(inputs.size());
+            loop_block.simulate_block(inputs, actual);
+            if (actual != expected || loop_block != loop)
+                throw std::runtime_error{ "Block and per-sample simulations do not match" };
+        }
+    });
+    it_should_throw<std::runtime_error>("PętlaUAR simulate_block() with mismatched sizes", []() {
+        PętlaUAR loop{ false };
+        std::vector<double> in(3), out(2);
+        loop.simulate_block(in, out);
+    });
+}
+
+namespace {
+/// Component allocating memory in every simulation step.
+class AllocatingObject : public ObiektSISO {
+protected:
+    void write_dump(ByteWriter &) const override { }
+
+public:
+    double symuluj(double u) override { return *std::make_unique<double>(u); }
+    std::size_t dump_size() const override { return 0; }
+};
+}
+
+void UARTests::test_profile()
+{
+    it_should_not_throw("PętlaUAR profile", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.4, 2.0));
+        loop.push_back(std::make_unique<AllocatingObject>());
+        auto nested = std::make_unique<PętlaUAR>(false);
+        nested->push_back(std::make_unique<ObiektStatyczny>());
+        loop.push_back(std::move(nested));
+        for (int i = 0; i < 100; ++i)
+            loop.symuluj(1.0);
+        auto &inner = dynamic_cast<PętlaUAR &>(loop.at(2));
+
+        if constexpr (!profiling_enabled) {
+            if (!loop.profile().empty() || !inner.profile().empty())
+                throw std::logic_error{ "Profiles collected without POLABS_PROFILING" };
+            return;
+        }
+        const auto profile = loop.profile();
+        if (profile.size() != 3 || profile[0].calls != 100 || profile[0].samples != 100
+            || profile[2].calls != 100)
+            throw std::logic_error{ "Wrong call counts" };
+        if (profile[1].allocations != 100 || profile[0].allocations != 0)
+            throw std::logic_error{ "Wrong allocation counts" };
+        if (profile[2].time < inner.profile()[0].time)
+            throw std::logic_error{ "Nested loop time is not inclusive" };
+        std::vector<double> block(256, 1.0);
+        inner.simulate_block(block, block);
+        if (inner.profile()[0].calls != 101 || inner.profile()[0].samples != 356)
+            throw std::logic_error{ "Wrong nested loop call counts" };
+
+        // Profiles follow their components
+        loop.insert(0, std::make_unique<ObiektStatyczny>());
+        if (loop.profile()[0].calls != 0 || loop.profile()[1].calls != 100)
+            throw std::logic_error{ "Profiles not moved on insertion" };
+        loop.erase(2);
+        if (loop.profile()[2].calls != 100 || loop.profile().size() != 3)
+            throw std::logic_error{ "Profiles not moved on erasure" };
+        loop.reset_profile();
+        if (loop.profile()[1] != ComponentProfile{} || inner.profile()[0] != ComponentProfile{})
+            throw std::logic_error{ "Profiles not reset" };
+    });
+}
+
+namespace {
+/// Memory resource counting the bytes allocated from the heap.
+class CountingResource : public std::pmr::memory_resource {
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        allocated += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    /// Total number of allocated bytes.
+    std::size_t allocated{};
+};
+}
+
+void UARTests::test_arena()
+{
+    using p = ObiektStatyczny::point;
+    it_should_not_throw("PętlaUAR deserialized into an arena", []() {
+        PętlaUAR loop{ true, 0.25 };
+        loop.push_back(std::make_unique<RegulatorPID>(0.4, 2.0, 0.1));
+        loop.push_back(std::make_unique<ObiektStatyczny>(p{ -2.0, -1.5 }, p{ 2.0, 1.5 }));
+        auto inner_loop = std::make_unique<PętlaUAR>(false);
+        inner_loop->push_back(std::make_unique<ModelARX>(std::vector{ -0.4, 0.1 },
+                                                         std::vector{ 0.6 }, 2, 0.01));
+        loop.push_back(std::move(inner_loop));
+        for (int i = 0; i < 5; ++i)
+            loop.symuluj(1.0);
+
+        auto arena_loop = PętlaUAR::with_arena(loop.dump());
+        if (arena_loop != loop || !arena_loop.in_arena(0))
+            throw std::runtime_error{ "Loop is not deserialized into the arena" };
+        auto &inner = dynamic_cast<PętlaUAR &>(arena_loop.at(2));
+        if (!inner.in_arena(0))
+            throw std::runtime_error{ "Nested loop is not deserialized into the arena" };
+        for (int i = 0; i < 20; ++i)
+            if (loop.symuluj(1.0) != arena_loop.symuluj(1.0))
+                throw std::runtime_error{ "Loop simulations do not match" };
+
+        // Inserted components stay on the heap
+        inner.push_back(std::make_unique<RegulatorPID>(1.5));
+        if (inner.in_arena(1) || !inner.in_arena(0))
+            throw std::runtime_error{ "Inserted component is in the arena" };
+
+        // The old components are destroyed before their arena
+        PętlaUAR moved{ std::move(arena_loop) };
+        moved = PętlaUAR::with_arena(loop.dump());
+        if (moved != loop || arena_loop.size() != 0)
+            throw std::runtime_error{ "Moved loop does not match" };
+        moved.clear();
+        moved.push_back(std::make_unique<RegulatorPID>(1.0));
+        if (moved.size() != 1 || moved.in_arena(0))
+            throw std::runtime_error{ "Component inserted into a cleared loop is in the arena" };
+    });
+    it_should_not_throw("PętlaUAR arena doesn't grow when components are replaced", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.4, 2.0));
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }));
+        CountingResource upstream;
+        std::pmr::monotonic_buffer_resource arena{ &upstream };
+        PętlaUAR arena_loop{ loop.dump(), &arena };
+        const auto allocated = upstream.allocated;
+        // Like the GUI editing the tree: erase a component and insert its replacement
+        for (int i = 0; i < 10'000; ++i) {
+            arena_loop.erase(1);
+            arena_loop.insert(1, std::make_unique<ModelARX>(std::vector{ -0.4 },
+                                                            std::vector{ 0.6 }));
+        }
+        if (upstream.allocated != allocated || arena_loop.in_arena(1) || !arena_loop.in_arena(0))
+            throw std::runtime_error{ "Replaced components are allocated in the arena" };
+    });
+    it_should_throw<std::runtime_error>("PętlaUAR with_arena() of truncated data", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        auto dump = loop.dump();
+        dump.pop_back();
+        PętlaUAR::with_arena(dump);
+    });
+}
+
+namespace {
+/// Unbounded unit gain counting its simulation steps.
+class CountingGain : public ObiektStatyczny {
+public:
+    std::size_t steps{};
+
+    CountingGain()
+        : ObiektStatyczny{ ObiektStatyczny::unbounded(1.0) }
+    {
+    }
+    double symuluj(double u) override
+    {
+        ++steps;
+        return ObiektStatyczny::symuluj(u);
+    }
+};
+}
+
+void UARTests::test_steady_skip()
+{
+    using p = ObiektStatyczny::point;
+    it_should_not_throw("Components report steady states only at fixed points", []() {
+        RegulatorPID pd{ 0.5, 0.0, 0.2 }, pi{ 0.5, 2.0 };
+        ModelARX arx{ { -0.5 }, { 0.5 }, 1 }, noisy{ { -0.5 }, { 0.5 }, 1, 0.1 };
+        if (pd.steady_output(1.0) || !ObiektStatyczny{}.steady_output(5.0))
+            throw std::runtime_error{ "Wrong steady state before simulation" };
+        pd.symuluj(1.0);
+        if (pd.steady_output(1.0) != 0.5)
+            throw std::runtime_error{ "PD regulator is not steady after a repeated input" };
+        pi.symuluj(1.0);
+        if (pi.steady_output(1.0))
+            throw std::runtime_error{ "PI regulator with a nonzero input is steady" };
+        pi.symuluj(0.0);
+        if (pi.steady_output(0.0) != pi.symuluj(0.0))
+            throw std::runtime_error{ "PI regulator is not steady with a zero input" };
+        for (int i = 0; i < 2000; ++i) {
+            arx.symuluj(1.0);
+            noisy.symuluj(1.0);
+        }
+        const auto arx_y = arx.steady_output(1.0);
+        if (!arx_y || *arx_y != arx.symuluj(1.0) || noisy.steady_output(1.0))
+            throw std::runtime_error{ "ARX model steady state is wrong" };
+    });
+    it_should_not_throw("PętlaUAR steady-state skipping is bit-exact", []() {
+        for (const double stddev : { 0.0, 0.05 }) {
+            const auto make_loop = [stddev]() {
+                auto loop = std::make_unique<PętlaUAR>(true, 0.25);
+                loop->push_back(std::make_unique<RegulatorPID>(0.8, 0.0, 0.1));
+                loop->push_back(std::make_unique<CountingGain>());
+                loop->push_back(std::make_unique<ObiektStatyczny>(p{ -1.0, -1.0 }, p{ 1.0, 1.0 }));
+                auto inner_loop = std::make_unique<PętlaUAR>(false);
+                inner_loop->push_back(std::make_unique<ModelARX>(std::vector{ -0.6, 0.05 },
+                                                                 std::vector{ 0.3, 0.1 }, 2, stddev));
+                loop->push_back(std::move(inner_loop));
+                return loop;
+            };
+            const auto reseed = [](PętlaUAR &loop) {
+                dynamic_cast<ModelARX &>(dynamic_cast<PętlaUAR &>(loop.at(3)).at(0)).reseed(7);
+            };
+            auto reference = make_loop();
+            auto skipping = make_loop();
+            reseed(*reference);
+            reseed(*skipping);
+            skipping->set_steady_skip(true);
+
+            // Piecewise constant input with a few short segments
+            std::vector<double> inputs(20000);
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                const auto segment = i / 5000, offset = i % 5000;
+                inputs[i] = offset < 3 ? 0.1 * static_cast<double>(offset)
+                                       : (segment % 2 ? 2.0 : -0.5);
+            }
+            std::vector<double> expected(inputs.size()), actual(inputs.size());
+            for (std::size_t i = 0; i < inputs.size(); ++i)
+                expected[i] = reference->symuluj(inputs[i]);
+            for (std::size_t i = 0; i < inputs.size(); i += 4096) {
+                const auto n = std::min<std::size_t>(4096, inputs.size() - i);
+                skipping->simulate_block(std::span{ inputs }.subspan(i, n),
+                                         std::span{ actual }.subspan(i, n));
+            }
+            if (!std::ranges::equal(actual, expected, same_bits)
+                || skipping->dump() != reference->dump())
+                throw std::runtime_error{ "Skipped and stepped simulations do not match" };
+            const auto steps = dynamic_cast<const CountingGain &>(skipping->at(1)).steps;
+            if (stddev == 0.0 ? steps > inputs.size() / 4 : steps != inputs.size())
+                throw std::runtime_error{ "Wrong number of simulated steps" };
+        }
+    });
+}
+
 void UARTests::run_tests()
 {
     test_simple_pid_arx();
     test_uar_serialization();
+    test_dump_to();
+    test_simulate_block();
+    test_profile();
+    test_arena();
+    test_steady_skip();
 }
 #endif
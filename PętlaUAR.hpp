@@ -1,10 +1,16 @@
 #pragma once
 #include "ModelARX.h"
 #include "ObiektSISO.h"
+#include "loop_graph.hpp"
 #include "ObiektStatyczny.hpp"
 #include "RegulatorPID.h"
+#include "profiling.hpp"
 #include <cassert>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
 /// Control loop derived from ObiektSISO
@@ -18,21 +24,56 @@ private:
     static constexpr std::size_t prefix_size{ unique_name.size()
                                               * sizeof(decltype(unique_name)::value_type) };
 
+    /// @brief Arena owned by a root loop built with with_arena().
+    /// @details Declared before #m_loop, so that the components are destroyed first.
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena{};
     /// Vector of the loop's components.
-    std::vector<std::unique_ptr<ObiektSISO>> m_loop{};
+    std::vector<component_ptr> m_loop{};
     /// Whether the loop is closed and forms a feedback loop.
     bool m_closed;
     /// Stored previous simulation result.
     double m_prev_result;
+    /// Whether simulate_block() skips constant inputs in a steady state (not serialized).
+    bool m_steady_skip{};
+#ifdef POLABS_PROFILING
+    /// Profiles of the components, in the same order as #m_loop.
+    std::vector<ComponentProfile> m_profile{};
+
+    /// Profile of component `index`, adding missing profiles of components appended to the loop.
+    ComponentProfile &profile_at(std::size_t index)
+    {
+        if (m_profile.size() != m_loop.size())
+            m_profile.resize(m_loop.size());
+        return m_profile[index];
+    }
+#endif
 
     /// @brief Check if pointer is not `nullptr`.
     /// @param ptr reference to unique pointer to check
     /// @throws `std::runtime_error` if the pointer in `nullptr`
-    constexpr static void check_ptr(const std::unique_ptr<ObiektSISO> &ptr)
+    constexpr static void check_ptr(const component_ptr &ptr)
     {
         if (ptr == nullptr)
             throw std::runtime_error{ "Inserted pointers must not be null" };
     }
+    /// @brief Simulate a block sample by sample or component by component, without skipping.
+    /// @param in loop's inputs, must not be empty
+    /// @param out responses from the last loop component, the same size as `in`
+    void simulate_samples(std::span<const double> in, std::span<double> out);
+
+protected:
+    /// @brief Write the loop header and all components directly into the output buffer.
+    /// @param out writer over a buffer of dump_size() bytes
+    constexpr void write_dump(ByteWriter &out) const override
+    {
+        out.put(static_cast<uint32_t>(dump_size() - sizeof(uint32_t)));
+        out.put_range(unique_name);
+        out.put(m_closed ? 1_u8 : 0_u8);
+        out.put(m_prev_result);
+        out.put(static_cast<uint64_t>(m_loop.size()));
+        for (const auto &e : m_loop)
+            write_nested(*e, out);
+    }
 
 public:
     /// @brief Regular constructor accepting basic loop parameters (closed and initial value);
@@ -45,6 +86,55 @@ public:
         , m_prev_result{ init_val }
     {
     }
+    /// @brief Deserializing constructor, which allocates the components in an arena.
+    ///
+    /// Components (including nested loops' components and buffers of ARX models) are allocated in
+    /// the pre-order of the tree, so the arena holds them in the order of simulation. The arena must
+    /// outlive the loop; with_arena() builds a loop which owns it.
+    ///
+    /// @param serialized bytes representing serialized PętlaUAR
+    /// @param arena memory resource for the components, `nullptr` to allocate them with `new`
+    /// @throws `std::runtime_error` if the data is not a valid PętlaUAR.
+    PętlaUAR(std::span<const uint8_t> serialized, std::pmr::memory_resource *arena);
+    /// @brief Deserialize a loop into a new arena owned by the loop.
+    ///
+    /// The whole tree is stored in a few contiguous blocks, which are released at once when the
+    /// loop is destroyed or cleared. Components inserted later stay on the heap, so editing the
+    /// loop never grows the arena; memory of erased components is only released by clear().
+    ///
+    /// @param serialized bytes representing serialized PętlaUAR
+    /// @return The deserialized loop.
+    /// @throws `std::runtime_error` if the data is not a valid PętlaUAR.
+    static PętlaUAR with_arena(std::span<const uint8_t> serialized);
+    /// Move constructor; the moved-from loop is left empty and without an arena.
+    PętlaUAR(PętlaUAR &&other) noexcept
+        : m_arena{ std::move(other.m_arena) }
+        , m_loop{ std::move(other.m_loop) }
+        , m_closed{ other.m_closed }
+        , m_prev_result{ other.m_prev_result }
+        , m_steady_skip{ other.m_steady_skip }
+#ifdef POLABS_PROFILING
+        , m_profile{ std::move(other.m_profile) }
+#endif
+    {
+        other.m_loop.clear();
+    }
+    /// Move assignment; the previous components are destroyed before their arena is released.
+    PętlaUAR &operator=(PętlaUAR &&other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        m_loop = std::move(other.m_loop);
+        other.m_loop.clear();
+        m_arena = std::move(other.m_arena);
+        m_closed = other.m_closed;
+        m_prev_result = other.m_prev_result;
+        m_steady_skip = other.m_steady_skip;
+#ifdef POLABS_PROFILING
+        m_profile = std::move(other.m_profile);
+#endif
+        return *this;
+    }
     /// @brief Deserializing constructor for an input range of bytes
     /// @tparam T type of the input range
     /// @param serialized input range over bytes representing serialized PętlaUAR
@@ -103,11 +193,80 @@ public:
     /// @param u loop's input, the setpoint in closed loop
     /// @return response from the last loop component
     double symuluj(double u) override;
-    /// Remove all componets.
-    constexpr void clear() noexcept { m_loop.clear(); }
+    /// @brief Simulate loop's response to a block of input samples.
+    ///
+    /// In open loop each component processes the whole block before passing it to the next one,
+    /// so the block costs one virtual call per component. A closed loop needs the previous output
+    /// to compute the next error, so it falls back to per-sample simulation with symuluj().
+    /// The results are the same as those of consecutive symuluj() calls in both cases.
+    ///
+    /// With steady-state skipping enabled (see set_steady_skip()) runs of identical inputs are
+    /// skipped with skip_steady() as soon as the loop reaches a steady state.
+    ///
+    /// @param in loop's inputs, setpoints in closed loop
+    /// @param out responses from the last loop component, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    void simulate_block(std::span<const double> in, std::span<double> out) override;
+    /// @brief Output of the loop in a steady state for a constant input.
+    ///
+    /// The loop is in a steady state if all components are, given the outputs of their
+    /// predecessors. A closed loop also needs the output equal to #m_prev_result, so that the error
+    /// does not change.
+    ///
+    /// @param u loop's constant input, the setpoint in closed loop
+    /// @return Output of symuluj(u) or `std::nullopt` if the loop is not in a steady state.
+    std::optional<double> steady_output(double u) const override;
+    /// @brief Skip steps in a steady state by skipping them in all components.
+    /// @param u loop's constant input, steady_output(u) must have a value
+    /// @param n number of skipped steps
+    void skip_steady(double u, std::size_t n) override;
+    /// @brief Remove all componets.
+    ///
+    /// The arena of a loop built with with_arena() is released at once.
+    void clear() noexcept
+    {
+        m_loop.clear();
+#ifdef POLABS_PROFILING
+        m_profile.clear();
+#endif
+        if (m_arena)
+            m_arena->release();
+    }
+    /// @brief Statistics of the components' simulation calls (see profiling.hpp).
+    ///
+    /// Each component's profile includes its nested components, whose profiles are available from
+    /// their loops. Profiles are collected by symuluj() and simulate_block() of this class, a
+    /// FrozenLoop doesn't collect them.
+    ///
+    /// @return Profiles of the components in the loop order, empty if profiling is not compiled in
+    /// (`POLABS_PROFILING` is not defined). Components which were not simulated yet may be missing.
+    std::span<const ComponentProfile> profile() const noexcept
+    {
+#ifdef POLABS_PROFILING
+        return m_profile;
+#else
+        return {};
+#endif
+    }
+    /// Reset profiles of all components, including nested loops.
+    void reset_profile() noexcept;
     /// @brief Get size of the loop.
     /// @return Number of components in the loop
     constexpr std::size_t size() const noexcept { return m_loop.size(); }
+    /// @brief Access component at given index.
+    /// @param index index of the component
+    /// @return A reference to the component.
+    /// @throws `std::out_of_range` if index is not less than the loop size
+    constexpr const ObiektSISO &at(std::size_t index) const { return *m_loop.at(index); }
+    /// @copydoc at(std::size_t) const
+    constexpr ObiektSISO &at(std::size_t index) { return *m_loop.at(index); }
+    /// @brief Check if a component is allocated in an arena.
+    /// @param index index of the component
+    /// @throws `std::out_of_range` if index is not less than the loop size
+    constexpr bool in_arena(std::size_t index) const
+    {
+        return m_loop.at(index).get_deleter().in_arena();
+    }
     /// Last result (#m_prev_result) getter.
     constexpr double get_last_result() const noexcept { return m_prev_result; }
     /// Closed setting (#m_closed) getter.
@@ -116,9 +275,18 @@ public:
     constexpr void set_init(double init_val) noexcept { m_prev_result = init_val; }
     /// Closed setting (#m_closed) setter.
     constexpr void set_closed(bool closed) noexcept { m_closed = closed; }
+    /// Steady-state skipping setting (#m_steady_skip) getter.
+    constexpr bool get_steady_skip() const noexcept { return m_steady_skip; }
+    /// @brief Steady-state skipping setting (#m_steady_skip) setter.
+    ///
+    /// Skipping gives bit-identical results, but skipped steps are not profiled and components
+    /// which don't report steady states (see ObiektSISO::steady_output()) prevent it.
+    ///
+    /// @param skip whether simulate_block() should skip constant inputs in a steady state
+    constexpr void set_steady_skip(bool skip) noexcept { m_steady_skip = skip; }
     /// @brief Append component to the loop.
     /// @param element the component to append at the back
-    constexpr void push_back(std::unique_ptr<ObiektSISO> &&element)
+    constexpr void push_back(component_ptr &&element)
     {
         check_ptr(element);
         m_loop.push_back(std::move(element));
@@ -126,7 +294,7 @@ public:
     /// @brief Append component to the loop and return its position.
     /// @param value the component to append at the back
     /// @return Index of the appended component (size of the loop - 1).
-    constexpr std::size_t insert(std::unique_ptr<ObiektSISO> &&value)
+    constexpr std::size_t insert(component_ptr &&value)
     {
         push_back(std::move(value));
         return m_loop.size() - 1;
@@ -135,22 +303,26 @@ public:
     /// @param index position at which the component should be inserted
     /// @param value the component to be inserted
     /// @return Index of the inserted component.
-    constexpr std::size_t insert(std::size_t index, std::unique_ptr<ObiektSISO> &&value)
+    constexpr std::size_t insert(std::size_t index, component_ptr &&value)
     {
         check_ptr(value);
         const auto it = std::next(m_loop.cbegin(), index);
         const auto oit = m_loop.insert(it, std::move(value));
+#ifdef POLABS_PROFILING
+        // Profiles of the following components are moved with them
+        if (index < m_profile.size())
+            m_profile.insert(std::next(m_profile.cbegin(), index), ComponentProfile{});
+#endif
         return static_cast<std::size_t>(std::distance(m_loop.begin(), oit));
     }
     /// @brief Insert multiple components starting at given index.
-    /// @tparam ...Args type of components (must be convertible to std::unique_ptr<ObiektSISO>)
+    /// @tparam ...Args type of components (must be convertible to #component_ptr)
     /// @param index position at which the first of components should be inserted
     /// @param value first component to be inserted
     /// @param ...args remaining components to be inserted
     /// @return Index of the last inserted component.
     template <typename... Args>
-    constexpr std::size_t insert(std::size_t index, std::unique_ptr<ObiektSISO> &&value,
-                                 Args &&...args)
+    constexpr std::size_t insert(std::size_t index, component_ptr &&value, Args &&...args)
     {
         const auto ins_idx = insert(index, std::move(value));
         if constexpr (sizeof...(Args)) {
@@ -168,20 +340,19 @@ public:
             throw std::range_error{ "Index out of range" };
         const auto it = std::next(m_loop.cbegin(), index);
         const auto oit = m_loop.erase(it);
+#ifdef POLABS_PROFILING
+        if (index < m_profile.size())
+            m_profile.erase(std::next(m_profile.cbegin(), index));
+#endif
         return static_cast<std::size_t>(std::distance(m_loop.begin(), oit));
     }
-    constexpr std::vector<uint8_t> dump() const override
+    constexpr std::size_t dump_size() const override
     {
-        const auto prefix = range_to_bytes(unique_name);
-        const auto closed = to_bytes(m_closed ? 1_u8 : 0_u8);
-        const auto last = to_bytes(m_prev_result);
-        const auto n_elements = to_bytes(static_cast<uint64_t>(m_loop.size()));
-        const auto elements = m_loop
-            | std::views::transform([](const auto &e) { return e->dump(); }) | std::views::join
-            | std::ranges::to<std::vector<uint8_t>>();
-        const auto len_b = to_bytes(static_cast<uint32_t>(prefix_size + closed.size() + last.size()
-                                                          + n_elements.size() + elements.size()));
-        return concat_iterables(len_b, prefix, closed, last, n_elements, elements);
+        std::size_t size = sizeof(uint32_t) + prefix_size + sizeof(uint8_t) + sizeof m_prev_result
+            + sizeof(uint64_t);
+        for (const auto &e : m_loop)
+            size += e->dump_size();
+        return size;
     }
 
     /// @brief Overloaded equal comparison operator, which compares all parameters and checks if
@@ -210,6 +381,10 @@ public:
                 const auto b_uar = dynamic_cast<const PętlaUAR *>(bp);
                 if (b_uar == nullptr || *a_uar != *b_uar)
                     return false;
+            } else if (const auto a_graph = dynamic_cast<const LoopGraph *>(ap)) {
+                const auto b_graph = dynamic_cast<const LoopGraph *>(bp);
+                if (b_graph == nullptr || *a_graph != *b_graph)
+                    return false;
             } else {
                 assert(false);
             }
@@ -220,11 +395,24 @@ public:
 };
 DESERIALIZABLE_SISO(PętlaUAR);
 
+/// @brief Find a component in a (nested) loop.
+/// @param root the root component, usually a loop
+/// @param path indices of consecutive nested loops' elements or graphs' blocks, starting in `root`;
+/// empty for `root`
+/// @return Reference to the component.
+/// @throws `std::runtime_error` if the path does not point to a loop component.
+ObiektSISO &find_component(ObiektSISO &root, std::span<const std::size_t> path);
+
 #ifdef LAB_TESTS
 class UARTests {
 private:
     static void test_simple_pid_arx();
     static void test_uar_serialization();
+    static void test_dump_to();
+    static void test_simulate_block();
+    static void test_profile();
+    static void test_arena();
+    static void test_steady_skip();
 
 public:
     static void run_tests();
@@ -57,15 +57,23 @@ private:
         return m_td * diff;
     }
 
+protected:
+    constexpr void write_dump(ByteWriter &out) const override
+    {
+        out.put(static_cast<uint32_t>(dump_size() - sizeof(uint32_t)));
+        out.put_range(unique_name);
+        out.put(std::array{ m_k, m_ti, m_td, m_integral, m_prev_e });
+    }
+
 public:
-    /// @brief Deserializing constructor from vector of `uint8_t`.
+    /// @brief Deserializing constructor from a span of `uint8_t`.
     ///
-    /// Uses @link RegulatorPID::RegulatorPID(Iter, Iter)@endlink with the `data` vector's
+    /// Uses @link RegulatorPID::RegulatorPID(Iter, Iter)@endlink with the `data` span's
     /// iterators.
     ///
-    /// @param data vector of bytes representing serialized RegulatorPID
-    constexpr RegulatorPID(const std::vector<uint8_t> &data)
-        : RegulatorPID{ data.cbegin(), data.cend() } {};
+    /// @param data bytes representing serialized RegulatorPID
+    constexpr RegulatorPID(std::span<const uint8_t> data)
+        : RegulatorPID{ data.begin(), data.end() } {};
     /// @brief Deserializing constructor from a pair of iterators over `uint8_t`.
     /// @param start iterator to the beginning of the range
     /// @param end end iterator of the range
@@ -158,11 +166,38 @@ public:
     {
         return sim_propoprtional(e) + sim_integral(e) + sim_derviative(e);
     }
-    constexpr std::vector<uint8_t> dump() const override
+    /// @brief Simulate PID response for a block of inputs.
+    ///
+    /// Produces the same results as consecutive symuluj() calls, without virtual dispatch.
+    ///
+    /// @param in inputs to the regulator
+    /// @param out regulator outputs, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    constexpr void simulate_block(std::span<const double> in, std::span<double> out) override
+    {
+        check_block(in, out);
+        for (std::size_t i = 0; i < in.size(); ++i)
+            out[i] = RegulatorPID::symuluj(in[i]);
+    }
+    /// @brief Output of the regulator in a steady state for a constant input.
+    ///
+    /// The regulator is in a steady state if the previous input was the same (so the derivative
+    /// part is 0) and the integral part is disabled or `e / Ti` is too small to change the
+    /// accumulator. A P or PD regulator reaches it one step after the input settles.
+    ///
+    /// @param e constant input to the regulator
+    /// @return Output of symuluj(e) or `std::nullopt` if the regulator is not in a steady state.
+    constexpr std::optional<double> steady_output(const double e) const override
+    {
+        if (!same_bits(e, m_prev_e))
+            return std::nullopt;
+        if (m_ti > 0.0 && !same_bits(m_integral + e / m_ti, m_integral))
+            return std::nullopt;
+        return sim_propoprtional(e) + (m_ti > 0.0 ? m_integral : 0.0) + m_td * (e - m_prev_e);
+    }
+    constexpr std::size_t dump_size() const noexcept override
     {
-        auto bytes = to_bytes(std::array{ m_k, m_ti, m_td, m_integral, m_prev_e });
-        constexpr auto dump_size_b = to_bytes(static_cast<uint32_t>(prefix_size + bytes.size()));
-        return concat_iterables(dump_size_b, range_to_bytes(unique_name), bytes);
+        return sizeof(uint32_t) + prefix_size + 5 * sizeof(double);
     }
     /// Reset state of the regulator by setting #m_integral and #m_prev_e to 0.
     constexpr void reset() noexcept override
@@ -177,6 +212,7 @@ public:
     friend std::ostream &operator<<(std::ostream &os, const RegulatorPID &m);
     /// Stream input operator, which can reconfigure the object to match provided the text form.
     friend std::istream &operator>>(std::istream &is, RegulatorPID &m);
+    friend class BatchPID;
 };
 DESERIALIZABLE_SISO(RegulatorPID);
 
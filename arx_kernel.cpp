@@ -0,0 +1,212 @@
+#include "arx_kernel.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARX_KERNEL_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ARX_KERNEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+using dot_fn = double (*)(const double *, const double *, std::size_t) noexcept;
+
+/// Portable fallback with 4 independent accumulators, which compilers can vectorize.
+double dot_scalar_fast(const double *a, const double *b, std::size_t n) noexcept
+{
+    double s0{}, s1{}, s2{}, s3{};
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; ++i)
+        s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef ARX_KERNEL_X86
+__attribute__((target("avx2,fma"))) double dot_avx2(const double *a, const double *b,
+                                                    std::size_t n) noexcept
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+    if (i + 4 <= n) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        i += 4;
+    }
+    const __m256d acc = _mm256_add_pd(acc0, acc1);
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx512f"))) double dot_avx512(const double *a, const double *b,
+                                                     std::size_t n) noexcept
+{
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+    }
+    if (i + 8 <= n) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        i += 8;
+    }
+    // _mm512_reduce_add_pd() triggers a false -Wuninitialized in some GCC versions, so the
+    // horizontal sum is done on a spilled copy of the accumulator
+    double lanes[8];
+    _mm512_storeu_pd(lanes, _mm512_add_pd(acc0, acc1));
+    double sum = ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5]))
+        + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+    for (; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+#endif
+
+#ifdef ARX_KERNEL_NEON
+double dot_neon(const double *a, const double *b, std::size_t n) noexcept
+{
+    float64x2_t acc0 = vdupq_n_f64(0.0);
+    float64x2_t acc1 = vdupq_n_f64(0.0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vfmaq_f64(acc0, vld1q_f64(a + i), vld1q_f64(b + i));
+        acc1 = vfmaq_f64(acc1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+    }
+    double sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+    for (; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+#endif
+
+/// Detect the best instruction set supported by the CPU and compiler.
+KernelISA detect_isa() noexcept
+{
+#ifdef ARX_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return KernelISA::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return KernelISA::AVX2;
+#elif defined(ARX_KERNEL_NEON)
+    // Advanced SIMD is mandatory on AArch64
+    return KernelISA::NEON;
+#endif
+    return KernelISA::SCALAR;
+}
+
+/// Kernel implementing the fast mode for a given instruction set.
+dot_fn fast_kernel(KernelISA isa) noexcept
+{
+    switch (isa) {
+#ifdef ARX_KERNEL_X86
+    case KernelISA::AVX512:
+        return dot_avx512;
+    case KernelISA::AVX2:
+        return dot_avx2;
+#endif
+#ifdef ARX_KERNEL_NEON
+    case KernelISA::NEON:
+        return dot_neon;
+#endif
+    default:
+        return dot_scalar_fast;
+    }
+}
+
+/// Instruction set detected once, at startup.
+const KernelISA detected_isa{ detect_isa() };
+/// Kernel of the fast mode for #detected_isa.
+const dot_fn fast_dot{ fast_kernel(detected_isa) };
+}
+
+constinit std::atomic<bool> fast_math_flag{ false };
+
+double dot_product_fast(const double *a, const double *b, std::size_t n) noexcept
+{
+    return fast_dot(a, b, n);
+}
+
+void set_fast_math(bool enabled) noexcept
+{
+    fast_math_flag.store(enabled, std::memory_order_relaxed);
+}
+
+bool fast_math_enabled() noexcept { return fast_math_flag.load(std::memory_order_relaxed); }
+
+KernelISA fast_kernel_isa() noexcept { return detected_isa; }
+
+#ifdef LAB_TESTS
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace {
+/// Deterministic, non-trivial test data in range [-1, 1).
+std::vector<double> test_vector(std::size_t n, double phase)
+{
+    std::vector<double> v(n);
+    for (std::size_t i = 0; i < n; ++i)
+        v[i] = std::sin(static_cast<double>(i) * 0.7 + phase);
+    return v;
+}
+}
+
+void KernelTests::test_strict_order()
+{
+    std::cerr << "Kernel (strict) -> bit-identical to std::inner_product: ";
+    set_fast_math(false);
+    for (std::size_t n : { 0, 1, 3, 4, 7, 16, 33, 64, 257 }) {
+        const auto a = test_vector(n, 0.1);
+        const auto b = test_vector(n, 1.3);
+        const auto expected = std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+        if (std::bit_cast<std::uint64_t>(dot_product(a.data(), b.data(), n))
+            != std::bit_cast<std::uint64_t>(expected)) {
+            std::cerr << "FAIL! (n = " << n << ")\n";
+            return;
+        }
+    }
+    std::cerr << "OK!\n";
+}
+
+void KernelTests::test_fast_tolerance()
+{
+    std::cerr << "Kernel (fast, " << isa_name(fast_kernel_isa()) << ") -> close to strict: ";
+    for (std::size_t n : { 0, 1, 3, 4, 7, 8, 15, 16, 17, 33, 64, 257 }) {
+        const auto a = test_vector(n, 0.4);
+        const auto b = test_vector(n, 2.2);
+        set_fast_math(false);
+        const auto strict = dot_product(a.data(), b.data(), n);
+        set_fast_math(true);
+        const auto fast = dot_product(a.data(), b.data(), n);
+        set_fast_math(false);
+        // Each term is bounded by 1, so the rounding error is bounded relative to n
+        if (std::abs(fast - strict) > 1e-14 * static_cast<double>(n + 1)) {
+            std::cerr << "FAIL! (n = " << n << ")\n";
+            return;
+        }
+    }
+    std::cerr << "OK!\n";
+}
+
+void KernelTests::run_tests()
+{
+    test_strict_order();
+    test_fast_tolerance();
+}
+#endif
@@ -0,0 +1,78 @@
+/// @file arx_kernel.hpp
+/// @brief Dot product kernels used by ModelARX with runtime instruction set dispatch.
+///
+/// Two modes are available:
+/// - **strict** (default) - a sequential sum, in exactly the same order as `std::inner_product`,
+///   so the results are bit-identical to the original ModelARX implementation,
+/// - **fast** (opt-in) - an explicitly vectorized kernel (AVX-512, AVX2+FMA or NEON, whichever is
+///   the best one supported by the CPU at startup, with an unrolled scalar fallback). It uses
+///   multiple accumulators and fused multiply-add, so the summation order and rounding differ and
+///   **the results are not bit-identical** to the strict mode (differences are usually a few ULPs).
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <numeric>
+#include <string_view>
+
+/// Instruction set used by the fast dot product kernel.
+enum class KernelISA {
+    SCALAR, ///< Portable, unrolled scalar code
+    AVX2, ///< x86-64 AVX2 with FMA
+    AVX512, ///< x86-64 AVX-512F
+    NEON ///< AArch64 Advanced SIMD
+};
+
+/// Whether the fast kernel is enabled, use set_fast_math() and fast_math_enabled() instead.
+extern constinit std::atomic<bool> fast_math_flag;
+/// @brief Compute a dot product using the fast kernel detected at startup.
+/// @details Called by dot_product() when the fast mode is enabled.
+double dot_product_fast(const double *a, const double *b, std::size_t n) noexcept;
+
+/// @brief Compute @f$\sum_{i=0}^{n-1} a_i b_i@f$ using the kernel selected by set_fast_math().
+/// @details The strict mode is inlined into the caller, only the fast mode calls a kernel through
+/// a pointer.
+/// @param a pointer to the first array of `n` elements
+/// @param b pointer to the second array of `n` elements
+/// @param n number of elements
+/// @return The dot product of `a` and `b`.
+inline double dot_product(const double *a, const double *b, std::size_t n) noexcept
+{
+    if (fast_math_flag.load(std::memory_order_relaxed)) [[unlikely]]
+        return dot_product_fast(a, b, n);
+    // Sequential sum, exactly the same operations as in the original ModelARX
+    return std::inner_product(a, a + n, b, 0.0);
+}
+/// @brief Enable or disable the fast (vectorized, not bit-identical) dot product kernel.
+/// @details The setting is process-wide and affects all ModelARX instances.
+/// @param enabled `true` to use the fast kernel, `false` for the strict (default) one
+void set_fast_math(bool enabled) noexcept;
+/// Check whether the fast dot product kernel is enabled.
+bool fast_math_enabled() noexcept;
+/// Instruction set of the fast kernel detected at startup.
+KernelISA fast_kernel_isa() noexcept;
+/// @brief Human-readable name of an instruction set.
+/// @param isa instruction set
+constexpr std::string_view isa_name(KernelISA isa) noexcept
+{
+    switch (isa) {
+    case KernelISA::AVX2:
+        return "AVX2";
+    case KernelISA::AVX512:
+        return "AVX-512";
+    case KernelISA::NEON:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
+
+#ifdef LAB_TESTS
+class KernelTests {
+    static void test_strict_order();
+    static void test_fast_tolerance();
+
+public:
+    static void run_tests();
+};
+#endif
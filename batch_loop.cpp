@@ -0,0 +1,422 @@
+#include "batch_loop.hpp"
+#include "philox.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+/// @brief Cast components of all channels to `T`.
+/// @return Pointers to the components or an empty vector if the first one is not a `T`.
+/// @throws `std::runtime_error` if only some of the components are `T`s.
+template <typename T> std::vector<const T *> cast_all(std::span<const ObiektSISO *const> components)
+{
+    std::vector<const T *> cast;
+    if (dynamic_cast<const T *>(components.front()) == nullptr)
+        return cast;
+    cast.reserve(components.size());
+    for (const auto c : components) {
+        const auto ptr = dynamic_cast<const T *>(c);
+        if (ptr == nullptr)
+            throw std::runtime_error{ "Loops' components have different types" };
+        cast.push_back(ptr);
+    }
+    return cast;
+}
+
+/// Append the loops of all channels (nested at the same position) to `out` in pre-order.
+void flatten(std::span<const PętlaUAR *const> loops, std::vector<BatchLoop::element> &out)
+{
+    const auto &first = *loops.front();
+    BatchLoop::LoopHeader header{ first.get_closed(), {}, 0 };
+    header.prev_result.reserve(loops.size());
+    for (const auto loop : loops) {
+        if (loop->get_closed() != first.get_closed() || loop->size() != first.size())
+            throw std::runtime_error{ "Loops have different topologies" };
+        header.prev_result.push_back(loop->get_last_result());
+    }
+    const auto header_idx = out.size();
+    out.emplace_back(std::move(header));
+
+    std::vector<const ObiektSISO *> components(loops.size());
+    for (std::size_t i = 0; i < first.size(); ++i) {
+        std::ranges::transform(loops, components.begin(),
+                               [i](const PętlaUAR *loop) { return &loop->at(i); });
+        if (const auto nested = cast_all<PętlaUAR>(components); !nested.empty())
+            flatten(nested, out);
+        else if (const auto pid = cast_all<RegulatorPID>(components); !pid.empty())
+            out.emplace_back(BatchPID{ pid });
+        else if (const auto stat = cast_all<ObiektStatyczny>(components); !stat.empty())
+            out.emplace_back(BatchStatic{ stat });
+        else if (const auto arx = cast_all<ModelARX>(components); !arx.empty())
+            out.emplace_back(BatchARX{ arx });
+        else
+            throw std::runtime_error{ "Loop contains a component which cannot be batched" };
+    }
+    std::get<BatchLoop::LoopHeader>(out[header_idx]).length = out.size() - header_idx - 1;
+}
+
+/// @brief Rebuild the loop of channel `k` starting at `index`.
+/// @param index index of the loop's header, set to the index after the loop on return
+PętlaUAR rebuild(std::span<const BatchLoop::element> elements, std::size_t k, std::size_t &index)
+{
+    const auto &header = std::get<BatchLoop::LoopHeader>(elements[index]);
+    PętlaUAR loop{ header.closed, header.prev_result[k] };
+    const auto end = index + 1 + header.length;
+    for (++index; index < end;) {
+        if (std::holds_alternative<BatchLoop::LoopHeader>(elements[index])) {
+            loop.push_back(std::make_unique<PętlaUAR>(rebuild(elements, k, index)));
+            continue;
+        }
+        std::visit(overloaded{ [](const BatchLoop::LoopHeader &) {},
+                               [&loop, k]<typename T>(const T &e) {
+                                   loop.push_back(std::make_unique<decltype(e.channel(k))>(
+                                       e.channel(k)));
+                               } },
+                   elements[index]);
+        ++index;
+    }
+    return loop;
+}
+}
+
+BatchHistory::BatchHistory(std::size_t channels, std::size_t rows)
+    : m_channels{ channels }
+    , m_rows{ rows }
+    , m_data(2 * rows * channels)
+{
+}
+
+void BatchHistory::push_front(const double *values)
+{
+    if (m_rows == 0) [[unlikely]] {
+        m_rows = 1;
+        m_data.assign(values, values + m_channels);
+        m_data.insert(m_data.end(), values, values + m_channels);
+        return;
+    }
+    m_head = m_head == 0 ? m_rows - 1 : m_head - 1;
+    std::copy_n(values, m_channels, m_data.data() + m_head * m_channels);
+    std::copy_n(values, m_channels, m_data.data() + (m_head + m_rows) * m_channels);
+}
+
+void BatchHistory::set_channel(std::size_t channel, std::span<const double> history)
+{
+    for (std::size_t age = 0; age < m_rows; ++age) {
+        m_data[((m_head + age) % m_rows) * m_channels + channel] = history[age];
+        m_data[((m_head + age) % m_rows + m_rows) * m_channels + channel] = history[age];
+    }
+}
+
+std::vector<double> BatchHistory::get_channel(std::size_t channel) const
+{
+    std::vector<double> history(m_rows);
+    for (std::size_t age = 0; age < m_rows; ++age)
+        history[age] = row(age)[channel];
+    return history;
+}
+
+BatchPID::BatchPID(std::span<const RegulatorPID *const> channels)
+{
+    for (const auto pid : channels) {
+        m_k.push_back(pid->m_k);
+        m_ti.push_back(pid->m_ti);
+        m_td.push_back(pid->m_td);
+        m_integral.push_back(pid->m_integral);
+        m_prev_e.push_back(pid->m_prev_e);
+    }
+}
+
+void BatchPID::step(std::span<double> v) noexcept
+{
+    // Same operations in the same order as in RegulatorPID::symuluj(), so the results are
+    // bit-identical
+    for (std::size_t k = 0; k < v.size(); ++k) {
+        const auto e = v[k];
+        const auto has_integral = m_ti[k] > 0.0;
+        m_integral[k] = has_integral ? m_integral[k] + e / m_ti[k] : m_integral[k];
+        const auto integral = has_integral ? m_integral[k] : 0.0;
+        const auto diff = e - m_prev_e[k];
+        m_prev_e[k] = e;
+        v[k] = m_k[k] * e + integral + m_td[k] * diff;
+    }
+}
+
+RegulatorPID BatchPID::channel(std::size_t k) const
+{
+    RegulatorPID pid{ m_k[k], m_ti[k], m_td[k] };
+    pid.m_integral = m_integral[k];
+    pid.m_prev_e = m_prev_e[k];
+    return pid;
+}
+
+BatchStatic::BatchStatic(std::span<const ObiektStatyczny *const> channels)
+{
+    for (const auto stat : channels) {
+        m_max_val.push_back(stat->m_max_val);
+        m_min_val.push_back(stat->m_min_val);
+        m_a.push_back(stat->m_a);
+        m_b.push_back(stat->m_b);
+    }
+}
+
+void BatchStatic::step(std::span<double> v) noexcept
+{
+    for (std::size_t k = 0; k < v.size(); ++k)
+        v[k] = std::min(m_max_val[k], std::max(m_min_val[k], m_a[k] * v[k] + m_b[k]));
+}
+
+ObiektStatyczny BatchStatic::channel(std::size_t k) const
+{
+    ObiektStatyczny stat{};
+    stat.m_max_val = m_max_val[k];
+    stat.m_min_val = m_min_val[k];
+    stat.m_a = m_a[k];
+    stat.m_b = m_b[k];
+    return stat;
+}
+
+BatchARX::BatchARX(std::span<const ModelARX *const> channels)
+    : m_channels{ channels.size() }
+    , m_na{ channels.front()->m_coeff_a.size() }
+    , m_nb{ channels.front()->m_coeff_b.size() }
+    , m_in{ channels.size(), channels.front()->m_in_signal_mem.size() }
+    , m_out{ channels.size(), channels.front()->m_out_signal_mem.size() }
+    , m_delay{ channels.size(), channels.front()->m_delay_mem.size() }
+    , m_scratch(3 * channels.size())
+{
+    const auto &first = *channels.front();
+    if (m_in.rows() < m_nb || m_out.rows() < m_na || m_delay.rows() == 0)
+        throw std::runtime_error{ "ModelARX histories are shorter than its polynomials" };
+    m_coeff_a.resize(m_na * m_channels);
+    m_coeff_b.resize(m_nb * m_channels);
+    for (std::size_t k = 0; k < m_channels; ++k) {
+        const auto &m = *channels[k];
+        if (m.m_coeff_a.size() != m_na || m.m_coeff_b.size() != m_nb
+            || m.m_transport_delay != first.m_transport_delay
+            || m.m_in_signal_mem.size() != m_in.rows() || m.m_out_signal_mem.size() != m_out.rows()
+            || m.m_delay_mem.size() != m_delay.rows())
+            throw std::runtime_error{ "ModelARX orders or delays of the loops differ" };
+        // The Mersenne Twister stream of version 0 dumps can't be drawn from by position
+        if (m.m_legacy_noise)
+            throw std::runtime_error{ "ModelARX with legacy noise cannot be batched" };
+        for (std::size_t i = 0; i < m_na; ++i)
+            m_coeff_a[i * m_channels + k] = m.m_coeff_a[i];
+        for (std::size_t i = 0; i < m_nb; ++i)
+            m_coeff_b[i * m_channels + k] = m.m_coeff_b[i];
+        m_noise_mean.push_back(m.m_noise_mean);
+        m_noise_stddev.push_back(m.m_noise_stddev);
+        m_seed.push_back(m.m_init_seed);
+        m_n_generated.push_back(m.m_n_generated);
+        m_in.set_channel(k, m.m_in_signal_mem.view());
+        m_out.set_channel(k, m.m_out_signal_mem.view());
+        m_delay.set_channel(k, m.m_delay_mem.view());
+    }
+}
+
+void BatchARX::step(std::span<double> v)
+{
+    const auto delayed = m_scratch.data();
+    const auto b_poly = delayed + m_channels;
+    const auto a_poly = b_poly + m_channels;
+    std::copy_n(m_delay.row(m_delay.rows() - 1), m_channels, delayed);
+    m_delay.push_front(v.data());
+    m_in.push_front(delayed);
+    // Terms are added in the same order as in the strict dot product kernel, but each of them for
+    // all channels at once
+    std::fill_n(b_poly, 2 * m_channels, 0.0);
+    for (std::size_t i = 0; i < m_nb; ++i) {
+        const auto coeff = m_coeff_b.data() + i * m_channels;
+        const auto in = m_in.row(i);
+        for (std::size_t k = 0; k < m_channels; ++k)
+            b_poly[k] = b_poly[k] + coeff[k] * in[k];
+    }
+    for (std::size_t i = 0; i < m_na; ++i) {
+        const auto coeff = m_coeff_a.data() + i * m_channels;
+        const auto out = m_out.row(i);
+        for (std::size_t k = 0; k < m_channels; ++k)
+            a_poly[k] = a_poly[k] + coeff[k] * out[k];
+    }
+    for (std::size_t k = 0; k < m_channels; ++k) {
+        const auto noise = m_noise_stddev[k] == 0.0
+            ? m_noise_mean[k]
+            : m_noise_mean[k] + m_noise_stddev[k] * philox_normal(m_seed[k], m_n_generated[k]);
+        m_n_generated[k]++;
+        v[k] = b_poly[k] - a_poly[k] + noise;
+    }
+    m_out.push_front(v.data());
+}
+
+ModelARX BatchARX::channel(std::size_t k) const
+{
+    std::vector<double> coeff_a(m_na), coeff_b(m_nb);
+    for (std::size_t i = 0; i < m_na; ++i)
+        coeff_a[i] = m_coeff_a[i * m_channels + k];
+    for (std::size_t i = 0; i < m_nb; ++i)
+        coeff_b[i] = m_coeff_b[i * m_channels + k];
+    ModelARX m{ std::move(coeff_a), std::move(coeff_b), 1, m_noise_stddev[k] };
+    m.m_transport_delay = static_cast<uint32_t>(m_delay.rows());
+    m.m_noise_mean = m_noise_mean[k];
+    m.m_init_seed = m_seed[k];
+    m.m_n_generated = m_n_generated[k];
+    const auto in = m_in.get_channel(k);
+    const auto out = m_out.get_channel(k);
+    const auto delay = m_delay.get_channel(k);
+    m.m_in_signal_mem.assign(in.begin(), in.end());
+    m.m_out_signal_mem.assign(out.begin(), out.end());
+    m.m_delay_mem.assign(delay.begin(), delay.end());
+    return m;
+}
+
+BatchLoop::BatchLoop(std::span<const PętlaUAR *const> loops)
+    : m_channels{ loops.size() }
+{
+    if (loops.empty())
+        throw std::runtime_error{ "BatchLoop requires at least one loop" };
+    flatten(loops, m_elements);
+}
+
+void BatchLoop::simulate_loop(std::size_t index, std::span<double> v)
+{
+    auto &header = std::get<LoopHeader>(m_elements[index]);
+    if (header.closed)
+        for (std::size_t k = 0; k < m_channels; ++k)
+            v[k] -= header.prev_result[k];
+    const auto end = index + 1 + header.length;
+    for (auto i = index + 1; i < end;) {
+        if (const auto nested = std::get_if<LoopHeader>(&m_elements[i])) {
+            const auto next = i + 1 + nested->length;
+            simulate_loop(i, v);
+            i = next;
+            continue;
+        }
+        std::visit(overloaded{ [](LoopHeader &) { std::unreachable(); },
+                               [v](auto &e) { e.step(v); } },
+                   m_elements[i]);
+        ++i;
+    }
+    std::ranges::copy(v, header.prev_result.begin());
+}
+
+void BatchLoop::step(std::span<const double> u, std::span<double> y)
+{
+    if (u.size() != m_channels || y.size() != m_channels)
+        throw std::runtime_error{ "Input and output sizes must equal the number of channels" };
+    if (u.data() != y.data())
+        std::ranges::copy(u, y.begin());
+    simulate_loop(0, y);
+}
+
+void BatchLoop::simulate_block(std::span<const double> in, std::span<double> out)
+{
+    if (in.size() != out.size() || in.size() % m_channels != 0)
+        throw std::runtime_error{
+            "Input and output blocks must have the same size, multiple of the number of channels"
+        };
+    for (std::size_t offset = 0; offset < in.size(); offset += m_channels)
+        step(in.subspan(offset, m_channels), out.subspan(offset, m_channels));
+}
+
+PętlaUAR BatchLoop::channel(std::size_t k) const
+{
+    if (k >= m_channels)
+        throw std::runtime_error{ "Channel index out of range" };
+    std::size_t index = 0;
+    return rebuild(m_elements, k, index);
+}
+
+#ifdef LAB_TESTS
+#include <iostream>
+
+namespace {
+/// Loop of a channel: PID, static object and noisy ARX in a closed loop with a nested open loop.
+PętlaUAR batch_test_loop(std::size_t k)
+{
+    using p = ObiektStatyczny::point;
+    const auto s = static_cast<double>(k);
+    PętlaUAR loop{ true, 0.1 * s };
+    loop.push_back(std::make_unique<RegulatorPID>(0.4 + 0.05 * s, k % 2 == 0 ? 0.0 : 2.0, 0.1));
+    loop.push_back(std::make_unique<ObiektStatyczny>(p{ -2.0, -1.5 }, p{ 2.0, 1.0 + 0.1 * s }));
+    loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.4, 0.05 * s }, std::vector{ 0.6 }, 2,
+                                              k % 3 == 0 ? 0.0 : 0.01));
+    auto inner_loop = std::make_unique<PętlaUAR>(false);
+    inner_loop->push_back(std::make_unique<RegulatorPID>(1.2 - 0.1 * s));
+    inner_loop->push_back(std::make_unique<ModelARX>(std::vector{ -0.2, 0.1 },
+                                                     std::vector{ 0.5, 0.3 + 0.01 * s }, 1));
+    loop.push_back(std::move(inner_loop));
+    return loop;
+}
+}
+
+void BatchLoopTests::test_matches_loops()
+{
+    it_should_not_throw("BatchLoop channels match individual PętlaUARs", []() {
+        constexpr std::size_t channels = 7;
+        std::vector<PętlaUAR> loops;
+        std::vector<const PętlaUAR *> pointers;
+        for (std::size_t k = 0; k < channels; ++k)
+            loops.push_back(batch_test_loop(k));
+        for (const auto &loop : loops)
+            pointers.push_back(&loop);
+        BatchLoop batch{ pointers };
+        std::vector<double> u(channels), y(channels);
+        for (int t = 0; t < 300; ++t) {
+            for (std::size_t k = 0; k < channels; ++k)
+                u[k] = static_cast<double>((t / 20 + k) % 2);
+            batch.step(u, y);
+            for (std::size_t k = 0; k < channels; ++k)
+                if (y[k] != loops[k].symuluj(u[k]))
+                    throw std::runtime_error{ "Batched simulation does not match" };
+        }
+        std::vector<double> block(50 * channels, 1.0);
+        batch.simulate_block(block, block);
+        for (std::size_t k = 0; k < channels; ++k) {
+            std::vector<double> in(50, 1.0), expected(50);
+            loops[k].simulate_block(in, expected);
+            for (std::size_t t = 0; t < 50; ++t)
+                if (block[t * channels + k] != expected[t])
+                    throw std::runtime_error{ "Batched block simulation does not match" };
+            if (batch.channel(k) != loops[k])
+                throw std::runtime_error{ "Extracted channel does not match" };
+        }
+    });
+}
+
+void BatchLoopTests::test_mismatch()
+{
+    it_should_throw<std::runtime_error>(
+        "BatchLoop rejects loops with different ARX orders",
+        []() {
+            auto a = batch_test_loop(0);
+            PętlaUAR b{ true };
+            b.push_back(std::make_unique<RegulatorPID>(0.4));
+            b.push_back(std::make_unique<ObiektStatyczny>());
+            b.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 2));
+            auto inner_loop = std::make_unique<PętlaUAR>(false);
+            inner_loop->push_back(std::make_unique<RegulatorPID>(1.2));
+            inner_loop->push_back(std::make_unique<ModelARX>(std::vector{ -0.2, 0.1 },
+                                                             std::vector{ 0.5, 0.3 }, 1));
+            b.push_back(std::move(inner_loop));
+            const std::vector<const PętlaUAR *> loops{ &a, &b };
+            BatchLoop batch{ loops };
+        },
+        "ModelARX orders or delays of the loops differ");
+    it_should_throw<std::runtime_error>(
+        "BatchLoop rejects loops with different component types",
+        []() {
+            PętlaUAR a{ false }, b{ false };
+            a.push_back(std::make_unique<RegulatorPID>(0.4));
+            b.push_back(std::make_unique<ObiektStatyczny>());
+            const std::vector<const PętlaUAR *> loops{ &a, &b };
+            BatchLoop batch{ loops };
+        },
+        "Loops' components have different types");
+}
+
+void BatchLoopTests::run_tests()
+{
+    test_matches_loops();
+    test_mismatch();
+}
+#endif
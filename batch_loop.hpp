@@ -0,0 +1,211 @@
+/// @file batch_loop.hpp
+/// @brief Many independent loops with the same topology, simulated in lockstep.
+
+#pragma once
+#include "ModelARX.h"
+#include "ObiektStatyczny.hpp"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <variant>
+#include <vector>
+
+/// @brief Newest-first histories of many channels in structure-of-arrays layout.
+///
+/// A row holds one sample of every channel. Like in HistoryBuffer, every row is stored twice, so
+/// rows from the newest to the oldest are always consecutive.
+class BatchHistory {
+private:
+    /// Number of channels (row length).
+    std::size_t m_channels{};
+    /// Number of rows (samples of every channel).
+    std::size_t m_rows{};
+    /// Index of the newest row in the first half.
+    std::size_t m_head{};
+    /// Storage of `2 * m_rows` rows, the second half mirrors the first one.
+    std::vector<double> m_data;
+
+public:
+    /// @brief Construct zeroed histories.
+    /// @param channels number of channels
+    /// @param rows number of samples of every channel
+    BatchHistory(std::size_t channels, std::size_t rows);
+    /// Number of samples of every channel.
+    std::size_t rows() const noexcept { return m_rows; }
+    /// @brief Samples `age` steps older than the newest one, one per channel.
+    /// @param age age of the samples, must be smaller than rows()
+    const double *row(std::size_t age) const noexcept
+    {
+        return m_data.data() + (m_head + age) * m_channels;
+    }
+    /// @brief Insert a new row and drop the oldest one.
+    ///
+    /// Pushing into an empty history leaves it with a single row, like HistoryBuffer::push_front().
+    ///
+    /// @param values the newest sample of every channel
+    void push_front(const double *values);
+    /// @brief Set the history of a channel.
+    /// @param channel index of the channel
+    /// @param history newest-first samples, rows() of them
+    void set_channel(std::size_t channel, std::span<const double> history);
+    /// @brief Get the history of a channel.
+    /// @param channel index of the channel
+    /// @return Newest-first samples.
+    std::vector<double> get_channel(std::size_t channel) const;
+};
+
+/// @brief RegulatorPID instances simulated together, parameters and state stored per channel.
+class BatchPID {
+private:
+    std::vector<double> m_k, m_ti, m_td, m_integral, m_prev_e;
+
+public:
+    /// @brief Copy parameters and state of the regulators.
+    /// @param channels regulator of every channel
+    explicit BatchPID(std::span<const RegulatorPID *const> channels);
+    /// Number of channels.
+    std::size_t channels() const noexcept { return m_k.size(); }
+    /// @brief Simulate one step of every channel.
+    /// @param v input of every channel, replaced by the output
+    void step(std::span<double> v) noexcept;
+    /// Regulator of channel `k` with its current state.
+    RegulatorPID channel(std::size_t k) const;
+};
+
+/// @brief ObiektStatyczny instances simulated together, parameters stored per channel.
+class BatchStatic {
+private:
+    std::vector<double> m_max_val, m_min_val, m_a, m_b;
+
+public:
+    /// @brief Copy parameters of the objects.
+    /// @param channels object of every channel
+    explicit BatchStatic(std::span<const ObiektStatyczny *const> channels);
+    /// Number of channels.
+    std::size_t channels() const noexcept { return m_a.size(); }
+    /// @brief Simulate one step of every channel.
+    /// @param v input of every channel, replaced by the output
+    void step(std::span<double> v) noexcept;
+    /// Object of channel `k`.
+    ObiektStatyczny channel(std::size_t k) const;
+};
+
+/// @brief ModelARX instances with the same orders and delay simulated together.
+///
+/// Coefficients are stored as rows of all channels, so each term of the polynomials is computed
+/// for all channels by one contiguous loop, which compilers vectorize. Every channel sums its terms
+/// in the same order as the strict dot product kernel (regardless of set_fast_math()) and draws
+/// the noise from its own stream, so the results are bit-identical to simulating the models one by
+/// one with the default settings.
+class BatchARX {
+private:
+    /// Number of channels.
+    std::size_t m_channels;
+    /// Polynomial A coefficients, `m_coeff_a[i * m_channels + k]` is coefficient `i` of channel
+    /// `k`.
+    std::vector<double> m_coeff_a;
+    /// Polynomial B coefficients, same layout as #m_coeff_a.
+    std::vector<double> m_coeff_b;
+    /// Number of coefficients of polynomial A.
+    std::size_t m_na;
+    /// Number of coefficients of polynomial B.
+    std::size_t m_nb;
+    /// Noise means of the channels.
+    std::vector<double> m_noise_mean;
+    /// Noise standard deviations of the channels.
+    std::vector<double> m_noise_stddev;
+    /// Noise stream keys of the channels.
+    std::vector<std::uint64_t> m_seed;
+    /// Noise stream positions of the channels.
+    std::vector<std::uint64_t> m_n_generated;
+    /// Histories of input samples after delay.
+    BatchHistory m_in;
+    /// Histories of output samples.
+    BatchHistory m_out;
+    /// Histories of input samples being delayed.
+    BatchHistory m_delay;
+    /// Scratch rows: delayed inputs, B polynomial values and A polynomial values.
+    std::vector<double> m_scratch;
+
+public:
+    /// @brief Copy parameters and state of the models.
+    /// @param channels model of every channel
+    /// @throws `std::runtime_error` if orders, delays or history lengths of the models differ or a
+    /// model has legacy noise (see ModelARX::has_legacy_noise()).
+    explicit BatchARX(std::span<const ModelARX *const> channels);
+    /// Number of channels.
+    std::size_t channels() const noexcept { return m_channels; }
+    /// @brief Simulate one step of every channel.
+    /// @param v input of every channel, replaced by the output
+    void step(std::span<double> v);
+    /// Model of channel `k` with its current state.
+    ModelARX channel(std::size_t k) const;
+};
+
+/// @brief Many PętlaUARs with the same topology simulated in lockstep (one channel per loop).
+///
+/// The loops are flattened in pre-order like in FrozenLoop, but every element holds the parameters
+/// and state of all channels in structure-of-arrays layout. A step advances all channels through
+/// each element at once, so the cost of dispatch is shared by all of them. Every channel keeps its
+/// own previous results, so closed loops work the same way as in PętlaUAR.
+class BatchLoop {
+public:
+    /// Beginning of a (possibly nested) loop, which contains the following #length elements.
+    struct LoopHeader {
+        /// Whether the loop is closed.
+        bool closed;
+        /// Stored previous simulation result of every channel.
+        std::vector<double> prev_result;
+        /// Number of elements (in all nested loops) that belong to this loop.
+        std::size_t length;
+    };
+    /// A single element of the flattened loops.
+    using element = std::variant<LoopHeader, BatchPID, BatchStatic, BatchARX>;
+
+private:
+    /// Number of channels.
+    std::size_t m_channels;
+    /// Flattened loops; the first element is the header of the root loop.
+    std::vector<element> m_elements;
+
+    /// @brief Simulate the loop starting at `index` for all channels.
+    /// @param index index of the loop's header in #m_elements
+    /// @param v input of every channel, replaced by the output
+    void simulate_loop(std::size_t index, std::span<double> v);
+
+public:
+    /// @brief Copy the loops.
+    /// @param loops loop of every channel, at least one
+    /// @throws `std::runtime_error` if the loops have different topologies (including orders and
+    /// delays of ARX models) or contain unsupported components.
+    explicit BatchLoop(std::span<const PętlaUAR *const> loops);
+    /// Number of channels.
+    std::size_t channels() const noexcept { return m_channels; }
+    /// @brief Simulate one step of all loops.
+    /// @param u input of every channel
+    /// @param y output of every channel, may be the same as `u`
+    /// @throws `std::runtime_error` if sizes of `u` or `y` differ from channels().
+    void step(std::span<const double> u, std::span<double> y);
+    /// @brief Simulate consecutive steps of all loops.
+    /// @param in inputs, `in[t * channels() + k]` is the input of channel `k` in step `t`
+    /// @param out outputs in the same layout, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ or are not multiples of
+    /// channels().
+    void simulate_block(std::span<const double> in, std::span<double> out);
+    /// @brief Extract the loop of a channel.
+    /// @param k index of the channel
+    /// @return A PętlaUAR with the same components and state as channel `k`.
+    PętlaUAR channel(std::size_t k) const;
+};
+
+#ifdef LAB_TESTS
+class BatchLoopTests {
+    static void test_matches_loops();
+    static void test_mismatch();
+
+public:
+    static void run_tests();
+};
+#endif
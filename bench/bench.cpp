@@ -0,0 +1,90 @@
+#include "bench.hpp"
+#include "../arx_kernel.hpp"
+#include <array>
+#include <cstdio>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+/// Escape a string for a JSON string literal.
+std::string json_escape(std::string_view s)
+{
+    std::string escaped;
+    for (const auto c : s) {
+        if (c == '"' || c == '\\')
+            escaped += std::format("\\{}", c);
+        else if (static_cast<unsigned char>(c) < 0x20)
+            escaped += std::format("\\u{:04x}", static_cast<unsigned>(c));
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+}
+
+void BenchmarkRunner::run(std::string name, const Body &body)
+{
+    if (!m_filter.empty() && name.find(m_filter) == std::string::npos)
+        return;
+    for (std::size_t iterations = 1;; iterations *= 2) {
+        const auto cpu_start = std::clock();
+        const auto start = std::chrono::steady_clock::now();
+        const auto items = body(iterations);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const auto cpu_elapsed = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        // Stop at the minimum time, or when doubling the iterations again could overflow
+        if (elapsed < m_min_time && iterations < (std::size_t{ 1 } << 40))
+            continue;
+        const auto n = static_cast<double>(iterations);
+        auto &result = m_results.emplace_back(BenchmarkResult{
+            std::move(name), iterations, elapsed.count() * 1e9 / n, cpu_elapsed * 1e9 / n,
+            static_cast<double>(items) / elapsed.count() });
+        std::printf("%-56s %14.1f ns %14.1f ns %12zu", result.name.c_str(), result.real_time,
+                    result.cpu_time, result.iterations);
+        if (items != 0)
+            std::printf(" %12.4g items/s", result.items_per_second);
+        std::printf("\n");
+        return;
+    }
+}
+
+void BenchmarkRunner::write_json(const std::string &path, std::string_view executable) const
+{
+    std::ofstream out{ path, std::ios::out | std::ios::trunc };
+    const auto now = std::time(nullptr);
+    std::array<char, 32> date{};
+    std::strftime(date.data(), date.size(), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    const auto isa = isa_name(fast_kernel_isa());
+    out << "{\n  \"context\": {\n";
+    out << std::format("    \"date\": \"{}\",\n", date.data());
+    out << std::format("    \"executable\": \"{}\",\n", json_escape(executable));
+    out << std::format("    \"num_cpus\": {},\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+    out << "    \"library_build_type\": \"release\",\n";
+#else
+    out << "    \"library_build_type\": \"debug\",\n";
+#endif
+    out << std::format("    \"arx_fast_kernel\": \"{}\"\n", json_escape(isa));
+    out << "  },\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i < m_results.size(); ++i) {
+        const auto &r = m_results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\n";
+        out << std::format("      \"name\": \"{0}\",\n      \"run_name\": \"{0}\",\n",
+                           json_escape(r.name));
+        out << "      \"run_type\": \"iteration\",\n";
+        out << std::format("      \"iterations\": {},\n", r.iterations);
+        out << std::format("      \"real_time\": {},\n", r.real_time);
+        out << std::format("      \"cpu_time\": {},\n", r.cpu_time);
+        out << "      \"time_unit\": \"ns\"";
+        if (r.items_per_second != 0.0)
+            out << std::format(",\n      \"items_per_second\": {}", r.items_per_second);
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+    out.flush();
+    if (!out)
+        throw std::runtime_error{ "Could not write the benchmark results" };
+}
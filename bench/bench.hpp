@@ -0,0 +1,82 @@
+/// @file bench.hpp
+/// @brief Minimal microbenchmark runner writing results in the Google Benchmark JSON format.
+///
+/// Every benchmark is a function running a given number of iterations. The runner doubles the
+/// number of iterations until a run takes at least the minimum time (like Google Benchmark does)
+/// and reports the time per iteration. The JSON output has the same layout as the one of
+/// `--benchmark_out_format=json`, so the results can be compared with the usual tools (e.g.
+/// `compare.py` from Google Benchmark).
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// @brief Prevent the compiler from optimizing out computation of `value`.
+template <typename T> inline void do_not_optimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char *>(&value);
+#endif
+}
+
+/// Result of a single benchmark.
+struct BenchmarkResult {
+    /// Name of the benchmark, e.g. `"ModelARX/symuluj/order:16/delay:1"`.
+    std::string name;
+    /// Number of iterations of the measured run.
+    std::size_t iterations{};
+    /// Wall clock time per iteration in nanoseconds.
+    double real_time{};
+    /// CPU time per iteration in nanoseconds.
+    double cpu_time{};
+    /// Items (e.g. samples) processed per second of wall clock time, 0 if not reported.
+    double items_per_second{};
+};
+
+/// @brief Runs benchmarks and collects their results.
+class BenchmarkRunner {
+public:
+    /// @brief Benchmark body.
+    /// @param iterations number of iterations to run
+    /// @return Number of processed items, 0 if the benchmark doesn't count items.
+    using Body = std::function<std::size_t(std::size_t iterations)>;
+
+private:
+    /// Only benchmarks with names containing this string are run.
+    std::string m_filter;
+    /// Minimum duration of the measured run.
+    std::chrono::duration<double> m_min_time;
+    /// Results of the benchmarks run so far.
+    std::vector<BenchmarkResult> m_results;
+
+public:
+    /// @brief Construct a runner.
+    /// @param filter substring of the names of benchmarks to run, empty to run all
+    /// @param min_time minimum duration of the measured run in seconds
+    explicit BenchmarkRunner(std::string filter = {}, double min_time = 0.2)
+        : m_filter{ std::move(filter) }
+        , m_min_time{ min_time }
+    {
+    }
+
+    /// @brief Run a benchmark and print its result to the standard output.
+    /// @param name name of the benchmark
+    /// @param body benchmark body
+    void run(std::string name, const Body &body);
+    /// Results of the benchmarks run so far.
+    const std::vector<BenchmarkResult> &results() const noexcept { return m_results; }
+    /// @brief Write the results in the Google Benchmark JSON format.
+    /// @param path path of the file, overwritten if it exists
+    /// @param executable name of the benchmark executable, stored in the context
+    /// @throws `std::runtime_error` if the file can't be written.
+    void write_json(const std::string &path, std::string_view executable) const;
+};
@@ -0,0 +1,84 @@
+/// @file bench_arx.cpp
+/// @brief Throughput of ModelARX::symuluj() for different model orders.
+///
+/// Compares the HistoryBuffer-based ModelARX with a reference std::deque implementation of the same
+/// model (the storage used previously, including the noise draw), in both strict and fast math
+/// modes of the dot product kernel. Run with `--filter ARXStorage`.
+
+#include "../ModelARX.h"
+#include "../arx_kernel.hpp"
+#include "groups.hpp"
+#include <deque>
+#include <format>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+    /// ARX model simulated the old way, with `pop_back()`/`push_front()` calls per sample.
+    class DequeARX {
+        std::vector<double> m_coeff_a;
+        std::vector<double> m_coeff_b;
+        std::deque<double> m_in, m_out, m_delay;
+        std::normal_distribution<double> m_distribution{ 0.0, 0.0 };
+        std::mt19937_64 m_mt{ 5489U };
+
+    public:
+        DequeARX(const std::vector<double> &a, const std::vector<double> &b, std::size_t delay)
+            : m_coeff_a{ a }
+            , m_coeff_b{ b }
+            , m_in(b.size())
+            , m_out(a.size())
+            , m_delay(delay)
+        {
+        }
+        double symuluj(double u)
+        {
+            m_in.pop_back();
+            m_in.push_front(m_delay.back());
+            m_delay.pop_back();
+            m_delay.push_front(u);
+            const auto y
+                = std::inner_product(m_coeff_b.begin(), m_coeff_b.end(), m_in.begin(), 0.0)
+                - std::inner_product(m_coeff_a.begin(), m_coeff_a.end(), m_out.begin(), 0.0)
+                + m_distribution(m_mt);
+            m_out.pop_back();
+            m_out.push_front(y);
+            return y;
+        }
+    };
+
+    /// @brief Benchmark of `model` simulated sample by sample.
+    /// @param model the simulated model
+    /// @param fast whether the dot product kernel is switched to fast math during the run
+    template <typename M> BenchmarkRunner::Body steps(M model, bool fast)
+    {
+        return [model = std::make_shared<M>(std::move(model)), fast](std::size_t n) {
+            set_fast_math(fast);
+            double acc = 0.0;
+            for (std::size_t i = 0; i < n; ++i)
+                acc += model->symuluj(static_cast<double>(i % 16 == 0));
+            set_fast_math(false);
+            do_not_optimize(acc);
+            return n;
+        };
+    }
+}
+
+void register_arx_storage(BenchmarkRunner &runner)
+{
+    for (const std::size_t order : { 1UZ, 4UZ, 16UZ, 64UZ, 128UZ, 256UZ }) {
+        std::vector<double> coeff_a(order);
+        std::vector<double> coeff_b(order);
+        for (std::size_t i = 0; i < order; ++i) {
+            coeff_a[i] = (i % 2 ? -0.3 : 0.4) / static_cast<double>(order);
+            coeff_b[i] = 1.0 / static_cast<double>(order);
+        }
+        const ModelARX model{ std::vector{ coeff_a }, std::vector{ coeff_b }, 1, 0.0 };
+        runner.run(std::format("ARXStorage/strict/order:{}", order), steps(model, false));
+        runner.run(std::format("ARXStorage/fast/order:{}", order), steps(model, true));
+        runner.run(std::format("ARXStorage/deque/order:{}", order),
+                   steps(DequeARX{ coeff_a, coeff_b, 1 }, false));
+    }
+}
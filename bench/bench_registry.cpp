@@ -0,0 +1,105 @@
+/// @file bench_registry.cpp
+/// @brief Lookup time of PrefixRegistry for different numbers of registered types.
+///
+/// Compares PrefixRegistry with a reference vector of [prefix, factory] pairs scanned linearly (the
+/// registry used previously). Names are looked up in random order, followed by some payload, like
+/// in serialized data. The time of deserializing a stack of nested generators is measured as well.
+/// Run with `--filter Registry`.
+
+#include "../generators.hpp"
+#include "../prefix_registry.hpp"
+#include "groups.hpp"
+#include <algorithm>
+#include <format>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    using Factory = std::size_t (*)(std::span<const std::uint8_t>);
+    /// Serialized data looked up in a registry.
+    using Keys = std::vector<std::vector<std::uint8_t>>;
+
+    /// Registry matched the old way, comparing the data with every registered name.
+    class LinearRegistry {
+        std::vector<std::pair<std::vector<std::uint8_t>, Factory>> m_entries;
+
+    public:
+        void add(std::string_view name, Factory factory)
+        {
+            m_entries.emplace_back(std::vector<std::uint8_t>(name.begin(), name.end()), factory);
+        }
+        Factory find(std::span<const std::uint8_t> data) const noexcept
+        {
+            for (const auto &[name, factory] : m_entries) {
+                if (data.size() >= name.size() && std::ranges::equal(data.first(name.size()), name))
+                    return factory;
+            }
+            return nullptr;
+        }
+    };
+
+    /// @brief Benchmark of looking up `keys` in turn, an iteration is a lookup.
+    template <typename R>
+    BenchmarkRunner::Body lookups(std::shared_ptr<const R> registry,
+                                  std::shared_ptr<const Keys> keys)
+    {
+        return [registry = std::move(registry), keys = std::move(keys)](std::size_t n) {
+            std::size_t acc = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto &key = (*keys)[i % keys->size()];
+                acc += registry->find(key)(key);
+            }
+            do_not_optimize(acc);
+            return n;
+        };
+    }
+}
+
+void register_registry(BenchmarkRunner &runner)
+{
+    const Factory factory = [](std::span<const std::uint8_t> data) { return data.size(); };
+    std::mt19937_64 mt{ 5489U };
+    for (const std::size_t types : { 6UZ, 16UZ, 64UZ, 256UZ, 1024UZ }) {
+        // Names of the same length with a shared prefix, like those of plugins from one library
+        std::vector<std::string> names;
+        for (std::size_t i = 0; i < types; ++i)
+            names.push_back("plugin_" + std::to_string(1000 + i));
+        // 1024 names of 11 bytes need about 1200 nodes, too many for the stack
+        const auto trie = std::make_shared<PrefixRegistry<Factory, 2048>>();
+        const auto linear = std::make_shared<LinearRegistry>();
+        for (const auto &name : names) {
+            trie->add(name, factory);
+            linear->add(name, factory);
+        }
+        const auto keys = std::make_shared<Keys>();
+        for (std::size_t i = 0; i < 4096; ++i) {
+            auto key = range_to_bytes(names[mt() % types]);
+            key.resize(key.size() + 32);
+            keys->push_back(std::move(key));
+        }
+        runner.run(std::format("Registry/trie/types:{}", types),
+                   lookups<PrefixRegistry<Factory, 2048>>(trie, keys));
+        runner.run(std::format("Registry/linear/types:{}", types),
+                   lookups<LinearRegistry>(linear, keys));
+    }
+
+    // Deeply nested decorators, every level is dispatched through the registry
+    std::unique_ptr<Generator> generator = std::make_unique<GeneratorBaza>(1.0);
+    for (int i = 0; i < 100; ++i) {
+        if (i % 2 == 0)
+            generator = std::make_unique<GeneratorSinus>(std::move(generator), 1.0, 10);
+        else
+            generator = std::make_unique<GeneratorUniformNoise>(std::move(generator), 0.1);
+    }
+    runner.run("Registry/deserialize/nested_generators:101",
+               [serialized = generator->dump()](std::size_t n) {
+                   for (std::size_t i = 0; i < n; ++i) {
+                       const auto restored = Generator::deserialize(serialized);
+                       do_not_optimize(restored.get());
+                   }
+                   return n;
+               });
+}
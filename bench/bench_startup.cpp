@@ -0,0 +1,38 @@
+/// @file bench_startup.cpp
+/// @brief Cold start time of the executables, for scripts launching many short-lived instances.
+///
+/// Launches a command repeatedly and measures the wall time of a launch, next to the time of
+/// launching an empty shell command. By default `polabs-cli --help` from the directory of the
+/// benchmark executable is measured, which includes the static initialization of the deserializer
+/// registries. The GUI is measured with `POlabsBench --filter Startup --startup "./POlabs
+/// --startup-time"`, which quits as soon as the window and its deferred widgets are set up.
+
+#include "groups.hpp"
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+#ifdef _WIN32
+    constexpr const char *discard_output = " > NUL 2>&1";
+#else
+    constexpr const char *discard_output = " > /dev/null 2>&1";
+#endif
+
+    /// @brief Benchmark of launching `command`, an iteration is a launch.
+    BenchmarkRunner::Body launches(std::string command)
+    {
+        return [command = std::move(command) + discard_output](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                if (std::system(command.c_str()) != 0)
+                    throw std::runtime_error{ "Could not launch: " + command };
+            }
+            return n;
+        };
+    }
+}
+
+void register_startup(BenchmarkRunner &runner, const std::string &command)
+{
+    runner.run("Startup/shell", launches("exit 0"));
+    runner.run("Startup/command", launches(command));
+}
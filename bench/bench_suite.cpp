@@ -0,0 +1,316 @@
+/// @file bench_suite.cpp
+/// @brief Microbenchmarks of all SISO components, generators and serialization.
+///
+/// Usage: `POlabsBench [--filter SUBSTRING] [--min-time SECONDS] [--json FILE] [--startup COMMAND]`
+///
+/// Results are printed as a table and optionally written as JSON (see bench.hpp), so that
+/// throughput can be compared between releases. The groups in groups.hpp are run as well, the
+/// startup group launches `COMMAND` (see bench_startup.cpp). Build in Release mode for meaningful
+/// numbers.
+
+#include "../ModelARX.h"
+#include "../ObiektStatyczny.hpp"
+#include "../PętlaUAR.hpp"
+#include "../RegulatorPID.h"
+#include "../batch_loop.hpp"
+#include "../feedback_loop.hpp"
+#include "../generators.hpp"
+#include "../linear_fusion.hpp"
+#include "bench.hpp"
+#include "groups.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Number of samples of block simulation benchmarks.
+constexpr std::size_t block_size = 1024;
+
+/// ARX model of given order with stable coefficients.
+ModelARX make_arx(std::size_t order, int delay, double stddev = 0.0)
+{
+    std::vector<double> coeff_a(order), coeff_b(order);
+    for (std::size_t i = 0; i < order; ++i) {
+        coeff_a[i] = (i % 2 ? -0.3 : 0.4) / static_cast<double>(order);
+        coeff_b[i] = 1.0 / static_cast<double>(order);
+    }
+    return ModelARX{ std::move(coeff_a), std::move(coeff_b), delay, stddev };
+}
+
+/// Loop of `depth` loops nested in each other, each one with a regulator and a static object.
+PętlaUAR make_nested_loop(std::size_t depth)
+{
+    PętlaUAR loop{ true };
+    loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.1));
+    loop.push_back(std::make_unique<ObiektStatyczny>());
+    if (depth > 1)
+        loop.push_back(std::make_unique<PętlaUAR>(make_nested_loop(depth - 1)));
+    return loop;
+}
+
+/// Open loop of `width` components, alternating regulators and ARX models.
+PętlaUAR make_wide_loop(std::size_t width)
+{
+    PętlaUAR loop{ false };
+    for (std::size_t i = 0; i < width; ++i) {
+        if (i % 2 == 0)
+            loop.push_back(std::make_unique<RegulatorPID>(0.9, 10.0));
+        else
+            loop.push_back(std::make_unique<ModelARX>(make_arx(4, 1)));
+    }
+    return loop;
+}
+
+/// Generator chain with every generator type.
+std::unique_ptr<Generator> make_generator_chain()
+{
+    auto base = std::make_unique<GeneratorBaza>(1.0);
+    auto sin = std::make_unique<GeneratorSinus>(std::move(base), 2.0, 50);
+    auto pwm = std::make_unique<GeneratorProstokat>(std::move(sin), 1.0, 20, 0.25);
+    auto saw = std::make_unique<GeneratorSawtooth>(std::move(pwm), 0.5, 30);
+    auto uni = std::make_unique<GeneratorUniformNoise>(std::move(saw), 0.1);
+    return std::make_unique<GeneratorNormalNoise>(std::move(uni), 0.0, 0.05);
+}
+
+/// Benchmark of per-sample simulation of a SISO object.
+template <typename T> BenchmarkRunner::Body siso_symuluj(T object)
+{
+    // Shared, since loops can't be copied into the std::function
+    return [object = std::make_shared<T>(std::move(object))](std::size_t n) {
+        double acc = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+            acc += object->symuluj(static_cast<double>(i % 16 == 0));
+        do_not_optimize(acc);
+        return n;
+    };
+}
+
+/// Benchmark of block simulation of a SISO object, an iteration is a block.
+template <typename T> BenchmarkRunner::Body siso_block(T object)
+{
+    return [object = std::make_shared<T>(std::move(object))](std::size_t n) {
+        std::vector<double> in(block_size), out(block_size);
+        for (std::size_t i = 0; i < block_size; ++i)
+            in[i] = static_cast<double>(i % 16 == 0);
+        for (std::size_t i = 0; i < n; ++i) {
+            object->simulate_block(in, out);
+            do_not_optimize(out.back());
+        }
+        return n * block_size;
+    };
+}
+
+/// Benchmark of a dump() and ObiektSISO::deserialize() round trip.
+BenchmarkRunner::Body siso_round_trip(const ObiektSISO &object)
+{
+    return [&object](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto restored = ObiektSISO::deserialize(object.dump());
+            do_not_optimize(restored.get());
+        }
+        return n;
+    };
+}
+
+void register_siso(BenchmarkRunner &runner)
+{
+    for (const std::size_t order : { 1UZ, 4UZ, 16UZ, 64UZ, 256UZ }) {
+        for (const int delay : { 1, 16 }) {
+            runner.run(std::format("ModelARX/symuluj/order:{}/delay:{}", order, delay),
+                       siso_symuluj(make_arx(order, delay)));
+        }
+    }
+    runner.run("ModelARX/symuluj/order:16/noise", siso_symuluj(make_arx(16, 1, 0.01)));
+    runner.run("ModelARX/simulate_block/order:16", siso_block(make_arx(16, 1)));
+    runner.run("RegulatorPID/symuluj/P", siso_symuluj(RegulatorPID{ 0.5 }));
+    runner.run("RegulatorPID/symuluj/PID", siso_symuluj(RegulatorPID{ 0.5, 5.0, 0.2 }));
+    runner.run("RegulatorPID/simulate_block/PID", siso_block(RegulatorPID{ 0.5, 5.0, 0.2 }));
+    runner.run("ObiektStatyczny/symuluj", siso_symuluj(ObiektStatyczny{}));
+    runner.run("ObiektStatyczny/simulate_block", siso_block(ObiektStatyczny{}));
+    const auto pid_arx_uar = [] {
+        PętlaUAR loop{ true };
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+        loop.push_back(std::make_unique<ModelARX>(make_arx(4, 1, 0.01)));
+        return loop;
+    };
+    runner.run("PętlaUAR/symuluj/PID+ARX", siso_symuluj(pid_arx_uar()));
+    runner.run("PętlaUAR/simulate_block/PID+ARX", siso_block(pid_arx_uar()));
+    runner.run("PidArxLoop/symuluj",
+               siso_symuluj(PidArxLoop{ RegulatorPID{ 0.5, 5.0, 0.2 }, make_arx(4, 1, 0.01) }));
+    runner.run("PidArxLoop/simulate_block",
+               siso_block(PidArxLoop{ RegulatorPID{ 0.5, 5.0, 0.2 }, make_arx(4, 1, 0.01) }));
+    for (const std::size_t depth : { 1UZ, 4UZ, 16UZ }) {
+        runner.run(std::format("PętlaUAR/symuluj/depth:{}", depth),
+                   siso_symuluj(make_nested_loop(depth)));
+    }
+    for (const std::size_t width : { 2UZ, 8UZ, 32UZ }) {
+        runner.run(std::format("PętlaUAR/symuluj/width:{}", width),
+                   siso_symuluj(make_wide_loop(width)));
+        runner.run(std::format("PętlaUAR/simulate_block/width:{}", width),
+                   siso_block(make_wide_loop(width)));
+    }
+}
+
+void register_batch(BenchmarkRunner &runner)
+{
+    // An item is a sample of one channel, comparable with PętlaUAR/symuluj/width:8
+    for (const std::size_t channels : { 1UZ, 8UZ, 64UZ }) {
+        std::vector<PętlaUAR> loops;
+        std::vector<const PętlaUAR *> pointers;
+        for (std::size_t k = 0; k < channels; ++k)
+            loops.push_back(make_wide_loop(8));
+        for (const auto &loop : loops)
+            pointers.push_back(&loop);
+        auto batch = std::make_shared<BatchLoop>(pointers);
+        runner.run(std::format("BatchLoop/step/width:8/channels:{}", channels),
+                   [batch, channels](std::size_t n) {
+                       std::vector<double> u(channels), y(channels);
+                       for (std::size_t i = 0; i < n; ++i) {
+                           std::ranges::fill(u, static_cast<double>(i % 16 == 0));
+                           batch->step(u, y);
+                           do_not_optimize(y.back());
+                       }
+                       return n * channels;
+                   });
+    }
+}
+
+void register_fusion(BenchmarkRunner &runner)
+{
+    // Closed loop of a regulator and a chain of 4 second order models separated by gains
+    const auto make_chain_loop = [] {
+        PętlaUAR loop{ true };
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0));
+        for (std::size_t i = 0; i < 4; ++i) {
+            if (i != 0)
+                loop.push_back(std::make_unique<ObiektStatyczny>(ObiektStatyczny::unbounded(1.1)));
+            loop.push_back(std::make_unique<ModelARX>(make_arx(2, 1)));
+        }
+        return loop;
+    };
+    runner.run("Fusion/symuluj/chain:7", siso_symuluj(make_chain_loop()));
+    auto fused = make_chain_loop();
+    fuse_linear_chains(fused);
+    runner.run("Fusion/symuluj/chain:7/fused", siso_symuluj(std::move(fused)));
+}
+
+void register_generators(BenchmarkRunner &runner)
+{
+    const auto base = [] { return std::make_unique<GeneratorBaza>(1.0); };
+    std::vector<std::pair<std::string_view, std::shared_ptr<Generator>>> generators;
+    generators.emplace_back(GeneratorBaza::unique_name, base());
+    generators.emplace_back(GeneratorSinus::unique_name,
+                            std::make_shared<GeneratorSinus>(base(), 2.0, 50));
+    generators.emplace_back(GeneratorProstokat::unique_name,
+                            std::make_shared<GeneratorProstokat>(base(), 2.0, 50, 0.3));
+    generators.emplace_back(GeneratorSawtooth::unique_name,
+                            std::make_shared<GeneratorSawtooth>(base(), 2.0, 50));
+    generators.emplace_back(GeneratorUniformNoise::unique_name,
+                            std::make_shared<GeneratorUniformNoise>(base(), 0.5));
+    generators.emplace_back(GeneratorNormalNoise::unique_name,
+                            std::make_shared<GeneratorNormalNoise>(base(), 0.0, 0.5));
+    generators.emplace_back("chain", make_generator_chain());
+    for (const auto &[name, generator] : generators) {
+        runner.run(std::format("Generator/symuluj/{}", name), [generator](std::size_t n) {
+            double acc = 0.0;
+            for (std::size_t i = 0; i < n; ++i)
+                acc += generator->symuluj(static_cast<int>(i % (1U << 30)));
+            do_not_optimize(acc);
+            return n;
+        });
+        runner.run(std::format("Generator/generate/{}", name), [generator](std::size_t n) {
+            std::vector<double> out(block_size);
+            for (std::size_t i = 0; i < n; ++i) {
+                generator->generate(static_cast<int>(i % (1U << 20) * block_size), out);
+                do_not_optimize(out.back());
+            }
+            return n * block_size;
+        });
+    }
+}
+
+void register_serialization(BenchmarkRunner &runner)
+{
+    static const RegulatorPID pid{ 0.5, 5.0, 0.2 };
+    static const ModelARX arx = make_arx(64, 3, 0.01);
+    static const PętlaUAR nested = make_nested_loop(4);
+    static const PętlaUAR wide = make_wide_loop(32);
+    runner.run("RoundTrip/RegulatorPID", siso_round_trip(pid));
+    runner.run("RoundTrip/ModelARX/order:64", siso_round_trip(arx));
+    runner.run("RoundTrip/PętlaUAR/depth:4", siso_round_trip(nested));
+    runner.run("RoundTrip/PętlaUAR/width:32", siso_round_trip(wide));
+    static const auto chain = make_generator_chain();
+    runner.run("RoundTrip/Generator/chain", [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto restored = Generator::deserialize(chain->dump());
+            do_not_optimize(restored.get());
+        }
+        return n;
+    });
+}
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter, json, startup;
+    double min_time = 0.2;
+    const std::span args{ argv, static_cast<std::size_t>(argc) };
+    for (std::size_t i = 1; i + 1 < args.size(); i += 2) {
+        const std::string_view arg{ args[i] }, value{ args[i + 1] };
+        if (arg == "--filter") {
+            filter = value;
+        } else if (arg == "--json") {
+            json = value;
+        } else if (arg == "--startup") {
+            startup = value;
+        } else if (arg == "--min-time") {
+            const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(),
+                                                   min_time);
+            if (ec != std::errc{} || end != value.data() + value.size() || min_time < 0.0) {
+                std::fprintf(stderr, "Invalid minimum time: %s\n", args[i + 1]);
+                return 2;
+            }
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", args[i]);
+            return 2;
+        }
+    }
+    if (args.size() % 2 == 0) {
+        std::fprintf(stderr, "Option %s expects a value\n", args.back());
+        return 2;
+    }
+
+    if (startup.empty()) {
+        const auto cli = std::filesystem::path{ args[0] }.parent_path() / "polabs-cli";
+        startup = '"' + cli.string() + "\" --help";
+    }
+
+    BenchmarkRunner runner{ filter, min_time };
+    std::printf("%-56s %17s %17s %12s\n", "benchmark", "time", "cpu", "iterations");
+    try {
+        register_siso(runner);
+        register_batch(runner);
+        register_fusion(runner);
+        register_generators(runner);
+        register_serialization(runner);
+        register_arx_storage(runner);
+        register_registry(runner);
+        register_startup(runner, startup);
+        if (!json.empty())
+            runner.write_json(json, args[0]);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+/// @file groups.hpp
+/// @brief Benchmark groups comparing optimized implementations with the ones they replaced.
+///
+/// Every group registers its benchmarks in a BenchmarkRunner; they are run by the POlabsBench
+/// executable together with the microbenchmarks in bench_suite.cpp.
+
+#pragma once
+#include "bench.hpp"
+#include <string>
+
+/// @brief ModelARX::symuluj() in strict and fast math modes, and a reference std::deque model.
+/// @param runner runner of the benchmarks
+void register_arx_storage(BenchmarkRunner &runner);
+/// @brief PrefixRegistry lookups, a reference linear registry and nested deserialization.
+/// @param runner runner of the benchmarks
+void register_registry(BenchmarkRunner &runner);
+/// @brief Cold start time of a command and of an empty shell command, an iteration is a launch.
+/// @param runner runner of the benchmarks
+/// @param command command to launch, its output is discarded
+/// @throws `std::runtime_error` from the benchmark if the command fails.
+void register_startup(BenchmarkRunner &runner, const std::string &command);
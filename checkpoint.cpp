@@ -0,0 +1,242 @@
+#include "checkpoint.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+/// @brief Number of zero bytes after the serialized objects, so that the history is aligned.
+/// @param data_size total size of the serialized loop and generators
+constexpr std::size_t history_padding(std::uint64_t data_size)
+{
+    return static_cast<std::size_t>((sizeof(double) - data_size % sizeof(double))
+                                    % sizeof(double));
+}
+}
+
+void write_checkpoint(const std::filesystem::path &path, const ObiektSISO &loop,
+                      std::span<const std::uint8_t> generators, std::int64_t generator_time,
+                      ResultStore &results)
+{
+    const auto first = results.first_available();
+    const auto n_results = results.size() - first;
+    const auto loop_size = loop.dump_size();
+    const auto data_size = loop_size + generators.size();
+
+    // Header, loop and generators are serialized into a single buffer
+    std::vector<std::uint8_t> head(Checkpoint::header_size + data_size
+                                   + history_padding(data_size));
+    ByteWriter writer{ head };
+    writer.put_range(Checkpoint::magic);
+    writer.put(Checkpoint::version);
+    writer.put(static_cast<std::uint64_t>(loop_size));
+    writer.put(static_cast<std::uint64_t>(generators.size()));
+    writer.put(generator_time);
+    writer.put(static_cast<std::uint64_t>(first));
+    writer.put(static_cast<std::uint64_t>(n_results));
+    loop.dump_to(writer.take(loop_size));
+    std::ranges::copy(generators, writer.take(generators.size()).begin());
+
+    // The history may be read from a mapping of the file at `path` (restore_results()), so it
+    // must not be truncated: a new file is written and renamed over it, keeping the old inode
+    auto temp_path = path;
+    temp_path += ".tmp";
+    std::ofstream out{ temp_path, std::ios::out | std::ios::trunc | std::ios::binary };
+    out.write(reinterpret_cast<const char *>(head.data()),
+              static_cast<std::streamsize>(head.size()));
+
+    // All inputs are followed by all outputs, the history is copied one chunk at a time
+    const auto inputs_offset = static_cast<std::streamoff>(head.size());
+    const auto outputs_offset
+        = inputs_offset + static_cast<std::streamoff>(n_results * sizeof(double));
+    const auto block = results.chunk_size();
+    std::vector<double> inputs(block), outputs(block);
+    for (std::size_t done = 0; done < n_results && out; done += block) {
+        const auto n = std::min(block, n_results - done);
+        results.read(first + done, std::span{ inputs }.first(n), std::span{ outputs }.first(n));
+        const auto bytes = static_cast<std::streamsize>(n * sizeof(double));
+        const auto offset = static_cast<std::streamoff>(done * sizeof(double));
+        out.seekp(inputs_offset + offset);
+        out.write(reinterpret_cast<const char *>(inputs.data()), bytes);
+        out.seekp(outputs_offset + offset);
+        out.write(reinterpret_cast<const char *>(outputs.data()), bytes);
+    }
+    out.close();
+    std::error_code error;
+    if (out)
+        std::filesystem::rename(temp_path, path, error);
+    if (!out || error) {
+        std::filesystem::remove(temp_path, error);
+        throw std::runtime_error{ "Could not write the checkpoint" };
+    }
+}
+
+Checkpoint::Checkpoint(const std::filesystem::path &path)
+    : m_file{ path }
+{
+    ByteReader reader{ m_file.bytes() };
+    if (m_file.size() < header_size || !prefix_match(magic, reader.take(magic.size())))
+        throw std::runtime_error{ "File is not a checkpoint" };
+    if (reader.get<std::uint32_t>() != version)
+        throw std::runtime_error{ "Unsupported checkpoint version" };
+    const auto loop_size = reader.get<std::uint64_t>();
+    const auto generators_size = reader.get<std::uint64_t>();
+    m_generator_time = reader.get<std::int64_t>();
+    m_first_result = reader.get<std::uint64_t>();
+    const auto n_results = reader.get<std::uint64_t>();
+
+    if (loop_size > reader.remaining() || generators_size > reader.remaining() - loop_size)
+        throw std::runtime_error{ "Checkpoint is truncated" };
+    m_loop = reader.take(static_cast<std::size_t>(loop_size));
+    m_generators = reader.take(static_cast<std::size_t>(generators_size));
+    const auto padding = history_padding(loop_size + generators_size);
+    if (reader.remaining() < padding
+        || (reader.remaining() - padding) / (2 * sizeof(double)) != n_results
+        || (reader.remaining() - padding) % (2 * sizeof(double)) != 0)
+        throw std::runtime_error{ "Checkpoint size does not match its header" };
+    reader.take(padding);
+
+    // The mapping is page-aligned and the history starts at an offset aligned to double
+    const auto history = reader.take(reader.remaining());
+    const auto n = static_cast<std::size_t>(n_results);
+    const auto data = reinterpret_cast<const double *>(history.data());
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(double) != 0)
+        throw std::runtime_error{ "Checkpoint history is not aligned" };
+    m_inputs = { data, n };
+    m_outputs = { data + n, n };
+}
+
+void Checkpoint::restore_results(const std::shared_ptr<const Checkpoint> &checkpoint,
+                                 ResultStore &results)
+{
+    results.restore(static_cast<std::size_t>(checkpoint->m_first_result), checkpoint->m_inputs,
+                    checkpoint->m_outputs, checkpoint);
+}
+
+#ifdef LAB_TESTS
+#include "PętlaUAR.hpp"
+#include "generators.hpp"
+#include <format>
+
+void CheckpointTests::test_round_trip()
+{
+    it_should_not_throw("Checkpoint - round trip", [] {
+        const auto dir = std::filesystem::temp_directory_path();
+        const auto path = dir / "polabs_checkpoint_test.pock";
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+        loop.push_back(std::make_unique<ModelARX>(std::vector<double>(300, -0.001),
+                                                  std::vector<double>(200, 0.002), 7, 0.01));
+        const GeneratorSinus generator{ std::make_unique<GeneratorBaza>(1.0), 2.0, 50 };
+        // Odd size, so that the history needs padding
+        const auto generators = concat_iterables(generator.dump(), std::array<uint8_t, 1>{});
+        std::weak_ptr<const Checkpoint> weak;
+        {
+            ResultStore results{ 64, 2, dir / "polabs_checkpoint_test.bin" };
+            for (int i = 0; i < 10; ++i) {
+                std::vector<double> in(100, static_cast<double>(i)), out(in.size());
+                loop.simulate_block(in, out);
+                results.append(in, out);
+            }
+            write_checkpoint(path, loop, generators, 1000, results);
+
+            const auto checkpoint = std::make_shared<const Checkpoint>(path);
+            weak = checkpoint;
+            const auto restored = checkpoint->restore_loop();
+            if (dynamic_cast<const PętlaUAR &>(*restored) != loop)
+                throw std::runtime_error{ "Restored loop differs" };
+            if (!std::ranges::equal(checkpoint->generators_dump(), generators)
+                || checkpoint->generator_time() != 1000 || checkpoint->first_result() != 0)
+                throw std::runtime_error{ "Restored generators differ" };
+
+            ResultStore restored_results{ 64, 2 };
+            Checkpoint::restore_results(checkpoint, restored_results);
+            std::vector<double> in(results.size()), out(in.size()), r_in(in.size()),
+                r_out(in.size());
+            results.read(0, in, out);
+            restored_results.read(0, r_in, r_out);
+            if (in != r_in || out != r_out || !std::ranges::equal(checkpoint->outputs(), out))
+                throw std::runtime_error{ "Restored results differ" };
+            restored_results.append(in, out);
+            if (restored_results.size() != 2 * results.size())
+                throw std::runtime_error{ "Can't append to the restored results" };
+        }
+        std::filesystem::remove(path);
+        if (!weak.expired())
+            throw std::runtime_error{ "Checkpoint is still referenced" };
+    });
+}
+
+void CheckpointTests::test_overwrite_restored()
+{
+    it_should_not_throw("Checkpoint - overwrite the restored file", [] {
+        const auto path = std::filesystem::temp_directory_path() / "polabs_checkpoint_same.pock";
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0, 2.0));
+        std::vector<double> in(1000), out(in.size());
+        for (std::size_t i = 0; i < in.size(); ++i)
+            in[i] = static_cast<double>(i % 7);
+        loop.simulate_block(in, out);
+        {
+            ResultStore results{ 1024, 4 };
+            results.append(in, out);
+            write_checkpoint(path, loop, {}, 0, results);
+        }
+        // The restored history references the mapping of the file which is overwritten
+        ResultStore results{ 1024, 4 };
+        Checkpoint::restore_results(std::make_shared<const Checkpoint>(path), results);
+        results.append(in, out);
+        write_checkpoint(path, loop, {}, 0, results);
+
+        const Checkpoint saved{ path };
+        const auto expected_in = concat_iterables(in, in);
+        const auto expected_out = concat_iterables(out, out);
+        if (!std::ranges::equal(saved.inputs(), expected_in)
+            || !std::ranges::equal(saved.outputs(), expected_out))
+            throw std::runtime_error{ "Overwritten checkpoint differs" };
+        std::vector<double> r_in(in.size()), r_out(in.size());
+        results.read(0, r_in, r_out);
+        if (r_in != in || r_out != out)
+            throw std::runtime_error{ "Restored results changed" };
+        if (std::filesystem::exists(std::filesystem::path{ path } += ".tmp"))
+            throw std::runtime_error{ "Temporary file was left behind" };
+        std::filesystem::remove(path);
+    });
+}
+
+void CheckpointTests::test_invalid()
+{
+    const auto path = std::filesystem::temp_directory_path() / "polabs_checkpoint_invalid.pock";
+    PętlaUAR loop;
+    loop.push_back(std::make_unique<RegulatorPID>(1.0));
+    ResultStore results{ 16, 4 };
+    const std::vector<double> values(20, 1.0);
+    results.append(values, values);
+    write_checkpoint(path, loop, {}, 0, results);
+    const auto valid_size = std::filesystem::file_size(path);
+
+    it_should_throw<std::runtime_error>(
+        "Checkpoint - truncated file",
+        [&] {
+            std::filesystem::resize_file(path, valid_size - 8);
+            Checkpoint{ path };
+        },
+        "Checkpoint size does not match its header");
+    it_should_throw<std::runtime_error>(
+        "Checkpoint - not a checkpoint",
+        [&] {
+            std::ofstream{ path, std::ios::binary | std::ios::trunc } << "POCL and some data";
+            Checkpoint{ path };
+        },
+        "File is not a checkpoint");
+    std::filesystem::remove(path);
+}
+
+void CheckpointTests::run_tests()
+{
+    test_round_trip();
+    test_overwrite_restored();
+    test_invalid();
+}
+#endif
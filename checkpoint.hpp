@@ -0,0 +1,95 @@
+/// @file checkpoint.hpp
+/// @brief Checkpoints of the full simulation state, restored from a memory-mapped file.
+
+#pragma once
+#include "ObiektSISO.h"
+#include "mapped_file.hpp"
+#include "result_store.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+
+/// @brief Write a checkpoint file, see docs/checkpoint_format.md.
+/// @param path path of the file, replaced if it exists; a mapping of the old file (e.g. a restored
+/// history in `results`) stays valid, since the file is written next to it and renamed
+/// @param loop simulated loop
+/// @param generators serialized generators (Generator::dump()), may be empty
+/// @param generator_time simulation time of the generators
+/// @param results simulation history, samples from ResultStore::first_available() are written
+/// @throws `std::runtime_error` if writing fails.
+void write_checkpoint(const std::filesystem::path &path, const ObiektSISO &loop,
+                      std::span<const std::uint8_t> generators, std::int64_t generator_time,
+                      ResultStore &results);
+
+/// @brief Memory-mapped checkpoint file.
+///
+/// Opening a checkpoint maps the file and validates its header, so it takes the same time
+/// regardless of the file size. The loop and generators are deserialized directly from the
+/// mapping on request and the result history is referenced in place.
+class Checkpoint {
+public:
+    /// Magic number at the beginning of the file.
+    static constexpr std::string_view magic{ "POCK" };
+    /// Version of the format.
+    static constexpr std::uint32_t version = 1;
+    /// Size of the fixed-length header.
+    static constexpr std::size_t header_size = 48;
+
+private:
+    /// The mapped file.
+    MappedFile m_file;
+    /// Serialized loop.
+    std::span<const std::uint8_t> m_loop;
+    /// Serialized generators, empty if there are none.
+    std::span<const std::uint8_t> m_generators;
+    /// Simulation time of the generators.
+    std::int64_t m_generator_time{};
+    /// Index of the first sample of the result history.
+    std::uint64_t m_first_result{};
+    /// Simulation inputs.
+    std::span<const double> m_inputs;
+    /// Simulation outputs.
+    std::span<const double> m_outputs;
+
+public:
+    /// @brief Map and validate a checkpoint file.
+    /// @param path path of the file
+    /// @throws `std::runtime_error` if the file can't be mapped or is not a valid checkpoint.
+    explicit Checkpoint(const std::filesystem::path &path);
+
+    /// Serialized loop (ObiektSISO::dump()), refers to the mapped file.
+    std::span<const std::uint8_t> loop_dump() const noexcept { return m_loop; }
+    /// Serialized generators (Generator::dump()), refers to the mapped file; may be empty.
+    std::span<const std::uint8_t> generators_dump() const noexcept { return m_generators; }
+    /// Simulation time of the generators.
+    std::int64_t generator_time() const noexcept { return m_generator_time; }
+    /// Index of the first sample of the result history.
+    std::uint64_t first_result() const noexcept { return m_first_result; }
+    /// Simulation inputs of the result history, refer to the mapped file.
+    std::span<const double> inputs() const noexcept { return m_inputs; }
+    /// Simulation outputs of the result history, refer to the mapped file.
+    std::span<const double> outputs() const noexcept { return m_outputs; }
+    /// @brief Deserialize the loop.
+    /// @return The restored loop.
+    /// @throws `std::runtime_error` if the loop can't be deserialized.
+    std::unique_ptr<ObiektSISO> restore_loop() const { return ObiektSISO::deserialize(m_loop); }
+    /// @brief Replace contents of `results` with the result history, without copying it.
+    /// @param checkpoint the checkpoint, kept alive as long as `results` references it
+    /// @param results store to restore
+    static void restore_results(const std::shared_ptr<const Checkpoint> &checkpoint,
+                                ResultStore &results);
+};
+
+#ifdef LAB_TESTS
+class CheckpointTests {
+    static void test_round_trip();
+    static void test_overwrite_restored();
+    static void test_invalid();
+
+public:
+    static void run_tests();
+};
+#endif
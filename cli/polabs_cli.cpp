@@ -0,0 +1,407 @@
+/// @file polabs_cli.cpp
+/// @brief Headless batch simulation of a serialized loop, without any Qt dependency.
+///
+/// Loads a loop and a generator chain, simulates the requested number of steps in blocks and
+/// writes the generator outputs (loop inputs) and loop outputs as CSV, raw binary or the columnar
+/// format (see ColumnarResultWriter) while the simulation runs. Loops made only of
+/// the built-in components are frozen (see FrozenLoop), otherwise they are simulated through
+/// ObiektSISO::simulate_block(). With --skip-steady loops skip constant inputs in a steady state
+/// (see PętlaUAR::set_steady_skip()) instead of being frozen. With --period steps are simulated
+/// in real time (see PacedSimulation) and the jitter statistics are printed to stderr. With --tune
+/// the first RegulatorPID is tuned for the generated inputs instead (see tune_pid()).
+
+#include "../ObiektSISO.h"
+#include "../PętlaUAR.hpp"
+#include "../checkpoint.hpp"
+#include "../frozen_loop.hpp"
+#include "../generators.hpp"
+#include "../mapped_file.hpp"
+#include "../paced_sim.hpp"
+#include "../pid_tuner.hpp"
+#include "../result_export.hpp"
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+/// Number of samples generated and simulated at once.
+constexpr std::size_t block_size = 4096;
+
+constexpr std::string_view usage{
+    R"(Usage: polabs-cli [options] <config>
+
+Simulates a serialized loop driven by a generator chain.
+
+<config> is a POlabs config file (.pocf), checkpoint (.pock) or loop model (.lmod).
+
+Options:
+  -n, --steps N          number of simulated steps (required)
+  -g, --generators FILE  generator chain (.gens), replaces the one from <config>
+  -t, --time T           simulation time of the first step, defaults to 0 or to the time stored in
+                         the checkpoint
+  -f, --format FORMAT    output format: csv (default), bin or pors
+  -o, --output FILE      output file, defaults to the standard output
+  -s, --skip-steady      skip constant inputs once the loop settles, for long piecewise constant
+                         signals; the results are the same
+  -p, --period US        simulate one step every US microseconds in real time and print the
+                         deadline misses and jitter statistics to stderr
+  -c, --cpu N            pin the real-time simulation thread to CPU N
+  -T, --tune             tune the first PID regulator of the loop for the inputs instead of
+                         simulating and write its "k,ti,td,cost" as CSV; a lone ARX model is
+                         tuned in a closed loop with a new regulator
+  --cost COST            tuning cost: ise (default), iae or settling (settling time)
+  --max-overshoot X      reject tunings with a relative overshoot larger than X
+  -h, --help             print this message
+
+CSV output has a "time,input,output" header and one row per step. Binary output is a sequence of
+[input, output] pairs of native doubles. pors output is the columnar format, which can be
+memory-mapped for reading (see docs/result_format.md).
+)"
+};
+
+/// Error in the command line arguments.
+class UsageError : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/// Output format.
+enum class Format { CSV, BINARY, COLUMNAR };
+
+/// Parsed command line.
+struct Options {
+    std::filesystem::path config;
+    std::optional<std::filesystem::path> generators;
+    std::optional<std::filesystem::path> output;
+    std::size_t steps{};
+    std::optional<int> time;
+    Format format{ Format::CSV };
+    bool skip_steady{};
+    std::optional<std::chrono::microseconds> period;
+    std::optional<unsigned> cpu;
+    bool tune{};
+    std::optional<TuneCost> cost;
+    std::optional<double> max_overshoot;
+};
+
+/// @brief Parse an integer option value.
+/// @throws UsageError if `value` is not an integer in range of `T`.
+template <typename T> T parse_number(std::string_view option, std::string_view value)
+{
+    T result{};
+    const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc{} || end != value.data() + value.size())
+        throw UsageError{ std::string{ option } + " expects an integer, got "
+                          + std::string{ value } };
+    return result;
+}
+
+/// @brief Parse a floating point option value.
+/// @throws UsageError if `value` is not a number.
+double parse_double(std::string_view option, std::string_view value)
+{
+    double result{};
+    const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc{} || end != value.data() + value.size())
+        throw UsageError{ std::string{ option } + " expects a number, got " + std::string{ value } };
+    return result;
+}
+
+/// @brief Parse the command line.
+/// @return Options, `std::nullopt` if help was requested.
+/// @throws UsageError if the arguments are invalid.
+std::optional<Options> parse_args(std::span<char *> args)
+{
+    Options options;
+    bool have_config = false, have_steps = false;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const std::string_view arg{ args[i] };
+        if (arg == "-h" || arg == "--help")
+            return std::nullopt;
+        if (!arg.starts_with('-')) {
+            if (have_config)
+                throw UsageError{ "More than one config file given" };
+            options.config = arg;
+            have_config = true;
+            continue;
+        }
+        if (arg == "-s" || arg == "--skip-steady") {
+            options.skip_steady = true;
+            continue;
+        }
+        if (arg == "-T" || arg == "--tune") {
+            options.tune = true;
+            continue;
+        }
+        if (i + 1 >= args.size())
+            throw UsageError{ std::string{ arg } + " expects a value" };
+        const std::string_view value{ args[++i] };
+        if (arg == "-n" || arg == "--steps") {
+            options.steps = parse_number<std::size_t>(arg, value);
+            have_steps = true;
+        } else if (arg == "-g" || arg == "--generators") {
+            options.generators = value;
+        } else if (arg == "-t" || arg == "--time") {
+            options.time = parse_number<int>(arg, value);
+        } else if (arg == "-p" || arg == "--period") {
+            const auto us = parse_number<unsigned>(arg, value);
+            if (us == 0)
+                throw UsageError{ std::string{ arg } + " must be positive" };
+            options.period = std::chrono::microseconds{ us };
+        } else if (arg == "-c" || arg == "--cpu") {
+            options.cpu = parse_number<unsigned>(arg, value);
+        } else if (arg == "--cost") {
+            if (value == "ise")
+                options.cost = TuneCost::ISE;
+            else if (value == "iae")
+                options.cost = TuneCost::IAE;
+            else if (value == "settling")
+                options.cost = TuneCost::SETTLING_TIME;
+            else
+                throw UsageError{ "Unknown tuning cost: " + std::string{ value } };
+        } else if (arg == "--max-overshoot") {
+            options.max_overshoot = parse_double(arg, value);
+        } else if (arg == "-o" || arg == "--output") {
+            options.output = value;
+        } else if (arg == "-f" || arg == "--format") {
+            if (value == "csv")
+                options.format = Format::CSV;
+            else if (value == "bin")
+                options.format = Format::BINARY;
+            else if (value == "pors")
+                options.format = Format::COLUMNAR;
+            else
+                throw UsageError{ "Unknown output format: " + std::string{ value } };
+        } else {
+            throw UsageError{ "Unknown option: " + std::string{ arg } };
+        }
+    }
+    if (!have_config)
+        throw UsageError{ "No config file given" };
+    if (!have_steps)
+        throw UsageError{ "Number of steps not given" };
+    if (options.cpu && !options.period)
+        throw UsageError{ "--cpu requires --period" };
+    if (options.period && options.skip_steady)
+        throw UsageError{ "--skip-steady can't be used with --period" };
+    if (options.tune && (options.period || options.skip_steady || options.format != Format::CSV))
+        throw UsageError{ "--tune can't be used with --period, --skip-steady or --format" };
+    if (!options.tune && (options.cost || options.max_overshoot))
+        throw UsageError{ "--cost and --max-overshoot require --tune" };
+    return options;
+}
+
+/// Loaded simulation job.
+struct Job {
+    std::unique_ptr<ObiektSISO> loop;
+    std::unique_ptr<Generator> generator;
+    int time{};
+};
+
+/// @brief Load the loop and generators described by `options`.
+/// @throws `std::runtime_error` if the files can't be read or deserialized.
+Job load(const Options &options)
+{
+    Job job;
+    const auto ext = options.config.extension();
+    if (ext == ".pock") {
+        const Checkpoint checkpoint{ options.config };
+        job.loop = checkpoint.restore_loop();
+        if (!checkpoint.generators_dump().empty())
+            job.generator = Generator::deserialize(checkpoint.generators_dump());
+        job.time = static_cast<int>(checkpoint.generator_time());
+    } else if (ext == ".pocf" || ext == ".lmod") {
+        const MappedFile file{ options.config };
+        const auto data = file.bytes();
+        if (data.size() < sizeof(uint32_t))
+            throw std::runtime_error{ "Config file is too short" };
+        const std::size_t loop_size = sizeof(uint32_t) + from_byte_range<uint32_t>(data);
+        if (loop_size > data.size())
+            throw std::runtime_error{ "Config file is truncated" };
+        job.loop = ObiektSISO::deserialize(data.first(loop_size));
+        if (ext == ".pocf" && data.size() > loop_size)
+            job.generator = Generator::deserialize(data.subspan(loop_size));
+    } else {
+        throw UsageError{ "Unsupported config file type: " + ext.string() };
+    }
+    if (options.generators) {
+        const MappedFile file{ *options.generators };
+        job.generator = Generator::deserialize(file.bytes());
+    }
+    if (!job.generator)
+        throw UsageError{ "The config has no generators, use --generators" };
+    if (options.time)
+        job.time = *options.time;
+    return job;
+}
+
+/// @brief Create a writer of the results in the requested format.
+/// @param file output file
+/// @param format output format
+/// @param job simulated job, the loop is identified by its hash in the columnar format
+std::unique_ptr<ResultExporter> make_writer(std::FILE *file, Format format, const Job &job)
+{
+    switch (format) {
+    case Format::BINARY:
+        return std::make_unique<RawResultWriter>(file);
+    case Format::COLUMNAR:
+        return std::make_unique<ColumnarResultWriter>(file, job.time, 1.0,
+                                                      dump_hash(job.loop->dump()));
+    case Format::CSV:
+        break;
+    }
+    return std::make_unique<CsvResultWriter>(file, job.time);
+}
+
+/// @brief Generate `steps` inputs starting at the time of the job.
+/// @throws `std::runtime_error` if the time is out of range.
+std::vector<double> generate(Job &job, std::size_t steps)
+{
+    if (static_cast<long long>(job.time) + static_cast<long long>(steps)
+        > std::numeric_limits<int>::max())
+        throw std::runtime_error{ "Simulation time out of range" };
+    std::vector<double> inputs(steps);
+    for (std::size_t done = 0; done < steps; done += block_size) {
+        const auto n = std::min(block_size, steps - done);
+        job.generator->generate(job.time + static_cast<int>(done),
+                                std::span{ inputs }.subspan(done, n));
+    }
+    return inputs;
+}
+
+/// @brief Simulate the job in real time, write the results and print the pacing statistics.
+/// @param period sample period
+/// @param cpu CPU to which the simulation thread is pinned
+void run_paced(Job &job, std::size_t steps, std::chrono::microseconds period,
+               std::optional<unsigned> cpu, ResultExporter &writer)
+{
+    using namespace std::chrono_literals;
+    PacedSimulation sim{ std::move(job.loop), generate(job, steps), period, cpu };
+    while (true) {
+        // Check before polling, so that no batch published before finishing is missed
+        const bool finished = sim.finished();
+        while (auto batch = sim.poll())
+            writer.add(batch->inputs, batch->outputs);
+        if (finished)
+            break;
+        std::this_thread::sleep_for(5ms);
+    }
+    job.loop = sim.take_loop();
+    writer.finish();
+    const auto stats = sim.stats();
+    if (cpu && !stats.pinned)
+        std::fprintf(stderr, "polabs-cli: could not pin the simulation to CPU %u\n", *cpu);
+    std::fprintf(stderr, "%s\n", format_stats(stats).c_str());
+}
+
+/// @brief Tune the first RegulatorPID of the job's loop and write its parameters.
+/// @throws `std::runtime_error` if the loop has no regulator.
+void run_tune(Job &job, const Options &options, std::FILE *file)
+{
+    if (const auto arx = dynamic_cast<const ModelARX *>(job.loop.get()))
+        job.loop = std::make_unique<PętlaUAR>(tuning_loop(*arx));
+    const auto path = find_pid(*job.loop);
+    if (!path)
+        throw std::runtime_error{ "The loop has no PID regulator" };
+    TuneOptions tune_options;
+    tune_options.cost = options.cost.value_or(TuneCost::ISE);
+    tune_options.max_overshoot = options.max_overshoot;
+    const auto result = tune_pid(job.loop->dump(), *path, generate(job, options.steps),
+                                 tune_options);
+    std::fprintf(file, "k,ti,td,cost\n%.17g,%.17g,%.17g,%.17g\n", result.pid.k, result.pid.ti,
+                 result.pid.td, result.cost);
+    std::fprintf(stderr, "%zu candidates simulated, %zu stopped early\n", result.evaluations,
+                 result.pruned);
+}
+
+/// Simulate the job and write the results.
+void run(Job &job, std::size_t steps, bool skip_steady, ResultExporter &writer)
+{
+    // The devirtualized loop is used if all components are supported, unless skipping is requested
+    std::optional<FrozenLoop> frozen;
+    if (const auto loop = dynamic_cast<PętlaUAR *>(job.loop.get()); loop && skip_steady) {
+        loop->set_steady_skip(true);
+    } else if (loop) {
+        try {
+            frozen.emplace(freeze(*loop));
+        } catch (const std::runtime_error &) {
+        }
+    }
+    std::vector<double> in(block_size), out(block_size);
+    for (std::size_t done = 0; done < steps; done += block_size) {
+        const auto n = std::min(block_size, steps - done);
+        const auto block_in = std::span{ in }.first(n);
+        const auto block_out = std::span{ out }.first(n);
+        if (static_cast<long long>(job.time) + static_cast<long long>(done + n)
+            > std::numeric_limits<int>::max())
+            throw std::runtime_error{ "Simulation time out of range" };
+        const auto t0 = job.time + static_cast<int>(done);
+        job.generator->generate(t0, block_in);
+        if (frozen)
+            frozen->simulate_block(block_in, block_out);
+        else
+            job.loop->simulate_block(block_in, block_out);
+        writer.add(block_in, block_out);
+    }
+    writer.finish();
+}
+}
+
+int main(int argc, char *argv[])
+{
+    try {
+        const auto options = parse_args({ argv, static_cast<std::size_t>(argc) });
+        if (!options) {
+            std::fwrite(usage.data(), 1, usage.size(), stdout);
+            return 0;
+        }
+        auto job = load(*options);
+
+        std::FILE *file = stdout;
+        if (options->output) {
+            file = open_for_writing(*options->output);
+            if (file == nullptr)
+                throw std::runtime_error{ "Could not open the output file" };
+        } else if (options->format != Format::CSV) {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        }
+        if (options->tune) {
+            run_tune(job, *options, file);
+        } else {
+            const auto writer = make_writer(file, options->format, job);
+            if (options->period)
+                run_paced(job, options->steps, *options->period, options->cpu, *writer);
+            else
+                run(job, options->steps, options->skip_steady, *writer);
+        }
+        if (file != stdout && std::fclose(file) != 0)
+            throw std::runtime_error{ "Could not write the results" };
+    } catch (const UsageError &e) {
+        std::fprintf(stderr, "polabs-cli: %s\n\n%.*s", e.what(), static_cast<int>(usage.size()),
+                     usage.data());
+        return 2;
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "polabs-cli: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -1,27 +1,22 @@
 #include "feedback_loop.hpp"
 
-double feedback_step(RegulatorPID &regulator, ModelARX &model, const double u,
-                     const std::optional<double> &reset)
-{
-    static double last_output = 0.0;
-    if (reset.has_value())
-        last_output = reset.value();
-    const auto e = u - last_output;
-    const auto input = regulator.symuluj(e);
-    last_output = model.symuluj(input);
-    return last_output;
-}
+template class FeedbackLoop<RegulatorPID, ModelARX>;
 
 #ifdef LAB_TESTS
+#include "PętlaUAR.hpp"
+#include <iostream>
+#include <memory>
+#include <vector>
+
 ModelARX FeedbackTests::get_model() { return ModelARX{ { -0.4 }, { 0.6 }, 1, 0.0 }; }
 
-void FeedbackTests::run_sim(RegulatorPID &pid)
+void FeedbackTests::run_sim(const RegulatorPID &pid)
 {
     constexpr std::size_t steps{ 30 };
-    auto m = get_model();
-    std::cout << feedback_step(pid, m, 0.0, 0.0);
+    PidArxLoop loop{ pid, get_model() };
+    std::cout << loop.symuluj(0.0);
     for (auto i = 1UL; i < steps; ++i)
-        std::cout << ' ' << feedback_step(pid, m, 1.0);
+        std::cout << ' ' << loop.symuluj(1.0);
     std::cout << std::endl;
 }
 
@@ -53,11 +48,54 @@ void FeedbackTests::simulate_pi_2()
     run_sim(pi);
 }
 
+void FeedbackTests::test_matches_uar()
+{
+    it_should_not_throw("FeedbackLoop matches a closed PętlaUAR", []() {
+        const RegulatorPID pid{ 0.4, 2.0, 0.1 };
+        const ModelARX model{ { -0.4, 0.1 }, { 0.6, 0.2 }, 2, 0.05 };
+        PidArxLoop loop{ pid, model, 0.3 };
+        PętlaUAR uar{ true, 0.3 };
+        uar.push_back(std::make_unique<RegulatorPID>(pid));
+        uar.push_back(std::make_unique<ModelARX>(model));
+        for (int i = 0; i < 100; ++i)
+            if (loop.symuluj(i % 2) != uar.symuluj(i % 2))
+                throw std::runtime_error{ "Step results do not match" };
+        // More than one noise buffer
+        std::vector<double> in(600, 1.0), expected(600), actual(600);
+        uar.simulate_block(in, expected);
+        loop.simulate_block(in, actual);
+        if (actual != expected || loop.get_last_result() != uar.get_last_result())
+            throw std::runtime_error{ "Block results do not match" };
+        if (loop.model() != dynamic_cast<const ModelARX &>(uar.at(1)))
+            throw std::runtime_error{ "Model states do not match" };
+    });
+}
+
+void FeedbackTests::test_independent()
+{
+    it_should_not_throw("FeedbackLoops do not share state", []() {
+        PidArxLoop a{ RegulatorPID{ 0.5 }, get_model() };
+        PidArxLoop b{ RegulatorPID{ 0.5 }, get_model() };
+        PidArxLoop reference{ RegulatorPID{ 0.5 }, get_model() };
+        for (int i = 0; i < 20; ++i) {
+            a.symuluj(1.0);
+            b.symuluj(-3.0);
+            if (a.get_last_result() != reference.symuluj(1.0))
+                throw std::runtime_error{ "Loops interfere with each other" };
+        }
+        a.reset(0.5);
+        if (a.get_last_result() != 0.5 || a.regulator() != RegulatorPID{ 0.5 })
+            throw std::runtime_error{ "Loop was not reset" };
+    });
+}
+
 void FeedbackTests::run_tests()
 {
     simulate_p_1();
     simulate_p_2();
     simulate_pi_1();
     simulate_pi_2();
+    test_matches_uar();
+    test_independent();
 }
 #endif
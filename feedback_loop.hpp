@@ -4,25 +4,122 @@
 #pragma once
 #include "ModelARX.h"
 #include "RegulatorPID.h"
-#include <optional>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-/// @brief Simulate a single step of a closed feedback loop with a PID regulator and ARX model
-/// @param regulator a reference to PID regulator used in the loop
-/// @param model a reference to ARX model used in the loop
-/// @param u current input
-/// @param reset optional reset value to set the saved previous result to
-/// @return `model`'s output given `regulator`'s output, which was given `u - last_result`
-double feedback_step(RegulatorPID &regulator, ModelARX &model, const double u,
-                     const std::optional<double> &reset = std::nullopt);
+/// @brief Closed feedback loop of a regulator and a model with concrete types.
+///
+/// Unlike PętlaUAR, the components are stored by value and their `symuluj()` methods are called
+/// non-virtually, so they can be inlined. Every loop keeps its own previous result, so separate
+/// loops can be simulated concurrently.
+///
+/// @tparam Regulator type of the regulator, e.g. RegulatorPID
+/// @tparam Model type of the controlled model, e.g. ModelARX
+template <typename Regulator, typename Model> class FeedbackLoop {
+private:
+    /// Regulator, which gets the difference between the input and the previous result.
+    Regulator m_regulator;
+    /// Model controlled by the regulator.
+    Model m_model;
+    /// Stored previous simulation result.
+    double m_prev_result;
+
+    /// Call `symuluj()` of `component` without virtual dispatch.
+    template <typename T> static double step(T &component, double u)
+    {
+        return component.T::symuluj(u);
+    }
+
+public:
+    /// @brief Construct a loop from its components.
+    /// @param regulator regulator of the loop
+    /// @param model model controlled by the regulator
+    /// @param init_val initial value of saved previous result
+    FeedbackLoop(Regulator regulator, Model model, double init_val = 0.0)
+        : m_regulator{ std::move(regulator) }
+        , m_model{ std::move(model) }
+        , m_prev_result{ init_val }
+    {
+    }
+    /// @brief Simulate loop's response to the setpoint.
+    /// @param u current setpoint
+    /// @return `model`'s output given `regulator`'s output, which was given `u - last_result`
+    double symuluj(double u)
+    {
+        m_prev_result = step(m_model, step(m_regulator, u - m_prev_result));
+        return m_prev_result;
+    }
+    /// @brief Simulate loop's response to a block of setpoints.
+    ///
+    /// For ModelARX the noise of the whole block is drawn at once, like in
+    /// ModelARX::simulate_block(), and the results are the same as of consecutive symuluj() calls.
+    ///
+    /// @param in setpoints
+    /// @param out loop's responses, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    void simulate_block(std::span<const double> in, std::span<double> out)
+    {
+        if (in.size() != out.size())
+            throw std::runtime_error{ "Input and output blocks must have the same size" };
+        if constexpr (std::is_same_v<Model, ModelARX>) {
+            std::array<double, 256> noise_buffer;
+            for (std::size_t offset = 0; offset < in.size(); offset += noise_buffer.size()) {
+                const auto n = std::min(noise_buffer.size(), in.size() - offset);
+                const auto noise = std::span{ noise_buffer }.first(n);
+                m_model.draw_noise(noise);
+                for (std::size_t i = 0; i < n; ++i) {
+                    const auto v = step(m_regulator, in[offset + i] - m_prev_result);
+                    m_prev_result = m_model.step(v, noise[i]);
+                    out[offset + i] = m_prev_result;
+                }
+            }
+        } else {
+            for (std::size_t i = 0; i < in.size(); ++i)
+                out[i] = symuluj(in[i]);
+        }
+    }
+    /// @brief Reset both components and set the saved previous result.
+    /// @param init_val the new value of saved previous result
+    void reset(double init_val = 0.0)
+    {
+        m_regulator.reset();
+        m_model.reset();
+        m_prev_result = init_val;
+    }
+    /// Regulator getter.
+    constexpr Regulator &regulator() noexcept { return m_regulator; }
+    /// Regulator getter.
+    constexpr const Regulator &regulator() const noexcept { return m_regulator; }
+    /// Model getter.
+    constexpr Model &model() noexcept { return m_model; }
+    /// Model getter.
+    constexpr const Model &model() const noexcept { return m_model; }
+    /// Last result getter.
+    constexpr double get_last_result() const noexcept { return m_prev_result; }
+    /// @brief Set the saved previous result without resetting the components.
+    /// @param value the new value of saved previous result
+    constexpr void set_last_result(double value) noexcept { m_prev_result = value; }
+};
+
+/// The most common loop, compiled once in feedback_loop.cpp.
+using PidArxLoop = FeedbackLoop<RegulatorPID, ModelARX>;
+extern template class FeedbackLoop<RegulatorPID, ModelARX>;
 
 #ifdef LAB_TESTS
 class FeedbackTests {
     static ModelARX get_model();
-    static void run_sim(RegulatorPID &pid);
+    static void run_sim(const RegulatorPID &pid);
     static void simulate_p_1();
     static void simulate_p_2();
     static void simulate_pi_1();
     static void simulate_pi_2();
+    static void test_matches_uar();
+    static void test_independent();
 
 public:
     static void run_tests();
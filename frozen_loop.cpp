@@ -0,0 +1,217 @@
+#include "frozen_loop.hpp"
+#include "util.hpp"
+#include <memory>
+
+namespace {
+/// @brief Check that the loop starting at `index` fits in `end` and has consistent nested loops.
+/// @return Index of the first element after the loop.
+std::size_t validate_loop(std::span<const FrozenLoop::element> elements, std::size_t index,
+                          std::size_t end)
+{
+    const auto header = std::get_if<FrozenLoop::LoopHeader>(&elements[index]);
+    if (header == nullptr)
+        throw std::runtime_error{ "Frozen loop must start with a loop header" };
+    const auto loop_end = index + 1 + header->length;
+    if (loop_end > end)
+        throw std::runtime_error{ "Frozen loop length exceeds its parent" };
+    for (auto i = index + 1; i < loop_end;)
+        i = std::holds_alternative<FrozenLoop::LoopHeader>(elements[i])
+            ? validate_loop(elements, i, loop_end)
+            : i + 1;
+    return loop_end;
+}
+
+/// Append `loop` and its components to `out` in pre-order.
+void flatten(const PętlaUAR &loop, std::vector<FrozenLoop::element> &out)
+{
+    const auto header_idx = out.size();
+    out.emplace_back(FrozenLoop::LoopHeader{ loop.get_closed(), loop.get_last_result(), 0 });
+    for (std::size_t i = 0; i < loop.size(); ++i) {
+        const ObiektSISO *const e = &loop.at(i);
+        if (const auto nested = dynamic_cast<const PętlaUAR *>(e))
+            flatten(*nested, out);
+        else if (const auto pid = dynamic_cast<const RegulatorPID *>(e))
+            out.emplace_back(*pid);
+        else if (const auto stat = dynamic_cast<const ObiektStatyczny *>(e))
+            out.emplace_back(*stat);
+        else if (const auto arx = dynamic_cast<const ModelARX *>(e))
+            out.emplace_back(*arx);
+        else
+            throw std::runtime_error{ "Loop contains a component which cannot be frozen" };
+    }
+    std::get<FrozenLoop::LoopHeader>(out[header_idx]).length = out.size() - header_idx - 1;
+}
+
+/// @brief Rebuild the loop starting at `index`.
+/// @param index index of the loop's header, set to the index after the loop on return
+PętlaUAR rebuild(std::span<const FrozenLoop::element> elements, std::size_t &index)
+{
+    const auto &header = std::get<FrozenLoop::LoopHeader>(elements[index]);
+    PętlaUAR loop{ header.closed, header.prev_result };
+    const auto end = index + 1 + header.length;
+    for (++index; index < end;) {
+        if (std::holds_alternative<FrozenLoop::LoopHeader>(elements[index])) {
+            loop.push_back(std::make_unique<PętlaUAR>(rebuild(elements, index)));
+            continue;
+        }
+        std::visit(overloaded{ [](const FrozenLoop::LoopHeader &) {},
+                               [&loop]<typename T>(const T &e) {
+                                   loop.push_back(std::make_unique<T>(e));
+                               } },
+                   elements[index]);
+        ++index;
+    }
+    return loop;
+}
+}
+
+FrozenLoop::FrozenLoop(std::vector<element> &&elements)
+    // Braces would pick the initializer_list constructor, because ObiektStatyczny can be
+    // constructed from any range
+    : m_elements(std::move(elements))
+{
+    if (m_elements.empty() || validate_loop(m_elements, 0, m_elements.size()) != m_elements.size())
+        throw std::runtime_error{ "Frozen loop elements do not form a single loop" };
+}
+
+double FrozenLoop::simulate_loop(std::size_t index, double u)
+{
+    auto &header = std::get<LoopHeader>(m_elements[index]);
+    double v = header.closed ? u - header.prev_result : u;
+    const auto end = index + 1 + header.length;
+    for (auto i = index + 1; i < end;) {
+        if (const auto nested = std::get_if<LoopHeader>(&m_elements[i])) {
+            const auto next = i + 1 + nested->length;
+            v = simulate_loop(i, v);
+            i = next;
+            continue;
+        }
+        // Qualified calls are not virtual, so they can be inlined
+        v = std::visit(overloaded{ [](LoopHeader &) -> double { std::unreachable(); },
+                                   [v](RegulatorPID &e) { return e.RegulatorPID::symuluj(v); },
+                                   [v](ObiektStatyczny &e) {
+                                       return e.ObiektStatyczny::symuluj(v);
+                                   },
+                                   [v](ModelARX &e) { return e.ModelARX::symuluj(v); } },
+                       m_elements[i]);
+        ++i;
+    }
+    header.prev_result = v;
+    return v;
+}
+
+void FrozenLoop::simulate_block(std::span<const double> in, std::span<double> out)
+{
+    if (in.size() != out.size())
+        throw std::runtime_error{ "Input and output blocks must have the same size" };
+    for (std::size_t i = 0; i < in.size(); ++i)
+        out[i] = symuluj(in[i]);
+}
+
+void FrozenLoop::reset(double init_val)
+{
+    for (auto &e : m_elements)
+        std::visit(overloaded{ [](LoopHeader &h) { h.prev_result = 0.0; },
+                               []<typename T>(T &c) { c.T::reset(); } },
+                   e);
+    std::get<LoopHeader>(m_elements.front()).prev_result = init_val;
+}
+
+std::vector<uint8_t> FrozenLoop::dump() const { return thaw(*this).dump(); }
+
+FrozenLoop freeze(const PętlaUAR &loop)
+{
+    std::vector<FrozenLoop::element> elements;
+    flatten(loop, elements);
+    return FrozenLoop{ std::move(elements) };
+}
+
+PętlaUAR thaw(const FrozenLoop &frozen)
+{
+    std::size_t index = 0;
+    return rebuild(frozen.elements(), index);
+}
+
+#ifdef LAB_TESTS
+#include <iostream>
+
+PętlaUAR FrozenLoopTests::get_test_loop()
+{
+    using p = ObiektStatyczny::point;
+    PętlaUAR loop{ true, 0.25 };
+    loop.push_back(std::make_unique<RegulatorPID>(0.4, 2.0, 0.1));
+    loop.push_back(std::make_unique<ObiektStatyczny>(p{ -2.0, -1.5 }, p{ 2.0, 1.5 }));
+    loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 2, 0.01));
+    auto inner_loop = std::make_unique<PętlaUAR>(false);
+    inner_loop->push_back(std::make_unique<RegulatorPID>(1.2));
+    inner_loop->push_back(
+        std::make_unique<ModelARX>(std::vector{ -0.2, 0.1 }, std::vector{ 0.5, 0.3 }, 1));
+    loop.push_back(std::move(inner_loop));
+    return loop;
+}
+
+void FrozenLoopTests::test_freeze_simulation()
+{
+    it_should_not_throw("FrozenLoop simulation matches PętlaUAR", []() {
+        auto loop = get_test_loop();
+        auto frozen = freeze(loop);
+        if (frozen.elements().size() != 7)
+            throw std::runtime_error{ "Unexpected number of flattened elements" };
+        for (int i = 0; i < 200; ++i) {
+            const double u = (i / 20) % 2;
+            if (loop.symuluj(u) != frozen.symuluj(u))
+                throw std::runtime_error{ "Simulations do not match" };
+        }
+        std::vector<double> in(50, 1.0), expected(50), actual(50);
+        loop.simulate_block(in, expected);
+        frozen.simulate_block(in, actual);
+        if (actual != expected || frozen.get_last_result() != loop.get_last_result())
+            throw std::runtime_error{ "Block simulations do not match" };
+    });
+}
+
+void FrozenLoopTests::test_thaw()
+{
+    it_should_not_throw("FrozenLoop thaw() restores the loop and its state", []() {
+        auto loop = get_test_loop();
+        auto frozen = freeze(loop);
+        for (int i = 0; i < 30; ++i) {
+            loop.symuluj(1.0);
+            frozen.symuluj(1.0);
+        }
+        if (thaw(frozen) != loop || frozen.dump() != loop.dump())
+            throw std::runtime_error{ "Thawed loop does not match" };
+        loop.reset(0.5);
+        frozen.reset(0.5);
+        if (thaw(frozen) != loop)
+            throw std::runtime_error{ "Reset loops do not match" };
+    });
+}
+
+void FrozenLoopTests::test_static_loop()
+{
+    it_should_not_throw("StaticLoop simulation matches PętlaUAR", []() {
+        auto loop = get_test_loop();
+        StaticLoop<true, RegulatorPID, ObiektStatyczny, ModelARX,
+                   StaticLoop<false, RegulatorPID, ModelARX>>
+            static_loop{ loop };
+        for (int i = 0; i < 200; ++i) {
+            const double u = (i / 20) % 2;
+            if (loop.symuluj(u) != static_loop.symuluj(u))
+                throw std::runtime_error{ "Simulations do not match" };
+        }
+    });
+    it_should_throw<std::runtime_error>("StaticLoop with mismatched topology", []() {
+        StaticLoop<true, RegulatorPID, ModelARX, ObiektStatyczny, RegulatorPID> static_loop{
+            get_test_loop()
+        };
+    });
+}
+
+void FrozenLoopTests::run_tests()
+{
+    test_freeze_simulation();
+    test_thaw();
+    test_static_loop();
+}
+#endif
@@ -0,0 +1,199 @@
+/// @file frozen_loop.hpp
+/// @brief Devirtualized ("frozen") forms of PętlaUAR with a fixed topology.
+
+#pragma once
+#include "ModelARX.h"
+#include "ObiektStatyczny.hpp"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// @brief A PętlaUAR flattened into a contiguous array of components stored by value.
+///
+/// The components (including nested loops) are stored in pre-order in a single vector of
+/// `std::variant`s, so simulation does not follow any `unique_ptr` indirection, makes no virtual
+/// calls and uses no `dynamic_cast`s. Components' `symuluj()` methods are called non-virtually,
+/// which lets the compiler inline RegulatorPID and ObiektStatyczny into the simulation loop.
+///
+/// The topology cannot be changed. Use thaw() to convert it back into an editable PętlaUAR.
+class FrozenLoop {
+public:
+    /// Beginning of a (possibly nested) loop, which contains the following #length elements.
+    struct LoopHeader {
+        /// Whether the loop is closed (PętlaUAR::get_closed()).
+        bool closed;
+        /// Stored previous simulation result (PętlaUAR::get_last_result()).
+        double prev_result;
+        /// Number of elements (in all nested loops) that belong to this loop.
+        std::size_t length;
+
+        friend constexpr bool operator==(const LoopHeader &, const LoopHeader &) = default;
+    };
+    /// A single element of the flattened loop.
+    using element = std::variant<LoopHeader, RegulatorPID, ObiektStatyczny, ModelARX>;
+
+private:
+    /// Flattened loop; the first element is the header of the root loop.
+    std::vector<element> m_elements;
+
+    /// @brief Simulate the loop starting at `index`.
+    /// @param index index of the loop's header in #m_elements
+    /// @param u loop's input
+    /// @return Output of the loop.
+    double simulate_loop(std::size_t index, double u);
+
+public:
+    /// @brief Construct a frozen loop from flattened elements.
+    /// @param elements elements in pre-order, starting with the LoopHeader of the root loop
+    /// @throws `std::runtime_error` if loop headers' lengths are inconsistent.
+    explicit FrozenLoop(std::vector<element> &&elements);
+    /// @brief Simulate loop's response to the input signal.
+    ///
+    /// Produces the same results as PętlaUAR::symuluj() of the loop that was frozen.
+    ///
+    /// @param u loop's input, the setpoint in closed loop
+    /// @return response from the last loop component
+    double symuluj(double u) { return simulate_loop(0, u); }
+    /// @brief Simulate loop's response to a block of input samples.
+    /// @param in loop's inputs
+    /// @param out loop's responses, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    void simulate_block(std::span<const double> in, std::span<double> out);
+    /// @brief Reset all components and set previous results of all loops to `0`, except the root
+    /// loop, which is set to `init_val` (same as PętlaUAR::reset()).
+    /// @param init_val the new value of saved previous result of the root loop
+    void reset(double init_val = 0.0);
+    /// @brief Serialize the loop.
+    /// @return Dump identical to the one of the equivalent PętlaUAR.
+    std::vector<uint8_t> dump() const;
+    /// Flattened elements (in pre-order, starting with the root LoopHeader).
+    std::span<const element> elements() const noexcept { return m_elements; }
+    /// Last result of the root loop.
+    double get_last_result() const noexcept
+    {
+        return std::get<LoopHeader>(m_elements.front()).prev_result;
+    }
+};
+
+/// @brief Convert a loop into its frozen form.
+///
+/// The loop is copied, so its current state is preserved and the original remains unchanged.
+///
+/// @param loop loop to freeze, may contain nested loops
+/// @return A FrozenLoop with the same components and state.
+/// @throws `std::runtime_error` if the loop contains a component of unsupported type.
+FrozenLoop freeze(const PętlaUAR &loop);
+/// @brief Convert a frozen loop back into a regular, editable PętlaUAR.
+/// @param frozen frozen loop
+/// @return A PętlaUAR with the same components and state.
+PętlaUAR thaw(const FrozenLoop &frozen);
+
+template <bool Closed, typename... Ts>
+    requires(sizeof...(Ts) > 0)
+class StaticLoop;
+/// `true` if `T` is a specialization of StaticLoop.
+template <typename T> constexpr bool is_static_loop_v = false;
+template <bool Closed, typename... Ts>
+constexpr bool is_static_loop_v<StaticLoop<Closed, Ts...>> = true;
+
+/// @brief A loop with topology fixed at compile time.
+///
+/// Components are stored in a `std::tuple` and the simulation is a fold expression over non-virtual
+/// `symuluj()` calls, so there is no runtime dispatch at all.
+///
+/// @tparam Closed whether the loop is closed
+/// @tparam Ts types of loop components (RegulatorPID, ObiektStatyczny, ModelARX or StaticLoop)
+template <bool Closed, typename... Ts>
+    requires(sizeof...(Ts) > 0)
+class StaticLoop {
+private:
+    /// Loop components.
+    std::tuple<Ts...> m_stages;
+    /// Stored previous simulation result.
+    double m_prev_result;
+
+    /// Call `symuluj()` of `stage` without virtual dispatch.
+    template <typename T> static double step(T &stage, double u) { return stage.T::symuluj(u); }
+
+public:
+    /// @brief Construct a loop from components.
+    /// @param stages loop components
+    /// @param init_val initial value of saved previous result
+    constexpr explicit StaticLoop(Ts... stages, double init_val = 0.0)
+        : m_stages{ std::move(stages)... }
+        , m_prev_result{ init_val }
+    {
+    }
+    /// @brief Construct a loop from the components of a matching PętlaUAR.
+    /// @param loop loop to copy the components and state from
+    /// @throws `std::runtime_error` if the loop's topology does not match `Closed` and `Ts`.
+    explicit StaticLoop(const PętlaUAR &loop)
+        : m_stages{ copy_stages(loop, std::index_sequence_for<Ts...>{}) }
+        , m_prev_result{ loop.get_last_result() }
+    {
+        if (loop.get_closed() != Closed)
+            throw std::runtime_error{ "Loop closed setting does not match" };
+    }
+    /// @brief Simulate loop's response to the input signal.
+    /// @param u loop's input, the setpoint in closed loop
+    /// @return response from the last loop component
+    double symuluj(double u)
+    {
+        double v = Closed ? u - m_prev_result : u;
+        std::apply([&v](auto &...stage) { ((v = step(stage, v)), ...); }, m_stages);
+        m_prev_result = v;
+        return v;
+    }
+    /// @brief Simulate loop's response to a block of input samples.
+    /// @param in loop's inputs
+    /// @param out loop's responses, may be the same as `in`
+    /// @throws `std::runtime_error` if sizes of `in` and `out` differ.
+    void simulate_block(std::span<const double> in, std::span<double> out)
+    {
+        if (in.size() != out.size())
+            throw std::runtime_error{ "Input and output blocks must have the same size" };
+        for (std::size_t i = 0; i < in.size(); ++i)
+            out[i] = symuluj(in[i]);
+    }
+    /// Access component `I`.
+    template <std::size_t I> constexpr auto &get() noexcept { return std::get<I>(m_stages); }
+    /// Last result getter.
+    constexpr double get_last_result() const noexcept { return m_prev_result; }
+
+private:
+    /// Copy components of `loop` checking that their types match `Ts`.
+    template <std::size_t... Is>
+    static std::tuple<Ts...> copy_stages(const PętlaUAR &loop, std::index_sequence<Is...>)
+    {
+        if (loop.size() != sizeof...(Ts))
+            throw std::runtime_error{ "Loop size does not match" };
+        const auto cast = []<typename T>(const ObiektSISO &e) -> T {
+            // Nested StaticLoops are constructed from nested PętlaUARs
+            using source_t = std::conditional_t<is_static_loop_v<T>, PętlaUAR, T>;
+            const auto ptr = dynamic_cast<const source_t *>(&e);
+            if (ptr == nullptr)
+                throw std::runtime_error{ "Loop component type does not match" };
+            return T{ *ptr };
+        };
+        return { cast.template operator()<Ts>(loop.at(Is))... };
+    }
+};
+
+#ifdef LAB_TESTS
+class FrozenLoopTests {
+    static PętlaUAR get_test_loop();
+    static void test_freeze_simulation();
+    static void test_thaw();
+    static void test_static_loop();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -1,9 +1,14 @@
 #include "generators.hpp"
 
-std::mt19937_64 __rng_eng{ std::random_device{}() };
-std::vector<std::pair<std::vector<std::uint8_t>,
-                      std::unique_ptr<Generator> (*)(const std::vector<std::uint8_t> &)>>
-    gen_deserializers;
+constinit PrefixRegistry<std::unique_ptr<Generator> (*)(std::span<const std::uint8_t>)>
+    gen_deserializers{};
+
+std::unique_ptr<Generator> Generator::deserialize(std::span<const uint8_t> serialized)
+{
+    if (const auto factory = gen_deserializers.find(serialized))
+        return factory(serialized);
+    throw std::runtime_error{ "Serialized data does not match any known generator." };
+}
 
 #ifdef LAB_TESTS
 #include <format>
@@ -202,6 +207,186 @@ void GeneratorTests::test_serialization()
     });
 }
 
+void GeneratorTests::test_registry()
+{
+    using Factory = std::unique_ptr<Generator> (*)(std::span<const std::uint8_t>);
+    const Factory first = [](std::span<const std::uint8_t> d) -> std::unique_ptr<Generator> {
+        return std::make_unique<GeneratorBaza>(d);
+    };
+    const Factory second = [](std::span<const std::uint8_t> d) -> std::unique_ptr<Generator> {
+        return std::make_unique<GeneratorSinus>(d);
+    };
+    it_should_not_throw("Registry - lookup"sv, [&] {
+        PrefixRegistry<Factory> registry;
+        if (registry.find(range_to_bytes("sin"sv)) != nullptr)
+            throw std::logic_error{ "Empty registry found a factory" };
+        registry.add("sin", first);
+        registry.add("saw", second);
+        if (registry.add("sin", second) || registry.size() != 2)
+            throw std::logic_error{ "Duplicate name was registered" };
+        if (registry.find(range_to_bytes("sin and data"sv)) != first
+            || registry.find(range_to_bytes("saw"sv)) != second)
+            throw std::logic_error{ "Wrong factory was found" };
+        if (registry.find(range_to_bytes("si"sv)) != nullptr
+            || registry.find(range_to_bytes("pwm"sv)) != nullptr)
+            throw std::logic_error{ "Factory found for an unknown name" };
+    });
+    it_should_throw<std::runtime_error>(
+        "Registry - name conflicts with a shorter name"sv,
+        [&] {
+            PrefixRegistry<Factory> registry;
+            registry.add("sin", first);
+            registry.add("sinus", second);
+        },
+        "Registered name conflicts with a shorter name"sv);
+    it_should_throw<std::runtime_error>(
+        "Registry - name conflicts with a longer name"sv,
+        [&] {
+            PrefixRegistry<Factory> registry;
+            registry.add("sinus", first);
+            registry.add("sin", second);
+        },
+        "Registered name conflicts with a longer name"sv);
+    it_should_throw<std::runtime_error>(
+        "Registry - capacity exceeded"sv,
+        [&] {
+            // The root and 3 bytes of "sin" fill the registry
+            PrefixRegistry<Factory, 4> registry;
+            registry.add("sin", first);
+            registry.add("saw", second);
+        },
+        "Registry capacity exceeded"sv);
+    it_should_not_throw("Registry - built at compile time"sv, [] {
+        using Constant = int (*)();
+        constexpr auto registry = [] {
+            PrefixRegistry<Constant, 8> r;
+            r.add("ab", [] { return 1; });
+            r.add("ac", [] { return 2; });
+            return r;
+        }();
+        constexpr std::array<std::uint8_t, 3> data{ 'a', 'c', 'x' };
+        static_assert(registry.size() == 2 && registry.find(data) != nullptr);
+        if (registry.find(data)() != 2)
+            throw std::logic_error{ "Wrong factory was found" };
+    });
+    it_should_throw<std::runtime_error>(
+        "Registry - unknown generator"sv,
+        [] { Generator::deserialize(range_to_bytes("square"sv)); },
+        "Serialized data does not match any known generator."sv);
+}
+
+void GeneratorTests::test_noise_streams()
+{
+    it_should_not_throw("Noise generators - same stream gives same samples", [] {
+        GeneratorUniformNoise u1{ get_base(), 2.0 }, u2{ get_base(), 2.0 };
+        GeneratorNormalNoise n1{ get_base(), 1.0, 0.5 }, n2{ get_base(), 1.0, 0.5 };
+        if (u1.get_seed() == u2.get_seed())
+            throw std::logic_error{ "Generators share a stream key" };
+        u2.set_seed(u1.get_seed());
+        n2.set_seed(n1.get_seed(), 10);
+        for (int t = 0; t < 10; ++t)
+            n1.symuluj(t);
+        for (int t = 0; t < 100; ++t) {
+            if (u1.symuluj(t) != u2.symuluj(t) || n1.symuluj(t) != n2.symuluj(t))
+                throw std::logic_error{ std::format("Samples differ at t = {}", t) };
+        }
+    });
+    it_should_not_throw("Noise generators - batch draws", [] {
+        GeneratorUniformNoise u{ get_base(), 3.0 };
+        GeneratorNormalNoise n{ get_base(), -1.0, 2.0 };
+        std::vector<double> u_batch(64), n_batch(64);
+        const auto u_seed = u.get_seed(), n_seed = n.get_seed();
+        u.draw_noise(u_batch);
+        n.draw_noise(n_batch);
+        if (u.get_stream_position() != 64 || n.get_stream_position() != 64)
+            throw std::logic_error{ "Stream position was not advanced" };
+        u.set_seed(u_seed);
+        n.set_seed(n_seed);
+        for (int t = 0; t < 64; ++t) {
+            const auto u_v = u.symuluj(t), n_v = n.symuluj(t);
+            if (u_v != u_batch[t] || n_v != n_batch[t] || u_v < -3.0 || u_v >= 3.0)
+                throw std::logic_error{ std::format("Wrong sample at t = {}", t) };
+        }
+    });
+}
+
+void GeneratorTests::test_generate()
+{
+    it_should_not_throw("Block generation matches symuluj", [] {
+        // Cached waveforms are tested separately, check the incremental computation here
+        set_waveform_cache(false);
+        auto make = [] {
+            auto base = std::make_unique<GeneratorBaza>(0.5, 3, 4000);
+            auto saw = std::make_unique<GeneratorSawtooth>(std::move(base), 1.25, 87, 12, 3980);
+            auto sin = std::make_unique<GeneratorSinus>(std::move(saw), 2.125, 55);
+            auto sin2 = std::make_unique<GeneratorSinus>(std::move(sin), 0.5, 1000, 100, 2500);
+            auto pwm
+                = std::make_unique<GeneratorProstokat>(std::move(sin2), 3.5, 285, 0.25, 2, 4200);
+            auto uni = std::make_unique<GeneratorUniformNoise>(std::move(pwm), 0.35);
+            uni->set_seed(1234);
+            auto norm = std::make_unique<GeneratorNormalNoise>(std::move(uni), 0.1, 0.2);
+            norm->set_seed(5678);
+            return norm;
+        };
+        auto per_sample = make(), block = make();
+
+        std::vector<double> out(4500);
+        // Uneven blocks, so that activity windows and periods start in the middle of blocks
+        for (std::size_t done = 0, n = 1; done < out.size(); done += n, n = n * 3 + 1) {
+            n = std::min(n, out.size() - done);
+            block->generate(static_cast<int>(done), std::span{ out }.subspan(done, n));
+        }
+        for (int t = 0; t < static_cast<int>(out.size()); ++t) {
+            const auto expected = per_sample->symuluj(t);
+            if (std::abs(out[t] - expected) > 1e-12)
+                throw std::logic_error{ std::format(
+                    "generate() returned {} instead of {} at t = {}", out[t], expected, t) };
+        }
+        set_waveform_cache(true);
+    });
+}
+
+void GeneratorTests::test_waveform_cache()
+{
+    it_should_not_throw("Waveform cache - same values as computed", [] {
+        auto make = [] {
+            auto sin = std::make_unique<GeneratorSinus>(get_base(), 2.125, 55, 3, 900);
+            auto pwm = std::make_unique<GeneratorProstokat>(std::move(sin), 3.5, 37, 0.3);
+            return std::make_unique<GeneratorSawtooth>(std::move(pwm), 1.25, 87);
+        };
+        auto cached = make(), computed = make();
+        std::vector<double> block(1000);
+        cached->generate(0, block);
+        set_waveform_cache(false);
+        for (int t = 0; t < 1000; ++t) {
+            const auto expected = computed->symuluj(t);
+            if (block[t] != expected)
+                throw std::logic_error{ std::format(
+                    "Cached value {} instead of {} at t = {}", block[t], expected, t) };
+        }
+        set_waveform_cache(true);
+        for (int t = 0; t < 1000; ++t) {
+            if (cached->symuluj(t) != block[t])
+                throw std::logic_error{ std::format("symuluj differs from generate at {}", t) };
+        }
+    });
+    it_should_not_throw("Waveform cache - tables are shared and follow parameters", [] {
+        GeneratorSinus a{ get_base(), 1.5, 40 }, b{ get_base(), 1.5, 40 };
+        a.symuluj(0);
+        b.symuluj(0);
+        const auto table_a = waveform_table({ Waveform::SINE, 1.5, 40, 0.0 }, [](uint32_t) {
+            throw std::logic_error{ "Table of an equal generator was not shared" };
+            return 0.0;
+        });
+        if (!table_a || table_a->size() != 40)
+            throw std::logic_error{ "Wrong table" };
+        b.set_period(80);
+        const double expected = 1.5 * std::sin(2.0 * std::numbers::pi * 10 / 80);
+        if (b.symuluj(10) != expected)
+            throw std::logic_error{ "Stale table used after set_period" };
+    });
+}
+
 void GeneratorTests::run_tests()
 {
     test_base();
@@ -211,5 +396,9 @@ void GeneratorTests::run_tests()
     test_sawtooth();
     test_addition();
     test_serialization();
+    test_registry();
+    test_noise_streams();
+    test_generate();
+    test_waveform_cache();
 }
 #endif
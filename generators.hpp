@@ -1,13 +1,16 @@
 /// @file generators.hpp
 
 #pragma once
+#include "philox.hpp"
+#include "prefix_registry.hpp"
 #include "util.hpp"
+#include "waveform_cache.hpp"
 #include <cmath>
 #include <format>
 #include <functional>
 #include <memory>
 #include <numbers>
-#include <random>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -16,25 +19,22 @@
 
 class Generator;
 
-/// Shared pseudo-global PRNG used by generators.
-extern std::mt19937_64 __rng_eng;
-/// Vector of [prefix, deserializer function] pairs.
-extern std::vector<std::pair<std::vector<std::uint8_t>,
-                             std::unique_ptr<Generator> (*)(const std::vector<std::uint8_t> &)>>
+/// Registry of deserializer functions, indexed by the unique names of the classes.
+extern constinit PrefixRegistry<std::unique_ptr<Generator> (*)(std::span<const std::uint8_t>)>
     gen_deserializers;
+/// @brief Deserializer of class `T` added to #gen_deserializers by #DESERIALIZABLE_GEN.
+template <typename T>
+std::unique_ptr<Generator> deserialize_generator(std::span<const std::uint8_t> bin_data)
+{
+    return std::make_unique<T>(bin_data);
+}
 /// @brief Declare class @a class_name as deserializable and add its deserializer to
 /// #gen_deserializers.
-/// @details The class must have a `::unique_name` member.
+/// @details The class must have a `::unique_name` member. Names must be prefix-free, see
+/// PrefixRegistry::add(). The registration is an inline variable, so it runs once per program.
 #define DESERIALIZABLE_GEN(class_name)                                                             \
-    namespace {                                                                                    \
-        [[maybe_unused]] const auto __add_serializable_generator__##class_name                     \
-            = gen_deserializers.emplace_back(                                                      \
-                std::ranges::to<std::vector<std::uint8_t>>(                                        \
-                    range_to_bytes(class_name::unique_name)),                                      \
-                [](const std::vector<std::uint8_t> &bin_data) -> std::unique_ptr<Generator> {      \
-                    return std::make_unique<class_name>(bin_data);                                 \
-                });                                                                                \
-    }
+    [[maybe_unused]] inline const bool __add_serializable_generator__##class_name                  \
+        = gen_deserializers.add(class_name::unique_name, &deserialize_generator<class_name>)
 
 /// Abstract base class representing a signal generator.
 class Generator {
@@ -56,6 +56,21 @@ protected:
     {
         return (m_t_start == 0 && m_t_end == 0) || (time >= m_t_start && time <= m_t_end);
     }
+    /// @brief Find the part of a block during which the generator is enabled.
+    /// @param t0 simulation time of the first sample of the block
+    /// @param n number of samples in the block
+    /// @return `[begin, end)` range of sample indices, empty if the generator is disabled.
+    constexpr std::pair<std::size_t, std::size_t> enabled_range(int t0,
+                                                                std::size_t n) const noexcept
+    {
+        if (m_t_start == 0 && m_t_end == 0)
+            return { 0, n };
+        const auto clip = [n, t0](long long t) {
+            return static_cast<std::size_t>(std::clamp(t - t0, 0LL, static_cast<long long>(n)));
+        };
+        const auto begin = clip(m_t_start), end = clip(m_t_end + 1LL);
+        return { begin, std::max(begin, end) };
+    }
     /// @brief Validate whether end time is not smaller than start time.
     /// @param t_start start time
     /// @param t_end end time
@@ -139,6 +154,21 @@ public:
     /// @param time simulation time
     /// @return Generator's simulation output.
     virtual double symuluj(int time) = 0;
+    /// @brief Simulate a block of consecutive samples.
+    ///
+    /// The result is the same as calling #symuluj for times `t0, t0 + 1, ...`, but derived classes
+    /// generate the whole block in one pass. The only exception is GeneratorSinus without a cached
+    /// waveform: it rotates the (sin, cos) pair by a constant angle, resynchronized every 256
+    /// samples, so its samples differ from #symuluj by up to about 2e-14 times the amplitude.
+    /// Compare such blocks with a tolerance, not with `==`.
+    ///
+    /// @param t0 simulation time of `out[0]`
+    /// @param out output buffer, overwritten with the generated samples
+    virtual void generate(int t0, std::span<double> out)
+    {
+        for (std::size_t i = 0; i < out.size(); ++i)
+            out[i] = symuluj(t0 + static_cast<int>(i));
+    }
     /// @brief Serialize the object.
     /// @return A vector of bytes (`uint8_t`) from which the object can be reconstructed.
     virtual constexpr std::vector<uint8_t> dump() const
@@ -157,7 +187,16 @@ public:
 
     /// @brief Deserialize `serialized` into a Generator derived class based on data prefix.
     ///
-    /// The serialized (target) class must be registered using #DESERIALIZABLE_GEN.
+    /// The serialized (target) class must be registered using #DESERIALIZABLE_GEN. Generators are
+    /// constructed directly from `serialized`, decorated ones from subspans of it.
+    ///
+    /// @param serialized byte representation of a Generator derived class
+    /// @return A unique pointer owning a deserialized instance of an appropriate class
+    /// @throws `std::runtime_error` if the data does not match any registered class.
+    static std::unique_ptr<Generator> deserialize(std::span<const uint8_t> serialized);
+    /// @brief Deserialize a range of bytes, see deserialize(std::span<const uint8_t>).
+    ///
+    /// Contiguous ranges of `uint8_t` are viewed as a span, other ranges are copied first.
     ///
     /// @tparam T type of input range over bytes
     /// @param serialized byte representation of a Generator derived class
@@ -167,15 +206,16 @@ public:
         requires ByteRepr<std::ranges::range_value_t<T>>
     static std::unique_ptr<Generator> deserialize(const T &serialized)
     {
-        for (const auto &[name, factory] : gen_deserializers) {
-#if __cpp_lib_ranges_starts_ends_with >= 202106L
-            if (std::ranges::starts_with(serialized, name))
-#else
-            if (std::ranges::mismatch(serialized, name).in2 == std::ranges::end(name))
-#endif
-                return factory(serialized | std::ranges::to<std::vector<uint8_t>>());
+        if constexpr (std::ranges::contiguous_range<T> && std::ranges::sized_range<T>
+                      && std::same_as<std::ranges::range_value_t<T>, uint8_t>) {
+            return deserialize(std::span<const uint8_t>{ std::ranges::data(serialized),
+                                                         std::ranges::size(serialized) });
+        } else {
+            const auto copy = serialized
+                | std::views::transform([](auto b) { return static_cast<uint8_t>(b); })
+                | std::ranges::to<std::vector<uint8_t>>();
+            return deserialize(std::span<const uint8_t>{ copy });
         }
-        throw std::runtime_error{ "Serialized data does not match any known generator." };
     }
 
     friend bool operator==(const Generator &a, const Generator &b)
@@ -193,6 +233,15 @@ protected:
     /// @param time simulation time
     /// @return Simulation result of own generator function ignoring the decorated #m_base class.
     virtual double simulate_internal(int time) = 0;
+    /// @brief Add own signal to a block of samples.
+    /// @details The default implementation calls #simulate_internal for every sample.
+    /// @param t0 simulation time of `out[0]`
+    /// @param out block to which own signal is added
+    virtual void add_internal(int t0, std::span<double> out)
+    {
+        for (std::size_t i = 0; i < out.size(); ++i)
+            out[i] += simulate_internal(t0 + static_cast<int>(i));
+    }
     /// @brief Equality check with other generators.
     ///
     /// This method compares only the GeneratorDecor and Generator member variables. Derived classes
@@ -238,6 +287,15 @@ public:
     /// @param time simulation time
     /// @return Generator's simulation output including the decorated generator.
     double symuluj(int time) override { return m_base->symuluj(time) + simulate_internal(time); }
+    /// @brief Simulate a block, one decorator layer at a time.
+    /// @details The decorated generator fills the whole block first and then own signal is added.
+    /// @param t0 simulation time of `out[0]`
+    /// @param out output buffer, overwritten with the generated samples
+    void generate(int t0, std::span<double> out) override
+    {
+        m_base->generate(t0, out);
+        add_internal(t0, out);
+    }
     constexpr std::vector<uint8_t> dump() const override
     {
         return concat_iterables(Generator::dump(), m_base->dump());
@@ -275,6 +333,12 @@ public:
     /// Alias to #set_amplitude
     constexpr void set_value(double value = 0.0) noexcept { set_amplitude(value); };
     constexpr double symuluj(int time) override { return enabled_time(time) ? m_amplitude : 0.0; }
+    void generate(int t0, std::span<double> out) override
+    {
+        const auto [begin, end] = enabled_range(t0, out.size());
+        std::ranges::fill(out, 0.0);
+        std::ranges::fill(out.subspan(begin, end - begin), m_amplitude);
+    }
     constexpr std::vector<uint8_t> dump() const override
     {
         return concat_iterables(range_to_bytes(unique_name), Generator::dump());
@@ -298,6 +362,50 @@ class GeneratorPeriodic : public GeneratorDecor {
 protected:
     /// Period of the function implemented by the generator.
     uint32_t m_period;
+    /// Cached table of one period of own waveform, `nullptr` if not cached.
+    WaveformTable m_table{};
+    /// Parameters for which #m_table was obtained.
+    WaveformKey m_table_key{};
+
+    /// Parameters of own waveform, used as the waveform cache key.
+    virtual WaveformKey waveform_key() const = 0;
+    /// @brief Compute own signal at a given position in the period, ignoring activity time.
+    /// @param p position in the period, smaller than #m_period
+    virtual double waveform_value(uint32_t p) const = 0;
+    /// @brief Get the cached table of one period of own waveform.
+    /// @details The table is obtained again after any parameter changes.
+    /// @return Pointer to #m_period values or `nullptr` if the waveform is not cached.
+    const double *table()
+    {
+        const auto key = waveform_key();
+        if (!(m_table && key == m_table_key) || !waveform_cache_enabled()) {
+            m_table = waveform_table(key, [this](uint32_t p) { return waveform_value(p); });
+            m_table_key = key;
+        }
+        return m_table ? m_table->data() : nullptr;
+    }
+    /// @brief Own signal at given time, using the cached table if possible.
+    /// @param time simulation time
+    double periodic_value(int time)
+    {
+        if (!enabled_time(time))
+            return 0.0;
+        const auto p = phase(time);
+        const double *t = table();
+        return t ? t[p] : waveform_value(p);
+    }
+    /// @brief Add own signal to a block using the cached table.
+    /// @param t0 simulation time of `out[0]`
+    /// @param out block to which own signal is added
+    /// @return `false` if the waveform is not cached and nothing was added.
+    bool add_from_table(int t0, std::span<double> out)
+    {
+        const double *t = table();
+        if (!t)
+            return false;
+        for_each_enabled(t0, out.size(), [&](std::size_t i, uint32_t p) { out[i] += t[p]; });
+        return true;
+    }
 
     /// @brief Equality check with other generators.
     ///
@@ -312,6 +420,33 @@ protected:
         auto &bp = dynamic_cast<const GeneratorPeriodic &>(b);
         return GeneratorDecor::eq(bp) && m_period == bp.m_period;
     }
+    /// @brief Position of a sample in the period.
+    /// @details Uses the same (unsigned) arithmetic as `time % m_period` in simulation functions.
+    /// @param time simulation time
+    constexpr uint32_t phase(int time) const noexcept
+    {
+        return static_cast<uint32_t>(time) % m_period;
+    }
+    /// @brief Call `fn(i, p)` for every `i` in the enabled part of the block.
+    ///
+    /// `p` is the position of sample `i` in the period, which is computed incrementally instead of
+    /// using modulo for every sample.
+    ///
+    /// @param t0 simulation time of the first sample of the block
+    /// @param n number of samples in the block
+    /// @param fn function accepting the sample index and its position in the period
+    constexpr void for_each_enabled(int t0, std::size_t n, auto &&fn) const
+    {
+        const auto [begin, end] = enabled_range(t0, n);
+        if (begin == end)
+            return;
+        uint32_t p = phase(t0 + static_cast<int>(begin));
+        for (std::size_t i = begin; i < end; ++i) {
+            fn(i, p);
+            if (++p == m_period)
+                p = 0;
+        }
+    }
 
 public:
     /// @brief Regular constructor of a periodic generator that decorates another Generator.
@@ -346,17 +481,45 @@ public:
     }
 };
 
-/// Sine wave generator.
+/// @brief Sine wave generator.
+/// @details Blocks generated without a cached waveform are approximate, see Generator::generate().
 class GeneratorSinus : public GeneratorPeriodic {
 private:
-    // std::sin is constexpr since C++26, but this is legal since C++23
-    constexpr double simulate_internal(int time) override
-    {
-        return enabled_time(time)
-            // Should (time - m_start_time) be used instead of time? This question applies to all
-            // non-constant signals
-            ? m_amplitude * std::sin(2.0 * std::numbers::pi * (time % m_period) / m_period)
-            : 0.0;
+    WaveformKey waveform_key() const override
+    {
+        return { Waveform::SINE, m_amplitude, m_period, 0.0 };
+    }
+    double waveform_value(uint32_t p) const override
+    {
+        // Should (time - m_start_time) be used instead of time? This question applies to all
+        // non-constant signals
+        return m_amplitude * std::sin(2.0 * std::numbers::pi * p / m_period);
+    }
+    double simulate_internal(int time) override { return periodic_value(time); }
+    void add_internal(int t0, std::span<double> out) override
+    {
+        if (add_from_table(t0, out))
+            return;
+        // (sin, cos) pair is rotated by a constant angle every sample. It is recomputed at the
+        // start of every period and after resync_interval samples to bound the rounding error.
+        constexpr std::size_t resync_interval = 256;
+        const double step = 2.0 * std::numbers::pi / m_period;
+        const double sin_step = std::sin(step), cos_step = std::cos(step);
+        double s = 0.0, c = 1.0;
+        std::size_t since_sync = resync_interval;
+        for_each_enabled(t0, out.size(), [&](std::size_t i, uint32_t p) {
+            if (p == 0 || since_sync == resync_interval) {
+                const double angle = 2.0 * std::numbers::pi * p / m_period;
+                s = std::sin(angle);
+                c = std::cos(angle);
+                since_sync = 0;
+            }
+            out[i] += m_amplitude * s;
+            const double s_next = s * cos_step + c * sin_step;
+            c = c * cos_step - s * sin_step;
+            s = s_next;
+            ++since_sync;
+        });
     }
 
 public:
@@ -413,10 +576,24 @@ private:
             throw std::runtime_error{ "Duty cycle should be between 0 and 1. If you want a "
                                       "constant signal use GeneratorBaza." };
     }
-    constexpr double simulate_internal(int time) override
+    WaveformKey waveform_key() const override
     {
-        return enabled_time(time) && (time % m_period) < m_duty_cycle * m_period ? m_amplitude
-                                                                                 : 0.0;
+        return { Waveform::SQUARE, m_amplitude, m_period, m_duty_cycle };
+    }
+    double waveform_value(uint32_t p) const override
+    {
+        return p < m_duty_cycle * m_period ? m_amplitude : 0.0;
+    }
+    double simulate_internal(int time) override { return periodic_value(time); }
+    void add_internal(int t0, std::span<double> out) override
+    {
+        if (add_from_table(t0, out))
+            return;
+        const double threshold = m_duty_cycle * m_period;
+        for_each_enabled(t0, out.size(), [&](std::size_t i, uint32_t p) {
+            if (p < threshold)
+                out[i] += m_amplitude;
+        });
     }
     /// @brief Equality check with other generators.
     /// @param b the other generator, **must be** (derived from) GeneratorProstokat
@@ -492,11 +669,22 @@ DESERIALIZABLE_GEN(GeneratorProstokat);
 /// Sawtooth wave generator
 class GeneratorSawtooth : public GeneratorPeriodic {
 private:
-    constexpr double simulate_internal(int time) override
+    WaveformKey waveform_key() const override
+    {
+        return { Waveform::SAWTOOTH, m_amplitude, m_period, 0.0 };
+    }
+    double waveform_value(uint32_t p) const override
     {
-        return enabled_time(time)
-            ? m_amplitude * (2 * static_cast<double>(time % m_period) / m_period - 1)
-            : 0.0;
+        return m_amplitude * (2 * static_cast<double>(p) / m_period - 1);
+    }
+    double simulate_internal(int time) override { return periodic_value(time); }
+    void add_internal(int t0, std::span<double> out) override
+    {
+        if (add_from_table(t0, out))
+            return;
+        for_each_enabled(t0, out.size(), [&](std::size_t i, uint32_t p) {
+            out[i] += m_amplitude * (2 * static_cast<double>(p) / m_period - 1);
+        });
     }
 
 public:
@@ -541,12 +729,28 @@ public:
 };
 DESERIALIZABLE_GEN(GeneratorSawtooth);
 
-/// @brief Abstract template base class for random generators.
-/// @tparam D distribution used by the generators
-template <typename D> class GeneratorRandomBase : public GeneratorDecor {
+/// @brief Abstract base class for random generators.
+///
+/// Every generator draws from its own counter-based (Philox) stream. Sample `n` is a pure function
+/// of the stream key and `n`, so generators do not share any state, can be used from different
+/// threads and any position of the stream can be reached in O(1).
+class GeneratorRandomBase : public GeneratorDecor {
 protected:
-    /// Random number distribution.
-    D m_dist{};
+    /// Key of the noise stream, unique for every generator unless set with set_seed().
+    std::uint64_t m_stream_key{ philox_stream_key() };
+    /// Position in the noise stream (number of samples drawn so far).
+    std::uint64_t m_stream_pos{};
+
+    void add_internal(int, std::span<double> out) override
+    {
+        std::array<double, 256> noise;
+        for (std::size_t i = 0; i < out.size(); i += noise.size()) {
+            const auto chunk = std::span{ noise }.first(std::min(noise.size(), out.size() - i));
+            draw_noise(chunk);
+            for (std::size_t j = 0; j < chunk.size(); ++j)
+                out[i + j] += chunk[j];
+        }
+    }
 
 public:
     /// @brief Regular constructor of a random generator that decorates another Generator.
@@ -560,21 +764,41 @@ public:
     {
     }
     /// @brief Deserializing constructor from a range of bytes.
+    /// @details The stream state is not serialized, a new stream is used.
     /// @param serialized input range over bytes representing serialized GeneratorRandomBase
     GeneratorRandomBase(const std::ranges::input_range auto &serialized)
         : GeneratorDecor{ serialized }
     {
     }
+    /// Noise stream key (#m_stream_key) getter.
+    constexpr std::uint64_t get_seed() const noexcept { return m_stream_key; }
+    /// Noise stream position (#m_stream_pos) getter.
+    constexpr std::uint64_t get_stream_position() const noexcept { return m_stream_pos; }
+    /// @brief Select the noise stream and position in it.
+    /// @param key stream key
+    /// @param position position of the next sample in the stream
+    constexpr void set_seed(std::uint64_t key, std::uint64_t position = 0) noexcept
+    {
+        m_stream_key = key;
+        m_stream_pos = position;
+    }
+    /// @brief Draw consecutive noise samples in a batch.
+    ///
+    /// The values are the same as the own (not decorated) contributions of the following
+    /// `out.size()` simulations during activity time, and the stream position is advanced.
+    ///
+    /// @param out output for the noise samples
+    virtual void draw_noise(std::span<double> out) = 0;
 };
 
 /// @brief Noise generator with uniform distribution.
 /// @details The noise is generated uniformly around 0 in range @f$[-\frac{amplitude}{2},
 /// \frac{amplitude}{2}]@f$.
-class GeneratorUniformNoise : public GeneratorRandomBase<std::uniform_real_distribution<>> {
+class GeneratorUniformNoise : public GeneratorRandomBase {
 private:
     double simulate_internal(int) override
     {
-        return 2.0 * this->m_amplitude * (this->m_dist(__rng_eng) - 0.5);
+        return 2.0 * m_amplitude * (philox_uniform(m_stream_key, m_stream_pos++) - 0.5);
     }
 
 public:
@@ -587,21 +811,26 @@ public:
     /// @param t_end end time of own activity (inclusive)
     GeneratorUniformNoise(std::unique_ptr<Generator> &&base, double amplitude, int t_start = 0,
                           int t_end = 0)
-        : GeneratorRandomBase<std::uniform_real_distribution<>>{ std::move(base), amplitude,
-                                                                 t_start, t_end }
+        : GeneratorRandomBase{ std::move(base), amplitude, t_start, t_end }
     {
     }
     /// @brief Deserializing constructor from a range of bytes.
     /// @param serialized input range over bytes representing serialized GeneratorUniformNoise
     GeneratorUniformNoise(const std::ranges::input_range auto &serialized)
-        : GeneratorRandomBase<std::uniform_real_distribution<>>{ std::ranges::drop_view{
-              serialized, unique_name.size() } }
+        : GeneratorRandomBase{ std::ranges::drop_view{ serialized, unique_name.size() } }
     {
         if (!prefix_match(unique_name, serialized))
             throw std::runtime_error{
                 "GeneratorUniformNoise serialized data does not start with expected prefix"
             };
     }
+    void draw_noise(std::span<double> out) override
+    {
+        philox_fill_uniform(m_stream_key, m_stream_pos, out);
+        m_stream_pos += out.size();
+        for (auto &v : out)
+            v = 2.0 * m_amplitude * (v - 0.5);
+    }
     constexpr std::vector<uint8_t> dump() const override
     {
         return concat_iterables(range_to_bytes(unique_name), GeneratorDecor::dump());
@@ -621,17 +850,14 @@ public:
 DESERIALIZABLE_GEN(GeneratorUniformNoise);
 
 /// Noise generator with normal distribution.
-class GeneratorNormalNoise : public GeneratorRandomBase<std::normal_distribution<>> {
+class GeneratorNormalNoise : public GeneratorRandomBase {
 private:
-    /// `param_type` of the distribution.
-    using pt = std::normal_distribution<>::param_type;
-
     /// Standard deviation of the generator.
     double m_stddev;
 
     double simulate_internal(int) override
     {
-        return this->m_dist(__rng_eng, pt{ this->m_amplitude, m_stddev });
+        return m_amplitude + m_stddev * philox_normal(m_stream_key, m_stream_pos++);
     }
     /// @brief Equality check with other generators.
     /// @param b the other generator, **must be** (derived from) GeneratorNormalNoise
@@ -639,7 +865,7 @@ private:
     bool eq(const Generator &b) const override
     {
         auto &bp = dynamic_cast<const GeneratorNormalNoise &>(b);
-        return GeneratorRandomBase<std::normal_distribution<>>::eq(bp) && m_stddev == bp.m_stddev;
+        return GeneratorRandomBase::eq(bp) && m_stddev == bp.m_stddev;
     }
 
 public:
@@ -653,15 +879,15 @@ public:
     /// @param t_end end time of own activity (inclusive)
     GeneratorNormalNoise(std::unique_ptr<Generator> &&base, double mean, double stddev,
                          int t_start = 0, int t_end = 0)
-        : GeneratorRandomBase<std::normal_distribution<>>{ std::move(base), mean, t_start, t_end }
+        : GeneratorRandomBase{ std::move(base), mean, t_start, t_end }
         , m_stddev{ stddev }
     {
     }
     /// @brief Deserializing constructor from a range of bytes.
     /// @param serialized input range over bytes representing serialized GeneratorNormalNoise
     GeneratorNormalNoise(const std::ranges::input_range auto &serialized)
-        : GeneratorRandomBase<std::normal_distribution<>>{ std::ranges::drop_view{
-              serialized, unique_name.size() + sizeof m_stddev } }
+        : GeneratorRandomBase{ std::ranges::drop_view{ serialized,
+                                                       unique_name.size() + sizeof m_stddev } }
     {
         if (!prefix_match(unique_name, serialized))
             throw std::runtime_error{
@@ -674,6 +900,11 @@ public:
         std::ranges::copy_n(std::ranges::begin(remaining), sizeof m_stddev, stddev_bytes.begin());
         m_stddev = from_bytes<decltype(m_stddev)>(stddev_bytes);
     }
+    void draw_noise(std::span<double> out) override
+    {
+        philox_fill_normal(m_stream_key, m_stream_pos, out, m_amplitude, m_stddev);
+        m_stream_pos += out.size();
+    }
     /// Alias to #get_amplitude().
     constexpr double get_mean() const noexcept { return get_amplitude(); }
     /// Alias to #set_amplitude(double).
@@ -711,6 +942,10 @@ class GeneratorTests {
     static void test_sawtooth();
     static void test_addition();
     static void test_serialization();
+    static void test_registry();
+    static void test_noise_streams();
+    static void test_generate();
+    static void test_waveform_cache();
 
 public:
     static void run_tests();
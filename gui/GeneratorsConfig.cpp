@@ -544,11 +544,9 @@ void GeneratorsConfig::action_delete()
 void GeneratorsConfig::action_simulate()
 {
     const auto duration = spinbox_time->value();
-    const auto end = simulation_time + duration;
-    std::vector<double> outputs;
-    outputs.reserve(duration);
-    for (; simulation_time < end; ++simulation_time)
-        outputs.push_back(generator->symuluj(simulation_time));
+    std::vector<double> outputs(duration);
+    generator->generate(simulation_time, outputs);
+    simulation_time += duration;
 
     update_sim_time();
     emit simulated(outputs);
@@ -581,6 +579,12 @@ void GeneratorsConfig::reset_sim()
     update_sim_time();
 }
 
+void GeneratorsConfig::set_simulation_time(int time)
+{
+    simulation_time = time;
+    update_sim_time();
+}
+
 std::vector<uint8_t> GeneratorsConfig::dump() const
 {
     return generator == nullptr ? std::vector<uint8_t>{} : generator->dump();
@@ -149,6 +149,11 @@ public:
     explicit GeneratorsConfig(QWidget *parent = nullptr, Qt::WindowFlags f = Qt::WindowFlags());
     /// Reset simulation time.
     void reset_sim();
+    /// Current simulation time (#simulation_time) getter.
+    int get_simulation_time() const noexcept { return simulation_time; }
+    /// @brief Current simulation time (#simulation_time) setter.
+    /// @param time new simulation time
+    void set_simulation_time(int time);
     /// Check if there are no configured generators.
     bool empty() const { return generator == nullptr; }
     /// @brief Serialize the underlying topmost generator (all configured generators).
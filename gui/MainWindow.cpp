@@ -1,19 +1,57 @@
 #include "MainWindow.hpp"
 #include "../ObiektStatyczny.hpp"
+#include "../philox.hpp"
 #include <QApplication>
 #include <QDir>
 #include <QFileDialog>
 #include <QFrame>
 #include <QLabel>
-#include <QLineSeries>
 #include <QMenuBar>
+#include <QHBoxLayout>
 #include <QMessageBox>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
+#include <format>
 #include <fstream>
+#include <memory>
 #include <span>
+#include <stdexcept>
 
 namespace fs = std::filesystem;
 
+namespace {
+/// Tooltip of the real-time period spinbox
+constexpr const char *period_tooltip{
+    "Simulate one step per period in real time, also with generators"
+};
+/// Number of samples of the unit step used by MainWindow::autotune()
+constexpr std::size_t autotune_steps = 2000;
+/// Number of samples in a chunk of MainWindow::results
+constexpr std::size_t result_chunk_size = 1 << 16;
+/// Number of chunks of MainWindow::results kept in memory
+constexpr std::size_t result_memory_chunks = 16;
+/// Number of samples in a bucket of the finest level of the plot pyramids
+constexpr std::size_t plot_base_bucket = 64;
+}
+
+MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
+    : QMainWindow{ parent, flags }
+    // Old results are kept in a temporary file, so that memory usage is bounded
+    , results{ result_chunk_size, result_memory_chunks,
+               fs::temp_directory_path()
+                   / std::format("polabs-results-{:016x}.bin", philox_stream_key()) }
+    // Fine levels of the pyramids cover only the samples in memory, coarse ones the whole run
+    , pyramid_results{ plot_base_bucket,
+                       result_chunk_size * result_memory_chunks / plot_base_bucket }
+    , pyramid_inputs{ plot_base_bucket,
+                      result_chunk_size * result_memory_chunks / plot_base_bucket }
+{
+}
+
 void MainWindow::setup_ui()
 {
     prepare_menu_bar();
@@ -33,6 +71,9 @@ void MainWindow::prepare_menu_bar()
     action_save->setShortcut(QKeySequence::Save);
     connect(action_save, &QAction::triggered, this, &MainWindow::save_full_config);
 
+    action_save_checkpoint = menu_file->addAction("Save &checkpoint");
+    connect(action_save_checkpoint, &QAction::triggered, this, &MainWindow::save_checkpoint);
+
     // Export
     submenu_export = menu_file->addMenu("Export");
 
@@ -42,6 +83,9 @@ void MainWindow::prepare_menu_bar()
     action_export_generators = submenu_export->addAction("Generators");
     connect(action_export_generators, &QAction::triggered, this, &MainWindow::export_generators);
 
+    action_export_results = submenu_export->addAction("Simulation results");
+    connect(action_export_results, &QAction::triggered, this, &MainWindow::export_results);
+
     // Import
     submenu_import = menu_file->addMenu("Import");
 
@@ -137,25 +181,24 @@ void MainWindow::prepare_layout()
     layout_param_editors = new QStackedLayout{};
     layout_components->addItem(layout_param_editors);
 
+    // The other editors are created when a component of their type is first selected
     editor_nothing = new QWidget{ widget_components };
     layout_param_editors->addWidget(editor_nothing);
 
-    editor_pid = new PIDParams{ widget_components };
-    layout_param_editors->addWidget(editor_pid);
-
-    editor_static = new ObiektStatycznyParams{ widget_components };
-    layout_param_editors->addWidget(editor_static);
-
-    editor_arx = new ARXParams{ widget_components };
-    layout_param_editors->addWidget(editor_arx);
-
-    editor_uar = new UARParams{ widget_components };
-    layout_param_editors->addWidget(editor_uar);
-
     button_save_params = new QPushButton{ "Save changes", widget_components };
     layout_components->addWidget(button_save_params);
     connect(button_save_params, &QPushButton::released, this, &MainWindow::save_params);
 
+    button_autotune = new QPushButton{ "Autotune", widget_components };
+    button_autotune->setToolTip("Find k, Ti and Td minimizing the squared error of a unit step "
+                                "response");
+    button_autotune->setVisible(false);
+    layout_components->addWidget(button_autotune);
+    connect(button_autotune, &QPushButton::released, this, &MainWindow::autotune);
+    timer_tuning = new QTimer{ this };
+    timer_tuning->setInterval(50);
+    connect(timer_tuning, &QTimer::timeout, this, &MainWindow::poll_tuning);
+
     // Right part of the window
     widget_right = new QWidget{ main_columns_splitter };
     main_columns_splitter->addWidget(widget_right);
@@ -183,21 +226,102 @@ void MainWindow::prepare_layout()
     layout_inputs->addWidget(label_repetitons, 0, 2);
     layout_inputs->addWidget(input_repetitions, 0, 3);
 
+    input_period = new QSpinBox{ widget_inputs };
+    input_period->setRange(0, 1'000'000);
+    input_period->setSpecialValueText("Off");
+    input_period->setToolTip(period_tooltip);
+    const auto label_period = new QLabel{ "Real-time period [µs]", widget_inputs };
+    layout_inputs->addWidget(label_period, 1, 2);
+    layout_inputs->addWidget(input_period, 1, 3);
+
     button_simulate = new QPushButton{ "Simulate", widget_inputs };
     layout_inputs->addWidget(button_simulate, 1, 0);
     connect(button_simulate, &QPushButton::released, this, &MainWindow::simulate_manual);
 
-    // Generators
-    panel_generators = new GeneratorsConfig{ tabs_input };
-    connect(panel_generators, &GeneratorsConfig::simulated, this, &MainWindow::simulate_gen);
-    connect(panel_generators, &GeneratorsConfig::cleared, this, [this]() { this->reset_sim(); });
-    tabs_input->addTab(panel_generators, "Generators");
+    // Generators, created when the tab is first shown or the generators are used
+    widget_generators = new QWidget{ tabs_input };
+    const auto layout_generators = new QVBoxLayout{ widget_generators };
+    layout_generators->setContentsMargins(0, 0, 0, 0);
+    tabs_input->addTab(widget_generators, "Generators");
+    connect(tabs_input, &QTabWidget::currentChanged, this, [this](int index) {
+        if (tabs_input->widget(index) == widget_generators)
+            generators();
+    });
 
-    // Plot
+    // Background simulation controls, visible only while a simulation runs
+    widget_progress = new QWidget{ widget_right };
+    const auto layout_progress = new QHBoxLayout{ widget_progress };
+    progress_simulation = new QProgressBar{ widget_progress };
+    progress_simulation->setRange(0, 1000);
+    layout_progress->addWidget(progress_simulation);
+    button_pause = new QPushButton{ "Pause", widget_progress };
+    layout_progress->addWidget(button_pause);
+    connect(button_pause, &QPushButton::released, this, &MainWindow::toggle_pause);
+    button_cancel = new QPushButton{ "Cancel", widget_progress };
+    layout_progress->addWidget(button_cancel);
+    connect(button_cancel, &QPushButton::released, this, [this]() {
+        if (worker)
+            worker->cancel();
+    });
+    label_pacing = new QLabel{ widget_progress };
+    layout_progress->addWidget(label_pacing);
+    layout_right_col->addWidget(widget_progress);
+    widget_progress->setVisible(false);
+    timer_worker = new QTimer{ this };
+    timer_worker->setInterval(30);
+    connect(timer_worker, &QTimer::timeout, this, &MainWindow::poll_worker);
+}
+
+void MainWindow::create_chart()
+{
+    if (plot != nullptr)
+        return;
     plot = new QChart{};
     chart_view = new QChartView{ plot, widget_right };
     chart_view->setRenderHint(QPainter::Antialiasing);
-    layout_right_col->addWidget(chart_view);
+    // Zoom by selecting a time range, zoom out with the right mouse button
+    chart_view->setRubberBand(QChartView::HorizontalRubberBand);
+    // Above the simulation progress, below the inputs
+    layout_right_col->insertWidget(layout_right_col->indexOf(widget_progress), chart_view);
+    series_results = new QLineSeries{ plot };
+    series_results->setName("Simulation results");
+    series_inputs = new QLineSeries{ plot };
+    series_inputs->setName("Inputs");
+    plot->addSeries(series_results);
+    plot->addSeries(series_inputs);
+    axis_x = new QValueAxis{ plot };
+    axis_y = new QValueAxis{ plot };
+    plot->addAxis(axis_x, Qt::AlignBottom);
+    plot->addAxis(axis_y, Qt::AlignLeft);
+    for (const auto series : { series_results, series_inputs }) {
+        series->attachAxis(axis_x);
+        series->attachAxis(axis_y);
+    }
+    connect(axis_x, &QValueAxis::rangeChanged, this, [this](qreal min, qreal max) {
+        // Keep following new results only if the whole range is visible
+        if (!plot_updating)
+            plot_follow = min <= static_cast<double>(results.first_available())
+                && max >= static_cast<double>(results.size()) - 1.0;
+        schedule_plot_refresh();
+    });
+    connect(plot, &QChart::plotAreaChanged, this, &MainWindow::schedule_plot_refresh);
+
+    // Show the results simulated before the chart was created
+    show_all_results();
+    schedule_plot_refresh();
+}
+
+GeneratorsConfig *MainWindow::generators()
+{
+    if (panel_generators == nullptr) {
+        panel_generators = new GeneratorsConfig{ widget_generators };
+        widget_generators->layout()->addWidget(panel_generators);
+        panel_generators->setEnabled(worker == nullptr);
+        connect(panel_generators, &GeneratorsConfig::simulated, this, &MainWindow::simulate_gen);
+        connect(panel_generators, &GeneratorsConfig::cleared, this,
+                [this]() { this->reset_sim(); });
+    }
+    return panel_generators;
 }
 
 std::vector<double> MainWindow::parse_coefficients(const QString &coeff_text)
@@ -221,6 +345,8 @@ std::vector<double> MainWindow::parse_coefficients(const QString &coeff_text)
 
 void MainWindow::simulate(const std::vector<double> &out_inputs)
 {
+    if (worker)
+        return;
     if (loop.size() == 0) {
         QMessageBox message_box{ QMessageBox::Icon::Warning, "Problem", "Loop has no components",
                                  QMessageBox::StandardButton::Close };
@@ -236,49 +362,228 @@ void MainWindow::simulate(const std::vector<double> &out_inputs)
         inputs = parse_coefficients(input_inputs->text());
         repetitions = input_repetitions->value();
     }
+    std::vector<double> new_inputs;
+    new_inputs.reserve(inputs.size() * repetitions);
     for (int i = 0; i < repetitions; ++i) {
-        for (const auto &input : inputs) {
-            const auto out = loop.symuluj(input);
-            real_outputs.push_back(out);
-        }
 #if __cpp_lib_containers_ranges >= 202202L
         // This works with libc++, but it does not currently implement the
         // __cpp_lib_containers_ranges macro; only __cpp_lib_ranges_to_container is defined, even
         // though P1206R7 is fully implemented
         // Should be fixed in LLVM 19: https://github.com/llvm/llvm-project/pull/90914
         // A workaroud is provided in define_fixes.hpp
-        given_inputs.append_range(inputs);
+        new_inputs.append_range(inputs);
 #else
-        given_inputs.insert(given_inputs.end(), inputs.begin(), inputs.end());
+        new_inputs.insert(new_inputs.end(), inputs.begin(), inputs.end());
 #endif
     }
-    plot_results();
+    // The worker simulates its own copy of the loop, which replaces #loop when it finishes.
+    auto worker_loop = std::make_unique<PętlaUAR>(PętlaUAR::with_arena(loop.dump()));
+    parameters = {};
+    if (const auto period = input_period->value(); period > 0) {
+        worker = std::make_unique<PacedSimulation>(std::move(worker_loop), std::move(new_inputs),
+                                                   std::chrono::microseconds{ period });
+    } else {
+        // Repeated inputs are mostly constant, so steady states are skipped
+        worker_loop->set_steady_skip(true);
+        worker = std::make_unique<SimulationWorker>(std::move(worker_loop), std::move(new_inputs));
+    }
+    set_simulation_running(true);
+}
+
+void MainWindow::poll_worker()
+{
+    if (!worker)
+        return;
+    // Check before polling, so that no results published before finishing are left
+    const bool finished = worker->finished();
+    while (auto batch = worker->poll()) {
+        results.append(batch->inputs, batch->outputs);
+        plot_results(batch->inputs, batch->outputs);
+    }
+    const auto total = std::max<std::size_t>(worker->total(), 1);
+    progress_simulation->setValue(
+        static_cast<int>(progress_simulation->maximum() * worker->progress() / total));
+    if (const auto paced = dynamic_cast<const PacedSimulation *>(worker.get())) {
+        const auto stats = paced->stats();
+        label_pacing->setText(QString::fromStdString(format_stats(stats)));
+        label_pacing->setStyleSheet(stats.misses > 0 ? "color: red" : "");
+    }
+    if (finished)
+        finish_simulation(true);
+}
+
+void MainWindow::finish_simulation(bool keep_state)
+{
+    if (!worker)
+        return;
+    timer_worker->stop();
+    std::unique_ptr<ObiektSISO> simulated;
+    if (keep_state) {
+        try {
+            simulated = worker->take_loop();
+        } catch (const std::exception &e) {
+            QMessageBox message_box{ QMessageBox::Icon::Warning, "Problem",
+                                     QString{ "Simulation failed: " } + e.what(),
+                                     QMessageBox::StandardButton::Close };
+            message_box.exec();
+        }
+    }
+    // Statistics of the last real-time simulation remain available after the progress is hidden
+    if (const auto paced = dynamic_cast<const PacedSimulation *>(worker.get()))
+        input_period->setToolTip(QString{ period_tooltip } + "\nLast run: "
+                                 + QString::fromStdString(format_stats(paced->stats())));
+    worker.reset();
+    set_simulation_running(false);
+    if (simulated == nullptr)
+        return;
+
+    // Replace the loop with the simulated one, which has the same structure and parameters
+    const auto selected = component_path(tree_view->selectionModel()->currentIndex());
+    replace_loop(std::move(dynamic_cast<PętlaUAR &>(*simulated)));
+    auto index = tree_model->index(0, 0);
+    for (const auto row : selected)
+        index = tree_model->index(static_cast<int>(row), 0, index);
+    tree_view->setCurrentIndex(index);
 }
 
-void MainWindow::plot_results()
+void MainWindow::set_simulation_running(bool running)
 {
-    const auto results_series = new QLineSeries{ plot };
-    const auto inputs_series = new QLineSeries{ plot };
-    assert(real_outputs.size() == given_inputs.size());
-    for (std::size_t i = 0; i < real_outputs.size(); ++i) {
-        results_series->append(static_cast<double>(i), real_outputs[i]);
-        inputs_series->append(static_cast<double>(i), given_inputs[i]);
+    button_simulate->setEnabled(!running);
+    if (panel_generators != nullptr)
+        panel_generators->setEnabled(!running);
+    for (const auto action : { action_open, action_save, action_save_checkpoint,
+                               action_export_model, action_export_results, action_import_model,
+                               action_reset_sim, action_reset_sim_gen })
+        action->setEnabled(!running);
+    update_tree_actions(tree_view->selectionModel()->currentIndex());
+    button_pause->setText("Pause");
+    widget_progress->setVisible(running);
+    if (running) {
+        progress_simulation->setValue(0);
+        label_pacing->clear();
+        label_pacing->setVisible(dynamic_cast<const PacedSimulation *>(worker.get()) != nullptr);
+        timer_worker->start();
     }
-    results_series->setName("Simulation results");
-    inputs_series->setName("Inputs");
-    plot->removeAllSeries();
-    plot->addSeries(results_series);
-    plot->addSeries(inputs_series);
-    plot->createDefaultAxes();
+}
+
+void MainWindow::toggle_pause()
+{
+    if (!worker)
+        return;
+    if (worker->paused()) {
+        worker->resume();
+        button_pause->setText("Pause");
+    } else {
+        worker->pause();
+        button_pause->setText("Resume");
+    }
+}
+
+std::vector<std::size_t> MainWindow::component_path(const QModelIndex &index) const
+{
+    std::vector<std::size_t> path;
+    for (auto i = index; i.isValid() && tree_model->parent(i).isValid(); i = tree_model->parent(i))
+        path.push_back(static_cast<std::size_t>(i.row()));
+    std::ranges::reverse(path);
+    return path;
+}
+
+void MainWindow::plot_results(std::span<const double> inputs, std::span<const double> outputs)
+{
+    pyramid_inputs.append(inputs);
+    pyramid_results.append(outputs);
+    if (plot_follow && axis_x != nullptr)
+        show_all_results();
+    schedule_plot_refresh();
+}
+
+void MainWindow::schedule_plot_refresh()
+{
+    if (plot_refresh_pending)
+        return;
+    plot_refresh_pending = true;
+    QTimer::singleShot(0, this, &MainWindow::refresh_plot);
+}
+
+void MainWindow::show_all_results()
+{
+    const auto first = static_cast<double>(results.first_available());
+    plot_updating = true;
+    axis_x->setRange(first, std::max(static_cast<double>(results.size()) - 1.0, first + 1.0));
+    plot_updating = false;
+}
+
+void MainWindow::refresh_plot()
+{
+    plot_refresh_pending = false;
+    if (plot == nullptr)
+        return;
+    const auto n = static_cast<double>(results.size());
+    const auto first = static_cast<std::size_t>(
+        std::clamp(std::floor(axis_x->min()), static_cast<double>(results.first_available()), n));
+    const auto last = static_cast<std::size_t>(std::clamp(std::ceil(axis_x->max()) + 1.0, 0.0, n));
+    if (first >= last) {
+        series_results->clear();
+        series_inputs->clear();
+        return;
+    }
+    // About 2 points (minimum and maximum of a bucket) per horizontal pixel
+    const auto width = static_cast<std::size_t>(std::max(plot->plotArea().width(), 1.0));
+    const auto visible = last - first;
+
+    double y_min = std::numeric_limits<double>::infinity();
+    double y_max = -std::numeric_limits<double>::infinity();
+    const auto to_points = [&](const std::vector<MinMaxBucket> &buckets) {
+        QList<QPointF> points;
+        points.reserve(static_cast<qsizetype>(buckets.size() * 2));
+        for (const auto &b : buckets) {
+            const auto x = static_cast<double>(b.first) + static_cast<double>(b.count - 1) / 2;
+            points.emplace_back(x, b.min);
+            if (b.count > 1)
+                points.emplace_back(x, b.max);
+            y_min = std::min(y_min, b.min);
+            y_max = std::max(y_max, b.max);
+        }
+        return points;
+    };
+
+    if (visible <= pyramid_results.base_bucket() * width && first >= results.first_available()) {
+        // Finer than the pyramid, summarize the samples directly
+        std::vector<double> inputs(visible), outputs(visible);
+        results.read(first, inputs, outputs);
+        const auto bucket
+            = visible <= 2 * width ? std::size_t{ 1 } : (visible + width - 1) / width;
+        series_results->replace(to_points(MinMaxPyramid::bucketize(outputs, first, bucket)));
+        series_inputs->replace(to_points(MinMaxPyramid::bucketize(inputs, first, bucket)));
+    } else {
+        series_results->replace(to_points(pyramid_results.query(first, last, width)));
+        series_inputs->replace(to_points(pyramid_inputs.query(first, last, width)));
+    }
+
+    if (y_min == y_max)
+        axis_y->setRange(y_min - 1.0, y_max + 1.0);
+    else
+        axis_y->setRange(y_min, y_max);
 }
 
 void MainWindow::reset_sim(bool incl_generators)
 {
-    if (incl_generators)
+    finish_simulation(false);
+    // A panel which wasn't created yet has nothing to reset
+    if (incl_generators && panel_generators != nullptr)
         panel_generators->reset_sim();
-    real_outputs.clear();
-    given_inputs.clear();
+    results.clear();
+    pyramid_results.clear();
+    pyramid_inputs.clear();
+    plot_follow = true;
+    if (plot != nullptr) {
+        series_results->clear();
+        series_inputs->clear();
+        show_all_results();
+    }
     loop.reset();
+    loop.reset_profile();
+    tree_view->viewport()->update();
     refresh_editor();
 }
 
@@ -300,18 +605,7 @@ void MainWindow::simulate_gen(std::vector<double> inputs)
     simulate(inputs);
 }
 
-std::pair<std::unique_ptr<uint8_t[]>, std::size_t>
-MainWindow::read_file(const std::filesystem::path &path)
-{
-    std::ifstream in{ path, std::ios::binary };
-    in.seekg(0, std::ios::end);
-    const auto file_size = in.tellg();
-    in.seekg(0, std::ios::beg);
-    auto buff = std::make_unique_for_overwrite<uint8_t[]>(static_cast<std::size_t>(file_size));
-    in.read(reinterpret_cast<char *>(buff.get()), file_size);
-    in.close();
-    return { std::move(buff), file_size };
-}
+MappedFile MainWindow::read_file(const std::filesystem::path &path) { return MappedFile{ path }; }
 
 void MainWindow::write_file(const std::filesystem::path &path, const std::vector<uint8_t> &data)
 {
@@ -322,6 +616,7 @@ void MainWindow::write_file(const std::filesystem::path &path, const std::vector
 
 void MainWindow::replace_loop(PętlaUAR &&l)
 {
+    finish_simulation(false);
     tree_model->begin_reset();
     loop = std::move(l);
     tree_model->end_reset();
@@ -330,35 +625,39 @@ void MainWindow::replace_loop(PętlaUAR &&l)
 
 void MainWindow::open_file()
 {
-    QString filter{ "All supported files (*.pocf *.lmod *.gens)" };
+    QString filter{ "All supported files (*.pocf *.lmod *.gens *.pock)" };
     const auto filename = QFileDialog::getOpenFileName(
         this, "Select file", QDir::currentPath(),
-        "POlabs config file (*.pocf);; Loop model (*.lmod);;Generators (*.gens);;All supported "
-        "files (*.pocf *.lmod *.gens)",
+        "POlabs config file (*.pocf);; Loop model (*.lmod);;Generators (*.gens);;POlabs "
+        "checkpoint (*.pock);;All supported files (*.pocf *.lmod *.gens *.pock)",
         &filter);
     if (filename.isEmpty())
         return;
     const fs::path path{ filename.toStdU16String() };
     const auto ext = path.extension();
+    if (ext == ".pock") {
+        restore_checkpoint(path);
+        return;
+    }
     if (ext != ".pocf" && ext != ".lmod" && ext != ".gens")
         return;
-    const auto [buff, file_size] = read_file(path);
+    // Objects are deserialized directly from the mapped file
+    const auto file = read_file(path);
+    const auto data = file.bytes();
     if (ext == ".pocf") {
-        const std::size_t loop_size = sizeof(uint32_t) + *reinterpret_cast<uint32_t *>(buff.get());
-        if (loop_size > file_size)
+        if (data.size() < sizeof(uint32_t))
             return;
-        PętlaUAR imported_loop{ std::span(buff.get(), loop_size) };
-        const std::size_t gen_size = file_size - loop_size;
-        if (gen_size) {
-            auto imported_gens
-                = Generator::deserialize(std::span(buff.get() + loop_size, gen_size));
-            panel_generators->import(std::move(imported_gens));
-        }
+        const std::size_t loop_size = sizeof(uint32_t) + from_byte_range<uint32_t>(data);
+        if (loop_size > data.size())
+            return;
+        auto imported_loop = PętlaUAR::with_arena(data.first(loop_size));
+        if (data.size() > loop_size)
+            generators()->import(data.subspan(loop_size));
         replace_loop(std::move(imported_loop));
     } else if (ext == ".lmod") {
-        replace_loop(PętlaUAR{ std::span(buff.get(), file_size) });
+        replace_loop(PętlaUAR::with_arena(data));
     } else if (ext == ".gens") {
-        panel_generators->import(std::span(buff.get(), file_size));
+        generators()->import(data);
     } else {
         Q_ASSERT(false);
     }
@@ -377,10 +676,52 @@ void MainWindow::save_full_config()
     if (ext != ".pocf")
         path.replace_extension(".pocf");
 
-    const auto dump = concat_iterables(loop.dump(), panel_generators->dump());
+    // The loop is serialized directly into the file buffer, followed by the generators
+    const auto generators_dump = generators()->dump();
+    std::vector<uint8_t> dump(loop.dump_size() + generators_dump.size());
+    std::ranges::copy(generators_dump, loop.dump_to(dump).begin());
     write_file(path, dump);
 }
 
+void MainWindow::save_checkpoint()
+{
+    QString filter{ "POlabs checkpoint (*.pock)" };
+    const auto filename = QFileDialog::getSaveFileName(this, "Choose a filename to save to",
+                                                       QDir::currentPath(), filter, &filter)
+                              .toStdU16String();
+    if (filename.empty())
+        return;
+    fs::path path{ filename };
+    if (path.extension() != ".pock")
+        path.replace_extension(".pock");
+
+    write_checkpoint(path, loop, generators()->dump(), generators()->get_simulation_time(),
+                     results);
+}
+
+void MainWindow::restore_checkpoint(const std::filesystem::path &path)
+{
+    // Opening the checkpoint only maps the file and reads its header
+    const auto checkpoint = std::make_shared<const Checkpoint>(path);
+    auto restored_loop = PętlaUAR::with_arena(checkpoint->loop_dump());
+    auto restored_generators = checkpoint->generators_dump().empty()
+        ? nullptr
+        : Generator::deserialize(checkpoint->generators_dump());
+
+    reset_sim(true);
+    replace_loop(std::move(restored_loop));
+    if (restored_generators) {
+        generators()->import(std::move(restored_generators));
+        generators()->set_simulation_time(static_cast<int>(checkpoint->generator_time()));
+    }
+    last_source = checkpoint->generator_time() > 0 ? sources::GENERATOR : sources::MANUAL;
+    // A history without its beginning is plotted from its first sample
+    Checkpoint::restore_results(checkpoint, results);
+    pyramid_results.clear(static_cast<std::size_t>(checkpoint->first_result()));
+    pyramid_inputs.clear(static_cast<std::size_t>(checkpoint->first_result()));
+    plot_results(checkpoint->inputs(), checkpoint->outputs());
+}
+
 void MainWindow::export_model()
 {
     QString filter{ "Loop model (*.lmod)" };
@@ -399,7 +740,7 @@ void MainWindow::export_model()
 
 void MainWindow::export_generators()
 {
-    if (panel_generators->empty()) {
+    if (generators()->empty()) {
         QMessageBox message_box{ QMessageBox::Icon::Warning, "Problem",
                                  "There are no generators configured.",
                                  QMessageBox::StandardButton::Close };
@@ -417,7 +758,55 @@ void MainWindow::export_generators()
     if (ext != ".gens")
         path.replace_extension(".gens");
 
-    write_file(path, panel_generators->dump());
+    write_file(path, generators()->dump());
+}
+
+void MainWindow::export_results()
+{
+    const QString columnar_filter{ "Columnar results (*.pors)" };
+    QString filter{ columnar_filter };
+    const auto filename
+        = QFileDialog::getSaveFileName(this, "Choose a filename to export to", QDir::currentPath(),
+                                       columnar_filter + ";;CSV (*.csv)", &filter)
+              .toStdU16String();
+    if (filename.empty())
+        return;
+    fs::path path{ filename };
+    const bool columnar = filter == columnar_filter;
+    const auto ext = path.extension();
+    if (ext != (columnar ? ".pors" : ".csv"))
+        path.replace_extension(columnar ? ".pors" : ".csv");
+
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file{ open_for_writing(path),
+                                                             &std::fclose };
+    try {
+        if (!file)
+            throw std::runtime_error{ "Could not open the output file" };
+        const auto first = results.first_available();
+        std::unique_ptr<ResultExporter> writer;
+        if (columnar)
+            writer = std::make_unique<ColumnarResultWriter>(file.get(), first, 1.0,
+                                                            dump_hash(loop.dump()));
+        else
+            writer = std::make_unique<CsvResultWriter>(file.get(), first);
+        // Results are copied one chunk at a time, spilled ones are read from the disk
+        const auto block = results.chunk_size();
+        std::vector<double> inputs(block), outputs(block);
+        for (std::size_t done = first; done < results.size(); done += block) {
+            const auto n = std::min(block, results.size() - done);
+            const auto block_in = std::span{ inputs }.first(n);
+            const auto block_out = std::span{ outputs }.first(n);
+            results.read(done, block_in, block_out);
+            writer->add(block_in, block_out);
+        }
+        writer->finish();
+    } catch (const std::exception &e) {
+        // Exceptions must not escape from a slot
+        QMessageBox message_box{ QMessageBox::Icon::Warning, "Problem",
+                                 QString{ "Could not export the results: " } + e.what(),
+                                 QMessageBox::StandardButton::Close };
+        message_box.exec();
+    }
 }
 
 void MainWindow::import_model()
@@ -426,8 +815,7 @@ void MainWindow::import_model()
                                                        QDir::currentPath(), "Loop model (*.lmod)");
     if (filename.isEmpty())
         return;
-    const auto [buff, file_size] = read_file(filename.toStdU16String());
-    replace_loop(PętlaUAR{ std::span(buff.get(), file_size) });
+    replace_loop(PętlaUAR::with_arena(read_file(filename.toStdU16String()).bytes()));
 }
 
 void MainWindow::import_generators()
@@ -436,8 +824,7 @@ void MainWindow::import_generators()
                                                        QDir::currentPath(), "Generators (*.gens)");
     if (filename.isEmpty())
         return;
-    const auto [buff, file_size] = read_file(filename.toStdU16String());
-    panel_generators->import(std::span(buff.get(), file_size));
+    generators()->import(read_file(filename.toStdU16String()).bytes());
 }
 
 void MainWindow::remove_component()
@@ -461,25 +848,20 @@ void MainWindow::remove_component()
 void MainWindow::change_active_editor(const QModelIndex &index)
 {
     if (!index.isValid()) {
-        layout_param_editors->setCurrentIndex(0);
+        layout_param_editors->setCurrentWidget(editor_nothing);
         return;
     }
     auto ptr = static_cast<ObiektSISO *>(index.internalPointer());
-    if (auto p = dynamic_cast<RegulatorPID *>(ptr)) {
-        editor_pid->update_from(*p);
-        layout_param_editors->setCurrentIndex(1);
-    } else if (auto p = dynamic_cast<ObiektStatyczny *>(ptr)) {
-        editor_static->update_from(*p);
-        layout_param_editors->setCurrentIndex(2);
-    } else if (auto p = dynamic_cast<ModelARX *>(ptr)) {
-        editor_arx->update_from(*p);
-        layout_param_editors->setCurrentIndex(3);
-    } else if (auto p = dynamic_cast<PętlaUAR *>(ptr)) {
-        editor_uar->update_from(*p);
-        layout_param_editors->setCurrentIndex(4);
-    } else {
-        layout_param_editors->setCurrentIndex(0);
-    }
+    if (auto p = dynamic_cast<RegulatorPID *>(ptr))
+        show_editor(editor_pid)->update_from(*p);
+    else if (auto p = dynamic_cast<ObiektStatyczny *>(ptr))
+        show_editor(editor_static)->update_from(*p);
+    else if (auto p = dynamic_cast<ModelARX *>(ptr))
+        show_editor(editor_arx)->update_from(*p);
+    else if (auto p = dynamic_cast<PętlaUAR *>(ptr))
+        show_editor(editor_uar)->update_from(*p);
+    else
+        layout_param_editors->setCurrentWidget(editor_nothing);
 }
 
 void MainWindow::refresh_editor()
@@ -489,7 +871,8 @@ void MainWindow::refresh_editor()
 
 void MainWindow::update_tree_actions(const QModelIndex &index)
 {
-    if (!index.isValid()) {
+    // The structure of the loop can't change while the worker simulates its copy
+    if (!index.isValid() || worker) {
         submenu_append_child->setEnabled(false);
         submenu_insert_component->setEnabled(false);
         action_remove_component->setEnabled(false);
@@ -508,6 +891,7 @@ void MainWindow::on_tree_selection_change()
     update_tree_actions(idx);
     change_active_editor(idx);
     button_save_params->setEnabled(idx.isValid());
+    button_autotune->setVisible(layout_param_editors->currentWidget() == editor_pid);
 }
 
 void MainWindow::save_params()
@@ -516,16 +900,70 @@ void MainWindow::save_params()
     if (!sel_idx.isValid())
         return;
     const auto ptr = static_cast<ObiektSISO *>(sel_idx.internalPointer());
-    const auto editor_idx = layout_param_editors->currentIndex();
-    if (editor_idx == 1) {
+    // Editors which weren't created yet can't be shown
+    const auto editor = layout_param_editors->currentWidget();
+    if (editor == editor_pid) {
         update_from_editor<RegulatorPID>(editor_pid, ptr);
-    } else if (editor_idx == 2) {
+    } else if (editor == editor_static) {
         update_from_editor<ObiektStatyczny>(editor_static, ptr);
-    } else if (editor_idx == 3) {
+    } else if (editor == editor_arx) {
         update_from_editor<ModelARX>(editor_arx, ptr);
-    } else if (editor_idx == 4) {
+    } else if (editor == editor_uar) {
         update_from_editor<PętlaUAR>(editor_uar, ptr);
     }
+    // Publish the same parameters to the worker's copy, applied between simulation blocks
+    if (worker) {
+        parameters = parameters.with(component_path(sel_idx), capture_parameters(*ptr));
+        worker->publish_parameters(parameters);
+    }
+}
+
+void MainWindow::autotune()
+{
+    const auto sel_idx = tree_view->selectionModel()->currentIndex();
+    if (tuning.valid() || !sel_idx.isValid())
+        return;
+    // The copy starts from the reset state, so the tuning doesn't depend on previous simulations
+    const auto copy = ObiektSISO::deserialize(loop.dump());
+    copy->reset();
+    tuning_path = component_path(sel_idx);
+    tuning = std::async(std::launch::async, [dump = copy->dump(), path = tuning_path]() {
+        return tune_pid(dump, path, std::vector<double>(autotune_steps, 1.0));
+    });
+    button_autotune->setEnabled(false);
+    button_autotune->setText("Tuning...");
+    timer_tuning->start();
+}
+
+void MainWindow::poll_tuning()
+{
+    using namespace std::chrono_literals;
+    if (tuning.wait_for(0s) != std::future_status::ready)
+        return;
+    timer_tuning->stop();
+    button_autotune->setEnabled(true);
+    button_autotune->setText("Autotune");
+    QString problem;
+    try {
+        const auto result = tuning.get();
+        if (!std::isfinite(result.cost))
+            problem = "No stable parameters were found";
+        else if (component_path(tree_view->selectionModel()->currentIndex()) != tuning_path
+                 || layout_param_editors->currentWidget() != editor_pid)
+            problem = QString::fromStdString(
+                std::format("The tuned regulator is no longer selected, its parameters are k={}, "
+                            "Ti={}, Td={}",
+                            result.pid.k, result.pid.ti, result.pid.td));
+        else
+            editor_pid->update_from(RegulatorPID{ result.pid.k, result.pid.ti, result.pid.td });
+    } catch (const std::exception &e) {
+        problem = QString{ "Tuning failed: " } + e.what();
+    }
+    if (!problem.isEmpty()) {
+        QMessageBox message_box{ QMessageBox::Icon::Warning, "Problem", problem,
+                                 QMessageBox::StandardButton::Close };
+        message_box.exec();
+    }
 }
 
 void MainWindow::start()
@@ -533,4 +971,6 @@ void MainWindow::start()
     setup_ui();
     setWindowTitle("PO lab 2");
     show();
+    // The chart is the most expensive widget, build it once the window is on screen
+    QTimer::singleShot(0, this, &MainWindow::create_chart);
 }
@@ -2,7 +2,15 @@
 #include "../ModelARX.h"
 #include "../PętlaUAR.hpp"
 #include "../RegulatorPID.h"
+#include "../checkpoint.hpp"
 #include "../generators.hpp"
+#include "../mapped_file.hpp"
+#include "../minmax_pyramid.hpp"
+#include "../paced_sim.hpp"
+#include "../pid_tuner.hpp"
+#include "../result_export.hpp"
+#include "../result_store.hpp"
+#include "../sim_worker.hpp"
 #include "GeneratorsConfig.hpp"
 #include "TreeModel.hpp"
 #include "param_editors.hpp"
@@ -11,19 +19,27 @@
 #include <QChartView>
 #include <QDoubleSpinBox>
 #include <QGridLayout>
+#include <QLabel>
 #include <QLineEdit>
+#include <QLineSeries>
 #include <QMainWindow>
 #include <QMenu>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QSessionManager>
 #include <QSpinBox>
 #include <QSplitter>
 #include <QStackedLayout>
 #include <QTabWidget>
+#include <QTimer>
 #include <QTreeView>
 #include <QVBoxLayout>
+#include <QValueAxis>
 #include <filesystem>
+#include <future>
+#include <limits>
 #include <optional>
+#include <span>
 #include <vector>
 
 #ifdef IE_TESTS
@@ -47,10 +63,14 @@ private:
     QAction *action_open;
     /// @e Save action in the @link #menu_file @e File menu@endlink
     QAction *action_save;
+    /// _Save checkpoint_ action in the @link #menu_file @e File menu@endlink
+    QAction *action_save_checkpoint;
     /// _Export loop model_ action in the @link #submenu_export @e Export submenu@endlink
     QAction *action_export_model;
     /// _Export generators_ action in the @link #submenu_export @e Export submenu@endlink
     QAction *action_export_generators;
+    /// _Export simulation results_ action in the @link #submenu_export @e Export submenu@endlink
+    QAction *action_export_results;
     /// _Import loop model_ action in the @link #submenu_import @e Import submenu@endlink
     QAction *action_import_model;
     /// _Import generators_ action in the @link #submenu_import @e Import submenu@endlink
@@ -92,18 +112,40 @@ private:
     /// Widget with manual simualtion inputs
     QWidget *widget_inputs;
     /// @brief Tabbed widget with different simulation options - manual (#widget_inputs) and
-    /// generators (#panel_generators)
+    /// generators (#widget_generators)
     QTabWidget *tabs_input;
+    /// Tab of #tabs_input holding #panel_generators once it's created
+    QWidget *widget_generators;
     /// Splitter between left (#widget_components) and right (#widget_right) part of the window
     QSplitter *main_columns_splitter;
     /// Layout of the #widget_components widget
     QVBoxLayout *layout_components;
     /// Layout of the #widget_right widget
     QVBoxLayout *layout_right_col;
-    /// Chart with simulation results
-    QChart *plot;
+    /// Chart with simulation results, `nullptr` until create_chart()
+    QChart *plot{};
     /// Widget rendering the #plot
-    QChartView *chart_view;
+    QChartView *chart_view{};
+    /// Plotted simulation outputs
+    QLineSeries *series_results{};
+    /// Plotted simulation inputs
+    QLineSeries *series_inputs{};
+    /// Horizontal (time) axis of the #plot
+    QValueAxis *axis_x{};
+    /// Vertical (value) axis of the #plot
+    QValueAxis *axis_y{};
+    /// Widget with background simulation progress and controls
+    QWidget *widget_progress;
+    /// Progress of the background simulation
+    QProgressBar *progress_simulation;
+    /// _Pause_/_Resume_ button of the background simulation
+    QPushButton *button_pause;
+    /// _Cancel_ button of the background simulation
+    QPushButton *button_cancel;
+    /// Deadline misses and jitter of a real-time simulation
+    QLabel *label_pacing;
+    /// Timer polling the #worker for results
+    QTimer *timer_worker;
     /// Tree model of the #loop
     TreeModel *tree_model;
     /// Tree view of the #tree_model showing all components
@@ -112,16 +154,21 @@ private:
     QStackedLayout *layout_param_editors;
     /// Empty widget to show in #layout_param_editors when nothing is selected in #tree_view
     QWidget *editor_nothing;
-    /// Editor for RegulatorPID components shown in #layout_param_editors
-    PIDParams *editor_pid;
+    /// @brief Editor for RegulatorPID components shown in #layout_param_editors
+    /// @details This and the other editors are `nullptr` until first shown, see show_editor().
+    PIDParams *editor_pid{};
     /// Editor for ObiektStatyczny components shown in #layout_param_editors
-    ObiektStatycznyParams *editor_static;
+    ObiektStatycznyParams *editor_static{};
     /// Editor for ModelARX components shown in #layout_param_editors
-    ARXParams *editor_arx;
+    ARXParams *editor_arx{};
     /// Editor for PętlaUAR components shown in #layout_param_editors
-    UARParams *editor_uar;
+    UARParams *editor_uar{};
     /// _Save changes_ button shown in #layout_components to save editor changes
     QPushButton *button_save_params;
+    /// _Autotune_ button shown in #layout_components when a RegulatorPID is selected
+    QPushButton *button_autotune;
+    /// Timer polling the #tuning for its result
+    QTimer *timer_tuning;
     /// Layout of the #widget_inputs widget
     QGridLayout *layout_inputs;
     /// @brief Text input accepting a comma separated list of numbers to use as manual input shown
@@ -129,17 +176,36 @@ private:
     QLineEdit *input_inputs;
     /// Spinbox with number of repetitions of input from #input_inputs for manual simulation
     QSpinBox *input_repetitions;
+    /// Spinbox with the sample period of real-time simulation in microseconds, 0 to simulate as
+    /// fast as possible
+    QSpinBox *input_period;
     /// @e Simulate button for manual simulation
     QPushButton *button_simulate;
-    /// Widget with generator configuration and simulation
-    GeneratorsConfig *panel_generators;
+    /// Widget with generator configuration and simulation, `nullptr` until generators()
+    GeneratorsConfig *panel_generators{};
 
     /// The main control loop
     PętlaUAR loop{};
-    /// Simulation outputs
-    std::vector<double> real_outputs;
-    /// simulation inputs
-    std::vector<double> given_inputs;
+    /// Background simulation, `nullptr` if none is running
+    std::unique_ptr<BackgroundSimulation> worker;
+    /// Parameters edited during the current simulation, published to the #worker
+    ParameterSnapshot parameters;
+    /// Background tuning of a RegulatorPID, invalid if none is running
+    std::future<TuneResult> tuning;
+    /// Path of the tuned RegulatorPID, see component_path()
+    std::vector<std::size_t> tuning_path;
+    /// Simulation inputs and outputs
+    ResultStore results;
+    /// Min/max summaries of the simulation outputs from #results
+    MinMaxPyramid pyramid_results;
+    /// Min/max summaries of the simulation inputs from #results
+    MinMaxPyramid pyramid_inputs;
+    /// Whether the plot shows all results and should be extended with new ones
+    bool plot_follow{ true };
+    /// Set while the plot range is changed by the application rather than by the user
+    bool plot_updating{ false };
+    /// Whether #refresh_plot() is already scheduled
+    bool plot_refresh_pending{ false };
     /// Source of simulation
     enum class sources {
         MANUAL, ///< Manual inputs
@@ -154,15 +220,74 @@ private:
     void prepare_menu_bar();
     /// Prepare main window layout and connect signals
     void prepare_layout();
+    /// @brief Create the #plot and #chart_view
+    /// @details Called after the window is shown, so building the chart doesn't delay the first
+    /// frame. Does nothing if the chart already exists.
+    void create_chart();
+    /// @brief Get #panel_generators, creating it on first use
+    /// @return The generators panel.
+    GeneratorsConfig *generators();
+    /// @brief Show a parameter editor in #layout_param_editors, creating it on first use
+    /// @tparam E type of the editor
+    /// @param editor one of the editor members
+    /// @return The shown editor.
+    template <typename E>
+    E *show_editor(E *&editor)
+    {
+        if (editor == nullptr) {
+            editor = new E{ widget_components };
+            layout_param_editors->addWidget(editor);
+        }
+        layout_param_editors->setCurrentWidget(editor);
+        return editor;
+    }
     /// @brief Parse a comma-delimited string of decimal numbers
     /// @param coeff_text string with comma-separated decimal numbers
     /// @return A vector of parsed coefficients.
     std::vector<double> parse_coefficients(const QString &coeff_text);
-    /// @brief Perform simulation using provided or manual inputs
+    /// @brief Start a background simulation using provided or manual inputs
+    /// @details Does nothing if a simulation is already running.
     /// @param out_inputs inputs to evaluate, manual input is used if vector is empty
     void simulate(const std::vector<double> &out_inputs);
-    /// Update the plot with simulation results based on #real_outputs and #given_inputs
-    void plot_results();
+    /// Collect results from the #worker, update progress and finish the simulation when done
+    void poll_worker();
+    /// @brief Stop the background simulation, if any
+    /// @param keep_state whether the #loop should be replaced with the simulated one, otherwise the
+    /// simulation is cancelled and discarded
+    void finish_simulation(bool keep_state);
+    /// @brief Enable or disable the UI, which must not be used during a background simulation
+    /// @param running whether a simulation is running
+    void set_simulation_running(bool running);
+    /// Pause or resume the background simulation
+    void toggle_pause();
+    /// @brief Get the path of a component (see find_component()) in #tree_model
+    /// @param index index of the component
+    /// @return Rows of consecutive nested loops' elements, empty for the root loop.
+    std::vector<std::size_t> component_path(const QModelIndex &index) const;
+    /// @brief Add new simulation results to the plot summaries and schedule a plot refresh.
+    /// @details The visible range is extended to the new results if #plot_follow is set.
+    /// @param inputs new simulation inputs
+    /// @param outputs new simulation outputs
+    void plot_results(std::span<const double> inputs, std::span<const double> outputs);
+    /// Call #refresh_plot() from the event loop, once for any number of changes
+    void schedule_plot_refresh();
+    /// @brief Replace the plotted series with points of the visible range.
+    ///
+    /// Visible samples are summarized in buckets, so that there are about 2 points (the minimum
+    /// and the maximum of a bucket) per horizontal pixel. Short ranges are summarized directly from
+    /// #results, longer ones use the pyramids, so the cost does not depend on the number of
+    /// results. Long ranges of samples which are no longer in memory are shown with a coarser
+    /// level of the pyramids.
+    void refresh_plot();
+    /// Set the range of #axis_x to all available samples of #results
+    void show_all_results();
+    /// @brief Tune the selected RegulatorPID in the background, see tune_pid()
+    /// @details The regulator is tuned for a unit step, starting from the reset state of the
+    /// #loop. The result is shown in #editor_pid and applied by _Save changes_, so it can be
+    /// reviewed first.
+    void autotune();
+    /// Show the result of the #tuning when it is ready
+    void poll_tuning();
     /// @brief Clear saved inputs and outputs, call PętlaUAR::reset()
     /// @param incl_generators whether generators simulation time should be reset too using
     /// (GeneratorsConfig::reset_sim())
@@ -178,11 +303,10 @@ private:
     /// @param inputs simulation input sequence received from generator
     void simulate_gen(std::vector<double> inputs);
 
-    /// @brief Read whole file into memory
+    /// @brief Map a file into memory
     /// @param path file path
-    /// @return A pair with a pointer to the file data and the file size
-    static std::pair<std::unique_ptr<uint8_t[]>, std::size_t>
-    read_file(const std::filesystem::path &path);
+    /// @return The mapped file, its pages are read on first access
+    static MappedFile read_file(const std::filesystem::path &path);
     /// @brief Write bytes to file
     /// @param path file path
     /// @param data data to write
@@ -194,10 +318,18 @@ private:
     void open_file();
     /// Save full config (loop and generators) into a single file
     void save_full_config();
+    /// Save a checkpoint with the loop, generators and simulation results
+    void save_checkpoint();
+    /// @brief Restore the loop, generators and simulation results from a checkpoint
+    /// @details The result history is referenced in the mapped file, not copied into memory.
+    /// @param path path of the checkpoint file
+    void restore_checkpoint(const std::filesystem::path &path);
     /// Export the loop model to file
     void export_model();
     /// Export generators to file
     void export_generators();
+    /// Export the available simulation results to a columnar (`.pors`) or CSV file
+    void export_results();
     /// Import the loop model from file
     void import_model();
     /// Import generators from file
@@ -264,10 +396,7 @@ private:
 public:
     /// @brief Construct main window with given parent and flags
     /// @see QMainWindow::QMainWindow()
-    explicit MainWindow(QWidget *parent = nullptr, Qt::WindowFlags flags = Qt::WindowFlags())
-        : QMainWindow{ parent, flags }
-    {
-    }
+    explicit MainWindow(QWidget *parent = nullptr, Qt::WindowFlags flags = Qt::WindowFlags());
     /// @brief Initialize and show the window
     void start();
 
@@ -2,6 +2,7 @@
 #include "../ModelARX.h"
 #include "../ObiektStatyczny.hpp"
 #include "../RegulatorPID.h"
+#include <format>
 #include <optional>
 
 #define _RET_QSTRING_IF_CAST_OK(T, ptr)                                                            \
@@ -29,25 +30,52 @@ TreeModel::TreeModel(PętlaUAR *root_loop, QObject *parent)
 {
 }
 
+QString TreeModel::profile_text(const QModelIndex &index) const
+{
+    const auto parent_idx = parent(index);
+    if (!parent_idx.isValid())
+        return {};
+    const auto parent_loop
+        = dynamic_cast<PętlaUAR *>(static_cast<ObiektSISO *>(parent_idx.internalPointer()));
+    if (parent_loop == nullptr)
+        return {};
+    const auto profile = parent_loop->profile();
+    const auto row = static_cast<std::size_t>(index.row());
+    if (row >= profile.size() || profile[row].calls == 0)
+        return {};
+    const auto &p = profile[row];
+    const auto ns = static_cast<double>(p.time.count());
+    return QString::fromStdString(
+        std::format("{:.3f} ms, {:.1f} ns/sample, {} calls, {} allocations", ns / 1e6,
+                    p.samples ? ns / static_cast<double>(p.samples) : 0.0, p.calls, p.allocations));
+}
+
 QVariant TreeModel::data(const QModelIndex &index, int role) const
 {
     if (role == Qt::DisplayRole) {
         if (!index.isValid() || index.internalPointer() == nullptr)
             return {};
+        if (index.column() == 1)
+            return profile_text(index);
 
         auto raw_ptr = static_cast<ObiektSISO *>(index.internalPointer());
         _RET_QSTRING_IF_CAST_OK(PętlaUAR, raw_ptr);
         _RET_QSTRING_IF_CAST_OK(ModelARX, raw_ptr);
         _RET_QSTRING_IF_CAST_OK(RegulatorPID, raw_ptr);
         _RET_QSTRING_IF_CAST_OK(ObiektStatyczny, raw_ptr);
+        _RET_QSTRING_IF_CAST_OK(LoopGraph, raw_ptr);
     }
     return {};
 }
 
 QVariant TreeModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    if (role == Qt::DisplayRole && orientation == Qt::Orientation::Horizontal && section == 0)
+    if (role != Qt::DisplayRole || orientation != Qt::Orientation::Horizontal)
+        return {};
+    if (section == 0)
         return QString("Component");
+    if (section == 1)
+        return QString("Profile");
     return {};
 }
 
@@ -88,7 +116,7 @@ int TreeModel::rowCount(const QModelIndex &parent) const
     return as_loop != nullptr ? as_loop->size() : 0;
 }
 
-int TreeModel::columnCount(const QModelIndex &) const { return 1; }
+int TreeModel::columnCount(const QModelIndex &) const { return profiling_enabled ? 2 : 1; }
 
 bool TreeModel::insertChild(const QModelIndex &parent, int position,
                             std::unique_ptr<ObiektSISO> &&component)
@@ -101,17 +129,12 @@ bool TreeModel::insertChild(const QModelIndex &parent, int position,
     if (parent_loop == nullptr)
         return false;
 
-    auto &vec = parent_loop->m_loop;
-    if (static_cast<std::size_t>(position) > vec.size())
+    if (static_cast<std::size_t>(position) > parent_loop->size())
         return false;
 
+    // Inserted components stay on the heap, so replacing them doesn't grow the loop's arena
     beginInsertRows(parent, position, position);
-    if (static_cast<std::size_t>(position) == vec.size()) {
-        vec.push_back(std::move(component));
-    } else {
-        auto insert_it = std::next(vec.cbegin(), position);
-        vec.insert(insert_it, std::move(component));
-    }
+    parent_loop->insert(static_cast<std::size_t>(position), std::move(component));
     endInsertRows();
     return true;
 }
@@ -136,13 +159,11 @@ bool TreeModel::removeRow(const QModelIndex &parent, int position)
     if (parent_loop == nullptr)
         return false;
 
-    auto &vec = parent_loop->m_loop;
-    if (static_cast<std::size_t>(position) >= vec.size())
+    if (static_cast<std::size_t>(position) >= parent_loop->size())
         return false;
 
     beginRemoveRows(parent, position, position);
-    auto erase_it = std::next(vec.cbegin(), position);
-    vec.erase(erase_it);
+    parent_loop->erase(static_cast<std::size_t>(position));
     endRemoveRows();
     return true;
 }
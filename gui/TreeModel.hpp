@@ -19,6 +19,10 @@ private:
     /// @param loop_row row of `loop` in its parent
     /// @return A QModelIndex of `ptr`'s parent or a `std::nullopt` if not found.
     std::optional<QModelIndex> find_idx(PętlaUAR *loop, ObiektSISO *ptr, int loop_row) const;
+    /// @brief Format the profile of a component (see PętlaUAR::profile()).
+    /// @param index index of the component
+    /// @return Profile summary, empty if there is no profile of the component.
+    QString profile_text(const QModelIndex &index) const;
 
 public:
     Q_DISABLE_COPY_MOVE(TreeModel)
@@ -32,10 +36,10 @@ public:
     TreeModel(PętlaUAR *root_loop, QObject *parent = nullptr);
     ~TreeModel() override = default;
 
-    /// @brief Returns the name of component with given index.
+    /// @brief Returns the name of component with given index or its profile in the second column.
     /// @param index index of the element
     /// @param role role, data returned only for Qt::DisplayRole
-    /// @return Component name or nothing
+    /// @return Component name, profile summary or nothing
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     /// @brief Returns the data for the given `role` and `section` in the header with the specified
     /// orientation.
@@ -58,7 +62,8 @@ public:
 
     /// Get child row count of `parent`.
     int rowCount(const QModelIndex &parent = {}) const override;
-    /// Get column count (of `parent`). Always returns `1`.
+    /// Get column count (of `parent`). Returns `2` (with the profile column) if profiling is
+    /// compiled in (see profiling.hpp), otherwise `1`.
     int columnCount(const QModelIndex &parent = {}) const override;
 
     /// @brief Insert component as a child of parent at given position.
@@ -141,7 +141,7 @@ std::vector<double> ARXParams::parse_coefficients(const QString &coeff_text)
     return coefficients;
 }
 
-QString ARXParams::coeff_string(const std::vector<double> &coeff)
+QString ARXParams::coeff_string(std::span<const double> coeff)
 {
     QStringList list;
     for (const auto param : coeff) {
@@ -15,6 +15,7 @@
 #include <QSpinBox>
 #include <QVBoxLayout>
 #include <QWidget>
+#include <span>
 
 /// @brief Concept describing parameter editor widgets.
 /// @tparam E type of the editor widget
@@ -138,7 +139,7 @@ private:
     /// @brief Format a vector of doubles into human-readable, comma-delimited string.
     /// @param coeff vector of coefficients to represent as a string
     /// @return A human-readable string that can be parsed by #parse_coefficients().
-    static QString coeff_string(const std::vector<double> &coeff);
+    static QString coeff_string(std::span<const double> coeff);
 
 public:
     /// Type of object which can be edited.
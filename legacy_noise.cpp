@@ -0,0 +1,53 @@
+#include "legacy_noise.hpp"
+
+LegacyNoise::LegacyNoise(std::uint64_t seed, std::uint64_t n_generated, double mean, double stddev)
+    : m_state{ std::make_unique<State>() }
+{
+    restart(seed);
+    for (std::uint64_t i = 0; i < n_generated; ++i)
+        (*this)(mean, stddev);
+}
+
+void LegacyNoise::restart(std::uint64_t seed)
+{
+    m_state->engine.seed(seed);
+    m_state->distribution.reset();
+}
+
+bool operator==(const LegacyNoise &a, const LegacyNoise &b)
+{
+    if (a.m_state == nullptr || b.m_state == nullptr)
+        return a.m_state == b.m_state;
+    return a.m_state->engine == b.m_state->engine
+        && a.m_state->distribution == b.m_state->distribution;
+}
+
+#ifdef LAB_TESTS
+#include "util.hpp"
+#include <vector>
+
+void LegacyNoiseTests::test_replay()
+{
+    it_should_not_throw("LegacyNoise continues the replayed stream", []() {
+        // The stream as drawn by the first ModelARX implementation
+        std::mt19937_64 engine{ 1234 };
+        std::normal_distribution<double> distribution{ 0.0, 0.5 };
+        std::vector<double> expected(40);
+        for (auto &e : expected)
+            e = distribution(engine);
+
+        LegacyNoise restored{ 1234, 25, 0.0, 0.5 };
+        LegacyNoise copy{ restored };
+        for (std::size_t i = 25; i < expected.size(); ++i)
+            if (restored(0.0, 0.5) != expected[i])
+                throw std::runtime_error{ "Restored stream differs" };
+        if (copy == restored || copy(0.0, 0.5) != expected[25])
+            throw std::runtime_error{ "Copy shares the state" };
+        restored.restart(1234);
+        if (restored(0.0, 0.5) != expected[0])
+            throw std::runtime_error{ "Restarted stream differs" };
+    });
+}
+
+void LegacyNoiseTests::run_tests() { test_replay(); }
+#endif
@@ -0,0 +1,71 @@
+/// @file legacy_noise.hpp
+/// @brief Mersenne Twister noise stream of ModelARX dumps written before the Philox streams.
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <random>
+
+/// @brief Noise stream of ModelARX binary format version 0.
+///
+/// The first ModelARX implementation drew noise from `std::mt19937_64` through
+/// `std::normal_distribution`. The distribution has its own state, so the engine can't simply
+/// `discard()` draws and restoring a stream replays all of them, which takes O(n) time. Models
+/// loaded from such dumps keep drawing from this stream, so they continue the sequence they
+/// started with.
+///
+/// The engine is large and rarely used, so it is kept on the heap. Copies are deep.
+class LegacyNoise {
+    /// Engine and distribution, which together form the stream state.
+    struct State {
+        std::mt19937_64 engine;
+        std::normal_distribution<double> distribution;
+    };
+    /// The stream state, `nullptr` only after moving from the object.
+    std::unique_ptr<State> m_state;
+
+public:
+    /// @brief Restore a stream by replaying its draws.
+    /// @param seed seed of the engine
+    /// @param n_generated number of samples drawn from the stream so far
+    /// @param mean mean of the drawn samples
+    /// @param stddev standard deviation of the drawn samples
+    LegacyNoise(std::uint64_t seed, std::uint64_t n_generated, double mean, double stddev);
+    LegacyNoise(const LegacyNoise &other)
+        : m_state{ std::make_unique<State>(*other.m_state) }
+    {
+    }
+    LegacyNoise &operator=(const LegacyNoise &other)
+    {
+        if (this != &other)
+            m_state = std::make_unique<State>(*other.m_state);
+        return *this;
+    }
+    LegacyNoise(LegacyNoise &&) noexcept = default;
+    LegacyNoise &operator=(LegacyNoise &&) noexcept = default;
+
+    /// @brief Draw the next sample.
+    /// @param mean mean of the sample
+    /// @param stddev standard deviation of the sample
+    /// @return A normally distributed number.
+    double operator()(double mean, double stddev)
+    {
+        using param_type = std::normal_distribution<double>::param_type;
+        return m_state->distribution(m_state->engine, param_type{ mean, stddev });
+    }
+    /// @brief Restart the stream from its first sample.
+    /// @param seed seed of the engine
+    void restart(std::uint64_t seed);
+
+    /// Compare states of the streams.
+    friend bool operator==(const LegacyNoise &a, const LegacyNoise &b);
+};
+
+#ifdef LAB_TESTS
+class LegacyNoiseTests {
+    static void test_replay();
+
+public:
+    static void run_tests();
+};
+#endif
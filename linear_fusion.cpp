@@ -0,0 +1,251 @@
+#include "linear_fusion.hpp"
+#include "ModelARX.h"
+#include "ObiektStatyczny.hpp"
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace {
+/// @brief Linear transfer function @f$g z^{-d} B(z) / A(z)@f$ of a chain.
+///
+/// @f$A(z) = 1 + \sum_i a_i z^{-i-1}@f$ and @f$B(z) = \sum_i b_i z^{-i}@f$, like in ModelARX,
+/// except that @f$B(z) = 1@f$ of a chain of gains.
+struct TransferFunction {
+    std::vector<double> a{};
+    std::vector<double> b{ 1.0 };
+    uint32_t delay{};
+    double gain{ 1.0 };
+};
+
+/// Multiply polynomials @f$\sum_i p_i z^{-i}@f$ and @f$\sum_i q_i z^{-i}@f$.
+std::vector<double> multiply(std::span<const double> p, std::span<const double> q)
+{
+    if (p.empty() || q.empty())
+        return {};
+    std::vector<double> r(p.size() + q.size() - 1);
+    for (std::size_t i = 0; i < p.size(); ++i)
+        for (std::size_t j = 0; j < q.size(); ++j)
+            r[i + j] += p[i] * q[j];
+    return r;
+}
+
+/// Multiply A polynomials, whose coefficients do not include the leading `1`.
+std::vector<double> multiply_a(std::span<const double> p, std::span<const double> q)
+{
+    std::vector<double> p1{ 1.0 }, q1{ 1.0 };
+    p1.insert(p1.end(), p.begin(), p.end());
+    q1.insert(q1.end(), q.begin(), q.end());
+    auto r = multiply(p1, q1);
+    r.erase(r.begin());
+    return r;
+}
+
+/// Check whether a model is in its reset state.
+bool is_reset(const ModelARX &model)
+{
+    auto copy = model;
+    copy.reset();
+    return copy == model;
+}
+
+/// Replace components `[begin, end)` of `loop` with a single one.
+void replace(PętlaUAR &loop, std::size_t begin, std::size_t end, component_ptr &&c)
+{
+    for (auto i = end; i > begin; --i)
+        loop.erase(i - 1);
+    loop.insert(begin, std::move(c));
+}
+
+/// A chain being collected.
+class Chain {
+    /// Index of the first component.
+    std::size_t m_begin{};
+    /// Number of components.
+    std::size_t m_length{};
+    /// Product of components' transfer functions.
+    TransferFunction m_tf{};
+    /// Model the fused model is copied from (keeps noise parameters and the noise stream).
+    const ModelARX *m_base{};
+    /// Whether the chain ends with a noisy model and cannot be extended.
+    bool m_closed{};
+    /// Multiply-adds per sample of the components.
+    std::size_t m_multiply_adds{};
+
+public:
+    /// Start an empty chain at `index`.
+    void restart(std::size_t index) noexcept { *this = Chain{ index }; }
+    explicit Chain(std::size_t begin = 0) noexcept
+        : m_begin{ begin }
+    {
+    }
+    /// Number of components.
+    std::size_t length() const noexcept { return m_length; }
+    /// @brief Try to append a component.
+    /// @return `false` if the component is not linear or cannot follow the current components.
+    bool append(const ObiektSISO &component)
+    {
+        if (m_closed)
+            return false;
+        if (const auto stat = dynamic_cast<const ObiektStatyczny *>(&component)) {
+            if (!stat->is_unbounded() || stat->get_b() != 0.0)
+                return false;
+            m_tf.gain *= stat->get_a();
+            m_multiply_adds += 1;
+        } else if (const auto arx = dynamic_cast<const ModelARX *>(&component)) {
+            if (!is_reset(*arx))
+                return false;
+            const auto noisy = arx->get_stddev() != 0.0 || arx->get_mean() != 0.0;
+            // Previous components would filter the noise
+            if (noisy && !m_tf.a.empty())
+                return false;
+            m_tf.a = multiply_a(m_tf.a, arx->get_coeff_a());
+            m_tf.b = multiply(m_tf.b, arx->get_coeff_b());
+            m_tf.delay += arx->get_transport_delay();
+            m_multiply_adds += arx->get_coeff_a().size() + arx->get_coeff_b().size();
+            if (m_base == nullptr || noisy)
+                m_base = arx;
+            m_closed = noisy;
+        } else {
+            return false;
+        }
+        ++m_length;
+        return true;
+    }
+    /// @brief Replace the components of the chain in `loop` with the fused model.
+    /// @return Summary of the fusion.
+    FusionReport fuse(PętlaUAR &loop) const
+    {
+        FusionReport report{ 1, m_length, m_multiply_adds, 0 };
+        if (m_base == nullptr) {
+            replace(loop, m_begin, m_begin + m_length,
+                    std::make_unique<ObiektStatyczny>(ObiektStatyczny::unbounded(m_tf.gain)));
+            report.multiply_adds_after = 1;
+            return report;
+        }
+        auto fused = std::make_unique<ModelARX>(*m_base);
+        auto b = m_tf.b;
+        for (auto &coeff : b)
+            coeff *= m_tf.gain;
+        report.multiply_adds_after = m_tf.a.size() + b.size();
+        fused->set_coeff_a(std::vector{ m_tf.a });
+        fused->set_coeff_b(std::move(b));
+        fused->set_transport_delay(static_cast<int32_t>(m_tf.delay));
+        replace(loop, m_begin, m_begin + m_length, std::move(fused));
+        return report;
+    }
+};
+}
+
+FusionReport fuse_linear_chains(PętlaUAR &loop)
+{
+    FusionReport report;
+    for (std::size_t i = 0; i < loop.size(); ++i)
+        if (const auto nested = dynamic_cast<PętlaUAR *>(&loop.at(i)))
+            report += fuse_linear_chains(*nested);
+
+    Chain chain;
+    for (std::size_t i = 0; i <= loop.size();) {
+        if (i < loop.size() && chain.append(loop.at(i))) {
+            ++i;
+            continue;
+        }
+        if (chain.length() >= 2) {
+            report += chain.fuse(loop);
+            // The chain was replaced by a single component
+            i -= chain.length() - 1;
+        } else if (chain.length() == 0) {
+            // The component cannot be a part of any chain
+            ++i;
+        }
+        if (i > loop.size())
+            break;
+        chain.restart(i);
+    }
+    return report;
+}
+
+#ifdef LAB_TESTS
+#include <cmath>
+#include <iostream>
+
+namespace {
+/// Check that open-loop and closed-loop responses of two loops are close.
+void check_close(PętlaUAR &expected, PętlaUAR &actual)
+{
+    for (int i = 0; i < 400; ++i) {
+        const double u = (i / 40) % 2;
+        const auto e = expected.symuluj(u);
+        if (std::abs(actual.symuluj(u) - e) > 1e-12 * (1.0 + std::abs(e)))
+            throw std::runtime_error{ "Fused loop response differs" };
+    }
+}
+}
+
+void FusionTests::test_equivalence()
+{
+    it_should_not_throw("Fused linear chains are equivalent", []() {
+        PętlaUAR loop{ true };
+        loop.push_back(std::make_unique<RegulatorPID>(0.6, 4.0, 0.1));
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.5 }, std::vector{ 0.4, 0.1 }, 2));
+        loop.push_back(std::make_unique<ObiektStatyczny>(ObiektStatyczny::unbounded(0.8)));
+        loop.push_back(
+            std::make_unique<ModelARX>(std::vector{ -0.3, 0.02 }, std::vector{ 0.7 }, 1));
+        auto inner_loop = std::make_unique<PętlaUAR>(false);
+        inner_loop->push_back(std::make_unique<ObiektStatyczny>(ObiektStatyczny::unbounded(2.0)));
+        inner_loop->push_back(std::make_unique<ObiektStatyczny>(ObiektStatyczny::unbounded(0.5)));
+        loop.push_back(std::move(inner_loop));
+
+        PętlaUAR fused{ loop.dump() };
+        const auto report = fuse_linear_chains(fused);
+        if (report.chains != 2 || report.components_removed() != 3 || fused.size() != 3)
+            throw std::runtime_error{ "Unexpected fusion report" };
+        if (report.multiply_adds_before != 9 || report.multiply_adds_after != 6)
+            throw std::runtime_error{ "Unexpected multiply-add counts" };
+        const auto &model = dynamic_cast<const ModelARX &>(fused.at(1));
+        if (model.get_transport_delay() != 3 || model.get_coeff_a().size() != 3
+            || model.get_coeff_b().size() != 2)
+            throw std::runtime_error{ "Unexpected fused model" };
+        check_close(loop, fused);
+    });
+}
+
+void FusionTests::test_noise()
+{
+    it_should_not_throw("Noise of the last model in a chain is preserved", []() {
+        PętlaUAR loop{ false };
+        loop.push_back(std::make_unique<ModelARX>(std::vector<double>{}, std::vector{ 0.5, 0.5 }));
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.6 }, std::vector{ 1.0 }, 1, 0.1));
+        PętlaUAR fused{ loop.dump() };
+        if (fuse_linear_chains(fused).chains != 1 || fused.size() != 1)
+            throw std::runtime_error{ "Chain was not fused" };
+        if (dynamic_cast<const ModelARX &>(fused.at(0)).get_stddev() != 0.1)
+            throw std::runtime_error{ "Noise was not preserved" };
+        check_close(loop, fused);
+    });
+}
+
+void FusionTests::test_not_fused()
+{
+    it_should_not_throw("Non-linear, stateful and filtered noisy chains are not fused", []() {
+        PętlaUAR loop{ true };
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.5 }, std::vector{ 0.4 }));
+        // Noise would be filtered by the previous model
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.2 }, std::vector{ 1.0 }, 1, 0.1));
+        loop.push_back(std::make_unique<ObiektStatyczny>());
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.5 }, std::vector{ 0.4 }));
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.1 }, std::vector{ 0.3 }));
+        static_cast<ModelARX &>(loop.at(4)).symuluj(1.0);
+        PętlaUAR fused{ loop.dump() };
+        if (fuse_linear_chains(fused).chains != 0 || fused != loop)
+            throw std::runtime_error{ "Loop was changed" };
+    });
+}
+
+void FusionTests::run_tests()
+{
+    test_equivalence();
+    test_noise();
+    test_not_fused();
+}
+#endif
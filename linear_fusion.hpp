@@ -0,0 +1,61 @@
+/// @file linear_fusion.hpp
+/// @brief Optimizer pass, which collapses serial chains of linear components into single models.
+
+#pragma once
+#include "PętlaUAR.hpp"
+#include <cstddef>
+
+/// Summary of the changes made by fuse_linear_chains().
+struct FusionReport {
+    /// Number of fused chains (each one was replaced by a single component).
+    std::size_t chains{};
+    /// Number of components in the fused chains before fusion.
+    std::size_t components_before{};
+    /// Multiply-adds per sample of the fused chains' components before fusion.
+    std::size_t multiply_adds_before{};
+    /// Multiply-adds per sample of the components which replaced the chains.
+    std::size_t multiply_adds_after{};
+
+    /// Number of components removed from the loops.
+    constexpr std::size_t components_removed() const noexcept { return components_before - chains; }
+    /// Accumulate another report.
+    constexpr FusionReport &operator+=(const FusionReport &other) noexcept
+    {
+        chains += other.chains;
+        components_before += other.components_before;
+        multiply_adds_before += other.multiply_adds_before;
+        multiply_adds_after += other.multiply_adds_after;
+        return *this;
+    }
+};
+
+/// @brief Replace serial chains of linear components with equivalent single components.
+///
+/// A chain consists of adjacent components of the same loop (nested loops are processed
+/// recursively), which are:
+/// - ModelARX in the reset state (all signal histories filled with `0`s),
+/// - ObiektStatyczny without clamping (ObiektStatyczny::is_unbounded()) and with zero offset.
+///
+/// The transfer function @f$z^{-d} B(z) / A(z)@f$ of a chain is the product of its components'
+/// transfer functions, so the chain is replaced by one ModelARX with multiplied A and B polynomials
+/// and summed delays (or one ObiektStatyczny if there are only gains). Without noise the fused
+/// model is exactly equivalent up to floating point rounding.
+///
+/// Noise (and noise mean) is only supported in the last ModelARX of a chain, in which all previous
+/// components have empty A polynomials. Then the noise is not filtered by the other components and
+/// the fused model reuses the noise stream, so it draws the very same samples.
+///
+/// @param loop loop to optimize in place
+/// @return Summary of the fused chains.
+FusionReport fuse_linear_chains(PętlaUAR &loop);
+
+#ifdef LAB_TESTS
+class FusionTests {
+    static void test_equivalence();
+    static void test_noise();
+    static void test_not_fused();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,628 @@
+#include "loop_graph.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+/// Size of a serialized GraphEdge.
+constexpr std::size_t edge_dump_size = sizeof(std::uint8_t) + 2 * sizeof(std::uint32_t)
+    + sizeof(double) + sizeof(std::uint8_t);
+}
+
+LoopGraph::LoopGraph(std::span<const uint8_t> serialized, std::pmr::memory_resource *arena)
+{
+    ByteReader reader{ serialized };
+    const auto data_len = reader.get<uint32_t>();
+    if (reader.remaining() < data_len)
+        throw std::runtime_error{ "Data size is smaller than expected" };
+    if (!prefix_match(unique_name, reader.take(prefix_size)))
+        throw std::runtime_error{
+            "LoopGraph serialized data does not start with the expected prefix"
+        };
+    m_n_inputs = reader.get<uint32_t>();
+    const auto n_blocks = reader.get<uint64_t>();
+    const auto n_edges = reader.get<uint64_t>();
+    const auto n_outputs = reader.get<uint64_t>();
+    if (n_edges > reader.remaining() / edge_dump_size)
+        throw std::runtime_error{ "Serialized data is too short" };
+    m_edges.reserve(static_cast<std::size_t>(n_edges));
+    for (std::uint64_t i = 0; i < n_edges; ++i) {
+        const auto kind = reader.get<uint8_t>();
+        if (kind > static_cast<uint8_t>(GraphPort::Kind::BLOCK))
+            throw std::runtime_error{ "Invalid LoopGraph edge source" };
+        GraphEdge edge{};
+        edge.from = { static_cast<GraphPort::Kind>(kind), reader.get<uint32_t>() };
+        edge.to = reader.get<uint32_t>();
+        edge.gain = reader.get<double>();
+        edge.delayed = reader.get<uint8_t>() > 0_u8;
+        m_edges.push_back(edge);
+    }
+    m_outputs = reader.get_vector<uint32_t>(static_cast<std::size_t>(n_outputs));
+    // Every block takes at least its last output and its length
+    if (n_blocks > reader.remaining() / (sizeof(double) + sizeof(uint32_t)))
+        throw std::runtime_error{ "Serialized data is too short" };
+    m_last = reader.get_vector<double>(static_cast<std::size_t>(n_blocks));
+    m_blocks.reserve(static_cast<std::size_t>(n_blocks));
+    for (std::uint64_t i = 0; i < n_blocks; i++) {
+        const auto rest = serialized.last(reader.remaining());
+        const auto l = reader.get<uint32_t>();
+        reader.take(l);
+        m_blocks.push_back(ObiektSISO::deserialize(rest.first(sizeof(uint32_t) + l), arena));
+    }
+    validate();
+}
+
+void LoopGraph::write_dump(ByteWriter &out) const
+{
+    out.put(static_cast<uint32_t>(dump_size() - sizeof(uint32_t)));
+    out.put_range(unique_name);
+    out.put(m_n_inputs);
+    out.put(static_cast<uint64_t>(m_blocks.size()));
+    out.put(static_cast<uint64_t>(m_edges.size()));
+    out.put(static_cast<uint64_t>(m_outputs.size()));
+    for (const auto &e : m_edges) {
+        out.put(static_cast<uint8_t>(e.from.kind));
+        out.put(e.from.index);
+        out.put(e.to);
+        out.put(e.gain);
+        out.put(e.delayed ? 1_u8 : 0_u8);
+    }
+    out.put_range(m_outputs);
+    out.put_range(m_last);
+    for (const auto &b : m_blocks)
+        write_nested(*b, out);
+}
+
+std::size_t LoopGraph::dump_size() const
+{
+    std::size_t size = sizeof(uint32_t) + prefix_size + sizeof m_n_inputs + 3 * sizeof(uint64_t)
+        + m_edges.size() * edge_dump_size + m_outputs.size() * sizeof(uint32_t)
+        + m_last.size() * sizeof(double);
+    for (const auto &b : m_blocks)
+        size += b->dump_size();
+    return size;
+}
+
+std::uint32_t LoopGraph::add_block(component_ptr &&block)
+{
+    if (block == nullptr)
+        throw std::runtime_error{ "Inserted pointers must not be null" };
+    m_blocks.push_back(std::move(block));
+    m_last.push_back(0.0);
+    m_scheduled = false;
+    return static_cast<std::uint32_t>(m_blocks.size() - 1);
+}
+
+void LoopGraph::connect(GraphPort from, std::uint32_t to, double gain, bool delayed)
+{
+    const GraphEdge edge{ from, to, gain, delayed };
+    m_edges.push_back(edge);
+    try {
+        validate();
+    } catch (...) {
+        m_edges.pop_back();
+        throw;
+    }
+    m_scheduled = false;
+}
+
+std::size_t LoopGraph::add_output(std::uint32_t block)
+{
+    if (block >= m_blocks.size())
+        throw std::runtime_error{ "LoopGraph output refers to a missing block" };
+    m_outputs.push_back(block);
+    m_scheduled = false;
+    return m_outputs.size() - 1;
+}
+
+void LoopGraph::validate() const
+{
+    for (const auto &e : m_edges) {
+        if (e.to >= m_blocks.size())
+            throw std::runtime_error{ "LoopGraph edge ends in a missing block" };
+        if (e.from.kind == GraphPort::Kind::INPUT) {
+            if (e.from.index >= m_n_inputs)
+                throw std::runtime_error{ "LoopGraph edge starts in a missing input" };
+            if (e.delayed)
+                throw std::runtime_error{ "Only block outputs can be delayed" };
+        } else if (e.from.index >= m_blocks.size()) {
+            throw std::runtime_error{ "LoopGraph edge starts in a missing block" };
+        }
+    }
+    if (std::ranges::any_of(m_outputs, [this](auto b) { return b >= m_blocks.size(); }))
+        throw std::runtime_error{ "LoopGraph output refers to a missing block" };
+    if (m_last.size() != m_blocks.size())
+        throw std::runtime_error{ "LoopGraph state does not match its blocks" };
+}
+
+void LoopGraph::schedule()
+{
+    validate();
+    const auto n = static_cast<std::uint32_t>(m_blocks.size());
+
+    // Incoming edges of every block, in the order of addition
+    m_incoming_begin.assign(n + 1, 0);
+    for (const auto &e : m_edges)
+        ++m_incoming_begin[e.to + 1];
+    for (std::uint32_t b = 0; b < n; ++b)
+        m_incoming_begin[b + 1] += m_incoming_begin[b];
+    m_incoming.resize(m_edges.size());
+    {
+        auto next = m_incoming_begin;
+        for (std::uint32_t i = 0; i < m_edges.size(); ++i)
+            m_incoming[next[m_edges[i].to]++] = i;
+    }
+    // Destinations of all edges and of the undelayed ones between blocks
+    std::vector<std::vector<std::uint32_t>> successors(n), direct_successors(n);
+    std::vector<std::size_t> pending(n);
+    for (const auto &e : m_edges) {
+        if (e.from.kind != GraphPort::Kind::BLOCK)
+            continue;
+        successors[e.from.index].push_back(e.to);
+        if (!e.delayed) {
+            direct_successors[e.from.index].push_back(e.to);
+            ++pending[e.to];
+        }
+    }
+
+    // Order of blocks within a sample, in which undelayed edges go forward (Kahn's algorithm)
+    std::vector<std::uint32_t> order;
+    order.reserve(n);
+    for (std::uint32_t b = 0; b < n; ++b) {
+        if (pending[b] == 0)
+            order.push_back(b);
+    }
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        for (const auto next : direct_successors[order[i]]) {
+            if (--pending[next] == 0)
+                order.push_back(next);
+        }
+    }
+    if (order.size() != n)
+        throw std::runtime_error{ "LoopGraph has a feedback loop without a delayed edge" };
+    std::vector<std::uint32_t> position(n);
+    for (std::uint32_t i = 0; i < n; ++i)
+        position[order[i]] = i;
+
+    // Strongly connected components of all edges (Kosaraju's algorithm), which are found in a
+    // topological order of the condensed graph
+    std::vector<std::uint32_t> finished;
+    finished.reserve(n);
+    {
+        std::vector<bool> visited(n);
+        std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+        for (std::uint32_t s = 0; s < n; ++s) {
+            if (visited[s])
+                continue;
+            visited[s] = true;
+            stack.emplace_back(s, 0);
+            while (!stack.empty()) {
+                auto &[v, next] = stack.back();
+                if (next < successors[v].size()) {
+                    const auto w = successors[v][next++];
+                    if (!visited[w]) {
+                        visited[w] = true;
+                        stack.emplace_back(w, 0);
+                    }
+                } else {
+                    finished.push_back(v);
+                    stack.pop_back();
+                }
+            }
+        }
+    }
+    constexpr auto unassigned = ~std::uint32_t{};
+    std::vector<std::uint32_t> component(n, unassigned);
+    std::vector<Stage> stages;
+    for (auto it = finished.rbegin(); it != finished.rend(); ++it) {
+        if (component[*it] != unassigned)
+            continue;
+        const auto c = static_cast<std::uint32_t>(stages.size());
+        Stage stage{ { *it }, false };
+        component[*it] = c;
+        // Blocks reaching the root through incoming edges
+        for (std::size_t i = 0; i < stage.blocks.size(); ++i) {
+            const auto b = stage.blocks[i];
+            for (auto k = m_incoming_begin[b]; k < m_incoming_begin[b + 1]; ++k) {
+                const auto &e = m_edges[m_incoming[k]];
+                if (e.from.kind == GraphPort::Kind::BLOCK
+                    && component[e.from.index] == unassigned) {
+                    component[e.from.index] = c;
+                    stage.blocks.push_back(e.from.index);
+                }
+            }
+        }
+        std::ranges::sort(stage.blocks, {}, [&](auto b) { return position[b]; });
+        stage.cyclic = stage.blocks.size() > 1 || std::ranges::any_of(m_edges, [&](const auto &e) {
+            return e.from.kind == GraphPort::Kind::BLOCK && e.from.index == *it && e.to == *it;
+        });
+        stages.push_back(std::move(stage));
+    }
+
+    // Level of a stage is the length of the longest path to it, stages of a level are independent
+    std::vector<std::size_t> level(stages.size());
+    std::size_t n_levels = stages.empty() ? 0 : 1;
+    for (std::size_t c = 0; c < stages.size(); ++c) {
+        for (const auto b : stages[c].blocks) {
+            for (auto k = m_incoming_begin[b]; k < m_incoming_begin[b + 1]; ++k) {
+                const auto &e = m_edges[m_incoming[k]];
+                if (e.from.kind == GraphPort::Kind::BLOCK && component[e.from.index] != c)
+                    level[c] = std::max(level[c], level[component[e.from.index]] + 1);
+            }
+        }
+        n_levels = std::max(n_levels, level[c] + 1);
+    }
+    m_stages.clear();
+    m_stages.reserve(stages.size());
+    m_levels.assign(1, 0);
+    for (std::size_t l = 0; l < n_levels; ++l) {
+        for (std::size_t c = 0; c < stages.size(); ++c) {
+            if (level[c] == l)
+                m_stages.push_back(std::move(stages[c]));
+        }
+        m_levels.push_back(m_stages.size());
+    }
+
+    m_in_buffer.assign(std::size_t{ n } * chunk_size, 0.0);
+    m_out_buffer.assign(std::size_t{ n } * chunk_size, 0.0);
+    m_chunk_inputs.resize(m_n_inputs);
+    m_scheduled = true;
+}
+
+std::size_t LoopGraph::level_count()
+{
+    if (!m_scheduled)
+        schedule();
+    return m_levels.size() - 1;
+}
+
+double LoopGraph::edge_value(const GraphEdge &edge, std::span<const std::span<const double>> inputs,
+                             std::size_t i) noexcept
+{
+    if (edge.from.kind == GraphPort::Kind::INPUT)
+        return edge.gain * inputs[edge.from.index][i];
+    const auto out = chunk_out(edge.from.index);
+    if (!edge.delayed)
+        return edge.gain * out[i];
+    return edge.gain * (i == 0 ? m_last[edge.from.index] : out[i - 1]);
+}
+
+void LoopGraph::simulate_stage(const Stage &stage, std::span<const std::span<const double>> inputs,
+                               std::size_t n)
+{
+    if (stage.cyclic) {
+        for (std::size_t i = 0; i < n; ++i) {
+            for (const auto b : stage.blocks) {
+                double u = 0.0;
+                for (auto k = m_incoming_begin[b]; k < m_incoming_begin[b + 1]; ++k)
+                    u += edge_value(m_edges[m_incoming[k]], inputs, i);
+                chunk_out(b)[i] = m_blocks[b]->symuluj(u);
+            }
+        }
+        return;
+    }
+    // The whole chunk of every source is ready, so the input is summed edge by edge
+    const auto b = stage.blocks.front();
+    const auto in = chunk_in(b).first(n);
+    std::ranges::fill(in, 0.0);
+    for (auto k = m_incoming_begin[b]; k < m_incoming_begin[b + 1]; ++k) {
+        const auto &e = m_edges[m_incoming[k]];
+        const auto g = e.gain;
+        if (e.from.kind == GraphPort::Kind::INPUT) {
+            const auto src = inputs[e.from.index];
+            for (std::size_t i = 0; i < n; ++i)
+                in[i] += g * src[i];
+        } else if (!e.delayed) {
+            const auto src = chunk_out(e.from.index);
+            for (std::size_t i = 0; i < n; ++i)
+                in[i] += g * src[i];
+        } else {
+            const auto src = chunk_out(e.from.index);
+            in[0] += g * m_last[e.from.index];
+            for (std::size_t i = 1; i < n; ++i)
+                in[i] += g * src[i - 1];
+        }
+    }
+    m_blocks[b]->simulate_block(in, chunk_out(b).first(n));
+}
+
+void LoopGraph::simulate_chunk(std::span<const std::span<const double>> inputs, std::size_t n)
+{
+    for (std::size_t l = 0; l + 1 < m_levels.size(); ++l) {
+        const auto first = m_levels[l];
+        const auto count = m_levels[l + 1] - first;
+        if (m_pool != nullptr && count > 1 && n * count >= m_parallel_threshold) {
+            m_pool->parallel_for(count, [&](std::size_t k) {
+                simulate_stage(m_stages[first + k], inputs, n);
+            });
+        } else {
+            for (std::size_t k = 0; k < count; ++k)
+                simulate_stage(m_stages[first + k], inputs, n);
+        }
+    }
+    for (std::uint32_t b = 0; b < m_blocks.size(); ++b)
+        m_last[b] = chunk_out(b)[n - 1];
+}
+
+void LoopGraph::simulate_multi(std::span<const std::span<const double>> inputs,
+                               std::span<const std::span<double>> outputs)
+{
+    if (inputs.size() != m_n_inputs)
+        throw std::runtime_error{ "Number of signals does not match the LoopGraph inputs" };
+    if (outputs.size() > m_outputs.size())
+        throw std::runtime_error{ "LoopGraph has fewer outputs than requested" };
+    const auto size = !inputs.empty() ? inputs.front().size()
+        : !outputs.empty()            ? outputs.front().size()
+                                      : 0;
+    if (std::ranges::any_of(inputs, [size](auto s) { return s.size() != size; })
+        || std::ranges::any_of(outputs, [size](auto s) { return s.size() != size; }))
+        throw std::runtime_error{ "Input and output blocks must have the same size" };
+    if (!m_scheduled)
+        schedule();
+    for (std::size_t first = 0; first < size; first += chunk_size) {
+        const auto n = std::min(chunk_size, size - first);
+        for (std::size_t k = 0; k < inputs.size(); ++k)
+            m_chunk_inputs[k] = inputs[k].subspan(first, n);
+        simulate_chunk(m_chunk_inputs, n);
+        // Inputs of the chunk were already read, so outputs can overwrite them
+        for (std::size_t o = 0; o < outputs.size(); ++o)
+            std::ranges::copy(chunk_out(m_outputs[o]).first(n), outputs[o].begin() + first);
+    }
+}
+
+double LoopGraph::symuluj(double u)
+{
+    double y;
+    simulate_block({ &u, 1 }, { &y, 1 });
+    return y;
+}
+
+void LoopGraph::simulate_block(std::span<const double> in, std::span<double> out)
+{
+    check_block(in, out);
+    if (m_n_inputs != 1 || m_outputs.empty())
+        throw std::runtime_error{ "LoopGraph simulated as SISO must have 1 input and an output" };
+    const std::span<const double> inputs[]{ in };
+    const std::span<double> outputs[]{ out };
+    simulate_multi(inputs, outputs);
+}
+
+void LoopGraph::reset()
+{
+    for (auto &b : m_blocks)
+        b->reset();
+    std::ranges::fill(m_last, 0.0);
+}
+
+#ifdef LAB_TESTS
+#include "ModelARX.h"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include <format>
+
+namespace {
+/// Inputs alternating between two levels.
+std::vector<double> test_inputs(std::size_t n)
+{
+    std::vector<double> inputs(n);
+    for (std::size_t i = 0; i < n; ++i)
+        inputs[i] = (i / 300) % 2 ? 1.0 : -0.5;
+    return inputs;
+}
+
+/// Compare two signals exactly.
+void check_same(std::span<const double> expected, std::span<const double> actual,
+                std::string_view what)
+{
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i] != actual[i])
+            throw std::runtime_error{ std::format("{}: {} != {} at {}", what, actual[i],
+                                                  expected[i], i) };
+    }
+}
+}
+
+void LoopGraphTests::test_matches_loops()
+{
+    it_should_not_throw("LoopGraph - same results as a closed PętlaUAR", [] {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+        loop.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 1));
+        LoopGraph graph;
+        const auto pid = graph.add_block(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+        const auto arx = graph.add_block(
+            std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 1));
+        graph.connect(GraphPort::input(0), pid);
+        graph.connect(GraphPort::block(arx), pid, -1.0, true);
+        graph.connect(GraphPort::block(pid), arx);
+        graph.add_output(arx);
+
+        const auto inputs = test_inputs(5000);
+        std::vector<double> expected(inputs.size()), actual(inputs.size());
+        loop.simulate_block(std::span{ inputs }.first(3000), std::span{ expected }.first(3000));
+        graph.simulate_block(std::span{ inputs }.first(3000), std::span{ actual }.first(3000));
+        for (std::size_t i = 3000; i < inputs.size(); ++i) {
+            expected[i] = loop.symuluj(inputs[i]);
+            actual[i] = graph.symuluj(inputs[i]);
+        }
+        check_same(expected, actual, "Closed loop");
+        if (graph.level_count() != 1 || !graph.m_stages.front().cyclic)
+            throw std::runtime_error{ "Feedback loop is not a single cyclic stage" };
+    });
+    it_should_not_throw("LoopGraph - same results as cascaded PętlaUARs", [] {
+        // Outer controller drives the setpoint of the inner loop, both are closed over the plant
+        auto outer = std::make_unique<PętlaUAR>();
+        outer->push_back(std::make_unique<RegulatorPID>(0.3, 8.0));
+        auto inner = std::make_unique<PętlaUAR>();
+        inner->push_back(std::make_unique<RegulatorPID>(0.8, 2.0, 0.1));
+        inner->push_back(
+            std::make_unique<ModelARX>(std::vector{ -0.5, 0.1 }, std::vector{ 0.4 }, 2));
+        outer->push_back(std::move(inner));
+        // Open prefilter in front of the cascade
+        PętlaUAR serial{ false };
+        serial.push_back(std::make_unique<ModelARX>(std::vector{ -0.7 }, std::vector{ 0.3 }, 1));
+        serial.push_back(std::move(outer));
+
+        LoopGraph graph;
+        const auto filter = graph.add_block(
+            std::make_unique<ModelARX>(std::vector{ -0.7 }, std::vector{ 0.3 }, 1));
+        const auto pid_outer = graph.add_block(std::make_unique<RegulatorPID>(0.3, 8.0));
+        const auto pid_inner = graph.add_block(std::make_unique<RegulatorPID>(0.8, 2.0, 0.1));
+        const auto plant = graph.add_block(
+            std::make_unique<ModelARX>(std::vector{ -0.5, 0.1 }, std::vector{ 0.4 }, 2));
+        graph.connect(GraphPort::input(0), filter);
+        graph.connect(GraphPort::block(filter), pid_outer);
+        graph.connect(GraphPort::block(plant), pid_outer, -1.0, true);
+        graph.connect(GraphPort::block(pid_outer), pid_inner);
+        graph.connect(GraphPort::block(plant), pid_inner, -1.0, true);
+        graph.connect(GraphPort::block(pid_inner), plant);
+        graph.add_output(plant);
+
+        const auto inputs = test_inputs(5000);
+        std::vector<double> expected(inputs.size()), actual(inputs.size());
+        serial.simulate_block(inputs, expected);
+        graph.simulate_block(inputs, actual);
+        check_same(expected, actual, "Cascade");
+        // The prefilter is simulated in blocks before the feedback loops
+        if (graph.level_count() != 2 || graph.m_stages.front().cyclic)
+            throw std::runtime_error{ "Wrong schedule of the cascade" };
+    });
+}
+
+void LoopGraphTests::test_parallel_branches()
+{
+    it_should_not_throw("LoopGraph - parallel branches", [] {
+        constexpr std::uint32_t n_branches = 8;
+        const auto build = [] {
+            LoopGraph graph{ 2 };
+            // The sum of the branches and the difference of the inputs are the outputs
+            const auto sum = graph.add_block(std::make_unique<RegulatorPID>(1.0));
+            const auto diff = graph.add_block(std::make_unique<RegulatorPID>(1.0));
+            for (std::uint32_t k = 0; k < n_branches; ++k) {
+                const auto model = graph.add_block(std::make_unique<ModelARX>(
+                    std::vector{ -0.1 * k }, std::vector{ 0.5, 0.1 * k }, k % 3 + 1));
+                const auto pid = graph.add_block(std::make_unique<RegulatorPID>(0.1 * k + 0.1));
+                graph.connect(GraphPort::input(k % 2), model);
+                // A delayed signal is not a feedback loop unless it forms a cycle
+                graph.connect(GraphPort::block(diff), model, -0.01, true);
+                graph.connect(GraphPort::block(model), pid);
+                graph.connect(GraphPort::block(pid), sum, 1.0 / n_branches);
+            }
+            graph.connect(GraphPort::input(0), diff);
+            graph.connect(GraphPort::input(1), diff, -1.0);
+            graph.add_output(sum);
+            graph.add_output(diff);
+            return graph;
+        };
+        LoopGraph serial = build();
+        // Copied, so that the noise seeds are the same
+        LoopGraph parallel{ serial.dump() };
+        ThreadPool pool{ 4 };
+        parallel.set_thread_pool(&pool, 1);
+
+        const auto in0 = test_inputs(10'000);
+        std::vector<double> in1(in0.size());
+        for (std::size_t i = 0; i < in1.size(); ++i)
+            in1[i] = static_cast<double>(i % 7) * 0.1;
+        std::vector<double> sum_s(in0.size()), diff_s(in0.size()), sum_p(in0.size()),
+            diff_p(in0.size());
+        const std::span<const double> inputs[]{ in0, in1 };
+        const std::span<double> outputs_s[]{ sum_s, diff_s };
+        const std::span<double> outputs_p[]{ sum_p, diff_p };
+        serial.simulate_multi(inputs, outputs_s);
+        parallel.simulate_multi(inputs, outputs_p);
+        check_same(sum_s, sum_p, "Parallel sum");
+        check_same(diff_s, diff_p, "Parallel difference");
+        for (std::size_t i = 0; i < in0.size(); ++i) {
+            if (diff_s[i] != in0[i] - in1[i])
+                throw std::runtime_error{ std::format("Wrong difference at {}", i) };
+        }
+        // The difference, models, controllers, the sum
+        if (serial.level_count() != 4 || serial.m_levels[2] - serial.m_levels[1] != n_branches
+            || std::ranges::any_of(serial.m_stages, &LoopGraph::Stage::cyclic))
+            throw std::runtime_error{ "Branches are not independent" };
+        if (serial != parallel)
+            throw std::runtime_error{ "Parallel simulation left a different state" };
+    });
+}
+
+void LoopGraphTests::test_serialization()
+{
+    it_should_not_throw("LoopGraph - serialization", [] {
+        LoopGraph graph;
+        const auto pid = graph.add_block(std::make_unique<RegulatorPID>(0.5, 5.0));
+        auto inner = std::make_unique<PętlaUAR>(false);
+        inner->push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 1));
+        const auto loop = graph.add_block(std::move(inner));
+        graph.connect(GraphPort::input(0), pid, 2.0);
+        graph.connect(GraphPort::block(loop), pid, -1.0, true);
+        graph.connect(GraphPort::block(pid), loop);
+        graph.add_output(loop);
+        const auto inputs = test_inputs(1000);
+        std::vector<double> out(inputs.size());
+        graph.simulate_block(inputs, out);
+
+        // The graph can be nested in a loop and restored with ObiektSISO::deserialize()
+        PętlaUAR outer{ false };
+        outer.push_back(ObiektSISO::deserialize(graph.dump()));
+        const auto dump = outer.dump();
+        if (dump.size() != outer.dump_size())
+            throw std::runtime_error{ "Wrong dump size" };
+        auto restored = PętlaUAR::with_arena(dump);
+        if (restored != outer || !restored.in_arena(0))
+            throw std::runtime_error{ "Restored loop differs" };
+        auto &copy = dynamic_cast<LoopGraph &>(restored.at(0));
+        const std::vector<std::size_t> path{ 0, 1, 0 };
+        if (dynamic_cast<ModelARX *>(&find_component(restored, path)) == nullptr)
+            throw std::runtime_error{ "Path does not lead through the graph" };
+        std::vector<double> expected(inputs.size()), actual(inputs.size());
+        graph.simulate_block(inputs, expected);
+        copy.simulate_block(inputs, actual);
+        check_same(expected, actual, "Restored graph");
+    });
+}
+
+void LoopGraphTests::test_invalid()
+{
+    it_should_throw<std::runtime_error>("LoopGraph - feedback without delay", [] {
+        LoopGraph graph;
+        const auto a = graph.add_block(std::make_unique<RegulatorPID>(1.0));
+        const auto b = graph.add_block(std::make_unique<RegulatorPID>(1.0));
+        graph.connect(GraphPort::block(a), b);
+        graph.connect(GraphPort::block(b), a);
+        graph.add_output(b);
+        graph.symuluj(1.0);
+    });
+    it_should_throw<std::runtime_error>("LoopGraph - delayed input", [] {
+        LoopGraph graph;
+        graph.connect(GraphPort::input(0), graph.add_block(std::make_unique<RegulatorPID>(1.0)),
+                      1.0, true);
+    });
+    it_should_throw<std::runtime_error>("LoopGraph - missing block", [] {
+        LoopGraph graph;
+        graph.add_block(std::make_unique<RegulatorPID>(1.0));
+        graph.connect(GraphPort::block(1), 0);
+    });
+    it_should_throw<std::runtime_error>("LoopGraph - SISO simulation of 2 inputs", [] {
+        LoopGraph graph{ 2 };
+        graph.add_output(graph.add_block(std::make_unique<RegulatorPID>(1.0)));
+        graph.symuluj(1.0);
+    });
+    it_should_throw<std::runtime_error>("LoopGraph - truncated dump", [] {
+        LoopGraph graph;
+        graph.add_output(graph.add_block(std::make_unique<RegulatorPID>(1.0)));
+        auto dump = graph.dump();
+        dump.resize(dump.size() - 1);
+        ObiektSISO::deserialize(dump);
+    });
+}
+
+void LoopGraphTests::run_tests()
+{
+    test_matches_loops();
+    test_parallel_branches();
+    test_serialization();
+    test_invalid();
+}
+#endif
@@ -0,0 +1,262 @@
+/// @file loop_graph.hpp
+/// @brief Block diagram of components with parallel branches, multiple inputs and outputs.
+
+#pragma once
+#include "ObiektSISO.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+class ThreadPool;
+
+/// Source of a signal in a LoopGraph: an external input or the output of a block.
+struct GraphPort {
+    /// Type of the source.
+    enum class Kind : std::uint8_t {
+        INPUT, ///< External input of the graph
+        BLOCK ///< Output of a block
+    };
+    Kind kind;
+    /// Index of the input or the block.
+    std::uint32_t index;
+
+    /// External input `index`.
+    static constexpr GraphPort input(std::uint32_t index) noexcept
+    {
+        return { Kind::INPUT, index };
+    }
+    /// Output of block `index`.
+    static constexpr GraphPort block(std::uint32_t index) noexcept
+    {
+        return { Kind::BLOCK, index };
+    }
+    friend constexpr bool operator==(const GraphPort &, const GraphPort &) = default;
+};
+
+/// Connection from a source to the input of a block.
+struct GraphEdge {
+    /// The source.
+    GraphPort from;
+    /// Index of the destination block.
+    std::uint32_t to;
+    /// Multiplier of the signal; a block's input is the sum of its incoming signals.
+    double gain;
+    /// @brief Whether the edge passes the output of the previous step (a unit delay).
+    /// @details Every cycle (a feedback path) must contain a delayed edge, like the feedback of a
+    /// closed PętlaUAR. Only block outputs can be delayed.
+    bool delayed;
+    friend constexpr bool operator==(const GraphEdge &, const GraphEdge &) = default;
+};
+
+/// @brief Block diagram of components, which can have parallel branches and nested feedback loops.
+///
+/// Blocks are arbitrary components (including loops and graphs). The input of a block is the sum of
+/// its incoming edges: external inputs and outputs of other blocks multiplied by gains. Feedback
+/// paths must contain a delayed edge, which passes the output of the previous step. The graph is an
+/// ObiektSISO with input 0 and output 0, and simulates multiple inputs and outputs with
+/// simulate_multi().
+///
+/// The blocks are scheduled once, when the graph is first simulated after a change of its
+/// structure. Strongly connected blocks (feedback loops) are simulated sample by sample; any other
+/// block simulates whole blocks of samples with a single virtual call, even if it receives delayed
+/// signals. Blocks at the same depth of the diagram don't depend on each other, so they can be
+/// simulated in parallel (see set_thread_pool()).
+class LoopGraph : public ObiektSISO {
+public:
+    /// Unique name/prefix used to distinguish types in deserialization.
+    static constexpr std::string_view unique_name{ "Grph" };
+    /// Number of samples simulated by all blocks before the next ones.
+    static constexpr std::size_t chunk_size = 1024;
+
+private:
+    /// Size of the unique prefix.
+    static constexpr std::size_t prefix_size{ unique_name.size()
+                                              * sizeof(decltype(unique_name)::value_type) };
+
+    /// Blocks simulated together, either a single block or a feedback loop.
+    struct Stage {
+        /// Indices of the blocks, in the order of simulation within a sample.
+        std::vector<std::uint32_t> blocks;
+        /// Whether the blocks form a cycle and are simulated sample by sample.
+        bool cyclic;
+    };
+
+    /// Number of external inputs.
+    std::uint32_t m_n_inputs;
+    /// The blocks.
+    std::vector<component_ptr> m_blocks{};
+    /// Connections between inputs and blocks.
+    std::vector<GraphEdge> m_edges{};
+    /// Blocks whose outputs are the outputs of the graph.
+    std::vector<std::uint32_t> m_outputs{};
+    /// Outputs of the blocks in the previous step, read by delayed edges.
+    std::vector<double> m_last{};
+    /// Pool for simulating independent stages, not owned and not serialized.
+    ThreadPool *m_pool{};
+    /// Minimal number of samples simulated by a level of stages to use #m_pool.
+    std::size_t m_parallel_threshold{ 1 << 15 };
+
+    /// Whether #m_stages etc. match the structure.
+    bool m_scheduled{};
+    /// Stages in the order of simulation, grouped by levels.
+    std::vector<Stage> m_stages{};
+    /// Index of the first stage of every level, followed by the number of stages.
+    std::vector<std::size_t> m_levels{};
+    /// Indices of edges ending in every block, see #m_incoming_begin.
+    std::vector<std::uint32_t> m_incoming{};
+    /// Beginning of the incoming edges of every block in #m_incoming, followed by its size.
+    std::vector<std::size_t> m_incoming_begin{};
+    /// Inputs of the blocks in the current chunk, #chunk_size per block.
+    std::vector<double> m_in_buffer{};
+    /// Outputs of the blocks in the current chunk, #chunk_size per block.
+    std::vector<double> m_out_buffer{};
+    /// Parts of the graph inputs in the current chunk.
+    std::vector<std::span<const double>> m_chunk_inputs{};
+
+    /// @brief Check if all edges and outputs refer to existing inputs and blocks.
+    /// @throws `std::runtime_error` if they don't.
+    void validate() const;
+    /// @brief Validate the structure and compute the schedule.
+    /// @throws `std::runtime_error` if an edge or output is invalid or a cycle has no delay.
+    void schedule();
+    /// Outputs of `block` in the current chunk.
+    std::span<double> chunk_out(std::uint32_t block) noexcept
+    {
+        return std::span{ m_out_buffer }.subspan(block * chunk_size, chunk_size);
+    }
+    /// Inputs of `block` in the current chunk.
+    std::span<double> chunk_in(std::uint32_t block) noexcept
+    {
+        return std::span{ m_in_buffer }.subspan(block * chunk_size, chunk_size);
+    }
+    /// @brief Value of an edge in sample `i` of the current chunk.
+    /// @param inputs inputs of the graph, offset to the chunk
+    double edge_value(const GraphEdge &edge, std::span<const std::span<const double>> inputs,
+                      std::size_t i) noexcept;
+    /// @brief Simulate a stage over `n` samples of the current chunk.
+    void simulate_stage(const Stage &stage, std::span<const std::span<const double>> inputs,
+                        std::size_t n);
+    /// @brief Simulate a chunk, outputs of the blocks are left in #m_out_buffer.
+    /// @param inputs inputs of the graph, offset to the chunk
+    /// @param n number of samples, at most #chunk_size
+    void simulate_chunk(std::span<const std::span<const double>> inputs, std::size_t n);
+
+protected:
+    /// @brief Write the graph and all blocks directly into the output buffer.
+    /// @param out writer over a buffer of dump_size() bytes
+    void write_dump(ByteWriter &out) const override;
+
+public:
+    /// @brief Construct an empty graph.
+    /// @param n_inputs number of external inputs
+    explicit LoopGraph(std::uint32_t n_inputs = 1)
+        : m_n_inputs{ n_inputs }
+    {
+    }
+    /// @brief Deserializing constructor.
+    /// @param serialized bytes representing serialized LoopGraph
+    /// @param arena memory resource for the blocks, `nullptr` to allocate them with `new`
+    /// @throws `std::runtime_error` if the data is not a valid LoopGraph.
+    LoopGraph(std::span<const uint8_t> serialized, std::pmr::memory_resource *arena);
+    /// @copydoc LoopGraph(std::span<const uint8_t>, std::pmr::memory_resource *)
+    explicit LoopGraph(std::span<const uint8_t> serialized)
+        : LoopGraph{ serialized, nullptr }
+    {
+    }
+    LoopGraph(LoopGraph &&) noexcept = default;
+    LoopGraph &operator=(LoopGraph &&) noexcept = default;
+
+    /// @brief Add a block.
+    /// @param block the component
+    /// @return Index of the block.
+    /// @throws `std::runtime_error` if `block` is `nullptr`.
+    std::uint32_t add_block(component_ptr &&block);
+    /// @brief Connect a source to the input of a block.
+    /// @param from the source
+    /// @param to index of the destination block
+    /// @param gain multiplier of the signal
+    /// @param delayed whether the output of the previous step is passed, see GraphEdge::delayed
+    /// @throws `std::runtime_error` if a port does not exist or an input is delayed.
+    void connect(GraphPort from, std::uint32_t to, double gain = 1.0, bool delayed = false);
+    /// @brief Add an output of the graph.
+    /// @param block index of the block whose output is the output of the graph
+    /// @return Index of the output.
+    /// @throws `std::runtime_error` if the block does not exist.
+    std::size_t add_output(std::uint32_t block);
+
+    /// Number of external inputs.
+    constexpr std::uint32_t input_count() const noexcept { return m_n_inputs; }
+    /// Number of blocks.
+    constexpr std::size_t size() const noexcept { return m_blocks.size(); }
+    /// @brief Access a block.
+    /// @throws `std::out_of_range` if index is not less than size().
+    const ObiektSISO &at(std::size_t index) const { return *m_blocks.at(index); }
+    /// @copydoc at(std::size_t) const
+    ObiektSISO &at(std::size_t index) { return *m_blocks.at(index); }
+    /// Connections of the graph.
+    std::span<const GraphEdge> edges() const noexcept { return m_edges; }
+    /// Blocks whose outputs are the outputs of the graph.
+    std::span<const std::uint32_t> outputs() const noexcept { return m_outputs; }
+    /// @brief Number of levels of independent stages.
+    /// @throws `std::runtime_error` if the graph is invalid, see simulate_multi().
+    std::size_t level_count();
+
+    /// @brief Simulate independent stages in parallel.
+    ///
+    /// The pool is used for levels which simulate at least `threshold` samples in total, so only
+    /// large graphs are split. The pool's wait() waits for all of its tasks, so it must not be used
+    /// by other threads or run this graph itself.
+    ///
+    /// @param pool the pool, `nullptr` to simulate in the calling thread
+    /// @param threshold minimal number of samples in a level simulated in parallel
+    void set_thread_pool(ThreadPool *pool, std::size_t threshold = 1 << 15) noexcept
+    {
+        m_pool = pool;
+        m_parallel_threshold = threshold;
+    }
+
+    /// @brief Simulate all inputs and outputs of the graph.
+    ///
+    /// Equivalent to simulating one step at a time: every block, in an order which respects the
+    /// undelayed edges, receives the sum of its incoming signals. Outputs may refer to the memory
+    /// of the inputs, but not partially overlap it.
+    ///
+    /// @param inputs one signal per external input, all of the same size
+    /// @param outputs signals for the first `outputs.size()` outputs, of the same size as inputs
+    /// @throws `std::runtime_error` if the numbers or sizes of signals don't match or the graph is
+    /// invalid: an edge or output refers to a missing block or a cycle has no delayed edge.
+    void simulate_multi(std::span<const std::span<const double>> inputs,
+                        std::span<const std::span<double>> outputs);
+    /// @brief Simulate one step with input 0.
+    /// @return Output 0.
+    /// @throws `std::runtime_error` if the graph doesn't have exactly one input, has no outputs or
+    /// is invalid.
+    double symuluj(double u) override;
+    /// @brief Simulate a block of samples of input 0 and output 0, see simulate_multi().
+    void simulate_block(std::span<const double> in, std::span<double> out) override;
+    /// Reset all blocks and the outputs of the previous step.
+    void reset() override;
+    std::size_t dump_size() const override;
+
+    /// Graphs are equal if they have the same structure and state.
+    friend bool operator==(const LoopGraph &a, const LoopGraph &b) { return a.dump() == b.dump(); }
+    friend bool operator!=(const LoopGraph &, const LoopGraph &) = default;
+#ifdef LAB_TESTS
+    friend class LoopGraphTests;
+#endif
+};
+DESERIALIZABLE_SISO(LoopGraph);
+
+#ifdef LAB_TESTS
+class LoopGraphTests {
+    static void test_matches_loops();
+    static void test_parallel_branches();
+    static void test_serialization();
+    static void test_invalid();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -1,20 +1,50 @@
 #ifndef LAB_TESTS
 #include "gui/MainWindow.hpp"
 #include <QApplication>
+#include <QTimer>
+#include <chrono>
+#include <cstdio>
 
 int main(int argc, char *argv[])
 {
+    const auto launched = std::chrono::steady_clock::now();
     QApplication app{ argc, argv };
     MainWindow main_window{};
     main_window.start();
+    // Print the time until the window and its deferred widgets are set up and quit, see
+    // bench/bench_startup.cpp
+    if (app.arguments().contains("--startup-time")) {
+        QTimer::singleShot(0, &app, [&app, launched]() {
+            const std::chrono::duration<double, std::milli> elapsed
+                = std::chrono::steady_clock::now() - launched;
+            std::printf("Started in %.3f ms\n", elapsed.count());
+            app.quit();
+        });
+    }
     return app.exec();
 }
 #else
 #include "ModelARX.h"
 #include "PętlaUAR.hpp"
 #include "RegulatorPID.h"
+#include "arx_kernel.hpp"
+#include "batch_loop.hpp"
+#include "checkpoint.hpp"
 #include "feedback_loop.hpp"
+#include "frozen_loop.hpp"
 #include "generators.hpp"
+#include "legacy_noise.hpp"
+#include "linear_fusion.hpp"
+#include "loop_graph.hpp"
+#include "minmax_pyramid.hpp"
+#include "paced_sim.hpp"
+#include "parameter_snapshot.hpp"
+#include "philox.hpp"
+#include "pid_tuner.hpp"
+#include "result_export.hpp"
+#include "result_store.hpp"
+#include "sim_worker.hpp"
+#include "sweep.hpp"
 
 int main()
 {
@@ -23,6 +53,22 @@ int main()
     FeedbackTests::run_tests();
     GeneratorTests::run_tests();
     UARTests::run_tests();
+    LoopGraphTests::run_tests();
+    KernelTests::run_tests();
+    FrozenLoopTests::run_tests();
+    SweepTests::run_tests();
+    PidTunerTests::run_tests();
+    PhiloxTests::run_tests();
+    LegacyNoiseTests::run_tests();
+    ResultStoreTests::run_tests();
+    MinMaxPyramidTests::run_tests();
+    ParameterSnapshotTests::run_tests();
+    SimulationWorkerTests::run_tests();
+    PacedSimulationTests::run_tests();
+    CheckpointTests::run_tests();
+    ResultExportTests::run_tests();
+    BatchLoopTests::run_tests();
+    FusionTests::run_tests();
     return 0;
 }
 #endif
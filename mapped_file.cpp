@@ -0,0 +1,104 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path &path)
+{
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error{ "Could not open the file" };
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error{ "Could not read the file size" };
+    }
+    m_size = static_cast<std::size_t>(size.QuadPart);
+    if (m_size == 0) {
+        CloseHandle(file);
+        return;
+    }
+    const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        throw std::runtime_error{ "Could not map the file" };
+    // The view keeps the mapping alive
+    m_data = static_cast<const std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (m_data == nullptr)
+        throw std::runtime_error{ "Could not map the file" };
+}
+
+void MappedFile::unmap() noexcept
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    m_data = nullptr;
+    m_size = 0;
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error{ "Could not open the file" };
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error{ "Could not read the file size" };
+    }
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size == 0) {
+        ::close(fd);
+        return;
+    }
+    // The mapping stays valid after closing the descriptor
+    void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        throw std::runtime_error{ "Could not map the file" };
+    }
+    m_data = static_cast<const std::uint8_t *>(data);
+}
+
+void MappedFile::unmap() noexcept
+{
+    if (m_data != nullptr)
+        ::munmap(const_cast<std::uint8_t *>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data{ std::exchange(other.m_data, nullptr) }
+    , m_size{ std::exchange(other.m_size, 0) }
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
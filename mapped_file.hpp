@@ -0,0 +1,42 @@
+/// @file mapped_file.hpp
+/// @brief Read-only memory mapping of a whole file.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+/// @brief Read-only mapping of a whole file into memory.
+///
+/// Pages are loaded by the operating system when they are first accessed, so mapping a file takes
+/// the same time regardless of its size and parts which are never accessed are never read. The
+/// mapping starts at a page boundary, so data at offsets aligned in the file is aligned in memory.
+class MappedFile {
+private:
+    /// Beginning of the mapping, `nullptr` for empty files.
+    const std::uint8_t *m_data{};
+    /// Size of the file.
+    std::size_t m_size{};
+
+    /// Unmap the file, if it is mapped.
+    void unmap() noexcept;
+
+public:
+    /// @brief Map a file.
+    /// @param path path of the file
+    /// @throws `std::runtime_error` if the file can't be opened or mapped.
+    explicit MappedFile(const std::filesystem::path &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    /// Take over the mapping of `other`, which becomes empty.
+    MappedFile(MappedFile &&other) noexcept;
+    /// Unmap the current file and take over the mapping of `other`, which becomes empty.
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile() { unmap(); }
+
+    /// Contents of the file.
+    std::span<const std::uint8_t> bytes() const noexcept { return { m_data, m_size }; }
+    /// Size of the file.
+    std::size_t size() const noexcept { return m_size; }
+};
@@ -0,0 +1,218 @@
+#include "minmax_pyramid.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+MinMaxPyramid::MinMaxPyramid(std::size_t base_bucket, std::size_t max_level_buckets)
+    : m_base_bucket{ base_bucket }
+    , m_max_level_buckets{ max_level_buckets }
+{
+    if (base_bucket == 0)
+        throw std::runtime_error{ "MinMaxPyramid bucket size must be positive" };
+    if (max_level_buckets < 2)
+        throw std::runtime_error{ "MinMaxPyramid must keep at least 2 buckets per level" };
+}
+
+void MinMaxPyramid::append(std::span<const double> values)
+{
+    if (values.empty())
+        return;
+    if (m_levels.empty())
+        m_levels.emplace_back();
+
+    std::size_t changed = m_size / m_base_bucket;
+    auto &level0 = m_levels.front().buckets;
+    for (const double v : values) {
+        if (m_size % m_base_bucket == 0)
+            level0.push_back({ m_origin + m_size, 0, v, v });
+        auto &b = level0.back();
+        ++b.count;
+        b.min = std::min(b.min, v);
+        b.max = std::max(b.max, v);
+        ++m_size;
+    }
+
+    // Recompute parents of the changed buckets, up to the level with a single bucket. Levels are
+    // trimmed only afterwards and keep at least 2 buckets, so the children of the changed parents
+    // are always available.
+    for (std::size_t l = 0; m_levels[l].end() > 1; ++l) {
+        if (l + 1 == m_levels.size())
+            m_levels.emplace_back();
+        const auto &children = m_levels[l];
+        auto &parents = m_levels[l + 1];
+        changed /= 2;
+        parents.buckets.resize((children.end() + 1) / 2 - parents.offset);
+        for (std::size_t p = std::max(changed, parents.offset); p < parents.end(); ++p) {
+            auto bucket = children.buckets[2 * p - children.offset];
+            if (2 * p + 1 < children.end()) {
+                const auto &second = children.buckets[2 * p + 1 - children.offset];
+                bucket.count += second.count;
+                bucket.min = std::min(bucket.min, second.min);
+                bucket.max = std::max(bucket.max, second.max);
+            }
+            parents.buckets[p - parents.offset] = bucket;
+        }
+    }
+
+    // Trimming to half of the limit makes the erasing amortized constant per bucket
+    for (auto &level : m_levels) {
+        if (level.buckets.size() / 2 < m_max_level_buckets)
+            continue;
+        const auto dropped = level.buckets.size() - m_max_level_buckets;
+        level.buckets.erase(level.buckets.begin(),
+                            level.buckets.begin() + static_cast<std::ptrdiff_t>(dropped));
+        level.offset += dropped;
+    }
+}
+
+void MinMaxPyramid::clear(std::size_t origin)
+{
+    m_levels.clear();
+    m_origin = origin;
+    m_size = 0;
+}
+
+std::vector<MinMaxBucket> MinMaxPyramid::query(std::size_t first, std::size_t last,
+                                               std::size_t max_buckets) const
+{
+    // Buckets are aligned to the origin
+    first = std::max(first, m_origin) - m_origin;
+    last = std::min(std::max(last, m_origin) - m_origin, m_size);
+    if (first >= last)
+        return {};
+    max_buckets = std::max<std::size_t>(max_buckets, 1);
+
+    // The last level has a single bucket and is never trimmed
+    std::size_t level = 0;
+    std::size_t bucket_size = m_base_bucket;
+    while (level + 1 < m_levels.size()
+           && ((last - 1) / bucket_size - first / bucket_size + 1 > max_buckets
+               || first / bucket_size < m_levels[level].offset)) {
+        ++level;
+        bucket_size *= 2;
+    }
+    const auto &[buckets, offset] = m_levels[level];
+    return { buckets.begin() + static_cast<std::ptrdiff_t>(first / bucket_size - offset),
+             buckets.begin() + static_cast<std::ptrdiff_t>((last - 1) / bucket_size + 1 - offset) };
+}
+
+std::size_t MinMaxPyramid::stored_buckets() const noexcept
+{
+    std::size_t n = 0;
+    for (const auto &level : m_levels)
+        n += level.buckets.size();
+    return n;
+}
+
+std::vector<MinMaxBucket> MinMaxPyramid::bucketize(std::span<const double> values,
+                                                   std::size_t first, std::size_t bucket_size)
+{
+    bucket_size = std::max<std::size_t>(bucket_size, 1);
+    std::vector<MinMaxBucket> buckets;
+    buckets.reserve((values.size() + bucket_size - 1) / bucket_size);
+    for (std::size_t i = 0; i < values.size(); i += bucket_size) {
+        const auto part = values.subspan(i, std::min(bucket_size, values.size() - i));
+        const auto [min, max] = std::ranges::minmax(part);
+        buckets.push_back({ first + i, part.size(), min, max });
+    }
+    return buckets;
+}
+
+#ifdef LAB_TESTS
+#include "util.hpp"
+#include <cmath>
+#include <format>
+
+void MinMaxPyramidTests::test_query()
+{
+    it_should_not_throw("MinMaxPyramid - buckets match the samples", [] {
+        std::vector<double> values(10'000);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            values[i] = std::sin(0.01 * static_cast<double>(i)) * static_cast<double>(i % 97);
+        MinMaxPyramid pyramid{ 8 };
+        // Uneven blocks, so that buckets are completed in different calls
+        for (std::size_t done = 0, n = 1; done < values.size(); done += n, n = n * 2 + 3) {
+            n = std::min(n, values.size() - done);
+            pyramid.append(std::span{ values }.subspan(done, n));
+        }
+        for (const auto [first, last, max_buckets] : { std::array<std::size_t, 3>{ 0, 10'000, 50 },
+                                                       { 1234, 5678, 100 },
+                                                       { 17, 20, 10 },
+                                                       { 9000, 20'000, 1 } }) {
+            const auto buckets = pyramid.query(first, last, max_buckets);
+            if (buckets.empty() || buckets.size() > max_buckets)
+                throw std::runtime_error{ std::format("{} buckets for max {} in [{}, {})",
+                                                      buckets.size(), max_buckets, first, last) };
+            if (buckets.front().first > first
+                || buckets.back().first + buckets.back().count < std::min(last, values.size()))
+                throw std::runtime_error{ "Buckets do not cover the range" };
+            for (const auto &b : buckets) {
+                const auto [min, max] = std::ranges::minmax(std::span{ values }.subspan(b.first,
+                                                                                        b.count));
+                if (b.min != min || b.max != max)
+                    throw std::runtime_error{ std::format("Wrong bucket at {}", b.first) };
+            }
+        }
+    });
+}
+
+void MinMaxPyramidTests::test_bucketize()
+{
+    it_should_not_throw("MinMaxPyramid - bucketize", [] {
+        const std::vector values{ 1.0, -2.0, 3.0, 0.5, 7.0 };
+        const auto buckets = MinMaxPyramid::bucketize(values, 10, 2);
+        if (buckets.size() != 3 || buckets[0].min != -2.0 || buckets[1].max != 3.0
+            || buckets[2].first != 14 || buckets[2].count != 1 || buckets[2].min != 7.0)
+            throw std::runtime_error{ "Wrong buckets" };
+        // A pyramid of the same samples starting at the same index has the same buckets
+        MinMaxPyramid pyramid{ 2 };
+        pyramid.clear(10);
+        pyramid.append(values);
+        const auto queried = pyramid.query(0, 100, 10);
+        if (queried.size() != 3 || queried[2].first != 14 || queried[1].max != 3.0
+            || !pyramid.query(0, 10, 10).empty())
+            throw std::runtime_error{ "Wrong buckets with an origin" };
+    });
+}
+
+void MinMaxPyramidTests::test_trimmed()
+{
+    it_should_not_throw("MinMaxPyramid - trimmed levels", [] {
+        std::vector<double> values(100'000);
+        for (std::size_t i = 0; i < values.size(); ++i)
+            values[i] = std::cos(0.003 * static_cast<double>(i)) * static_cast<double>(i % 89);
+        MinMaxPyramid pyramid{ 4, 32 };
+        for (std::size_t done = 0; done < values.size(); done += 999)
+            pyramid.append(std::span{ values }.subspan(done, std::min<std::size_t>(
+                                                                 999, values.size() - done)));
+        // 16 levels of less than 64 buckets instead of about 2 * 25'000
+        if (pyramid.stored_buckets() > 16 * 64)
+            throw std::runtime_error{ std::format("{} buckets stored",
+                                                  pyramid.stored_buckets()) };
+        for (const auto [first, last, max_buckets, min_buckets] :
+             { std::array<std::size_t, 4>{ 99'900, 100'000, 100, 25 },
+               { 0, 100'000, 50, 1 },
+               { 10, 20, 100, 1 } }) {
+            const auto buckets = pyramid.query(first, last, max_buckets);
+            if (buckets.size() < min_buckets || buckets.size() > max_buckets)
+                throw std::runtime_error{ std::format("{} buckets for max {} in [{}, {})",
+                                                      buckets.size(), max_buckets, first, last) };
+            if (buckets.front().first > first
+                || buckets.back().first + buckets.back().count < last)
+                throw std::runtime_error{ "Buckets do not cover the range" };
+            for (const auto &b : buckets) {
+                const auto [min, max] = std::ranges::minmax(std::span{ values }.subspan(b.first,
+                                                                                        b.count));
+                if (b.min != min || b.max != max)
+                    throw std::runtime_error{ std::format("Wrong bucket at {}", b.first) };
+            }
+        }
+    });
+}
+
+void MinMaxPyramidTests::run_tests()
+{
+    test_query();
+    test_bucketize();
+    test_trimmed();
+}
+#endif
@@ -0,0 +1,109 @@
+/// @file minmax_pyramid.hpp
+/// @brief Multi-resolution min/max summaries of a growing signal, used for plotting.
+
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+/// Summary of a range of samples.
+struct MinMaxBucket {
+    /// Index of the first sample.
+    std::size_t first;
+    /// Number of samples.
+    std::size_t count;
+    /// Smallest value.
+    double min;
+    /// Largest value.
+    double max;
+};
+
+/// @brief Min/max pyramid over an append-only signal.
+///
+/// Level `l` stores the minimum and maximum of every `base_bucket << l` consecutive samples, so a
+/// range of any length can be summarized with a bounded number of buckets without reading the
+/// samples themselves. Appending updates only the buckets covering the new samples.
+///
+/// Every level keeps at most about `2 * max_level_buckets` of its newest buckets, so fine levels
+/// only summarize the recent samples (e.g. the ones kept in memory by a ResultStore) and memory
+/// grows only with the number of levels. Older ranges are summarized by coarser levels.
+class MinMaxPyramid {
+private:
+    /// Buckets of a level.
+    struct Level {
+        /// The newest buckets, the last one may be partial.
+        std::vector<MinMaxBucket> buckets;
+        /// Index of the first bucket in #buckets within the level.
+        std::size_t offset{};
+
+        /// Index after the last bucket of the level.
+        std::size_t end() const noexcept { return offset + buckets.size(); }
+    };
+
+    /// Number of samples in a bucket of level 0.
+    std::size_t m_base_bucket;
+    /// Number of buckets a level is trimmed to.
+    std::size_t m_max_level_buckets;
+    /// All levels, from the finest one.
+    std::vector<Level> m_levels;
+    /// Index of the first appended sample.
+    std::size_t m_origin{};
+    /// Number of appended samples.
+    std::size_t m_size{};
+
+public:
+    /// @brief Construct an empty pyramid.
+    /// @param base_bucket number of samples in a bucket of the finest level
+    /// @param max_level_buckets number of the newest buckets kept by every level when it grows to
+    /// twice as many, unlimited by default
+    /// @throws `std::runtime_error` if `base_bucket` is 0 or `max_level_buckets` is less than 2.
+    explicit MinMaxPyramid(std::size_t base_bucket = 64,
+                           std::size_t max_level_buckets = std::numeric_limits<std::size_t>::max());
+
+    /// @brief Append samples.
+    /// @param values new samples
+    void append(std::span<const double> values);
+    /// @brief Remove all samples.
+    /// @param origin index of the next appended sample, for a signal without its beginning
+    void clear(std::size_t origin = 0);
+    /// @brief Summarize a range using the finest level with at most `max_buckets` buckets.
+    ///
+    /// Buckets are aligned to the level, so the first and the last one may extend outside of the
+    /// range. Levels which no longer keep the beginning of the range are skipped.
+    ///
+    /// @param first index of the first sample, clamped to origin()
+    /// @param last index after the last sample, clamped to `origin() + size()`
+    /// @param max_buckets maximum number of returned buckets, at least 1
+    /// @return Buckets covering the range, in order; fewer than `max_buckets` if even the finest
+    /// level is coarser than requested.
+    std::vector<MinMaxBucket> query(std::size_t first, std::size_t last,
+                                    std::size_t max_buckets) const;
+    /// @brief Summarize raw samples in buckets of a fixed size.
+    /// @param values samples
+    /// @param first index of `values[0]`, stored in the result
+    /// @param bucket_size number of samples in a bucket, at least 1
+    /// @return Buckets covering `values`, the last one may be partial.
+    static std::vector<MinMaxBucket> bucketize(std::span<const double> values, std::size_t first,
+                                               std::size_t bucket_size);
+
+    /// Number of appended samples.
+    std::size_t size() const noexcept { return m_size; }
+    /// Index of the first appended sample, see clear().
+    std::size_t origin() const noexcept { return m_origin; }
+    /// Number of samples in a bucket of the finest level.
+    std::size_t base_bucket() const noexcept { return m_base_bucket; }
+    /// Number of buckets kept by all levels.
+    std::size_t stored_buckets() const noexcept;
+};
+
+#ifdef LAB_TESTS
+class MinMaxPyramidTests {
+    static void test_query();
+    static void test_bucketize();
+    static void test_trimmed();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,383 @@
+#include "paced_sim.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+std::size_t LatencyHistogram::bucket(std::uint64_t ns) noexcept
+{
+    if (ns < 4)
+        return static_cast<std::size_t>(ns);
+    // 2 bits below the highest set bit select one of 4 buckets of the power of 2
+    const auto exponent = static_cast<unsigned>(std::bit_width(ns)) - 1;
+    const auto sub = (ns >> (exponent - 2)) & 3;
+    return 4 * (exponent - 1) + static_cast<std::size_t>(sub);
+}
+
+std::uint64_t LatencyHistogram::bucket_max(std::size_t index) noexcept
+{
+    if (index < 4)
+        return index;
+    const auto exponent = static_cast<unsigned>(index / 4 + 1);
+    const std::uint64_t sub = index % 4;
+    // Wraps around to the largest value for the last bucket
+    return ((5 + sub) << (exponent - 2)) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) noexcept
+{
+    constexpr auto relaxed = std::memory_order_relaxed;
+    const auto ns = static_cast<std::uint64_t>(std::max(latency.count(), std::int64_t{}));
+    // There is a single writer, so plain loads and stores are enough
+    auto &b = m_buckets[bucket(ns)];
+    b.store(b.load(relaxed) + 1, relaxed);
+    m_sum.store(m_sum.load(relaxed) + ns, relaxed);
+    if (ns > m_max.load(relaxed))
+        m_max.store(ns, relaxed);
+    m_count.store(m_count.load(relaxed) + 1, relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::mean() const noexcept
+{
+    const auto n = count();
+    return std::chrono::nanoseconds{ n == 0 ? 0 : m_sum.load(std::memory_order_relaxed) / n };
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double q) const noexcept
+{
+    const auto n = count();
+    if (n == 0)
+        return {};
+    const auto fraction = std::clamp(q, 0.0, 1.0);
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(n))));
+    const auto max_ns = m_max.load(std::memory_order_relaxed);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::chrono::nanoseconds{ std::min(bucket_max(i), max_ns) };
+    }
+    // Buckets updated after the count was read
+    return std::chrono::nanoseconds{ max_ns };
+}
+
+LatencySummary summarize(const LatencyHistogram &histogram) noexcept
+{
+    return { histogram.count(), histogram.mean(), histogram.percentile(0.5),
+             histogram.percentile(0.99), histogram.max() };
+}
+
+std::string format_stats(const PacingStats &stats)
+{
+    const auto us = [](std::chrono::nanoseconds ns) {
+        return std::chrono::duration<double, std::micro>{ ns }.count();
+    };
+    const auto miss_percent = stats.steps == 0 ? 0.0
+                                               : 100.0 * static_cast<double>(stats.misses)
+                                                   / static_cast<double>(stats.steps);
+    return std::format("{} steps at {:.1f} us, {} missed ({:.2f}%), {} skipped, "
+                       "wake-up p50/p99/max {:.1f}/{:.1f}/{:.1f} us, "
+                       "latency p50/p99/max {:.1f}/{:.1f}/{:.1f} us{}",
+                       stats.steps, us(stats.period), stats.misses, miss_percent, stats.skipped,
+                       us(stats.wakeup.p50), us(stats.wakeup.p99), us(stats.wakeup.max),
+                       us(stats.latency.p50), us(stats.latency.p99), us(stats.latency.max),
+                       stats.pinned ? ", pinned" : "");
+}
+
+PacedScheduler::PacedScheduler(std::chrono::nanoseconds period)
+    : m_period{ period }
+{
+    if (period <= std::chrono::nanoseconds::zero())
+        throw std::runtime_error{ "Sample period must be positive" };
+}
+
+PacedScheduler::clock::time_point PacedScheduler::wait()
+{
+    const auto deadline = m_next;
+#ifdef __linux__
+    // libstdc++ and libc++ implement steady_clock with CLOCK_MONOTONIC
+    const auto since_epoch = deadline.time_since_epoch();
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(seconds.count());
+    ts.tv_nsec = static_cast<long>((since_epoch - seconds).count());
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+    m_next += m_period;
+    return deadline;
+}
+
+std::uint64_t PacedScheduler::skip_missed(clock::time_point now) noexcept
+{
+    if (now <= m_next)
+        return 0;
+    const auto missed = static_cast<std::uint64_t>((now - m_next) / m_period) + 1;
+    m_next += m_period * static_cast<std::int64_t>(missed);
+    return missed;
+}
+
+bool pin_current_thread(unsigned cpu) noexcept
+{
+#ifdef _WIN32
+    if (cpu >= sizeof(DWORD_PTR) * 8)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << cpu) != 0;
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+PacedSimulation::PacedSimulation(std::unique_ptr<ObiektSISO> loop, std::vector<double> inputs,
+                                 std::chrono::nanoseconds period, std::optional<unsigned> cpu)
+    : BackgroundSimulation{ std::move(loop), std::move(inputs) }
+    , m_period{ period }
+    , m_cpu{ cpu }
+{
+    if (!m_loop)
+        throw std::runtime_error{ "PacedSimulation loop must not be null" };
+    if (period <= std::chrono::nanoseconds::zero())
+        throw std::runtime_error{ "Sample period must be positive" };
+    start();
+}
+
+void PacedSimulation::run(std::stop_token stop)
+{
+    using namespace std::chrono_literals;
+    using clock = PacedScheduler::clock;
+    try {
+        if (m_cpu)
+            m_pinned.store(pin_current_thread(*m_cpu));
+        const auto publish_steps = std::max<std::size_t>(
+            1, static_cast<std::size_t>(publish_interval / m_period));
+        std::size_t published = 0;
+        ResultBatch batch;
+        // A full queue never blocks the steps, the batch grows until there is free space. Only the
+        // last batch waits for the consumer.
+        const auto publish = [&](bool wait) {
+            if (batch.inputs.empty())
+                return;
+            const auto n = batch.inputs.size();
+            while (!m_results.try_push(std::move(batch))) {
+                if (!wait || m_discard.load())
+                    return;
+                std::this_thread::sleep_for(1ms);
+            }
+            published += n;
+            m_done.store(published, std::memory_order_release);
+            batch = ResultBatch{ published, {}, {} };
+            batch.inputs.reserve(publish_steps);
+            batch.outputs.reserve(publish_steps);
+        };
+
+        PacedScheduler scheduler{ m_period };
+        scheduler.start(clock::now());
+        std::size_t i = 0;
+        while (i < m_inputs.size() && !stop.stop_requested()) {
+            if (m_paused.load()) {
+                publish(true);
+                m_paused.wait(true);
+                scheduler.start(clock::now());
+                continue;
+            }
+            apply_snapshot();
+            const auto deadline = scheduler.wait();
+            const auto woke = clock::now();
+            const auto u = m_inputs[i++];
+            const auto y = m_loop->symuluj(u);
+            const auto end = clock::now();
+
+            m_wakeup.record(woke - deadline);
+            m_latency.record(end - deadline);
+            if (end - deadline > m_period) {
+                m_misses.store(m_misses.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+                m_skipped.store(m_skipped.load(std::memory_order_relaxed)
+                                    + scheduler.skip_missed(end),
+                                std::memory_order_relaxed);
+            }
+            batch.inputs.push_back(u);
+            batch.outputs.push_back(y);
+            if (batch.inputs.size() >= publish_steps)
+                publish(false);
+        }
+        publish(true);
+        apply_snapshot();
+    } catch (...) {
+        m_error = std::current_exception();
+    }
+    m_finished.store(true, std::memory_order_release);
+}
+
+PacingStats PacedSimulation::stats() const noexcept
+{
+    return { m_latency.count(),
+             m_misses.load(std::memory_order_relaxed),
+             m_skipped.load(std::memory_order_relaxed),
+             m_period,
+             summarize(m_wakeup),
+             summarize(m_latency),
+             m_pinned.load() };
+}
+
+#ifdef LAB_TESTS
+#include "ModelARX.h"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include "util.hpp"
+
+void PacedSimulationTests::test_histogram()
+{
+    it_should_not_throw("LatencyHistogram - percentiles within a bucket", [] {
+        using namespace std::chrono_literals;
+        LatencyHistogram h;
+        if (h.count() != 0 || h.percentile(0.5) != 0ns || h.mean() != 0ns)
+            throw std::runtime_error{ "Empty histogram is not empty" };
+        for (int i = 1; i <= 100; ++i)
+            h.record(std::chrono::microseconds{ i });
+        h.record(-5ns);
+        const auto p50 = h.percentile(0.5);
+        const auto p99 = h.percentile(0.99);
+        if (h.count() != 101 || h.max() != 100us || h.percentile(1.0) != 100us)
+            throw std::runtime_error{ "Wrong count or maximum" };
+        if (h.mean() != 5050us / 101)
+            throw std::runtime_error{ std::format("Wrong mean {} ns", h.mean().count()) };
+        // Buckets are at most 25% wide
+        if (p50 < 50us || p50 > 50us * 5 / 4 || p99 < 99us || p99 > 100us)
+            throw std::runtime_error{ std::format("Wrong percentiles {} {} ns", p50.count(),
+                                                              p99.count()) };
+        if (h.percentile(0.0) != 0ns)
+            throw std::runtime_error{ "Negative latency not recorded as 0" };
+    });
+}
+
+void PacedSimulationTests::test_scheduler()
+{
+    it_should_not_throw("PacedScheduler - absolute deadlines", [] {
+        using namespace std::chrono_literals;
+        PacedScheduler scheduler{ 2ms };
+        const auto start = PacedScheduler::clock::now();
+        scheduler.start(start);
+        for (int k = 0; k < 5; ++k) {
+            const auto deadline = scheduler.wait();
+            if (deadline != start + k * 2ms || PacedScheduler::clock::now() < deadline)
+                throw std::runtime_error{ std::format("Wrong deadline {}", k) };
+        }
+        if (scheduler.skip_missed(start + 9ms) != 0)
+            throw std::runtime_error{ "Skipped a deadline in the future" };
+        // Deadlines at 10, 12 and 14 ms passed
+        if (scheduler.skip_missed(start + 15ms) != 3 || scheduler.next() != start + 16ms)
+            throw std::runtime_error{ "Wrong number of skipped deadlines" };
+    });
+    it_should_throw<std::runtime_error>("PacedScheduler - zero period",
+                                        [] { PacedScheduler{ std::chrono::nanoseconds{} }; });
+}
+
+void PacedSimulationTests::test_matches_direct()
+{
+    it_should_not_throw("PacedSimulation - same results as direct simulation", [] {
+        using namespace std::chrono_literals;
+        PętlaUAR direct;
+        direct.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+        direct.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 1));
+        std::vector<double> inputs(200);
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            inputs[i] = (i / 50) % 2 ? 1.0 : -0.5;
+
+        constexpr auto period = 200us;
+        const auto start = PacedScheduler::clock::now();
+        PacedSimulation sim{ ObiektSISO::deserialize(direct.dump()), inputs, period };
+        std::vector<ResultBatch> batches;
+        while (true) {
+            const bool finished = sim.finished();
+            while (auto batch = sim.poll())
+                batches.push_back(std::move(*batch));
+            if (finished)
+                break;
+            std::this_thread::sleep_for(1ms);
+        }
+        const auto loop = sim.take_loop();
+        const auto elapsed = PacedScheduler::clock::now() - start;
+
+        std::size_t next = 0;
+        for (const auto &b : batches) {
+            if (b.first != next || b.inputs.size() != b.outputs.size())
+                throw std::runtime_error{ std::format("Unexpected batch at {}", b.first) };
+            for (std::size_t i = 0; i < b.outputs.size(); ++i) {
+                if (b.inputs[i] != inputs[next + i]
+                    || b.outputs[i] != direct.symuluj(inputs[next + i]))
+                    throw std::runtime_error{ std::format("Wrong output {}", next + i) };
+            }
+            next += b.outputs.size();
+        }
+        const auto stats = sim.stats();
+        if (next != inputs.size() || sim.progress() != inputs.size()
+            || stats.steps != inputs.size() || stats.wakeup.count != stats.steps)
+            throw std::runtime_error{ "Not all steps were published" };
+        // Missed deadlines are skipped, so the run can only take longer
+        if (elapsed < period * static_cast<long>(inputs.size() - 1))
+            throw std::runtime_error{ "Steps were not paced" };
+        if (stats.latency.max < stats.latency.p99 || stats.latency.max < stats.wakeup.max)
+            throw std::runtime_error{ "Inconsistent latencies" };
+        if (loop->dump() != direct.dump())
+            throw std::runtime_error{ "Loop state differs after the simulation" };
+    });
+}
+
+void PacedSimulationTests::test_cancel()
+{
+    it_should_not_throw("PacedSimulation - cancel", [] {
+        using namespace std::chrono_literals;
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0));
+        PacedSimulation sim{ ObiektSISO::deserialize(loop.dump()), std::vector<double>(1000, 1.0),
+                             5ms };
+        std::this_thread::sleep_for(20ms);
+        sim.cancel();
+        sim.take_loop();
+        std::size_t published = 0;
+        while (auto batch = sim.poll())
+            published += batch->outputs.size();
+        if (published != sim.progress() || published != sim.stats().steps
+            || published >= sim.total())
+            throw std::runtime_error{ std::format("{} of {} steps published, progress {}",
+                                                  published, sim.total(), sim.progress()) };
+    });
+}
+
+void PacedSimulationTests::run_tests()
+{
+    test_histogram();
+    test_scheduler();
+    test_matches_direct();
+    test_cancel();
+}
+#endif
@@ -0,0 +1,195 @@
+/// @file paced_sim.hpp
+/// @brief Real-time simulation of a loop at a fixed sample period, with deadline monitoring.
+
+#pragma once
+#include "sim_worker.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/// @brief Histogram of latencies, recorded by one thread and read by any.
+///
+/// Buckets are log-linear: every power of 2 is split into 4 buckets, so a percentile is known
+/// with a relative error of at most 25% for any latency, from nanoseconds to hours. Recording is
+/// wait-free and does not use atomic read-modify-write operations.
+class LatencyHistogram {
+public:
+    /// Number of buckets, enough for all 64-bit values.
+    static constexpr std::size_t bucket_count = 252;
+
+private:
+    /// Number of latencies in each bucket.
+    std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets{};
+    /// Number of recorded latencies.
+    std::atomic<std::uint64_t> m_count{};
+    /// Sum of recorded latencies in nanoseconds.
+    std::atomic<std::uint64_t> m_sum{};
+    /// Maximum recorded latency in nanoseconds.
+    std::atomic<std::uint64_t> m_max{};
+
+    /// Index of the bucket of `ns`.
+    static std::size_t bucket(std::uint64_t ns) noexcept;
+    /// Largest value in the bucket with index `index`.
+    static std::uint64_t bucket_max(std::size_t index) noexcept;
+
+public:
+    /// @brief Record a latency (one thread only).
+    /// @param latency the latency, negative values are recorded as 0
+    void record(std::chrono::nanoseconds latency) noexcept;
+    /// Number of recorded latencies.
+    std::uint64_t count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+    /// Mean latency, 0 if nothing was recorded.
+    std::chrono::nanoseconds mean() const noexcept;
+    /// Maximum latency, 0 if nothing was recorded.
+    std::chrono::nanoseconds max() const noexcept
+    {
+        return std::chrono::nanoseconds{ m_max.load(std::memory_order_relaxed) };
+    }
+    /// @brief Latency which is not exceeded by a fraction of the recorded latencies.
+    /// @param q the fraction, from 0 to 1
+    /// @return Upper bound of the bucket containing the percentile, at most max().
+    std::chrono::nanoseconds percentile(double q) const noexcept;
+};
+
+/// Summary of a LatencyHistogram.
+struct LatencySummary {
+    /// Number of recorded latencies.
+    std::uint64_t count{};
+    std::chrono::nanoseconds mean{};
+    /// Median.
+    std::chrono::nanoseconds p50{};
+    /// 99th percentile.
+    std::chrono::nanoseconds p99{};
+    std::chrono::nanoseconds max{};
+};
+
+/// @brief Summarize a histogram.
+/// @param histogram the histogram
+LatencySummary summarize(const LatencyHistogram &histogram) noexcept;
+
+/// Statistics of a paced simulation.
+struct PacingStats {
+    /// Number of simulated steps.
+    std::uint64_t steps{};
+    /// Number of steps which finished after the deadline of the next step.
+    std::uint64_t misses{};
+    /// Number of periods skipped after the misses, in which no step was simulated.
+    std::uint64_t skipped{};
+    /// Sample period.
+    std::chrono::nanoseconds period{};
+    /// Delay between the deadline of a step and waking up for it (jitter of the scheduler).
+    LatencySummary wakeup;
+    /// Delay between the deadline of a step and the end of its simulation.
+    LatencySummary latency;
+    /// Whether the simulation thread is pinned to a CPU.
+    bool pinned{};
+};
+
+/// @brief Format statistics as a single line of text.
+/// @param stats the statistics
+/// @return Text like "1000 steps, 0 missed (0.00%), wake-up p50/p99/max 52.1/80.3/120.0 us, ...".
+std::string format_stats(const PacingStats &stats);
+
+/// @brief Source of absolute deadlines at a fixed period.
+///
+/// Sleeping until an absolute deadline, like `clock_nanosleep(TIMER_ABSTIME)`, instead of for a
+/// period does not accumulate the time spent by the step and the scheduling error. On Linux it is
+/// exactly clock_nanosleep() on `CLOCK_MONOTONIC`, the clock of `std::chrono::steady_clock`.
+class PacedScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    /// Time between deadlines.
+    std::chrono::nanoseconds m_period;
+    /// The next deadline.
+    clock::time_point m_next{};
+
+public:
+    /// @param period time between deadlines
+    /// @throws `std::runtime_error` if `period` is not positive.
+    explicit PacedScheduler(std::chrono::nanoseconds period);
+    /// @brief Set the first deadline.
+    /// @param first the deadline
+    void start(clock::time_point first) noexcept { m_next = first; }
+    /// The next deadline.
+    clock::time_point next() const noexcept { return m_next; }
+    /// @brief Sleep until the next deadline and advance it by one period.
+    /// @return The deadline.
+    clock::time_point wait();
+    /// @brief Skip the deadlines which already passed, so a late step is not followed by a burst
+    /// of steps catching up.
+    /// @param now current time
+    /// @return Number of skipped deadlines.
+    std::uint64_t skip_missed(clock::time_point now) noexcept;
+};
+
+/// @brief Pin the calling thread to a CPU.
+/// @param cpu index of the CPU
+/// @return `false` if the CPU does not exist, pinning is not permitted or not supported.
+bool pin_current_thread(unsigned cpu) noexcept;
+
+/// @brief Simulates a loop in a background thread in real time, one step per sample period.
+///
+/// Unlike SimulationWorker, steps are simulated one by one at absolute deadlines (see
+/// PacedScheduler), e.g. to drive hardware in the loop. For every step the delay of waking up and
+/// of finishing the step after its deadline is recorded. A step which takes longer than a period is
+/// a deadline miss, after which the missed deadlines are skipped. Results are published about every
+/// 10 ms without ever blocking the simulation thread; parameters and pausing apply between steps.
+/// Pacing restarts when a paused simulation is resumed.
+class PacedSimulation : public BackgroundSimulation {
+public:
+    /// Time between published batches.
+    static constexpr std::chrono::milliseconds publish_interval{ 10 };
+
+private:
+    /// Sample period.
+    std::chrono::nanoseconds m_period;
+    /// CPU to which the simulation thread is pinned.
+    std::optional<unsigned> m_cpu;
+    /// Delays of waking up after the deadlines.
+    LatencyHistogram m_wakeup;
+    /// Delays of finishing the steps after their deadlines.
+    LatencyHistogram m_latency;
+    /// Number of deadline misses.
+    std::atomic<std::uint64_t> m_misses{};
+    /// Number of skipped deadlines.
+    std::atomic<std::uint64_t> m_skipped{};
+    /// Whether the thread was pinned to #m_cpu.
+    std::atomic<bool> m_pinned{};
+
+    void run(std::stop_token stop) override;
+
+public:
+    /// @brief Start simulating. The first step is simulated immediately.
+    /// @param loop loop to simulate, owned by the simulation until take_loop()
+    /// @param inputs inputs of the run, one per period
+    /// @param period sample period
+    /// @param cpu CPU to which the simulation thread is pinned, see pin_current_thread()
+    /// @throws `std::runtime_error` if `loop` is `nullptr` or `period` is not positive.
+    PacedSimulation(std::unique_ptr<ObiektSISO> loop, std::vector<double> inputs,
+                    std::chrono::nanoseconds period, std::optional<unsigned> cpu = std::nullopt);
+    /// Cancel the simulation and join the thread.
+    ~PacedSimulation() override { stop(); }
+
+    /// Sample period.
+    std::chrono::nanoseconds period() const noexcept { return m_period; }
+    /// Current statistics, may be read while the simulation runs.
+    PacingStats stats() const noexcept;
+};
+
+#ifdef LAB_TESTS
+class PacedSimulationTests {
+    static void test_histogram();
+    static void test_scheduler();
+    static void test_matches_direct();
+    static void test_cancel();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,205 @@
+#include "parameter_snapshot.hpp"
+#include "ModelARX.h"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace {
+/// @brief Cast an edited component to the type of the parameters.
+/// @throws `std::runtime_error` if the type differs.
+template <typename T> T &edit_target(ObiektSISO &target)
+{
+    const auto ptr = dynamic_cast<T *>(&target);
+    if (ptr == nullptr)
+        throw std::runtime_error{ "Edited component has a different type" };
+    return *ptr;
+}
+}
+
+ComponentParameters capture_parameters(const ObiektSISO &source)
+{
+    if (const auto pid = dynamic_cast<const RegulatorPID *>(&source))
+        return PIDParameters{ pid->get_k(), pid->get_ti(), pid->get_td() };
+    if (const auto obj = dynamic_cast<const ObiektStatyczny *>(&source)) {
+        const auto [p1, p2] = obj->get_points();
+        return StaticParameters{ p1, p2 };
+    }
+    if (const auto arx = dynamic_cast<const ModelARX *>(&source)) {
+        const auto coeff_a = arx->get_coeff_a();
+        const auto coeff_b = arx->get_coeff_b();
+        return ARXParameters{ { coeff_a.begin(), coeff_a.end() },
+                              { coeff_b.begin(), coeff_b.end() },
+                              static_cast<std::int32_t>(arx->get_transport_delay()),
+                              arx->get_stddev() };
+    }
+    if (const auto uar = dynamic_cast<const PętlaUAR *>(&source))
+        return UARParameters{ uar->get_closed(), uar->get_last_result() };
+    throw std::runtime_error{ "Unsupported component type" };
+}
+
+void apply_parameters(ObiektSISO &target, const ComponentParameters &parameters)
+{
+    std::visit(
+        [&target](const auto &p) {
+            using P = std::remove_cvref_t<decltype(p)>;
+            if constexpr (std::is_same_v<P, PIDParameters>) {
+                auto &t = edit_target<RegulatorPID>(target);
+                t.set_k(p.k);
+                t.set_ti(p.ti);
+                t.set_td(p.td);
+            } else if constexpr (std::is_same_v<P, StaticParameters>) {
+                edit_target<ObiektStatyczny>(target).set_points(p.p1, p.p2);
+            } else if constexpr (std::is_same_v<P, ARXParameters>) {
+                auto &t = edit_target<ModelARX>(target);
+                auto coeff_a = p.coeff_a;
+                auto coeff_b = p.coeff_b;
+                t.set_coeff_a(std::move(coeff_a));
+                t.set_coeff_b(std::move(coeff_b));
+                t.set_transport_delay(p.delay);
+                t.set_stddev(p.stddev);
+            } else {
+                static_assert(std::is_same_v<P, UARParameters>);
+                auto &t = edit_target<PętlaUAR>(target);
+                t.set_closed(p.closed);
+                t.set_init(p.init);
+            }
+        },
+        parameters);
+}
+
+ParameterSnapshot ParameterSnapshot::with(std::vector<std::size_t> path,
+                                          ComponentParameters parameters) const
+{
+    ParameterSnapshot next{ *this };
+    ++next.m_version;
+    auto entry = std::make_shared<const Entry>(
+        Entry{ std::move(path), next.m_version, std::move(parameters) });
+    const auto same = std::ranges::find_if(
+        next.m_entries, [&entry](const auto &e) { return e->path == entry->path; });
+    if (same != next.m_entries.end())
+        *same = std::move(entry);
+    else
+        next.m_entries.push_back(std::move(entry));
+    return next;
+}
+
+void ParameterSnapshot::apply_since(ObiektSISO &root, std::uint64_t applied) const
+{
+    // Entries changed earlier were already applied and e.g. setting the initial value of a loop
+    // again would overwrite its state
+    for (const auto &entry : m_entries)
+        if (entry->version > applied)
+            apply_parameters(find_component(root, entry->path), entry->parameters);
+}
+
+ParameterMailbox::~ParameterMailbox()
+{
+    delete m_pending.load();
+    delete m_retired.load();
+}
+
+void ParameterMailbox::publish(ParameterSnapshot snapshot)
+{
+    // Release the snapshot applied most recently, unless the consumer didn't retire it yet
+    delete m_retired.exchange(nullptr, std::memory_order_acquire);
+    auto next = new ParameterSnapshot{ std::move(snapshot) };
+    delete m_pending.exchange(next, std::memory_order_acq_rel);
+}
+
+bool ParameterMailbox::apply(ObiektSISO &root)
+{
+    const auto snapshot = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+    if (snapshot == nullptr)
+        return false;
+    // Always hand the snapshot back, a snapshot retired before is only left if publish() didn't
+    // run since then
+    struct Retire {
+        ParameterMailbox &mailbox;
+        ParameterSnapshot *snapshot;
+        ~Retire() { delete mailbox.m_retired.exchange(snapshot, std::memory_order_acq_rel); }
+    } retire{ *this, snapshot };
+    const auto applied = std::exchange(m_applied, snapshot->version());
+    snapshot->apply_since(root, applied);
+    return true;
+}
+
+#ifdef LAB_TESTS
+#include "util.hpp"
+#include <format>
+
+void ParameterSnapshotTests::test_copy_on_write()
+{
+    it_should_not_throw("ParameterSnapshot - versions share unchanged parameters", [] {
+        const ParameterSnapshot empty;
+        const auto first = empty.with({ 0 }, PIDParameters{ 2.0, 1.0, 0.0 });
+        const auto second = first.with({ 1 }, StaticParameters{ { 0.0, 0.0 }, { 1.0, 2.0 } });
+        const auto third = second.with({ 0 }, PIDParameters{ 3.0, 1.0, 0.0 });
+        if (empty.version() != 0 || first.version() != 1 || third.version() != 3)
+            throw std::runtime_error{ std::format("Unexpected versions {} {} {}", empty.version(),
+                                                  first.version(), third.version()) };
+        if (!empty.entries().empty() || first.entries().size() != 1
+            || third.entries().size() != 2)
+            throw std::runtime_error{ "Unexpected number of entries" };
+        if (second.entries()[0] != first.entries()[0]
+            || third.entries()[1] != second.entries()[1])
+            throw std::runtime_error{ "Unchanged parameters are not shared" };
+        if (std::get<PIDParameters>(first.entries()[0]->parameters).k != 2.0
+            || std::get<PIDParameters>(third.entries()[0]->parameters).k != 3.0
+            || third.entries()[0]->version != 3)
+            throw std::runtime_error{ "Published parameters were modified" };
+    });
+    it_should_not_throw("ParameterSnapshot - only newer parameters are applied", [] {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        loop.push_back(std::make_unique<ObiektStatyczny>());
+        const auto first = ParameterSnapshot{}.with({}, UARParameters{ true, 5.0 });
+        const auto second = first.with({ 0 }, PIDParameters{ 2.0, 0.0, 0.0 });
+        first.apply_since(loop, 0);
+        loop.symuluj(1.0);
+        const auto state = loop.get_last_result();
+        second.apply_since(loop, first.version());
+        if (loop.get_last_result() != state)
+            throw std::runtime_error{ "Applied parameters were applied again" };
+        if (dynamic_cast<const RegulatorPID &>(loop.at(0)).get_k() != 2.0)
+            throw std::runtime_error{ "New parameters were not applied" };
+    });
+    it_should_throw<std::runtime_error>("ParameterSnapshot - parameters of a wrong type", [] {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        ParameterSnapshot{}.with({ 0 }, StaticParameters{}).apply_since(loop, 0);
+    });
+}
+
+void ParameterSnapshotTests::test_mailbox()
+{
+    it_should_not_throw("ParameterMailbox - latest snapshot wins", [] {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        ParameterMailbox mailbox;
+        if (mailbox.apply(loop))
+            throw std::runtime_error{ "Nothing was published" };
+        const auto first = ParameterSnapshot{}.with({ 0 }, PIDParameters{ 2.0, 0.0, 0.0 });
+        const auto second = first.with({ 0 }, PIDParameters{ 3.0, 0.0, 0.0 });
+        mailbox.publish(first);
+        mailbox.publish(second);
+        if (!mailbox.apply(loop) || mailbox.apply(loop))
+            throw std::runtime_error{ "Snapshots were not coalesced" };
+        const auto &pid = dynamic_cast<const RegulatorPID &>(loop.at(0));
+        if (pid.get_k() != 3.0)
+            throw std::runtime_error{ std::format("Unexpected k {}", pid.get_k()) };
+        // The retired snapshot is released by the next publish
+        mailbox.publish(second.with({ 0 }, PIDParameters{ 4.0, 0.0, 0.0 }));
+        if (!mailbox.apply(loop) || pid.get_k() != 4.0)
+            throw std::runtime_error{ "The next snapshot was not applied" };
+    });
+}
+
+void ParameterSnapshotTests::run_tests()
+{
+    test_copy_on_write();
+    test_mailbox();
+}
+#endif
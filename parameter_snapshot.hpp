@@ -0,0 +1,143 @@
+/// @file parameter_snapshot.hpp
+/// @brief Immutable, versioned parameters of loop components, published to a running simulation.
+
+#pragma once
+#include "ObiektSISO.h"
+#include "ObiektStatyczny.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <variant>
+#include <vector>
+
+/// Gains and time constants of a RegulatorPID.
+struct PIDParameters {
+    double k;
+    double ti;
+    double td;
+};
+
+/// Coefficients, delay and noise of a ModelARX.
+struct ARXParameters {
+    std::vector<double> coeff_a;
+    std::vector<double> coeff_b;
+    std::int32_t delay;
+    double stddev;
+};
+
+/// Points of an ObiektStatyczny.
+struct StaticParameters {
+    ObiektStatyczny::point p1;
+    ObiektStatyczny::point p2;
+};
+
+/// Type and initial value of a PętlaUAR.
+struct UARParameters {
+    bool closed;
+    double init;
+};
+
+/// Parameters of any component which can be edited in the GUI.
+using ComponentParameters
+    = std::variant<PIDParameters, ARXParameters, StaticParameters, UARParameters>;
+
+/// @brief Capture the editable parameters of a component.
+///
+/// Only parameters which can be changed in the GUI editors are captured: gains and time constants
+/// of RegulatorPID, points of ObiektStatyczny, coefficients, delay and noise of ModelARX and the
+/// type and initial value of PętlaUAR.
+///
+/// @param source the component
+/// @return Copy of its parameters.
+/// @throws `std::runtime_error` if `source` has an unsupported type.
+ComponentParameters capture_parameters(const ObiektSISO &source);
+/// @brief Set parameters of a component, keeping its internal state.
+/// @param target the component
+/// @param parameters parameters captured from a component of the same type
+/// @throws `std::runtime_error` if the type of `target` differs.
+void apply_parameters(ObiektSISO &target, const ComponentParameters &parameters);
+
+/// @brief Immutable set of parameters of the components of a loop.
+///
+/// A new version is made by with(), which copies only the pointers to the parameters of other
+/// components, so the parameters themselves are never modified after they are published (copy on
+/// write). Every entry remembers the version in which it was changed, so a consumer which applied
+/// version `v` only applies the entries changed after it (see apply_since()).
+class ParameterSnapshot {
+public:
+    /// Parameters of a single component.
+    struct Entry {
+        /// Path to the component, see find_component().
+        std::vector<std::size_t> path;
+        /// Version of the snapshot in which the parameters were set.
+        std::uint64_t version;
+        /// The parameters.
+        ComponentParameters parameters;
+    };
+
+private:
+    /// Version of the snapshot, incremented by every with().
+    std::uint64_t m_version{};
+    /// Parameters of the components, at most one entry per path.
+    std::vector<std::shared_ptr<const Entry>> m_entries{};
+
+public:
+    /// Version of the snapshot, 0 for an empty one.
+    std::uint64_t version() const noexcept { return m_version; }
+    /// Parameters of the components.
+    std::span<const std::shared_ptr<const Entry>> entries() const noexcept { return m_entries; }
+    /// @brief Make the next version with new parameters of a component.
+    /// @param path path to the component
+    /// @param parameters its parameters
+    /// @return Snapshot sharing the other entries with this one.
+    ParameterSnapshot with(std::vector<std::size_t> path, ComponentParameters parameters) const;
+    /// @brief Apply the parameters changed after a version.
+    /// @param root the root component, usually a loop
+    /// @param applied version which was already applied to `root`
+    /// @throws `std::runtime_error` if a path is invalid or a component has a different type.
+    void apply_since(ObiektSISO &root, std::uint64_t applied) const;
+};
+
+/// @brief Single-slot exchange of parameter snapshots between two threads, without locks.
+///
+/// The publisher replaces the pending snapshot with an atomic pointer swap; a snapshot which was
+/// not taken yet is superseded, since the next one contains all of its changes. The consumer takes
+/// the pending snapshot with another swap, so it never shares a pointer with the publisher. Taken
+/// snapshots are handed back through a second slot and usually released by the next publish(), so
+/// the consumer doesn't free memory.
+class ParameterMailbox {
+    /// Snapshot waiting for the consumer, owned by the mailbox.
+    std::atomic<ParameterSnapshot *> m_pending{};
+    /// Snapshot applied by the consumer, owned by the mailbox.
+    std::atomic<ParameterSnapshot *> m_retired{};
+    /// Version applied by the consumer.
+    std::uint64_t m_applied{};
+
+public:
+    ParameterMailbox() = default;
+    ParameterMailbox(const ParameterMailbox &) = delete;
+    ParameterMailbox &operator=(const ParameterMailbox &) = delete;
+    ~ParameterMailbox();
+
+    /// @brief Publish a snapshot (publisher thread only). Never blocks.
+    /// @param snapshot the snapshot, a later version of the previously published one
+    void publish(ParameterSnapshot snapshot);
+    /// @brief Apply the pending snapshot, if any (consumer thread only).
+    /// @param root the root component
+    /// @return `true` if a snapshot was applied.
+    /// @throws `std::runtime_error` if the snapshot doesn't match `root`, see
+    /// ParameterSnapshot::apply_since().
+    bool apply(ObiektSISO &root);
+};
+
+#ifdef LAB_TESTS
+class ParameterSnapshotTests {
+    static void test_copy_on_write();
+    static void test_mailbox();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,98 @@
+#include "philox.hpp"
+#include <atomic>
+#include <random>
+
+namespace {
+/// SplitMix64 mixing function, turns consecutive counter values into unrelated keys.
+constexpr std::uint64_t splitmix64(std::uint64_t x) noexcept
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/// Random seed of the process, used as a base of all stream keys.
+const std::uint64_t process_seed{ [] {
+    std::random_device rd;
+    return (static_cast<std::uint64_t>(rd()) << 32) | rd();
+}() };
+/// Number of keys returned so far.
+std::atomic<std::uint64_t> n_streams{};
+}
+
+std::uint64_t philox_stream_key() noexcept
+{
+    return splitmix64(process_seed + n_streams.fetch_add(1, std::memory_order_relaxed));
+}
+
+#ifdef LAB_TESTS
+#include <iostream>
+#include <vector>
+
+void PhiloxTests::test_known_answers()
+{
+    std::cerr << "Philox4x32-10 -> known answer test: ";
+    // Test vectors from the Random123 library (kat_vectors)
+    using a4 = std::array<std::uint32_t, 4>;
+    using a2 = std::array<std::uint32_t, 2>;
+    static_assert(philox4x32_10(a4{}, a2{})
+                  == a4{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 });
+    const bool ok
+        = philox4x32_10(a4{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+                        a2{ 0xffffffff, 0xffffffff })
+            == a4{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd }
+        && philox4x32_10(a4{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+                         a2{ 0xa4093822, 0x299f31d0 })
+            == a4{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 };
+    std::cerr << (ok ? "OK!\n" : "FAIL!\n");
+}
+
+void PhiloxTests::test_batch()
+{
+    std::cerr << "Philox -> batch draws match single draws: ";
+    constexpr std::uint64_t key = 0x1234'5678'9abc'def0;
+    std::vector<double> uniform(100), normal(100);
+    philox_fill_uniform(key, 1000, uniform);
+    philox_fill_normal(key, 1000, normal, 0.5, 2.0);
+    for (std::size_t i = 0; i < uniform.size(); ++i) {
+        if (uniform[i] != philox_uniform(key, 1000 + i)
+            || normal[i] != 0.5 + 2.0 * philox_normal(key, 1000 + i)) {
+            std::cerr << "FAIL!\n";
+            return;
+        }
+    }
+    std::cerr << (philox_stream_key() != philox_stream_key() ? "OK!\n" : "FAIL!\n");
+}
+
+void PhiloxTests::test_distribution()
+{
+    std::cerr << "Philox -> sample moments: ";
+    constexpr std::size_t n = 200'000;
+    // A fixed key, so that a failure can be reproduced
+    constexpr std::uint64_t key = 0x243f6a8885a308d3;
+    double u_sum = 0.0, n_sum = 0.0, n_sq_sum = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto u = philox_uniform(key, i);
+        const auto z = philox_normal(key, i);
+        if (u < 0.0 || u >= 1.0 || !std::isfinite(z)) {
+            std::cerr << "FAIL!\n";
+            return;
+        }
+        u_sum += u;
+        n_sum += z;
+        n_sq_sum += z * z;
+    }
+    // Standard errors of the means are ~6.5e-4 (uniform) and ~2.2e-3 (normal), allow 5 sigma
+    const bool ok = std::abs(u_sum / n - 0.5) < 3.5e-3 && std::abs(n_sum / n) < 1.2e-2
+        && std::abs(n_sq_sum / n - 1.0) < 1.6e-2;
+    std::cerr << (ok ? "OK!\n" : "FAIL!\n");
+}
+
+void PhiloxTests::run_tests()
+{
+    test_known_answers();
+    test_batch();
+    test_distribution();
+}
+#endif
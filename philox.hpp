@@ -0,0 +1,119 @@
+/// @file philox.hpp
+/// @brief Counter-based Philox4x32-10 random number generator.
+///
+/// Philox (J. K. Salmon et al., _Parallel Random Numbers: As Easy as 1, 2, 3_, SC'11) is a keyed
+/// bijection of a 128-bit counter. The n-th random number of a stream identified by a key is a pure
+/// function of `(key, n)`, so any position of a stream can be reached in O(1), there is no state to
+/// serialize except for the counter, and streams with different keys can be used concurrently
+/// without synchronization.
+
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <span>
+
+/// @brief Philox4x32 with 10 rounds.
+/// @param ctr 128-bit counter
+/// @param key 64-bit key
+/// @return 128 random bits.
+constexpr std::array<std::uint32_t, 4> philox4x32_10(std::array<std::uint32_t, 4> ctr,
+                                                     std::array<std::uint32_t, 2> key) noexcept
+{
+    constexpr std::uint32_t m0 = 0xD2511F53;
+    constexpr std::uint32_t m1 = 0xCD9E8D57;
+    constexpr std::uint32_t w0 = 0x9E3779B9;
+    constexpr std::uint32_t w1 = 0xBB67AE85;
+    for (int round = 0; round < 10; ++round) {
+        const std::uint64_t p0 = static_cast<std::uint64_t>(m0) * ctr[0];
+        const std::uint64_t p1 = static_cast<std::uint64_t>(m1) * ctr[2];
+        ctr = { static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                static_cast<std::uint32_t>(p1),
+                static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                static_cast<std::uint32_t>(p0) };
+        key[0] += w0;
+        key[1] += w1;
+    }
+    return ctr;
+}
+
+/// @brief 128 random bits at position `index` of stream `key`.
+/// @param key stream key
+/// @param index position in the stream
+/// @return Two random 64-bit words.
+constexpr std::array<std::uint64_t, 2> philox_bits(std::uint64_t key, std::uint64_t index) noexcept
+{
+    const auto r = philox4x32_10(
+        { static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(index >> 32), 0, 0 },
+        { static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(key >> 32) });
+    return { (static_cast<std::uint64_t>(r[1]) << 32) | r[0],
+             (static_cast<std::uint64_t>(r[3]) << 32) | r[2] };
+}
+
+/// @brief Uniformly distributed number in range @f$[0, 1)@f$.
+/// @param key stream key
+/// @param index position in the stream
+constexpr double philox_uniform(std::uint64_t key, std::uint64_t index) noexcept
+{
+    return static_cast<double>(philox_bits(key, index)[0] >> 11) * 0x1.0p-53;
+}
+
+/// @brief Standard normal number (Box-Muller transform of one 128-bit block).
+/// @param key stream key
+/// @param index position in the stream
+inline double philox_normal(std::uint64_t key, std::uint64_t index) noexcept
+{
+    const auto [a, b] = philox_bits(key, index);
+    // u1 is in (0, 1], so the logarithm is finite
+    const double u1 = static_cast<double>((a >> 11) + 1) * 0x1.0p-53;
+    const double u2 = static_cast<double>(b >> 11) * 0x1.0p-53;
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * std::numbers::pi * u2);
+}
+
+/// @brief Fill `out` with uniform numbers in range @f$[0, 1)@f$ at positions starting at `first`.
+/// @details The result is the same as calling philox_uniform() for every position, but the loop
+/// has no dependencies between iterations, so it can be vectorized.
+/// @param key stream key
+/// @param first position of `out[0]` in the stream
+/// @param out output
+constexpr void philox_fill_uniform(std::uint64_t key, std::uint64_t first,
+                                   std::span<double> out) noexcept
+{
+    for (std::size_t i = 0; i < out.size(); ++i)
+        out[i] = philox_uniform(key, first + i);
+}
+
+/// @brief Fill `out` with normal numbers at positions starting at `first`.
+/// @details The result is the same as `mean + stddev * philox_normal()` for every position.
+/// @param key stream key
+/// @param first position of `out[0]` in the stream
+/// @param out output
+/// @param mean mean of the distribution
+/// @param stddev standard deviation of the distribution
+inline void philox_fill_normal(std::uint64_t key, std::uint64_t first, std::span<double> out,
+                               double mean = 0.0, double stddev = 1.0) noexcept
+{
+    for (std::size_t i = 0; i < out.size(); ++i)
+        out[i] = mean + stddev * philox_normal(key, first + i);
+}
+
+/// @brief Get a new, unique stream key.
+///
+/// Keys are derived from a per-process random seed and an atomic counter, so every call (also from
+/// different threads) returns a different, statistically independent stream.
+///
+/// @return A new stream key.
+std::uint64_t philox_stream_key() noexcept;
+
+#ifdef LAB_TESTS
+class PhiloxTests {
+    static void test_known_answers();
+    static void test_batch();
+    static void test_distribution();
+
+public:
+    static void run_tests();
+};
+#endif
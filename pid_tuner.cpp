@@ -0,0 +1,393 @@
+#include "pid_tuner.hpp"
+#include "frozen_loop.hpp"
+#include "loop_graph.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+/// Number of samples simulated between checks of the pruning limit.
+constexpr std::size_t block_size = 4096;
+/// Cost of rejected candidates.
+constexpr double rejected = std::numeric_limits<double>::infinity();
+
+/// Parameters k, Ti and Td.
+using Point = std::array<double, 3>;
+
+/// Simulates candidates of all searches, shared by the threads.
+class Evaluator {
+    std::span<const uint8_t> m_dump;
+    std::span<const std::size_t> m_path;
+    std::span<const double> m_setpoint;
+    const TuneOptions &m_options;
+    std::atomic<std::size_t> m_pruned{};
+
+    /// Cost which only grows while the response is simulated, `-inf` if there is none.
+    double partial_cost(const SweepMetrics &m) const noexcept
+    {
+        switch (m_options.cost) {
+        case TuneCost::ISE:
+            return m.ise;
+        case TuneCost::IAE:
+            return m.iae;
+        case TuneCost::SETTLING_TIME:
+            break;
+        }
+        return -rejected;
+    }
+    /// Whether the response violates the overshoot constraint.
+    bool overshoots(const SweepMetrics &m) const noexcept
+    {
+        return m_options.max_overshoot && m.overshoot > *m_options.max_overshoot;
+    }
+
+public:
+    Evaluator(std::span<const uint8_t> dump, std::span<const std::size_t> path,
+              std::span<const double> setpoint, const TuneOptions &options)
+        : m_dump{ dump }
+        , m_path{ path }
+        , m_setpoint{ setpoint }
+        , m_options{ options }
+    {
+    }
+    /// Number of candidates stopped early.
+    std::size_t pruned() const noexcept { return m_pruned.load(); }
+
+    /// @brief Simulate a candidate.
+    /// @param p parameters of the regulator
+    /// @param limit the simulation may stop once the cost is known to exceed it
+    /// @param metrics if not `nullptr`, receives the metrics of the whole response
+    /// @return Cost of the candidate, infinite if it is rejected or exceeds `limit`.
+    double operator()(const Point &p, double limit, SweepMetrics *metrics = nullptr)
+    {
+        auto loop = ObiektSISO::deserialize(m_dump);
+        apply_parameters(find_component(*loop, m_path), PIDParameters{ p[0], p[1], p[2] });
+        if (m_options.noise_seed)
+            reseed_models(*loop, *m_options.noise_seed);
+        std::optional<FrozenLoop> frozen;
+        if (const auto uar = dynamic_cast<const PętlaUAR *>(loop.get())) {
+            try {
+                frozen.emplace(freeze(*uar));
+            } catch (const std::runtime_error &) {
+            }
+        }
+
+        MetricsAccumulator acc{ m_options.settling_band };
+        std::array<double, block_size> output;
+        for (std::size_t offset = 0; offset < m_setpoint.size(); offset += block_size) {
+            const auto in = m_setpoint.subspan(offset, std::min(block_size,
+                                                                m_setpoint.size() - offset));
+            const auto out = std::span{ output }.first(in.size());
+            if (frozen)
+                frozen->simulate_block(in, out);
+            else
+                loop->simulate_block(in, out);
+            acc.add(in, out);
+            if (m_options.prune && metrics == nullptr) {
+                const auto m = acc.result();
+                if (overshoots(m) || partial_cost(m) > limit) {
+                    m_pruned.fetch_add(1, std::memory_order_relaxed);
+                    return rejected;
+                }
+            }
+        }
+
+        const auto m = acc.result();
+        if (metrics != nullptr)
+            *metrics = m;
+        double cost;
+        if (m_options.cost == TuneCost::SETTLING_TIME)
+            cost = m.settling_time ? static_cast<double>(*m.settling_time)
+                                   : static_cast<double>(m_setpoint.size()) + m.iae;
+        else
+            cost = partial_cost(m);
+        // Unstable responses may overflow to NaN, which can't be compared
+        if (overshoots(m) || std::isnan(cost))
+            return rejected;
+        return cost;
+    }
+};
+
+/// Result of a single search.
+struct SearchResult {
+    Point best;
+    double cost;
+    std::size_t evaluations;
+};
+
+/// @brief Nelder-Mead search within the bounds, starting at `start`.
+///
+/// Every candidate is simulated with the limit which decides whether it is accepted, so pruned
+/// candidates take the same branches as fully simulated ones.
+SearchResult nelder_mead(Evaluator &evaluate, Point start, const TuneOptions &options)
+{
+    const auto &bounds = options.bounds;
+    const auto clamp = [&bounds](Point p) {
+        for (std::size_t i = 0; i < p.size(); ++i)
+            p[i] = std::clamp(p[i], bounds[i].first, bounds[i].second);
+        return p;
+    };
+    const auto along = [](const Point &from, const Point &to, double t) {
+        Point p;
+        for (std::size_t i = 0; i < p.size(); ++i)
+            p[i] = from[i] + t * (to[i] - from[i]);
+        return p;
+    };
+
+    struct Vertex {
+        Point p;
+        double cost;
+    };
+    std::array<Vertex, 4> simplex;
+    std::size_t evaluations = 0;
+    const auto eval = [&](const Point &p, double limit) {
+        ++evaluations;
+        return evaluate(p, limit);
+    };
+
+    start = clamp(start);
+    simplex[0] = { start, eval(start, rejected) };
+    for (std::size_t i = 0; i < start.size(); ++i) {
+        auto p = start;
+        const auto step = 0.1 * (bounds[i].second - bounds[i].first);
+        p[i] += p[i] + step > bounds[i].second ? -step : step;
+        simplex[i + 1] = { p, eval(p, rejected) };
+    }
+
+    const auto by_cost = [](const Vertex &a, const Vertex &b) { return a.cost < b.cost; };
+    while (true) {
+        std::ranges::stable_sort(simplex, by_cost);
+        auto &best = simplex.front();
+        auto &worst = simplex.back();
+        const auto &second = simplex[simplex.size() - 2];
+        if (evaluations >= options.max_evaluations)
+            break;
+        if (std::isfinite(worst.cost)
+            && worst.cost - best.cost <= options.tolerance * std::abs(best.cost))
+            break;
+        bool collapsed = true;
+        for (std::size_t i = 0; i < start.size(); ++i) {
+            const auto range = bounds[i].second - bounds[i].first;
+            for (const auto &v : simplex)
+                collapsed &= std::abs(v.p[i] - best.p[i]) <= 1e-12 * (range + 1.0);
+        }
+        if (collapsed)
+            break;
+
+        Point centroid{};
+        for (std::size_t k = 0; k + 1 < simplex.size(); ++k)
+            for (std::size_t i = 0; i < centroid.size(); ++i)
+                centroid[i] += simplex[k].p[i] / static_cast<double>(simplex.size() - 1);
+
+        const auto r = clamp(along(centroid, worst.p, -1.0));
+        const auto r_cost = eval(r, worst.cost);
+        if (r_cost < best.cost) {
+            const auto e = clamp(along(centroid, worst.p, -2.0));
+            const auto e_cost = eval(e, r_cost);
+            worst = e_cost < r_cost ? Vertex{ e, e_cost } : Vertex{ r, r_cost };
+            continue;
+        }
+        if (r_cost < second.cost) {
+            worst = { r, r_cost };
+            continue;
+        }
+        if (r_cost < worst.cost) {
+            const auto c = along(centroid, r, 0.5);
+            if (const auto c_cost = eval(c, r_cost); c_cost <= r_cost) {
+                worst = { c, c_cost };
+                continue;
+            }
+        } else {
+            const auto c = along(centroid, worst.p, 0.5);
+            if (const auto c_cost = eval(c, worst.cost); c_cost < worst.cost) {
+                worst = { c, c_cost };
+                continue;
+            }
+        }
+        for (std::size_t k = 1; k < simplex.size(); ++k) {
+            const auto p = along(best.p, simplex[k].p, 0.5);
+            simplex[k] = { p, eval(p, rejected) };
+        }
+    }
+    return { simplex.front().p, simplex.front().cost, evaluations };
+}
+}
+
+std::optional<std::vector<std::size_t>> find_pid(const ObiektSISO &root)
+{
+    if (dynamic_cast<const RegulatorPID *>(&root) != nullptr)
+        return std::vector<std::size_t>{};
+    const auto search = [](const auto &container) -> std::optional<std::vector<std::size_t>> {
+        for (std::size_t i = 0; i < container.size(); ++i) {
+            if (auto path = find_pid(container.at(i))) {
+                path->insert(path->begin(), i);
+                return path;
+            }
+        }
+        return std::nullopt;
+    };
+    if (const auto loop = dynamic_cast<const PętlaUAR *>(&root))
+        return search(*loop);
+    if (const auto graph = dynamic_cast<const LoopGraph *>(&root))
+        return search(*graph);
+    return std::nullopt;
+}
+
+PętlaUAR tuning_loop(const ModelARX &plant, const RegulatorPID &pid)
+{
+    PętlaUAR loop;
+    loop.push_back(std::make_unique<RegulatorPID>(pid));
+    loop.push_back(std::make_unique<ModelARX>(std::span<const uint8_t>{ plant.dump() }));
+    return loop;
+}
+
+TuneResult tune_pid(std::span<const uint8_t> loop_dump, std::span<const std::size_t> pid_path,
+                    std::span<const double> setpoint, const TuneOptions &options)
+{
+    // Validate everything before starting, so that errors are reported from the calling thread
+    for (const auto &[min, max] : options.bounds)
+        if (!(min >= 0.0 && min <= max && std::isfinite(max)))
+            throw std::runtime_error{ "Tuning bounds must be finite, non-negative and ordered" };
+    if (setpoint.empty())
+        throw std::runtime_error{ "Tuning setpoint must not be empty" };
+    const auto loop = ObiektSISO::deserialize(loop_dump);
+    const auto pid = dynamic_cast<const RegulatorPID *>(&find_component(*loop, pid_path));
+    if (pid == nullptr)
+        throw std::runtime_error{ "Tuned component is not RegulatorPID" };
+
+    std::vector<Point> starts{ { pid->get_k(), pid->get_ti(), pid->get_td() } };
+    for (const auto &p :
+         random_points(options.bounds, std::max<std::size_t>(options.starts, 1) - 1, options.seed))
+        starts.push_back({ p[0], p[1], p[2] });
+
+    Evaluator evaluate{ loop_dump, pid_path, setpoint, options };
+    std::vector<SearchResult> searches(starts.size());
+    ThreadPool pool{ options.n_threads };
+    pool.parallel_for(starts.size(),
+                      [&](std::size_t i) { searches[i] = nelder_mead(evaluate, starts[i], options); });
+
+    // The first best search wins, so the result doesn't depend on the order of completion
+    const auto &best = *std::ranges::min_element(
+        searches, [](const SearchResult &a, const SearchResult &b) { return a.cost < b.cost; });
+    TuneResult result{ { best.best[0], best.best[1], best.best[2] }, best.cost, {}, 0, 0 };
+    for (const auto &s : searches)
+        result.evaluations += s.evaluations;
+    result.pruned = evaluate.pruned();
+    evaluate(best.best, rejected, &result.metrics);
+    return result;
+}
+
+#ifdef LAB_TESTS
+#include "util.hpp"
+#include <format>
+
+namespace {
+/// Loop of a PID regulator and a slow first order plant.
+PętlaUAR test_loop(double k = 0.2)
+{
+    return tuning_loop(ModelARX{ std::vector{ -0.9 }, std::vector{ 0.1 }, 1 },
+                       RegulatorPID{ k, 20.0 });
+}
+}
+
+void PidTunerTests::test_improves()
+{
+    it_should_not_throw("PID tuner - improves the cost, same result with any threads", [] {
+        const auto dump = test_loop().dump();
+        const std::vector<double> setpoint(1000, 1.0);
+        TuneOptions options{ .starts = 4, .max_evaluations = 60, .n_threads = 4 };
+        const auto tuned = tune_pid(dump, std::vector<std::size_t>{ 0 }, setpoint, options);
+        options.n_threads = 1;
+        const auto serial = tune_pid(dump, std::vector<std::size_t>{ 0 }, setpoint, options);
+
+        auto initial = test_loop();
+        std::vector<double> output(setpoint.size());
+        initial.simulate_block(setpoint, output);
+        MetricsAccumulator acc{ options.settling_band };
+        acc.add(setpoint, output);
+        const auto initial_ise = acc.result().ise;
+        if (!(tuned.cost < initial_ise) || tuned.metrics.ise != tuned.cost)
+            throw std::runtime_error{ std::format("Tuned ISE {} is not better than {}",
+                                                  tuned.cost, initial_ise) };
+        if (tuned.pid.k != serial.pid.k || tuned.pid.ti != serial.pid.ti
+            || tuned.pid.td != serial.pid.td || tuned.evaluations != serial.evaluations)
+            throw std::runtime_error{ "Result depends on the number of threads" };
+        for (const auto &[v, b] : { std::pair{ tuned.pid.k, options.bounds[0] },
+                                   std::pair{ tuned.pid.ti, options.bounds[1] },
+                                   std::pair{ tuned.pid.td, options.bounds[2] } })
+            if (v < b.first || v > b.second)
+                throw std::runtime_error{ std::format("Parameter {} out of bounds", v) };
+    });
+}
+
+void PidTunerTests::test_pruning_is_exact()
+{
+    it_should_not_throw("PID tuner - pruning doesn't change the result", [] {
+        const auto dump = test_loop().dump();
+        const std::vector<double> setpoint(20'000, 1.0);
+        TuneOptions options{ .cost = TuneCost::IAE, .starts = 3, .max_evaluations = 80 };
+        const auto pruned = tune_pid(dump, std::vector<std::size_t>{ 0 }, setpoint, options);
+        options.prune = false;
+        const auto full = tune_pid(dump, std::vector<std::size_t>{ 0 }, setpoint, options);
+        if (pruned.pid.k != full.pid.k || pruned.pid.ti != full.pid.ti
+            || pruned.pid.td != full.pid.td || pruned.cost != full.cost
+            || pruned.evaluations != full.evaluations)
+            throw std::runtime_error{ "Pruning changed the search" };
+        if (pruned.pruned == 0 || full.pruned != 0)
+            throw std::runtime_error{ std::format("{} of {} candidates pruned", pruned.pruned,
+                                                  pruned.evaluations) };
+    });
+}
+
+void PidTunerTests::test_constraints()
+{
+    it_should_not_throw("PID tuner - settling time with an overshoot limit", [] {
+        // A plant nested in an open loop is found through find_pid()
+        PętlaUAR outer{ false };
+        outer.push_back(std::make_unique<PętlaUAR>(test_loop(1.0)));
+        const auto path = find_pid(outer);
+        if (path != std::vector<std::size_t>{ 0, 0 })
+            throw std::runtime_error{ "Regulator not found" };
+        const std::vector<double> setpoint(500, 1.0);
+        const TuneOptions options{ .cost = TuneCost::SETTLING_TIME,
+                                   .max_overshoot = 0.05,
+                                   .starts = 4,
+                                   .max_evaluations = 80 };
+        const auto tuned = tune_pid(outer.dump(), *path, setpoint, options);
+        if (!std::isfinite(tuned.cost) || !tuned.metrics.settling_time
+            || tuned.metrics.overshoot > 0.05
+            || static_cast<double>(*tuned.metrics.settling_time) != tuned.cost)
+            throw std::runtime_error{ std::format("Unexpected cost {}, overshoot {}", tuned.cost,
+                                                  tuned.metrics.overshoot) };
+    });
+}
+
+void PidTunerTests::test_invalid()
+{
+    it_should_throw<std::runtime_error>("PID tuner - path to a model", [] {
+        const std::vector<double> setpoint(10, 1.0);
+        tune_pid(test_loop().dump(), std::vector<std::size_t>{ 1 }, setpoint);
+    });
+    it_should_throw<std::runtime_error>("PID tuner - negative bounds", [] {
+        const std::vector<double> setpoint(10, 1.0);
+        TuneOptions options;
+        options.bounds[1] = { -1.0, 1.0 };
+        tune_pid(test_loop().dump(), std::vector<std::size_t>{ 0 }, setpoint, options);
+    });
+    it_should_not_throw("PID tuner - no regulator", [] {
+        if (find_pid(ModelARX{ std::vector{ -0.5 }, std::vector{ 0.5 }, 1 }))
+            throw std::runtime_error{ "Regulator found in a model" };
+    });
+}
+
+void PidTunerTests::run_tests()
+{
+    test_improves();
+    test_pruning_is_exact();
+    test_constraints();
+    test_invalid();
+}
+#endif
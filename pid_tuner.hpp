@@ -0,0 +1,116 @@
+/// @file pid_tuner.hpp
+/// @brief Parallel multi-start Nelder-Mead tuning of RegulatorPID parameters.
+
+#pragma once
+#include "ModelARX.h"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include "parameter_snapshot.hpp"
+#include "sweep.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+/// Cost minimized by tune_pid().
+enum class TuneCost {
+    ISE, ///< Integral (sum) of squared errors, see SweepMetrics::ise
+    IAE, ///< Integral (sum) of absolute errors, see SweepMetrics::iae
+    /// @brief Settling time in samples, see SweepMetrics::settling_time.
+    /// @details Responses which don't settle cost the number of samples plus their IAE, so they
+    /// are worse than any settled response and still ranked.
+    SETTLING_TIME
+};
+
+/// Options of tune_pid().
+struct TuneOptions {
+    /// The minimized cost.
+    TuneCost cost{ TuneCost::ISE };
+    /// @brief Largest allowed overshoot, relative to the setpoint (see SweepMetrics::overshoot).
+    /// @details Candidates exceeding it are rejected, `std::nullopt` allows any overshoot.
+    std::optional<double> max_overshoot{};
+    /// Half-width of the settling band, see SweepOptions::settling_band.
+    double settling_band{ 0.02 };
+    /// [min, max] ranges of k, Ti and Td, all values must be >= 0.
+    std::array<std::pair<double, double>, 3> bounds{ { { 0.0, 10.0 },
+                                                       { 0.0, 100.0 },
+                                                       { 0.0, 10.0 } } };
+    /// @brief Number of independent searches, run in parallel.
+    /// @details The first one starts at the current parameters of the regulator, the other ones
+    /// at random points within #bounds.
+    std::size_t starts{ 8 };
+    /// Largest number of simulations of a single search.
+    std::size_t max_evaluations{ 200 };
+    /// A search stops when the costs of its simplex differ by less than this relative tolerance.
+    double tolerance{ 1e-6 };
+    /// @brief Stop simulating candidates as soon as they are known to be rejected.
+    ///
+    /// A candidate of Nelder-Mead only matters if it is better than a vertex of the simplex, so
+    /// its simulation stops once the partial cost (ISE and IAE only grow) or the overshoot exceeds
+    /// the limit. This doesn't change the result, only the time.
+    bool prune{ true };
+    /// Number of worker threads, `0` uses all hardware threads.
+    std::size_t n_threads{ 0 };
+    /// Seed of the random starting points.
+    std::uint64_t seed{ 1 };
+    /// @brief Base seed of ModelARX noise generators.
+    /// @details If set, all models are reseeded with the same seeds for every candidate (common
+    /// random numbers), otherwise they keep the state from the dump.
+    std::optional<std::uint64_t> noise_seed{};
+};
+
+/// Result of tune_pid().
+struct TuneResult {
+    /// The best parameters found.
+    PIDParameters pid;
+    /// Cost of #pid, infinite if no candidate satisfied the constraints.
+    double cost;
+    /// Metrics of the response with #pid.
+    SweepMetrics metrics;
+    /// Number of simulated candidates.
+    std::size_t evaluations;
+    /// Number of candidates whose simulation was stopped early.
+    std::size_t pruned;
+};
+
+/// @brief Find the first RegulatorPID in a component.
+/// @param root component, searched depth-first if it's a loop or a graph
+/// @return Path to the regulator (see find_component()), `std::nullopt` if there is none.
+std::optional<std::vector<std::size_t>> find_pid(const ObiektSISO &root);
+/// @brief Build a closed loop of a regulator and a plant, for tuning the regulator of a model.
+/// @param plant the regulated model
+/// @param pid the initial regulator, at path `{ 0 }`
+/// @return Closed loop with the regulator followed by the plant.
+PętlaUAR tuning_loop(const ModelARX &plant, const RegulatorPID &pid = RegulatorPID{ 1.0 });
+
+/// @brief Tune a RegulatorPID of a loop for a setpoint signal.
+///
+/// Runs TuneOptions::starts Nelder-Mead searches within the bounds in parallel. Every candidate
+/// deserializes its own copy of the loop, sets the parameters of the regulator and simulates the
+/// setpoint from the state in the dump, frozen if possible (see freeze()). The result doesn't
+/// depend on the number of threads.
+///
+/// @param loop_dump serialized loop (e.g. PętlaUAR::dump())
+/// @param pid_path path to the tuned regulator, see find_component()
+/// @param setpoint inputs of the loop
+/// @param options tuning options
+/// @return The best parameters found by any search.
+/// @throws `std::runtime_error` if the path doesn't lead to a RegulatorPID, bounds are invalid or
+/// the setpoint is empty.
+TuneResult tune_pid(std::span<const uint8_t> loop_dump, std::span<const std::size_t> pid_path,
+                    std::span<const double> setpoint, const TuneOptions &options = {});
+
+#ifdef LAB_TESTS
+class PidTunerTests {
+    static void test_improves();
+    static void test_pruning_is_exact();
+    static void test_constraints();
+    static void test_invalid();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,118 @@
+/// @file prefix_registry.hpp
+/// @brief Registry of factories selected by the name at the beginning of serialized data.
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+/// @brief Byte trie mapping registered names to factories.
+///
+/// Looking up serialized data walks the trie along its first bytes, so the cost depends only on
+/// the length of the matched name, not on the number of registered types. Names must be prefix-free
+/// (no name may be a prefix of another one), otherwise data of the shorter name followed by some
+/// payload could be mistaken for the longer one. Conflicting registrations are rejected, so the
+/// matched factory never depends on the registration order.
+///
+/// Nodes are stored in a fixed array, with the children of a node linked as a list, so the
+/// registry never allocates. It is `constexpr`, so registries defined with `constinit` are
+/// zero-initialized before any registration made during dynamic initialization of other
+/// translation units, and a complete registry can be built at compile time.
+/// @tparam Factory factory function pointer type
+/// @tparam Capacity largest number of nodes: 1 for the root and 1 for every byte of the names
+/// which is not shared with a previously registered name
+template <typename Factory, std::size_t Capacity = 64> class PrefixRegistry {
+    static_assert(Capacity > 0 && Capacity <= UINT32_MAX);
+
+private:
+    /// Trie node.
+    struct Node {
+        /// Factory of the name ending at this node, `nullptr` if there is none.
+        Factory factory{};
+        /// Index of the first child, 0 (the root, which is nobody's child) if there is none.
+        std::uint32_t first_child{};
+        /// Index of the next child of the parent, 0 if there is none.
+        std::uint32_t next_sibling{};
+        /// Byte of the name leading from the parent to this node.
+        std::uint8_t byte{};
+    };
+    /// Nodes, the first one is the root.
+    std::array<Node, Capacity> m_nodes{};
+    /// Number of used nodes.
+    std::uint32_t m_used{ 1 };
+    /// Number of registered names.
+    std::size_t m_size{};
+
+    /// @brief Find the child of a node.
+    /// @return Index of the child, 0 if there is none.
+    constexpr std::uint32_t child(std::uint32_t node, std::uint8_t byte) const noexcept
+    {
+        for (auto i = m_nodes[node].first_child; i != 0; i = m_nodes[i].next_sibling) {
+            if (m_nodes[i].byte == byte)
+                return i;
+        }
+        return 0;
+    }
+
+public:
+    constexpr PrefixRegistry() noexcept = default;
+
+    /// @brief Register a factory.
+    ///
+    /// Registering the same name again is a no-op and keeps the first factory.
+    /// @param name unique name of the type
+    /// @param factory factory creating objects of the type
+    /// @return `true` if the name was not registered before.
+    /// @throws `std::runtime_error` if the name is empty, one of the name and an already
+    /// registered name is a prefix of the other or there are not enough free nodes.
+    constexpr bool add(std::string_view name, Factory factory)
+    {
+        if (name.empty())
+            throw std::runtime_error{ "Registered name can't be empty" };
+        std::uint32_t node = 0;
+        for (const auto c : name) {
+            if (m_nodes[node].factory != nullptr)
+                throw std::runtime_error{ "Registered name conflicts with a shorter name" };
+            const auto byte = static_cast<std::uint8_t>(c);
+            auto next = child(node, byte);
+            if (next == 0) {
+                if (m_used == Capacity)
+                    throw std::runtime_error{ "Registry capacity exceeded" };
+                next = m_used++;
+                m_nodes[next].byte = byte;
+                m_nodes[next].next_sibling = m_nodes[node].first_child;
+                m_nodes[node].first_child = next;
+            }
+            node = next;
+        }
+        if (m_nodes[node].factory != nullptr)
+            return false;
+        if (m_nodes[node].first_child != 0)
+            throw std::runtime_error{ "Registered name conflicts with a longer name" };
+        m_nodes[node].factory = factory;
+        ++m_size;
+        return true;
+    }
+
+    /// @brief Find the factory of the name at the beginning of `data`.
+    /// @param data serialized data, starting with the name
+    /// @return The factory, `nullptr` if `data` doesn't start with any registered name.
+    constexpr Factory find(std::span<const std::uint8_t> data) const noexcept
+    {
+        std::uint32_t node = 0;
+        for (const auto byte : data) {
+            node = child(node, byte);
+            if (node == 0)
+                return nullptr;
+            if (m_nodes[node].factory != nullptr)
+                return m_nodes[node].factory;
+        }
+        return nullptr;
+    }
+
+    /// Number of registered names.
+    constexpr std::size_t size() const noexcept { return m_size; }
+};
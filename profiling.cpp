@@ -0,0 +1,119 @@
+#include "profiling.hpp"
+
+#ifdef POLABS_PROFILING
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+/// Number of `operator new` calls made by the thread.
+thread_local std::uint64_t allocations = 0;
+}
+
+std::uint64_t allocation_count() noexcept { return allocations; }
+
+// Replacements of all global allocation functions, which count the allocations. Every form is
+// replaced, so memory is never allocated by one implementation (e.g. a sanitizer's) and freed by
+// another.
+namespace {
+/// @brief Allocate memory like the standard `operator new`, retrying after the new handler.
+/// @param size number of bytes
+/// @param alignment alignment, `0` for the default one
+/// @return Allocated memory, `nullptr` if there is no new handler and the allocation failed.
+void *counted_allocate(std::size_t size, std::size_t alignment) noexcept
+{
+    ++allocations;
+    if (size == 0)
+        size = 1;
+    while (true) {
+        void *ptr;
+        if (alignment == 0)
+            ptr = std::malloc(size);
+        else
+#ifdef _WIN32
+            ptr = _aligned_malloc(size, alignment);
+#else
+            // aligned_alloc() requires the size to be a multiple of the alignment
+            ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+        if (ptr != nullptr)
+            return ptr;
+        const auto handler = std::get_new_handler();
+        if (handler == nullptr)
+            return nullptr;
+        try {
+            handler();
+        } catch (...) {
+            return nullptr;
+        }
+    }
+}
+
+/// @brief Allocate memory, see counted_allocate().
+/// @throws `std::bad_alloc` if the allocation failed.
+void *counted_allocate_or_throw(std::size_t size, std::size_t alignment)
+{
+    if (void *ptr = counted_allocate(size, alignment))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+/// Free memory allocated with extended alignment.
+void aligned_free(void *ptr) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+}
+
+void *operator new(std::size_t size) { return counted_allocate_or_throw(size, 0); }
+void *operator new[](std::size_t size) { return counted_allocate_or_throw(size, 0); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, 0);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, 0);
+}
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    aligned_free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    aligned_free(ptr);
+}
+#endif
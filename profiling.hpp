@@ -0,0 +1,79 @@
+/// @file profiling.hpp
+/// @brief Optional instrumentation of loop components, enabled with the `POLABS_PROFILING` macro.
+///
+/// Without `POLABS_PROFILING` the #POLABS_PROFILE macro expands to nothing and loops store no
+/// profiles, so there is no overhead at all.
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+/// Whether the instrumentation is compiled in.
+#ifdef POLABS_PROFILING
+inline constexpr bool profiling_enabled = true;
+#else
+inline constexpr bool profiling_enabled = false;
+#endif
+
+/// Statistics of a single loop component, inclusive of its nested components.
+struct ComponentProfile {
+    /// Number of `symuluj()` and `simulate_block()` calls.
+    std::uint64_t calls{};
+    /// Number of simulated samples.
+    std::uint64_t samples{};
+    /// Total time spent in the calls.
+    std::chrono::nanoseconds time{};
+    /// Number of memory allocations made in the calls, by any form of `operator new`.
+    std::uint64_t allocations{};
+
+    friend constexpr bool operator==(const ComponentProfile &, const ComponentProfile &) = default;
+};
+
+#ifdef POLABS_PROFILING
+/// Number of `operator new` calls made by the current thread.
+std::uint64_t allocation_count() noexcept;
+
+/// @brief Adds the duration and allocations of its lifetime to a ComponentProfile.
+class ProfileScope {
+    using clock = std::chrono::steady_clock;
+
+    /// Updated profile.
+    ComponentProfile &m_profile;
+    /// Number of samples simulated in the scope.
+    std::uint64_t m_samples;
+    /// Allocation count at the beginning of the scope.
+    std::uint64_t m_allocations;
+    /// Beginning of the scope.
+    clock::time_point m_start;
+
+public:
+    /// @brief Start measuring.
+    /// @param profile profile to update at the end of the scope
+    /// @param samples number of samples simulated in the scope
+    ProfileScope(ComponentProfile &profile, std::uint64_t samples) noexcept
+        : m_profile{ profile }
+        , m_samples{ samples }
+        , m_allocations{ allocation_count() }
+        , m_start{ clock::now() }
+    {
+    }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+    ~ProfileScope()
+    {
+        const auto end = clock::now();
+        m_profile.time += std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start);
+        m_profile.calls += 1;
+        m_profile.samples += m_samples;
+        m_profile.allocations += allocation_count() - m_allocations;
+    }
+};
+
+/// @brief Profile the rest of the enclosing scope.
+/// @param profile ComponentProfile to update
+/// @param samples number of simulated samples
+#define POLABS_PROFILE(profile, samples)                                                           \
+    const ProfileScope polabs_profile_scope_{ profile, samples }
+#else
+#define POLABS_PROFILE(profile, samples) static_cast<void>(0)
+#endif
@@ -0,0 +1,354 @@
+#include "result_export.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+/// Maximum length of a CSV row: 20 characters of time, 2 doubles of up to 24 and 3 separators.
+constexpr std::size_t max_csv_row = 20 + 2 * 24 + 3;
+
+/// @brief Write bytes of a range to a file.
+/// @throws `std::runtime_error` if writing fails.
+template <typename T> void write_all(std::FILE *file, std::span<const T> data)
+{
+    if (std::fwrite(data.data(), sizeof(T), data.size(), file) != data.size())
+        throw std::runtime_error{ "Could not write the results" };
+}
+
+/// @throws `std::runtime_error` if sizes of `inputs` and `outputs` differ.
+void check_sizes(std::size_t inputs, std::size_t outputs)
+{
+    if (inputs != outputs)
+        throw std::runtime_error{ "Number of inputs and outputs must be equal" };
+}
+
+/// @throws `std::runtime_error` if flushing fails.
+void flush(std::FILE *file)
+{
+    if (std::fflush(file) != 0)
+        throw std::runtime_error{ "Could not write the results" };
+}
+}
+
+std::uint64_t dump_hash(std::span<const std::uint8_t> dump) noexcept
+{
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (const auto byte : dump)
+        hash = (hash ^ byte) * 0x100000001b3;
+    return hash;
+}
+
+std::FILE *open_for_writing(const std::filesystem::path &path) noexcept
+{
+#ifdef _WIN32
+    return _wfopen(path.c_str(), L"wb");
+#else
+    return std::fopen(path.c_str(), "wb");
+#endif
+}
+
+CsvResultWriter::CsvResultWriter(std::FILE *file, std::int64_t t0)
+    : m_file{ file }
+    , m_time{ t0 }
+{
+    write_all(m_file, std::span{ std::string_view{ "time,input,output\n" } });
+}
+
+void CsvResultWriter::add(std::span<const double> inputs, std::span<const double> outputs)
+{
+    check_sizes(inputs.size(), outputs.size());
+    // Rows are formatted directly into a buffer large enough for the longest ones
+    m_buffer.resize(inputs.size() * max_csv_row);
+    char *pos = m_buffer.data();
+    char *const end = m_buffer.data() + m_buffer.size();
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        pos = std::to_chars(pos, end, m_time++).ptr;
+        *pos++ = ',';
+        pos = std::to_chars(pos, end, inputs[i]).ptr;
+        *pos++ = ',';
+        pos = std::to_chars(pos, end, outputs[i]).ptr;
+        *pos++ = '\n';
+    }
+    write_all(m_file, std::span<const char>{ m_buffer.data(), pos });
+}
+
+void CsvResultWriter::finish() { flush(m_file); }
+
+void RawResultWriter::add(std::span<const double> inputs, std::span<const double> outputs)
+{
+    check_sizes(inputs.size(), outputs.size());
+    m_buffer.resize(2 * inputs.size());
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        m_buffer[2 * i] = inputs[i];
+        m_buffer[2 * i + 1] = outputs[i];
+    }
+    write_all(m_file, std::span<const double>{ m_buffer });
+}
+
+void RawResultWriter::finish() { flush(m_file); }
+
+ColumnarResultWriter::ColumnarResultWriter(std::FILE *file, std::int64_t t0, double dt,
+                                           std::uint64_t loop_hash, std::size_t group_size)
+    : m_file{ file }
+    , m_group_size{ group_size }
+    , m_header_offset{ std::ftell(file) }
+{
+    if (m_group_size == 0)
+        throw std::runtime_error{ "Result group size must be positive" };
+    m_inputs.reserve(m_group_size);
+    m_outputs.reserve(m_group_size);
+
+    std::array<std::uint8_t, header_size> header;
+    ByteWriter writer{ header };
+    writer.put_range(magic);
+    writer.put(version);
+    writer.put(static_cast<std::uint64_t>(m_group_size));
+    writer.put(unknown_size);
+    writer.put(t0);
+    writer.put(dt);
+    writer.put(loop_hash);
+    write_all(m_file, std::span<const std::uint8_t>{ header });
+}
+
+void ColumnarResultWriter::write_group(std::span<const double> inputs,
+                                       std::span<const double> outputs)
+{
+    write_all(m_file, inputs);
+    write_all(m_file, outputs);
+}
+
+void ColumnarResultWriter::add(std::span<const double> inputs, std::span<const double> outputs)
+{
+    check_sizes(inputs.size(), outputs.size());
+    m_size += inputs.size();
+    while (!inputs.empty()) {
+        // Whole groups are written directly from the arguments, without buffering
+        if (m_inputs.empty() && inputs.size() >= m_group_size) {
+            write_group(inputs.first(m_group_size), outputs.first(m_group_size));
+            inputs = inputs.subspan(m_group_size);
+            outputs = outputs.subspan(m_group_size);
+            continue;
+        }
+        const auto n = std::min(inputs.size(), m_group_size - m_inputs.size());
+        m_inputs.insert(m_inputs.end(), inputs.begin(), inputs.begin() + n);
+        m_outputs.insert(m_outputs.end(), outputs.begin(), outputs.begin() + n);
+        inputs = inputs.subspan(n);
+        outputs = outputs.subspan(n);
+        if (m_inputs.size() == m_group_size) {
+            write_group(m_inputs, m_outputs);
+            m_inputs.clear();
+            m_outputs.clear();
+        }
+    }
+}
+
+void ColumnarResultWriter::finish()
+{
+    write_group(m_inputs, m_outputs);
+    m_inputs.clear();
+    m_outputs.clear();
+    // The size follows the magic, version and group size
+    if (m_header_offset >= 0 && std::fseek(m_file, m_header_offset + 16, SEEK_SET) == 0) {
+        write_all(m_file, std::span<const std::uint64_t>{ &m_size, 1 });
+        if (std::fseek(m_file, 0, SEEK_END) != 0)
+            throw std::runtime_error{ "Could not write the results" };
+    }
+    flush(m_file);
+}
+
+ResultFile::ResultFile(const std::filesystem::path &path)
+    : m_file{ path }
+{
+    using W = ColumnarResultWriter;
+    ByteReader reader{ m_file.bytes() };
+    if (m_file.size() < W::header_size || !prefix_match(W::magic, reader.take(W::magic.size())))
+        throw std::runtime_error{ "File is not a result file" };
+    if (reader.get<std::uint32_t>() != W::version)
+        throw std::runtime_error{ "Unsupported result file version" };
+    const auto group_size = reader.get<std::uint64_t>();
+    const auto size = reader.get<std::uint64_t>();
+    m_t0 = reader.get<std::int64_t>();
+    m_dt = reader.get<double>();
+    m_loop_hash = reader.get<std::uint64_t>();
+    if (group_size == 0 || group_size > reader.remaining())
+        throw std::runtime_error{ "Invalid result group size" };
+    m_group_size = static_cast<std::size_t>(group_size);
+
+    // All groups except for the last one are full, so the size follows from the file size
+    const auto group_bytes = 2 * sizeof(double) * m_group_size;
+    const auto last_bytes = reader.remaining() % group_bytes;
+    m_size = reader.remaining() / group_bytes * m_group_size + last_bytes / (2 * sizeof(double));
+    if (last_bytes % (2 * sizeof(double)) != 0 || (size != W::unknown_size && size != m_size))
+        throw std::runtime_error{ "Result file size does not match its header" };
+
+    // The mapping is page-aligned and the header size is a multiple of 8
+    m_data = reinterpret_cast<const double *>(reader.take(reader.remaining()).data());
+    if (reinterpret_cast<std::uintptr_t>(m_data) % alignof(double) != 0)
+        throw std::runtime_error{ "Result file data is not aligned" };
+}
+
+std::pair<std::span<const double>, std::span<const double>>
+ResultFile::group(std::size_t index) const
+{
+    if (index >= group_count())
+        throw std::out_of_range{ "Result group does not exist" };
+    const auto first = index * m_group_size;
+    const auto n = std::min(m_group_size, m_size - first);
+    const auto inputs = m_data + 2 * first;
+    return { { inputs, n }, { inputs + n, n } };
+}
+
+void ResultFile::read(std::size_t first, std::span<double> inputs,
+                      std::span<double> outputs) const
+{
+    check_sizes(inputs.size(), outputs.size());
+    if (first > m_size || inputs.size() > m_size - first)
+        throw std::out_of_range{ "Requested samples are not in the result file" };
+    for (std::size_t done = 0; done < inputs.size();) {
+        const auto sample = first + done;
+        const auto [group_in, group_out] = group(sample / m_group_size);
+        const auto offset = sample % m_group_size;
+        const auto n = std::min(group_in.size() - offset, inputs.size() - done);
+        std::ranges::copy(group_in.subspan(offset, n), inputs.begin() + done);
+        std::ranges::copy(group_out.subspan(offset, n), outputs.begin() + done);
+        done += n;
+    }
+}
+
+#ifdef LAB_TESTS
+#include <fstream>
+#include <string>
+
+namespace {
+/// Inputs and outputs of the export tests, `n` samples with distinct values.
+std::pair<std::vector<double>, std::vector<double>> test_samples(std::size_t n)
+{
+    std::vector<double> inputs(n), outputs(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        inputs[i] = static_cast<double>(i) * 0.5;
+        outputs[i] = -static_cast<double>(i) / 3.0;
+    }
+    return { std::move(inputs), std::move(outputs) };
+}
+}
+
+void ResultExportTests::test_columnar_round_trip()
+{
+    it_should_not_throw("ResultFile - columnar round trip", [] {
+        const auto path = std::filesystem::temp_directory_path() / "polabs_export_test.pors";
+        const auto [inputs, outputs] = test_samples(1000);
+        const std::array<std::uint8_t, 3> dump{ 1, 2, 3 };
+        {
+            std::FILE *file = open_for_writing(path);
+            if (file == nullptr)
+                throw std::runtime_error{ "Could not open the test file" };
+            ColumnarResultWriter writer{ file, -5, 0.25, dump_hash(dump), 64 };
+            // Blocks smaller and larger than a group, not aligned to groups
+            writer.add(std::span{ inputs }.first(10), std::span{ outputs }.first(10));
+            writer.add(std::span{ inputs }.subspan(10, 700), std::span{ outputs }.subspan(10, 700));
+            writer.add(std::span{ inputs }.subspan(710), std::span{ outputs }.subspan(710));
+            writer.finish();
+            std::fclose(file);
+        }
+        {
+            const ResultFile file{ path };
+            if (file.size() != inputs.size() || file.group_count() != 16 || file.t0() != -5
+                || file.dt() != 0.25 || file.loop_hash() != dump_hash(dump))
+                throw std::runtime_error{ "Wrong header" };
+            const auto [last_in, last_out] = file.group(15);
+            if (last_in.size() != 40 || last_out.back() != outputs.back())
+                throw std::runtime_error{ "Wrong last group" };
+            std::vector<double> in(900), out(900);
+            file.read(50, in, out);
+            if (!std::ranges::equal(in, std::span{ inputs }.subspan(50, 900))
+                || !std::ranges::equal(out, std::span{ outputs }.subspan(50, 900)))
+                throw std::runtime_error{ "Read samples differ" };
+        }
+        std::filesystem::remove(path);
+    });
+}
+
+void ResultExportTests::test_unknown_size()
+{
+    it_should_not_throw("ResultFile - size of an unfinished file", [] {
+        const auto path = std::filesystem::temp_directory_path() / "polabs_export_stream.pors";
+        const auto [inputs, outputs] = test_samples(100);
+        {
+            std::FILE *file = open_for_writing(path);
+            if (file == nullptr)
+                throw std::runtime_error{ "Could not open the test file" };
+            ColumnarResultWriter writer{ file, 0, 1.0, 0, 32 };
+            writer.add(inputs, outputs);
+            // Without finish() only the whole groups are written and the size is unknown
+            std::fclose(file);
+        }
+        const ResultFile file{ path };
+        if (file.size() != 96 || file.group(2).second.back() != outputs[95])
+            throw std::runtime_error{ "Wrong size of a file with unknown size" };
+        std::filesystem::remove(path);
+    });
+}
+
+void ResultExportTests::test_csv()
+{
+    it_should_not_throw("CsvResultWriter - rows", [] {
+        const auto path = std::filesystem::temp_directory_path() / "polabs_export_test.csv";
+        {
+            std::FILE *file = open_for_writing(path);
+            if (file == nullptr)
+                throw std::runtime_error{ "Could not open the test file" };
+            CsvResultWriter writer{ file, 9 };
+            const std::array inputs{ 0.1, -2.0 }, outputs{ 1e300, 0.0 };
+            writer.add(inputs, outputs);
+            writer.finish();
+            std::fclose(file);
+        }
+        std::ifstream in{ path, std::ios::binary };
+        const std::string text{ std::istreambuf_iterator<char>{ in }, {} };
+        if (text != "time,input,output\n9,0.1,1e+300\n10,-2,0\n")
+            throw std::runtime_error{ "Wrong CSV: " + text };
+        in.close();
+        std::filesystem::remove(path);
+    });
+}
+
+void ResultExportTests::test_invalid()
+{
+    const auto path = std::filesystem::temp_directory_path() / "polabs_export_invalid.pors";
+    {
+        std::FILE *file = open_for_writing(path);
+        ColumnarResultWriter writer{ file, 0, 1.0, 0, 8 };
+        const auto [inputs, outputs] = test_samples(20);
+        writer.add(inputs, outputs);
+        writer.finish();
+        std::fclose(file);
+    }
+    const auto valid_size = std::filesystem::file_size(path);
+
+    it_should_throw<std::runtime_error>(
+        "ResultFile - truncated file",
+        [&] {
+            std::filesystem::resize_file(path, valid_size - 16);
+            ResultFile{ path };
+        },
+        "Result file size does not match its header");
+    it_should_throw<std::runtime_error>(
+        "ResultFile - not a result file",
+        [&] {
+            std::ofstream{ path, std::ios::binary | std::ios::trunc } << "POCK and some data";
+            ResultFile{ path };
+        },
+        "File is not a result file");
+    std::filesystem::remove(path);
+}
+
+void ResultExportTests::run_tests()
+{
+    test_columnar_round_trip();
+    test_unknown_size();
+    test_csv();
+    test_invalid();
+}
+#endif
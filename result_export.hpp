@@ -0,0 +1,189 @@
+/// @file result_export.hpp
+/// @brief Export of simulation inputs and outputs, see docs/result_format.md.
+
+#pragma once
+#include "mapped_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// @brief Hash of a serialized loop, which identifies the loop that produced exported results.
+/// @param dump serialized loop (ObiektSISO::dump())
+/// @return 64-bit FNV-1a hash of `dump`.
+std::uint64_t dump_hash(std::span<const std::uint8_t> dump) noexcept;
+/// @brief Open a file for binary writing, truncating it.
+/// @details Unlike `std::fopen(path.string().c_str(), ...)`, works with any path on Windows.
+/// @param path path of the file
+/// @return The file, `nullptr` if it can't be opened.
+std::FILE *open_for_writing(const std::filesystem::path &path) noexcept;
+
+/// @brief Writer of simulation results, which are added while the simulation runs.
+///
+/// Writers don't own the file they write to, so they can write to the standard output.
+class ResultExporter {
+public:
+    virtual ~ResultExporter() = default;
+    /// @brief Write a block of results.
+    /// @param inputs loop inputs
+    /// @param outputs loop outputs
+    /// @throws `std::runtime_error` if sizes differ or writing fails.
+    virtual void add(std::span<const double> inputs, std::span<const double> outputs) = 0;
+    /// @brief Write the buffered results and flush the file. Nothing can be added afterwards.
+    /// @throws `std::runtime_error` if writing fails.
+    virtual void finish() = 0;
+};
+
+/// @brief Writer of CSV with a "time,input,output" header and one row per sample.
+///
+/// Every value is written in the shortest form, which reads back the same. Rows of a block are
+/// formatted into a single buffer, which is written at once.
+class CsvResultWriter : public ResultExporter {
+    std::FILE *m_file;
+    /// Time of the next sample.
+    std::int64_t m_time;
+    /// Formatted rows of the current block.
+    std::vector<char> m_buffer;
+
+public:
+    /// @brief Write the header.
+    /// @param file output file
+    /// @param t0 simulation time of the first sample
+    CsvResultWriter(std::FILE *file, std::int64_t t0);
+    void add(std::span<const double> inputs, std::span<const double> outputs) override;
+    void finish() override;
+};
+
+/// Writer of raw `[input, output]` pairs of native doubles, without any header.
+class RawResultWriter : public ResultExporter {
+    std::FILE *m_file;
+    /// Interleaved pairs of the current block.
+    std::vector<double> m_buffer;
+
+public:
+    /// @param file output file
+    explicit RawResultWriter(std::FILE *file)
+        : m_file{ file }
+    {
+    }
+    void add(std::span<const double> inputs, std::span<const double> outputs) override;
+    void finish() override;
+};
+
+/// @brief Writer of the columnar result format (`.pors`).
+///
+/// Samples are written in groups of a fixed size, in which all inputs are followed by all
+/// outputs, so a single column can be read from a memory-mapped file without parsing or copying
+/// (see ResultFile). Only one group is buffered. The number of samples is written to the header
+/// in finish() if the file is seekable, otherwise it is derived from the file size when reading.
+class ColumnarResultWriter : public ResultExporter {
+public:
+    /// Magic number at the beginning of the file.
+    static constexpr std::string_view magic{ "PORS" };
+    /// Version of the format.
+    static constexpr std::uint32_t version = 1;
+    /// Size of the fixed-length header.
+    static constexpr std::size_t header_size = 48;
+    /// Number of samples stored in the header before it is known.
+    static constexpr std::uint64_t unknown_size = ~std::uint64_t{};
+
+private:
+    std::FILE *m_file;
+    /// Number of samples in a group.
+    std::size_t m_group_size;
+    /// Inputs of the current group.
+    std::vector<double> m_inputs;
+    /// Outputs of the current group.
+    std::vector<double> m_outputs;
+    /// Number of added samples.
+    std::uint64_t m_size{};
+    /// Position of the header in the file, -1 if the file is not seekable.
+    long m_header_offset;
+
+    /// Write a whole group or the last, partial one.
+    void write_group(std::span<const double> inputs, std::span<const double> outputs);
+
+public:
+    /// @brief Write the header.
+    /// @param file output file, positioned at the beginning of the results
+    /// @param t0 simulation time of the first sample
+    /// @param dt simulation time between samples
+    /// @param loop_hash dump_hash() of the simulated loop
+    /// @param group_size number of samples in a group
+    /// @throws `std::runtime_error` if `group_size` is 0 or writing fails.
+    ColumnarResultWriter(std::FILE *file, std::int64_t t0, double dt, std::uint64_t loop_hash,
+                         std::size_t group_size = 1 << 16);
+    void add(std::span<const double> inputs, std::span<const double> outputs) override;
+    void finish() override;
+};
+
+/// @brief Memory-mapped columnar result file written by ColumnarResultWriter.
+///
+/// Opening the file maps it and validates the header, so it takes the same time regardless of its
+/// size. Columns of a group are referenced in place.
+class ResultFile {
+    /// The mapped file.
+    MappedFile m_file;
+    /// Number of samples in a group.
+    std::size_t m_group_size{};
+    /// Total number of samples.
+    std::size_t m_size{};
+    /// Simulation time of the first sample.
+    std::int64_t m_t0{};
+    /// Simulation time between samples.
+    double m_dt{};
+    /// Hash of the simulated loop.
+    std::uint64_t m_loop_hash{};
+    /// Beginning of the first group.
+    const double *m_data{};
+
+public:
+    /// @brief Map and validate a result file.
+    /// @param path path of the file
+    /// @throws `std::runtime_error` if the file can't be mapped or is not a valid result file.
+    explicit ResultFile(const std::filesystem::path &path);
+
+    /// Total number of samples.
+    std::size_t size() const noexcept { return m_size; }
+    /// Number of samples in a group, the last group may be smaller.
+    std::size_t group_size() const noexcept { return m_group_size; }
+    /// Number of groups.
+    std::size_t group_count() const noexcept
+    {
+        return (m_size + m_group_size - 1) / m_group_size;
+    }
+    /// Simulation time of the first sample.
+    std::int64_t t0() const noexcept { return m_t0; }
+    /// Simulation time between samples.
+    double dt() const noexcept { return m_dt; }
+    /// dump_hash() of the simulated loop.
+    std::uint64_t loop_hash() const noexcept { return m_loop_hash; }
+    /// @brief Columns of a group.
+    /// @param index index of the group
+    /// @return Inputs and outputs of the group, which refer to the mapped file.
+    /// @throws `std::out_of_range` if `index` is not less than group_count().
+    std::pair<std::span<const double>, std::span<const double>> group(std::size_t index) const;
+    /// @brief Copy consecutive samples.
+    /// @param first index of the first sample
+    /// @param inputs output for inputs
+    /// @param outputs output for outputs, must have the same size as `inputs`
+    /// @throws `std::out_of_range` if any of the samples does not exist.
+    /// @throws `std::runtime_error` if sizes differ.
+    void read(std::size_t first, std::span<double> inputs, std::span<double> outputs) const;
+};
+
+#ifdef LAB_TESTS
+class ResultExportTests {
+    static void test_columnar_round_trip();
+    static void test_unknown_size();
+    static void test_csv();
+    static void test_invalid();
+
+public:
+    static void run_tests();
+};
+#endif
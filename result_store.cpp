@@ -0,0 +1,244 @@
+#include "result_store.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+ResultStore::ResultStore(std::size_t chunk_size, std::size_t max_memory_chunks,
+                         std::optional<std::filesystem::path> spill_file)
+    : m_chunk_size{ chunk_size }
+    , m_max_memory_chunks{ max_memory_chunks }
+    , m_spill_path{ std::move(spill_file) }
+{
+    if (chunk_size == 0 || max_memory_chunks == 0)
+        throw std::runtime_error{ "ResultStore chunk size and chunk count must be positive" };
+    if (m_spill_path) {
+        m_spill.open(*m_spill_path,
+                     std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!m_spill)
+            throw std::runtime_error{ "Could not open the ResultStore spill file" };
+    }
+}
+
+ResultStore::~ResultStore()
+{
+    if (m_spill_path) {
+        m_spill.close();
+        std::error_code ec;
+        std::filesystem::remove(*m_spill_path, ec);
+    }
+}
+
+void ResultStore::evict_chunk()
+{
+    const auto &chunk = m_chunks.front();
+    if (m_spill_path) {
+        // Chunks are stored at fixed offsets: all inputs followed by all outputs
+        const auto bytes = static_cast<std::streamsize>(m_chunk_size * sizeof(double));
+        m_spill.seekp(static_cast<std::streamoff>(m_first_chunk) * bytes * 2);
+        m_spill.write(reinterpret_cast<const char *>(chunk.inputs.data()), bytes);
+        m_spill.write(reinterpret_cast<const char *>(chunk.outputs.data()), bytes);
+        if (!m_spill)
+            throw std::runtime_error{ "Could not write to the ResultStore spill file" };
+    }
+    m_chunks.pop_front();
+    ++m_first_chunk;
+}
+
+void ResultStore::read_spilled(std::size_t chunk, std::size_t offset, std::span<double> inputs,
+                               std::span<double> outputs)
+{
+    const auto bytes = static_cast<std::streamoff>(m_chunk_size * sizeof(double));
+    const auto read_bytes = static_cast<std::streamsize>(inputs.size() * sizeof(double));
+    const auto base = static_cast<std::streamoff>(chunk) * bytes * 2
+        + static_cast<std::streamoff>(offset * sizeof(double));
+    m_spill.seekg(base);
+    m_spill.read(reinterpret_cast<char *>(inputs.data()), read_bytes);
+    m_spill.seekg(base + bytes);
+    m_spill.read(reinterpret_cast<char *>(outputs.data()), read_bytes);
+    if (!m_spill)
+        throw std::runtime_error{ "Could not read from the ResultStore spill file" };
+}
+
+void ResultStore::append(std::span<const double> inputs, std::span<const double> outputs)
+{
+    if (inputs.size() != outputs.size())
+        throw std::runtime_error{ "Number of inputs and outputs must be equal" };
+    std::size_t done = 0;
+    while (done < inputs.size()) {
+        if (m_chunks.empty() || m_chunks.back().inputs.size() == m_chunk_size) {
+            auto &chunk = m_chunks.emplace_back();
+            chunk.inputs.reserve(m_chunk_size);
+            chunk.outputs.reserve(m_chunk_size);
+        }
+        auto &chunk = m_chunks.back();
+        const auto n = std::min(m_chunk_size - chunk.inputs.size(), inputs.size() - done);
+        chunk.inputs.insert(chunk.inputs.end(), inputs.begin() + done, inputs.begin() + done + n);
+        chunk.outputs.insert(chunk.outputs.end(), outputs.begin() + done,
+                             outputs.begin() + done + n);
+        done += n;
+        m_size += n;
+        while (m_chunks.size() > m_max_memory_chunks)
+            evict_chunk();
+    }
+}
+
+void ResultStore::read(std::size_t first, std::span<double> inputs, std::span<double> outputs)
+{
+    if (inputs.size() != outputs.size())
+        throw std::runtime_error{ "Number of inputs and outputs must be equal" };
+    if (first < first_available() || first > m_size || inputs.size() > m_size - first)
+        throw std::out_of_range{ "Requested samples are not available in the ResultStore" };
+    std::size_t done = 0;
+    if (first < history_end()) {
+        const auto offset = first - m_history_first;
+        done = std::min(history_end() - first, inputs.size());
+        std::copy_n(m_history_inputs.begin() + offset, done, inputs.begin());
+        std::copy_n(m_history_outputs.begin() + offset, done, outputs.begin());
+    }
+    while (done < inputs.size()) {
+        const auto index = first + done - history_end();
+        const auto chunk_idx = index / m_chunk_size;
+        const auto offset = index % m_chunk_size;
+        const auto n = std::min(m_chunk_size - offset, inputs.size() - done);
+        if (chunk_idx < m_first_chunk) {
+            read_spilled(chunk_idx, offset, inputs.subspan(done, n), outputs.subspan(done, n));
+        } else {
+            const auto &chunk = m_chunks[chunk_idx - m_first_chunk];
+            std::copy_n(chunk.inputs.begin() + offset, n, inputs.begin() + done);
+            std::copy_n(chunk.outputs.begin() + offset, n, outputs.begin() + done);
+        }
+        done += n;
+    }
+}
+
+void ResultStore::clear()
+{
+    m_chunks.clear();
+    m_first_chunk = 0;
+    m_size = 0;
+    m_history_first = 0;
+    m_history_inputs = {};
+    m_history_outputs = {};
+    m_history_owner.reset();
+    if (m_spill_path) {
+        m_spill.close();
+        m_spill.open(*m_spill_path,
+                     std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    }
+}
+
+void ResultStore::restore(std::size_t first, std::span<const double> inputs,
+                          std::span<const double> outputs, std::shared_ptr<const void> owner)
+{
+    if (inputs.size() != outputs.size())
+        throw std::runtime_error{ "Number of inputs and outputs must be equal" };
+    clear();
+    m_history_first = first;
+    m_history_inputs = inputs;
+    m_history_outputs = outputs;
+    m_history_owner = std::move(owner);
+    m_size = history_end();
+}
+
+#ifdef LAB_TESTS
+#include "util.hpp"
+#include <format>
+#include <numeric>
+
+namespace {
+/// @brief Append `n` samples (input `i`, output `-i`) in blocks of uneven sizes and check them.
+void fill_and_check(ResultStore &store, std::size_t n)
+{
+    std::vector<double> in(n), out(n);
+    std::iota(in.begin(), in.end(), 0.0);
+    std::ranges::transform(in, out.begin(), [](double v) { return -v; });
+    for (std::size_t done = 0, block = 1; done < n; done += block, block = block * 2 + 1) {
+        block = std::min(block, n - done);
+        store.append(std::span{ in }.subspan(done, block), std::span{ out }.subspan(done, block));
+    }
+    if (store.size() != n)
+        throw std::runtime_error{ std::format("size() is {} instead of {}", store.size(), n) };
+    const auto first = store.first_available();
+    std::vector<double> r_in(n - first), r_out(n - first);
+    store.read(first, r_in, r_out);
+    for (std::size_t i = 0; i < r_in.size(); ++i) {
+        if (r_in[i] != in[first + i] || r_out[i] != out[first + i])
+            throw std::runtime_error{ std::format("Wrong sample {}", first + i) };
+    }
+}
+}
+
+void ResultStoreTests::test_memory_only()
+{
+    it_should_not_throw("ResultStore - memory only", [] {
+        ResultStore store{ 10, 3 };
+        fill_and_check(store, 95);
+        if (store.first_available() != 70)
+            throw std::runtime_error{ "Old chunks were not dropped" };
+        store.clear();
+        fill_and_check(store, 25);
+        if (store.first_available() != 0)
+            throw std::runtime_error{ "Chunks were dropped too early" };
+    });
+    it_should_throw<std::out_of_range>("ResultStore - reading dropped samples", [] {
+        ResultStore store{ 10, 1 };
+        fill_and_check(store, 30);
+        std::vector<double> in(1), out(1);
+        store.read(5, in, out);
+    });
+}
+
+void ResultStoreTests::test_spill()
+{
+    it_should_not_throw("ResultStore - spill to disk", [] {
+        const auto path = std::filesystem::temp_directory_path() / "polabs_result_store_test.bin";
+        {
+            ResultStore store{ 16, 2, path };
+            fill_and_check(store, 1000);
+            if (store.first_available() != 0)
+                throw std::runtime_error{ "Spilled samples are not available" };
+            store.clear();
+            fill_and_check(store, 100);
+        }
+        if (std::filesystem::exists(path))
+            throw std::runtime_error{ "Spill file was not removed" };
+    });
+}
+
+void ResultStoreTests::test_restore()
+{
+    it_should_not_throw("ResultStore - restored history", [] {
+        auto history = std::make_shared<std::vector<double>>(100);
+        std::iota(history->begin(), history->end(), 1000.0);
+        const std::span<const double> all{ *history };
+        ResultStore store{ 10, 2 };
+        fill_and_check(store, 5);
+        store.restore(300, all.first(50), all.subspan(50), history);
+        if (store.size() != 350 || store.first_available() != 300)
+            throw std::runtime_error{ "Wrong size of the restored store" };
+
+        const std::vector<double> in{ 1.0, 2.0, 3.0 }, out{ -1.0, -2.0, -3.0 };
+        store.append(in, out);
+        std::vector<double> r_in(5), r_out(5);
+        store.read(348, r_in, r_out);
+        if (r_in != std::vector{ 1048.0, 1049.0, 1.0, 2.0, 3.0 }
+            || r_out != std::vector{ 1098.0, 1099.0, -1.0, -2.0, -3.0 })
+            throw std::runtime_error{ "Wrong samples around the end of the history" };
+
+        for (int i = 0; i < 10; ++i)
+            store.append(in, out);
+        if (store.first_available() != 370)
+            throw std::runtime_error{ std::format("first_available() is {}",
+                                                  store.first_available()) };
+        store.clear();
+        if (history.use_count() != 1)
+            throw std::runtime_error{ "The history is still referenced after clear()" };
+    });
+}
+
+void ResultStoreTests::run_tests()
+{
+    test_memory_only();
+    test_spill();
+    test_restore();
+}
+#endif
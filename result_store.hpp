@@ -0,0 +1,132 @@
+/// @file result_store.hpp
+/// @brief Chunked, append-only storage of simulation inputs and outputs.
+
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// @brief Append-only store of (input, output) samples with bounded memory usage.
+///
+/// Samples are kept in fixed-size chunks. At most `max_memory_chunks` of the newest chunks are
+/// kept in memory. Older chunks are written to a spill file if one was provided, otherwise they
+/// are dropped and can no longer be read.
+///
+/// The store may also start with a restored history, which is referenced in place (e.g. in a
+/// memory-mapped checkpoint) instead of being copied, see restore().
+class ResultStore {
+private:
+    /// Samples of a single chunk.
+    struct Chunk {
+        /// Simulation inputs.
+        std::vector<double> inputs;
+        /// Simulation outputs.
+        std::vector<double> outputs;
+    };
+
+    /// Number of samples in a chunk.
+    std::size_t m_chunk_size;
+    /// Maximum number of chunks kept in memory.
+    std::size_t m_max_memory_chunks;
+    /// Chunks kept in memory, the last one may be partially filled.
+    std::deque<Chunk> m_chunks;
+    /// Index of the first chunk in #m_chunks.
+    std::size_t m_first_chunk{};
+    /// Total number of samples.
+    std::size_t m_size{};
+    /// Path of the spill file.
+    std::optional<std::filesystem::path> m_spill_path;
+    /// Spill file, open if #m_spill_path is set.
+    std::fstream m_spill;
+    /// Index of the first sample of the restored history.
+    std::size_t m_history_first{};
+    /// Inputs of the restored history.
+    std::span<const double> m_history_inputs;
+    /// Outputs of the restored history.
+    std::span<const double> m_history_outputs;
+    /// Owner of the memory referenced by the restored history.
+    std::shared_ptr<const void> m_history_owner;
+
+    /// Index after the last sample of the restored history, chunks start there.
+    std::size_t history_end() const noexcept
+    {
+        return m_history_first + m_history_inputs.size();
+    }
+
+    /// Write the first in-memory chunk to the spill file (if any) and remove it from memory.
+    void evict_chunk();
+    /// @brief Read samples of a spilled chunk.
+    /// @param chunk chunk index
+    /// @param offset index of the first read sample in the chunk
+    /// @param inputs output for inputs
+    /// @param outputs output for outputs, must have the same size as `inputs`
+    void read_spilled(std::size_t chunk, std::size_t offset, std::span<double> inputs,
+                      std::span<double> outputs);
+
+public:
+    /// @brief Construct an empty store.
+    /// @param chunk_size number of samples in a chunk
+    /// @param max_memory_chunks maximum number of chunks kept in memory
+    /// @param spill_file path of the file to which old chunks are written, it is truncated and
+    /// removed when the store is destroyed; without it old chunks are dropped
+    /// @throws `std::runtime_error` if any of the sizes is 0 or the spill file can't be opened.
+    explicit ResultStore(std::size_t chunk_size = 1 << 16, std::size_t max_memory_chunks = 16,
+                         std::optional<std::filesystem::path> spill_file = std::nullopt);
+    ResultStore(const ResultStore &) = delete;
+    ResultStore &operator=(const ResultStore &) = delete;
+    ~ResultStore();
+
+    /// @brief Append samples.
+    /// @param inputs simulation inputs
+    /// @param outputs simulation outputs, must have the same size as `inputs`
+    /// @throws `std::runtime_error` if sizes differ or writing to the spill file fails.
+    void append(std::span<const double> inputs, std::span<const double> outputs);
+    /// @brief Read consecutive samples.
+    /// @param first index of the first sample
+    /// @param inputs output for inputs
+    /// @param outputs output for outputs, must have the same size as `inputs`
+    /// @throws `std::out_of_range` if any of the samples was dropped or does not exist.
+    /// @throws `std::runtime_error` if sizes differ or reading the spill file fails.
+    void read(std::size_t first, std::span<double> inputs, std::span<double> outputs);
+    /// Remove all samples.
+    void clear();
+    /// @brief Replace all samples with a restored history.
+    ///
+    /// The history is not copied, `owner` keeps the referenced memory alive as long as the store
+    /// uses it. New samples are appended after the history.
+    ///
+    /// @param first index of the first sample of the history, earlier samples are not available
+    /// @param inputs simulation inputs
+    /// @param outputs simulation outputs, must have the same size as `inputs`
+    /// @param owner owner of the memory referenced by `inputs` and `outputs`
+    /// @throws `std::runtime_error` if sizes differ.
+    void restore(std::size_t first, std::span<const double> inputs,
+                 std::span<const double> outputs, std::shared_ptr<const void> owner);
+
+    /// Total number of appended samples.
+    std::size_t size() const noexcept { return m_size; }
+    /// Index of the oldest sample, which can still be read.
+    std::size_t first_available() const noexcept
+    {
+        return m_spill_path || m_first_chunk == 0 ? m_history_first
+                                                  : history_end() + m_first_chunk * m_chunk_size;
+    }
+    /// Number of samples in a chunk.
+    std::size_t chunk_size() const noexcept { return m_chunk_size; }
+};
+
+#ifdef LAB_TESTS
+class ResultStoreTests {
+    static void test_memory_only();
+    static void test_spill();
+    static void test_restore();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,222 @@
+#include "sim_worker.hpp"
+#include "ModelARX.h"
+#include "ObiektStatyczny.hpp"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+void BackgroundSimulation::start()
+{
+    m_thread = std::jthread{ [this](std::stop_token stop) { run(std::move(stop)); } };
+}
+
+void BackgroundSimulation::stop() noexcept
+{
+    // Nobody will poll the remaining results, so the thread must not wait for free space
+    m_discard.store(true);
+    cancel();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void BackgroundSimulation::apply_snapshot()
+{
+    m_parameters.apply(*m_loop);
+}
+
+void BackgroundSimulation::resume() noexcept
+{
+    m_paused.store(false);
+    m_paused.notify_all();
+}
+
+void BackgroundSimulation::cancel() noexcept
+{
+    m_thread.request_stop();
+    resume();
+}
+
+std::unique_ptr<ObiektSISO> BackgroundSimulation::take_loop()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_error)
+        std::rethrow_exception(m_error);
+    return std::move(m_loop);
+}
+
+SimulationWorker::SimulationWorker(std::unique_ptr<ObiektSISO> loop, std::vector<double> inputs,
+                                   std::size_t block_size)
+    : BackgroundSimulation{ std::move(loop), std::move(inputs) }
+    , m_block_size{ block_size }
+{
+    if (!m_loop)
+        throw std::runtime_error{ "SimulationWorker loop must not be null" };
+    if (block_size == 0)
+        throw std::runtime_error{ "SimulationWorker block size must be positive" };
+    start();
+}
+
+void SimulationWorker::run(std::stop_token stop)
+{
+    using namespace std::chrono_literals;
+    try {
+        std::size_t first = 0;
+        while (first < m_inputs.size() && !stop.stop_requested()) {
+            if (m_paused.load()) {
+                m_paused.wait(true);
+                continue;
+            }
+            apply_snapshot();
+            const auto n = std::min(m_block_size, m_inputs.size() - first);
+            const auto begin = m_inputs.begin() + static_cast<std::ptrdiff_t>(first);
+            ResultBatch batch{ first, { begin, begin + static_cast<std::ptrdiff_t>(n) },
+                               std::vector<double>(n) };
+            m_loop->simulate_block(batch.inputs, batch.outputs);
+            first += n;
+            // The loop state already includes the block, so the batch is published even after
+            // cancellation. Wait for the consumer if it can't keep up.
+            while (!m_results.try_push(std::move(batch))) {
+                if (m_discard.load())
+                    break;
+                std::this_thread::sleep_for(1ms);
+            }
+            m_done.store(first, std::memory_order_release);
+        }
+        apply_snapshot();
+    } catch (...) {
+        m_error = std::current_exception();
+    }
+    m_finished.store(true, std::memory_order_release);
+}
+
+#ifdef LAB_TESTS
+#include "util.hpp"
+#include <format>
+
+namespace {
+/// @brief Poll `worker` until it finishes.
+/// @return All published batches.
+std::vector<ResultBatch> collect(SimulationWorker &worker)
+{
+    using namespace std::chrono_literals;
+    std::vector<ResultBatch> batches;
+    while (true) {
+        // Check before polling, so that no batch published before finishing is missed
+        const bool finished = worker.finished();
+        while (auto batch = worker.poll())
+            batches.push_back(std::move(*batch));
+        if (finished)
+            return batches;
+        std::this_thread::sleep_for(1ms);
+    }
+}
+}
+
+void SimulationWorkerTests::test_matches_direct()
+{
+    it_should_not_throw("SimulationWorker - same results as direct simulation", [] {
+        PętlaUAR direct;
+        direct.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+        direct.push_back(std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 1));
+        std::vector<double> inputs(10'000);
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            inputs[i] = (i / 500) % 2 ? 1.0 : -0.5;
+
+        SimulationWorker worker{ ObiektSISO::deserialize(direct.dump()), inputs, 512 };
+        const auto batches = collect(worker);
+        const auto loop = worker.take_loop();
+        std::vector<double> expected(inputs.size());
+        direct.simulate_block(inputs, expected);
+
+        std::size_t next = 0;
+        for (const auto &b : batches) {
+            if (b.first != next || b.inputs.size() != b.outputs.size())
+                throw std::runtime_error{ std::format("Unexpected batch at {}", b.first) };
+            for (std::size_t i = 0; i < b.outputs.size(); ++i) {
+                if (b.outputs[i] != expected[b.first + i])
+                    throw std::runtime_error{ std::format("Wrong output {}", b.first + i) };
+            }
+            next += b.outputs.size();
+        }
+        if (next != inputs.size() || worker.progress() != inputs.size())
+            throw std::runtime_error{ "Not all samples were published" };
+        if (loop->dump() != direct.dump())
+            throw std::runtime_error{ "Loop state differs after the simulation" };
+    });
+}
+
+void SimulationWorkerTests::test_parameters()
+{
+    it_should_not_throw("SimulationWorker - published parameters are applied between blocks", [] {
+        PętlaUAR loop{ false };
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        SimulationWorker worker{ ObiektSISO::deserialize(loop.dump()),
+                                 std::vector<double>(100'000, 1.0), 256 };
+        const auto first = ParameterSnapshot{}.with({ 0 }, PIDParameters{ 2.0, 0.0, 0.0 });
+        worker.publish_parameters(first);
+        // Only the latest snapshot has to be applied, it contains all previous changes
+        worker.publish_parameters(first.with({ 0 }, PIDParameters{ 3.0, 0.0, 0.0 }));
+        const auto batches = collect(worker);
+        const auto result = worker.take_loop();
+
+        double last = 1.0;
+        for (const auto &b : batches) {
+            const auto value = b.outputs.front();
+            if (std::ranges::any_of(b.outputs, [value](double v) { return v != value; }))
+                throw std::runtime_error{ std::format("Snapshot applied inside block {}",
+                                                      b.first) };
+            if (value != last && !(last == 1.0 && value == 2.0) && value != 3.0)
+                throw std::runtime_error{ std::format("Unexpected output {}", value) };
+            last = value;
+        }
+        const auto &pid = dynamic_cast<const RegulatorPID &>(
+            dynamic_cast<const PętlaUAR &>(*result).at(0));
+        if (last != 3.0 || pid.get_k() != 3.0)
+            throw std::runtime_error{ "The latest snapshot was not applied" };
+    });
+    it_should_throw<std::runtime_error>("SimulationWorker - parameters of a wrong type", [] {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(1.0));
+        // The worker can't finish before the snapshot is published, because nothing is polled yet
+        SimulationWorker worker{ ObiektSISO::deserialize(loop.dump()),
+                                 std::vector<double>(1'000'000, 1.0), 256 };
+        worker.publish_parameters(ParameterSnapshot{}.with({ 0 }, UARParameters{ true, 0.0 }));
+        collect(worker);
+        worker.take_loop();
+    });
+}
+
+void SimulationWorkerTests::test_cancel()
+{
+    it_should_not_throw("SimulationWorker - pause and cancel", [] {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0));
+        // Without polling the worker stops when the result queue is full
+        SimulationWorker worker{ ObiektSISO::deserialize(loop.dump()),
+                                 std::vector<double>(1'000'000, 1.0), 256 };
+        worker.pause();
+        if (!worker.paused())
+            throw std::runtime_error{ "Worker is not paused" };
+        worker.cancel();
+        const auto batches = collect(worker);
+        worker.take_loop();
+        std::size_t published = 0;
+        for (const auto &b : batches)
+            published += b.outputs.size();
+        if (published != worker.progress() || published >= worker.total())
+            throw std::runtime_error{ std::format("{} of {} samples published, progress {}",
+                                                  published, worker.total(),
+                                                  worker.progress()) };
+    });
+}
+
+void SimulationWorkerTests::run_tests()
+{
+    test_matches_direct();
+    test_parameters();
+    test_cancel();
+}
+#endif
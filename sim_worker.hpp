@@ -0,0 +1,156 @@
+/// @file sim_worker.hpp
+/// @brief Background simulation of a control loop with progress, cancellation and streaming.
+
+#pragma once
+#include "ObiektSISO.h"
+#include "parameter_snapshot.hpp"
+#include "spsc_queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/// Consecutive simulation results published by SimulationWorker.
+struct ResultBatch {
+    /// Index of the first sample in the whole run.
+    std::size_t first{};
+    /// Simulation inputs.
+    std::vector<double> inputs;
+    /// Simulation outputs, the same size as #inputs.
+    std::vector<double> outputs;
+};
+
+/// @brief Simulation of a loop running in a background thread.
+///
+/// The simulation owns its loop until take_loop(). Results are published in batches and collected
+/// by poll(), parameter snapshots are applied by the simulation thread between steps or blocks.
+/// Derived classes implement run() and start the thread with start() at the end of their
+/// constructor. Their destructor must call stop(), because the thread uses their members.
+class BackgroundSimulation {
+public:
+    /// Capacity of the result queue.
+    static constexpr std::size_t queue_capacity = 64;
+
+protected:
+    /// The simulated loop.
+    std::unique_ptr<ObiektSISO> m_loop;
+    /// All inputs of the run.
+    std::vector<double> m_inputs;
+    /// Parameters published for the simulation thread.
+    ParameterMailbox m_parameters{};
+    /// Results waiting for poll().
+    SpscQueue<ResultBatch, queue_capacity> m_results;
+    /// Number of published samples.
+    std::atomic<std::size_t> m_done{};
+    /// Whether the simulation is paused.
+    std::atomic<bool> m_paused{};
+    /// Set by the simulation thread when it stops.
+    std::atomic<bool> m_finished{};
+    /// Set when unpublished results may be dropped, because nobody will poll them.
+    std::atomic<bool> m_discard{};
+    /// Exception thrown by the simulation, valid after #m_finished is set.
+    std::exception_ptr m_error{};
+
+private:
+    /// Simulation thread, must be the last member, so it is joined before anything is destroyed.
+    std::jthread m_thread;
+
+protected:
+    /// @param loop loop to simulate, owned by the simulation until take_loop()
+    /// @param inputs inputs of the run
+    BackgroundSimulation(std::unique_ptr<ObiektSISO> loop, std::vector<double> inputs)
+        : m_loop{ std::move(loop) }
+        , m_inputs{ std::move(inputs) }
+    {
+    }
+    /// @brief Main function of the simulation thread.
+    ///
+    /// Must set #m_error to an exception it throws and #m_finished when it returns.
+    ///
+    /// @param stop stop token of the thread
+    virtual void run(std::stop_token stop) = 0;
+    /// Start the simulation thread.
+    void start();
+    /// Cancel the simulation, drop unpublished results and join the thread.
+    void stop() noexcept;
+    /// Apply the latest published parameters.
+    void apply_snapshot();
+
+public:
+    BackgroundSimulation(const BackgroundSimulation &) = delete;
+    BackgroundSimulation &operator=(const BackgroundSimulation &) = delete;
+    virtual ~BackgroundSimulation() = default;
+    /// @brief Take the next batch of results.
+    /// @return The batch or `std::nullopt` if none is ready.
+    std::optional<ResultBatch> poll() { return m_results.try_pop(); }
+    /// @brief Publish parameters of the loop components, applied by the simulation thread.
+    ///
+    /// Never blocks and never fails: a snapshot which wasn't applied yet is replaced, so the
+    /// snapshot must contain all parameters changed since the start of the simulation.
+    ///
+    /// @param snapshot the parameters, see ParameterSnapshot::with()
+    void publish_parameters(ParameterSnapshot snapshot)
+    {
+        m_parameters.publish(std::move(snapshot));
+    }
+    /// Pause the simulation after the current step or block.
+    void pause() noexcept { m_paused.store(true); }
+    /// Resume a paused simulation.
+    void resume() noexcept;
+    /// Whether the simulation is paused.
+    bool paused() const noexcept { return m_paused.load(); }
+    /// Stop the simulation after the current step or block.
+    void cancel() noexcept;
+    /// Number of simulated samples.
+    std::size_t progress() const noexcept { return m_done.load(std::memory_order_acquire); }
+    /// Number of samples in the run.
+    std::size_t total() const noexcept { return m_inputs.size(); }
+    /// Whether the simulation thread stopped (after all inputs, cancellation or an error).
+    bool finished() const noexcept { return m_finished.load(std::memory_order_acquire); }
+    /// @brief Wait for the simulation thread and take the loop.
+    ///
+    /// The loop state matches the last published batch. Batches which were not polled yet are
+    /// still available.
+    ///
+    /// @return The simulated loop.
+    /// @throws Exception thrown by the simulation, if any.
+    std::unique_ptr<ObiektSISO> take_loop();
+};
+
+/// @brief Simulates a loop in a background thread as fast as possible.
+///
+/// The worker owns its loop, so the GUI thread never touches it while the simulation runs. Inputs
+/// are simulated in blocks; results of every block are published through a lock-free queue and
+/// collected by poll(). Parameter snapshots, pausing and cancellation take effect between blocks,
+/// so a block is always simulated with a consistent set of parameters.
+class SimulationWorker : public BackgroundSimulation {
+    /// Number of samples simulated at once.
+    std::size_t m_block_size;
+
+    void run(std::stop_token stop) override;
+
+public:
+    /// @brief Start simulating.
+    /// @param loop loop to simulate, owned by the worker until take_loop()
+    /// @param inputs inputs of the run
+    /// @param block_size number of samples in a published batch
+    /// @throws `std::runtime_error` if `loop` is `nullptr` or `block_size` is 0.
+    SimulationWorker(std::unique_ptr<ObiektSISO> loop, std::vector<double> inputs,
+                     std::size_t block_size = 4096);
+    /// Cancel the simulation and join the thread.
+    ~SimulationWorker() override { stop(); }
+};
+
+#ifdef LAB_TESTS
+class SimulationWorkerTests {
+    static void test_matches_direct();
+    static void test_parameters();
+    static void test_cancel();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -0,0 +1,67 @@
+/// @file spsc_queue.hpp
+/// @brief Lock-free single-producer, single-consumer queue.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+/// @brief Bounded lock-free queue for exactly one producer and one consumer thread.
+///
+/// The producer only writes #m_tail and the consumer only writes #m_head, so both can operate
+/// without locks. Indices grow monotonically and are reduced modulo the capacity, which must be a
+/// power of 2.
+///
+/// @tparam T type of elements, must be default constructible and move assignable
+/// @tparam Capacity maximum number of queued elements
+template <typename T, std::size_t Capacity> class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscQueue capacity must be a power of 2");
+
+private:
+    /// Size used to keep the indices on separate cache lines.
+    static constexpr std::size_t cache_line = 64;
+
+    /// Storage of queued elements.
+    std::array<T, Capacity> m_slots{};
+    /// Index of the next element to pop, written only by the consumer.
+    alignas(cache_line) std::atomic<std::size_t> m_head{};
+    /// Index of the next free slot, written only by the producer.
+    alignas(cache_line) std::atomic<std::size_t> m_tail{};
+
+public:
+    /// @brief Try to add an element (producer only).
+    /// @param value element to add, moved from only if the call succeeds
+    /// @return `false` if the queue is full.
+    bool try_push(T &&value)
+    {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        m_slots[tail % Capacity] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    /// @brief Try to remove the oldest element (consumer only).
+    /// @return The element or `std::nullopt` if the queue is empty.
+    std::optional<T> try_pop()
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return std::nullopt;
+        std::optional<T> value{ std::exchange(m_slots[head % Capacity], T{}) };
+        m_head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+    /// Approximate number of queued elements (exact if called by the producer or the consumer).
+    std::size_t size() const noexcept
+    {
+        // Head is read first, it can't overtake the tail read afterwards
+        const auto head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+    /// Maximum number of queued elements.
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+};
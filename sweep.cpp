@@ -0,0 +1,338 @@
+#include "sweep.hpp"
+#include "ModelARX.h"
+#include "PętlaUAR.hpp"
+#include "RegulatorPID.h"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace {
+/// Number of samples simulated at once by a single simulate_block() call.
+constexpr std::size_t block_size = 4096;
+
+/// SplitMix64 mixing function, used to derive independent seeds.
+constexpr std::uint64_t splitmix64(std::uint64_t x) noexcept
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/// @brief Set a swept parameter of a component to `value`.
+/// @param component the component at the path of the axis
+/// @throws `std::runtime_error` if the component type does not match or the value is invalid.
+void apply(ObiektSISO &component, const SweepAxis &axis, double value)
+{
+    if (axis.param == SweepParam::ARX_STDDEV) {
+        const auto arx = dynamic_cast<ModelARX *>(&component);
+        if (arx == nullptr)
+            throw std::runtime_error{ "Sweep axis component is not ModelARX" };
+        arx->set_stddev(value);
+        return;
+    }
+    const auto pid = dynamic_cast<RegulatorPID *>(&component);
+    if (pid == nullptr)
+        throw std::runtime_error{ "Sweep axis component is not RegulatorPID" };
+    switch (axis.param) {
+    case SweepParam::PID_K:
+        pid->set_k(value);
+        break;
+    case SweepParam::PID_TI:
+        pid->set_ti(value);
+        break;
+    default:
+        pid->set_td(value);
+        break;
+    }
+}
+
+/// Reseed all ModelARX components of `obj` with seeds derived from `seed`.
+void reseed_models(ObiektSISO &obj, std::uint64_t seed, std::uint64_t &counter)
+{
+    if (const auto loop = dynamic_cast<PętlaUAR *>(&obj)) {
+        for (std::size_t i = 0; i < loop->size(); ++i)
+            reseed_models(loop->at(i), seed, counter);
+    } else if (const auto graph = dynamic_cast<LoopGraph *>(&obj)) {
+        for (std::size_t i = 0; i < graph->size(); ++i)
+            reseed_models(graph->at(i), seed, counter);
+    } else if (const auto arx = dynamic_cast<ModelARX *>(&obj)) {
+        arx->reseed(splitmix64(seed + counter++));
+    }
+}
+
+/// @brief Prepare a copy of the loop with parameters of `point`.
+/// @throws `std::runtime_error` if axes do not match the loop or the point has a wrong size.
+std::unique_ptr<ObiektSISO> prepare_loop(std::span<const uint8_t> loop_dump,
+                                         std::span<const SweepAxis> axes,
+                                         std::span<const double> point)
+{
+    if (point.size() != axes.size())
+        throw std::runtime_error{ "Parameter point size does not match the number of axes" };
+    auto loop = ObiektSISO::deserialize(loop_dump);
+    for (std::size_t i = 0; i < axes.size(); ++i)
+        apply(find_component(*loop, axes[i].path), axes[i], point[i]);
+    return loop;
+}
+
+/// Simulate `loop` for the whole `input` and compute the metrics.
+SweepMetrics simulate(ObiektSISO &loop, std::span<const double> input, double settling_band)
+{
+    MetricsAccumulator acc{ settling_band };
+    std::array<double, block_size> output;
+    for (std::size_t offset = 0; offset < input.size(); offset += block_size) {
+        const auto in = input.subspan(offset, std::min(block_size, input.size() - offset));
+        const auto out = std::span{ output }.first(in.size());
+        loop.simulate_block(in, out);
+        acc.add(in, out);
+    }
+    return acc.result();
+}
+}
+
+void reseed_models(ObiektSISO &root, std::uint64_t seed)
+{
+    std::uint64_t counter = 0;
+    reseed_models(root, seed, counter);
+}
+
+void MetricsAccumulator::add(std::span<const double> setpoint, std::span<const double> output)
+{
+    if (setpoint.size() != output.size())
+        throw std::runtime_error{ "Setpoint and output blocks must have the same size" };
+    for (std::size_t i = 0; i < setpoint.size(); ++i) {
+        const auto r = setpoint[i];
+        const auto y = output[i];
+        const auto e = r - y;
+        m_metrics.iae += std::abs(e);
+        m_metrics.ise += e * e;
+        if (r != 0.0)
+            m_metrics.overshoot = std::max(m_metrics.overshoot, (y - r) / r);
+        const auto tolerance = r != 0.0 ? m_band * std::abs(r) : m_band;
+        if (std::abs(e) > tolerance)
+            m_last_outside = m_n + i + 1;
+    }
+    m_n += setpoint.size();
+    if (!output.empty())
+        m_metrics.final_output = output.back();
+}
+
+SweepMetrics MetricsAccumulator::result() const
+{
+    auto metrics = m_metrics;
+    if (m_n > 0 && m_last_outside == m_n)
+        metrics.settling_time = std::nullopt;
+    else
+        metrics.settling_time = m_last_outside;
+    return metrics;
+}
+
+std::vector<std::vector<double>> grid_points(std::span<const std::vector<double>> values)
+{
+    std::vector<std::vector<double>> points{ {} };
+    for (const auto &axis_values : values) {
+        std::vector<std::vector<double>> expanded;
+        expanded.reserve(points.size() * axis_values.size());
+        for (const auto &p : points) {
+            for (const auto v : axis_values) {
+                auto &np = expanded.emplace_back(p);
+                np.push_back(v);
+            }
+        }
+        points = std::move(expanded);
+    }
+    return points;
+}
+
+std::vector<std::vector<double>>
+random_points(std::span<const std::pair<double, double>> ranges, std::size_t n, std::uint64_t seed)
+{
+    std::mt19937_64 engine{ seed };
+    std::vector<std::vector<double>> points(n);
+    for (auto &p : points) {
+        p.reserve(ranges.size());
+        for (const auto &[min, max] : ranges)
+            p.push_back(std::uniform_real_distribution<double>{ min, max }(engine));
+    }
+    return points;
+}
+
+std::vector<SweepResult> run_sweep(std::span<const uint8_t> loop_dump,
+                                   std::span<const SweepAxis> axes,
+                                   std::span<const std::vector<double>> points, Generator &input,
+                                   std::size_t n_samples, const SweepOptions &options)
+{
+    // Validate all points before starting, so that errors are reported from the calling thread.
+    // The axes are resolved once and the values of every point are set on the same copy.
+    {
+        const auto loop = ObiektSISO::deserialize(loop_dump);
+        std::vector<ObiektSISO *> components;
+        for (const auto &axis : axes)
+            components.push_back(&find_component(*loop, axis.path));
+        for (const auto &p : points) {
+            if (p.size() != axes.size())
+                throw std::runtime_error{
+                    "Parameter point size does not match the number of axes"
+                };
+            for (std::size_t i = 0; i < axes.size(); ++i)
+                apply(*components[i], axes[i], p[i]);
+        }
+    }
+
+    std::vector<double> input_signal(n_samples);
+    input.generate(0, input_signal);
+
+    const auto repetitions = std::max<std::size_t>(options.repetitions, 1);
+    std::vector<SweepResult> results(points.size());
+    ThreadPool pool{ options.n_threads };
+    pool.parallel_for(points.size(), [&](std::size_t i) {
+        SweepMetrics sum{};
+        sum.settling_time = 0;
+        for (std::size_t rep = 0; rep < repetitions; ++rep) {
+            auto loop = prepare_loop(loop_dump, axes, points[i]);
+            if (options.noise_seed)
+                reseed_models(*loop,
+                              splitmix64(*options.noise_seed ^ splitmix64(i * repetitions + rep)));
+            const auto m = simulate(*loop, input_signal, options.settling_band);
+            sum.iae += m.iae;
+            sum.ise += m.ise;
+            sum.overshoot += m.overshoot;
+            sum.final_output += m.final_output;
+            if (sum.settling_time && m.settling_time)
+                sum.settling_time = std::max(*sum.settling_time, *m.settling_time);
+            else
+                sum.settling_time = std::nullopt;
+        }
+        const auto n = static_cast<double>(repetitions);
+        sum.iae /= n;
+        sum.ise /= n;
+        sum.overshoot /= n;
+        sum.final_output /= n;
+        results[i] = { points[i], sum };
+    });
+    return results;
+}
+
+#ifdef LAB_TESTS
+#include <iostream>
+
+void SweepTests::test_grid()
+{
+    it_should_not_throw("Sweep grid_points() cartesian product", []() {
+        const std::vector<std::vector<double>> values{ { 1.0, 2.0 }, { 3.0, 4.0, 5.0 } };
+        const auto points = grid_points(values);
+        const std::vector<std::vector<double>> expected{ { 1.0, 3.0 }, { 1.0, 4.0 }, { 1.0, 5.0 },
+                                                         { 2.0, 3.0 }, { 2.0, 4.0 }, { 2.0, 5.0 } };
+        if (points != expected)
+            throw std::runtime_error{ "Unexpected grid" };
+        const std::vector<std::pair<double, double>> ranges{ { 0.0, 1.0 }, { -5.0, -4.0 } };
+        const auto random = random_points(ranges, 100, 7);
+        if (random != random_points(ranges, 100, 7))
+            throw std::runtime_error{ "Random points are not reproducible" };
+        for (const auto &p : random)
+            if (p[0] < 0.0 || p[0] > 1.0 || p[1] < -5.0 || p[1] > -4.0)
+                throw std::runtime_error{ "Random point out of range" };
+    });
+}
+
+void SweepTests::test_metrics()
+{
+    it_should_not_throw("Sweep metrics of a known response", []() {
+        MetricsAccumulator acc{ 0.02 };
+        const std::vector<double> setpoint(5, 1.0);
+        const std::vector<double> output{ 0.0, 0.5, 1.2, 1.01, 1.0 };
+        acc.add(std::span{ setpoint }.first(2), std::span{ output }.first(2));
+        acc.add(std::span{ setpoint }.subspan(2), std::span{ output }.subspan(2));
+        const auto m = acc.result();
+        const auto close = [](double a, double b) { return std::abs(a - b) < 1e-12; };
+        if (!close(m.iae, 1.71) || !close(m.ise, 1.2901) || !close(m.overshoot, 0.2)
+            || m.settling_time != 3 || m.final_output != 1.0)
+            throw std::runtime_error{ "Unexpected metrics" };
+        acc.add(std::span{ setpoint }.first(1), std::span{ output }.first(1));
+        if (acc.result().settling_time)
+            throw std::runtime_error{ "Output outside of the band must not be settled" };
+    });
+}
+
+void SweepTests::test_parallel_matches_serial()
+{
+    it_should_not_throw("Sweep parallel results match serial simulation", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5, 4.0));
+        loop.push_back(
+            std::make_unique<ModelARX>(std::vector{ -0.4 }, std::vector{ 0.6 }, 1, 0.05));
+        const auto dump = loop.dump();
+        const std::vector<SweepAxis> axes{ { { 0 }, SweepParam::PID_K },
+                                           { { 1 }, SweepParam::ARX_STDDEV } };
+        const std::vector<std::vector<double>> values{ { 0.2, 0.5, 1.0 }, { 0.0, 0.1 } };
+        const auto points = grid_points(values);
+        GeneratorBaza step{ 1.0 };
+        SweepOptions options{ .n_threads = 3, .repetitions = 2, .noise_seed = 42 };
+        const auto results = run_sweep(dump, axes, points, step, 10'000, options);
+        options.n_threads = 1;
+        const auto results_1 = run_sweep(dump, axes, points, step, 10'000, options);
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            const auto &a = results[i].metrics;
+            const auto &b = results_1[i].metrics;
+            if (results[i].params != points[i] || a.iae != b.iae || a.ise != b.ise
+                || a.settling_time != b.settling_time)
+                throw std::runtime_error{ "Results depend on the number of threads" };
+            // Without noise the result must match a simple serial simulation
+            if (points[i][1] != 0.0)
+                continue;
+            PętlaUAR serial{ dump };
+            dynamic_cast<RegulatorPID &>(serial.at(0)).set_k(points[i][0]);
+            dynamic_cast<ModelARX &>(serial.at(1)).set_stddev(0.0);
+            MetricsAccumulator acc{ options.settling_band };
+            for (int t = 0; t < 10'000; ++t) {
+                const double r = 1.0;
+                const double y = serial.symuluj(r);
+                acc.add({ &r, 1 }, { &y, 1 });
+            }
+            const auto m = acc.result();
+            if (m.iae != a.iae || m.ise != a.ise || m.settling_time != a.settling_time
+                || m.overshoot != a.overshoot)
+                throw std::runtime_error{ "Results do not match serial simulation" };
+        }
+    });
+}
+
+void SweepTests::test_bad_axis()
+{
+    it_should_throw<std::runtime_error>("Sweep with an invalid component path", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5));
+        const std::vector<SweepAxis> axes{ { { 5 }, SweepParam::PID_K } };
+        const std::vector<std::vector<double>> points{ { 1.0 } };
+        GeneratorBaza step{ 1.0 };
+        run_sweep(loop.dump(), axes, points, step, 10);
+    });
+    it_should_throw<std::runtime_error>("Sweep with a mismatched component type", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5));
+        const std::vector<SweepAxis> axes{ { { 0 }, SweepParam::ARX_STDDEV } };
+        const std::vector<std::vector<double>> points{ { 1.0 } };
+        GeneratorBaza step{ 1.0 };
+        run_sweep(loop.dump(), axes, points, step, 10);
+    });
+    it_should_throw<std::runtime_error>("Sweep with an invalid value of a later point", []() {
+        PętlaUAR loop;
+        loop.push_back(std::make_unique<RegulatorPID>(0.5));
+        const std::vector<SweepAxis> axes{ { { 0 }, SweepParam::PID_K } };
+        const std::vector<std::vector<double>> points{ { 1.0 }, { 2.0 }, { -1.0 } };
+        GeneratorBaza step{ 1.0 };
+        run_sweep(loop.dump(), axes, points, step, 10);
+    });
+}
+
+void SweepTests::run_tests()
+{
+    test_grid();
+    test_metrics();
+    test_parallel_matches_serial();
+    test_bad_axis();
+}
+#endif
@@ -0,0 +1,146 @@
+/// @file sweep.hpp
+/// @brief Parallel parameter sweeps and Monte Carlo runs of control loops.
+
+#pragma once
+#include "ObiektSISO.h"
+#include "generators.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Parameter of a loop component, which can be changed in a sweep.
+enum class SweepParam {
+    PID_K, ///< RegulatorPID gain (RegulatorPID::set_k())
+    PID_TI, ///< RegulatorPID integration constant (RegulatorPID::set_ti())
+    PID_TD, ///< RegulatorPID derivation constant (RegulatorPID::set_td())
+    ARX_STDDEV ///< ModelARX noise standard deviation (ModelARX::set_stddev())
+};
+
+/// A swept parameter of a specific component.
+struct SweepAxis {
+    /// @brief Path to the component: indices of consecutive nested loops' elements, starting in the
+    /// root loop.
+    /// @details For example `{ 2, 0 }` is the first element of a loop, which is the third element
+    /// of the root loop.
+    std::vector<std::size_t> path;
+    /// Changed parameter, must match the component's type.
+    SweepParam param;
+};
+
+/// Aggregate quality metrics of a single simulation.
+struct SweepMetrics {
+    /// Integral (sum) of absolute errors between the input (setpoint) and the output.
+    double iae{};
+    /// Integral (sum) of squared errors between the input (setpoint) and the output.
+    double ise{};
+    /// Largest output excursion past a nonzero setpoint, relative to the setpoint magnitude.
+    double overshoot{};
+    /// @brief Number of samples after which the output stays within the settling band around the
+    /// setpoint, `std::nullopt` if it is outside of the band at the last sample.
+    std::optional<std::size_t> settling_time{};
+    /// Output at the last sample.
+    double final_output{};
+};
+
+/// Options of a sweep.
+struct SweepOptions {
+    /// Number of worker threads, `0` uses all hardware threads.
+    std::size_t n_threads{ 0 };
+    /// Half-width of the settling band, relative to the setpoint magnitude (or absolute at `0`).
+    double settling_band{ 0.02 };
+    /// @brief Number of Monte Carlo repetitions of every parameter point with different noise.
+    /// @details Metrics of repetitions are averaged. Settling time is the worst one.
+    std::size_t repetitions{ 1 };
+    /// @brief Base seed of ModelARX noise generators.
+    ///
+    /// If set, all ModelARX components are reseeded with seeds derived from it, the point index
+    /// and the repetition, so results are reproducible. Otherwise models keep the state from the
+    /// dump, so all repetitions are identical.
+    std::optional<std::uint64_t> noise_seed{};
+};
+
+/// Result of a single parameter point.
+struct SweepResult {
+    /// Values of the swept parameters, in the same order as axes.
+    std::vector<double> params;
+    /// Averaged metrics.
+    SweepMetrics metrics;
+};
+
+/// @brief Streaming accumulator of SweepMetrics, which does not store the trajectory.
+class MetricsAccumulator {
+private:
+    /// Metrics accumulated so far.
+    SweepMetrics m_metrics{};
+    /// Half-width of the settling band.
+    double m_band;
+    /// Number of processed samples.
+    std::size_t m_n{};
+    /// Index after the last sample outside of the settling band.
+    std::size_t m_last_outside{};
+
+public:
+    /// @brief Construct an empty accumulator.
+    /// @param settling_band half-width of the settling band, see SweepOptions::settling_band
+    constexpr explicit MetricsAccumulator(double settling_band)
+        : m_band{ settling_band }
+    {
+    }
+    /// @brief Add a block of samples.
+    /// @param setpoint loop inputs (setpoints)
+    /// @param output loop outputs, must have the same size as `setpoint`
+    void add(std::span<const double> setpoint, std::span<const double> output);
+    /// Metrics of all samples added so far.
+    SweepMetrics result() const;
+};
+
+/// @brief Cartesian product of parameter values.
+/// @param values values of each parameter
+/// @return All combinations; the last parameter changes the fastest.
+std::vector<std::vector<double>> grid_points(std::span<const std::vector<double>> values);
+/// @brief Uniformly distributed random parameter points.
+/// @param ranges [min, max] range of each parameter
+/// @param n number of points
+/// @param seed PRNG seed
+/// @return `n` random points.
+std::vector<std::vector<double>>
+random_points(std::span<const std::pair<double, double>> ranges, std::size_t n, std::uint64_t seed);
+
+/// @brief Reseed all ModelARX components of a component, including the nested ones.
+/// @param root the component, usually a loop
+/// @param seed base seed, the models get different seeds derived from it
+void reseed_models(ObiektSISO &root, std::uint64_t seed);
+
+/// @brief Simulate a loop for every parameter point in parallel and compute metrics.
+///
+/// The input signal is generated once, before starting the workers (generators are not
+/// thread-safe). Every task deserializes its own copy of the loop using ObiektSISO::deserialize(),
+/// applies the parameters and simulates it in blocks, so that only the metrics are kept.
+///
+/// @param loop_dump serialized loop (e.g. PętlaUAR::dump())
+/// @param axes swept parameters
+/// @param points parameter values, each one must have the same size as `axes`
+/// @param input generator of the input (setpoint) signal, simulated at times `[0, n_samples)`
+/// @param n_samples number of simulated samples
+/// @param options sweep options
+/// @return Results in the same order as `points`.
+/// @throws `std::runtime_error` if an axis path or parameter does not match the loop or a point
+/// has a wrong size.
+std::vector<SweepResult> run_sweep(std::span<const uint8_t> loop_dump,
+                                   std::span<const SweepAxis> axes,
+                                   std::span<const std::vector<double>> points, Generator &input,
+                                   std::size_t n_samples, const SweepOptions &options = {});
+
+#ifdef LAB_TESTS
+class SweepTests {
+    static void test_grid();
+    static void test_metrics();
+    static void test_parallel_matches_serial();
+    static void test_bad_axis();
+
+public:
+    static void run_tests();
+};
+#endif
@@ -56,9 +56,9 @@ private slots:
                 0xbf, 0x53, 0x57, 0x86, 0x42, 0x2d, 0x7c, 0x10, 0x5e, 0x9e, 0x23, 0x50, 0x80, 0x62,
                 0xa9, 0xf1, 0xf9, 0xc1, 0x31, 0x7,  0xcd, 0xbd, 0x1f, 0x64, 0xd4, 0xa4 };
         MainWindow::write_file(path, data);
-        const auto [read_data, file_size] = MainWindow::read_file(path);
-        QCOMPARE_EQ(file_size, data.size());
-        QVERIFY2(std::ranges::equal(std::span{ read_data.get(), file_size }, data),
+        const auto read_data = MainWindow::read_file(path);
+        QCOMPARE_EQ(read_data.size(), data.size());
+        QVERIFY2(std::ranges::equal(read_data.bytes(), data),
                  "Data read from file is different from data which should be written.");
     }
     void import_generators()
@@ -0,0 +1,448 @@
+/// @file regression.cpp
+/// @brief Regression harness comparing long simulation traces with reference traces.
+///
+/// Usage: `POlabsRegression [--filter SUBSTRING] [--scale N] [--threads N]`
+///
+/// Unlike LabTests, which check short sequences under sanitizers, this harness replays long
+/// traces, so it is meant to be built in Release mode to validate optimizations on large inputs:
+/// - generator cases extend the golden data of tests/sin.csv and tests/sawtooth.csv (one period of
+///   which is repeated) to millions of samples and compare Generator::generate() with them; the
+///   traces are split into chunks simulated in parallel,
+/// - loop cases compare the fast simulation paths (block simulation, FrozenLoop, steady state
+///   skipping, fused linear chains, BatchLoop) with a trace of per-sample ObiektSISO::symuluj()
+///   calls; every case runs in parallel with the others.
+///
+/// Every case reports the number of samples outside its tolerance, the largest error and the
+/// throughput of the tested path. The exit code is 1 if any case failed. `--scale` multiplies the
+/// lengths of all traces. Must be run from the repository root, so that the golden data is found.
+
+#include "../ModelARX.h"
+#include "../ObiektStatyczny.hpp"
+#include "../PętlaUAR.hpp"
+#include "../RegulatorPID.h"
+#include "../batch_loop.hpp"
+#include "../frozen_loop.hpp"
+#include "../generators.hpp"
+#include "../linear_fusion.hpp"
+#include "../mapped_file.hpp"
+#include "../thread_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Samples of a generator trace per unit of `--scale`.
+constexpr std::size_t generator_samples = 1 << 22;
+/// Samples of a loop trace per unit of `--scale`.
+constexpr std::size_t loop_samples = 1 << 18;
+/// Number of samples simulated at once.
+constexpr std::size_t block_size = 1 << 12;
+/// Number of samples of a generator trace compared by a single task.
+constexpr std::size_t generator_chunk = 1 << 16;
+
+using steady_clock = std::chrono::steady_clock;
+
+/// Result of comparing two traces.
+struct Comparison {
+    /// Number of compared samples.
+    std::size_t samples{};
+    /// Number of samples with an error above the tolerance (or NaN).
+    std::size_t mismatches{};
+    /// Largest absolute error.
+    double max_error{};
+
+    Comparison &operator+=(const Comparison &other) noexcept
+    {
+        samples += other.samples;
+        mismatches += other.mismatches;
+        max_error = std::max(max_error, other.max_error);
+        return *this;
+    }
+};
+
+/// @brief Compare traces sample by sample.
+///
+/// The loop has no branches, so it is vectorized by the compiler. NaN errors are counted as
+/// mismatches, because they fail the `<=` comparison.
+///
+/// @param expected reference trace
+/// @param actual tested trace, the same size as `expected`
+/// @param tolerance largest allowed absolute error
+Comparison compare(std::span<const double> expected, std::span<const double> actual,
+                   double tolerance) noexcept
+{
+    std::size_t mismatches = 0;
+    double max_error = 0.0;
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        const double error = std::fabs(expected[i] - actual[i]);
+        mismatches += !(error <= tolerance);
+        max_error = std::max(max_error, error);
+    }
+    return { expected.size(), mismatches, max_error };
+}
+
+/// A single regression case.
+struct Case {
+    /// Name used in the report and by `--filter`.
+    std::string name;
+    /// @brief Run the case.
+    /// @param pool pool for parallel parts of the case
+    /// @param scale multiplier of the trace length
+    /// @param tested time spent in the tested path, increased by the case
+    std::function<Comparison(ThreadPool &pool, std::size_t scale, steady_clock::duration &tested)>
+        run;
+};
+
+/// Golden data of a periodic generator.
+struct GoldenData {
+    /// Parameters from the lines before the header, e.g. `{"T", 20}`.
+    std::map<std::string, double, std::less<>> params;
+    /// Samples for times 0, 1, ...
+    std::vector<double> values;
+};
+
+/// @brief Read a golden data CSV: parameter lines, a "time,value" header and consecutive samples.
+/// @throws `std::runtime_error` if the file can't be read or parsed.
+GoldenData read_golden(const char *path)
+{
+    const MappedFile file{ path };
+    std::string_view text{ reinterpret_cast<const char *>(file.bytes().data()), file.size() };
+    GoldenData data;
+    bool header = false;
+    while (!text.empty()) {
+        const auto eol = std::min(text.find('\n'), text.size());
+        auto line = text.substr(0, eol);
+        text.remove_prefix(std::min(eol + 1, text.size()));
+        if (line.ends_with('\r'))
+            line.remove_suffix(1);
+        const auto comma = line.find(',');
+        if (line.empty() || comma == line.npos)
+            continue;
+        if (!header && line == "time,value") {
+            header = true;
+            continue;
+        }
+        double value{};
+        const auto value_text = line.substr(comma + 1);
+        const auto [end, ec] = std::from_chars(value_text.data(),
+                                               value_text.data() + value_text.size(), value);
+        if (ec != std::errc{} || end != value_text.data() + value_text.size())
+            throw std::runtime_error{ std::string{ "Invalid value in " } + path };
+        if (header)
+            data.values.push_back(value);
+        else
+            data.params.emplace(line.substr(0, comma), value);
+    }
+    return data;
+}
+
+/// @brief Case comparing a periodic generator with golden data extended to a long trace.
+/// @param name case name
+/// @param path golden data CSV with `A` (amplitude) and `T` (period) parameters
+/// @param make create the generator from the amplitude and period
+/// @param tolerance largest allowed absolute error
+Case golden_generator_case(std::string name, const char *path,
+                           std::function<std::unique_ptr<Generator>(double, uint32_t)> make,
+                           double tolerance)
+{
+    return { std::move(name),
+             [=](ThreadPool &pool, std::size_t scale, steady_clock::duration &tested) {
+                 const auto golden = read_golden(path);
+                 const auto period = static_cast<std::size_t>(golden.params.at("T"));
+                 if (period == 0 || golden.values.size() < period)
+                     throw std::runtime_error{ std::string{ "Golden data is too short: " }
+                                               + path };
+                 const auto amplitude = golden.params.at("A");
+                 const auto n = generator_samples * scale;
+                 const auto chunks = (n + generator_chunk - 1) / generator_chunk;
+                 std::vector<Comparison> results(chunks);
+                 std::vector<steady_clock::duration> times(chunks);
+                 // Generators cache their waveform tables, so every task has its own
+                 pool.parallel_for(chunks, [&](std::size_t chunk) {
+                     const auto generator = make(amplitude, static_cast<uint32_t>(period));
+                     const auto t0 = chunk * generator_chunk;
+                     const auto size = std::min(generator_chunk, n - t0);
+                     std::vector<double> expected(size), actual(size);
+                     for (std::size_t i = 0; i < size; ++i)
+                         expected[i] = golden.values[(t0 + i) % period];
+                     const auto start = steady_clock::now();
+                     generator->generate(static_cast<int>(t0), actual);
+                     times[chunk] = steady_clock::now() - start;
+                     results[chunk] = compare(expected, actual, tolerance);
+                 });
+                 Comparison total;
+                 for (std::size_t i = 0; i < chunks; ++i) {
+                     total += results[i];
+                     tested += times[i];
+                 }
+                 return total;
+             } };
+}
+
+/// Closed loop with a PID regulator and an ARX model with noise.
+PętlaUAR make_noisy_loop()
+{
+    PętlaUAR loop;
+    loop.push_back(std::make_unique<RegulatorPID>(0.5, 5.0, 0.2));
+    auto model = std::make_unique<ModelARX>(std::vector<double>{ -0.4, 0.2 },
+                                            std::vector<double>{ 0.6, 0.3 }, 2, 0.01);
+    model->reseed(1234);
+    loop.push_back(std::move(model));
+    return loop;
+}
+
+/// Closed loop with a PI regulator, a static gain and a chain of linear components.
+PętlaUAR make_linear_loop()
+{
+    PętlaUAR loop;
+    loop.push_back(std::make_unique<RegulatorPID>(0.4, 8.0));
+    loop.push_back(std::make_unique<ObiektStatyczny>(ObiektStatyczny::unbounded(0.8)));
+    loop.push_back(std::make_unique<ModelARX>(std::vector<double>{ -0.5 },
+                                              std::vector<double>{ 0.5 }, 1));
+    loop.push_back(std::make_unique<ModelARX>(std::vector<double>{ -0.3, 0.1 },
+                                              std::vector<double>{ 0.4, 0.2 }, 2));
+    return loop;
+}
+
+/// Input of loop cases: a sine with a rectangular wave, or only the rectangular wave.
+std::vector<double> loop_input(std::size_t n, bool with_sine)
+{
+    std::unique_ptr<Generator> input
+        = std::make_unique<GeneratorProstokat>(std::make_unique<GeneratorBaza>(), 1.0, 5000, 0.5);
+    if (with_sine)
+        input = std::make_unique<GeneratorSinus>(std::move(input), 0.3, 700);
+    std::vector<double> samples(n);
+    input->generate(0, samples);
+    return samples;
+}
+
+/// @brief Reference trace of a loop, simulated one sample at a time.
+/// @param loop simulated loop, not modified
+/// @param input loop inputs
+std::vector<double> reference_trace(const PętlaUAR &loop, std::span<const double> input)
+{
+    PętlaUAR copy{ loop.dump() };
+    std::vector<double> trace(input.size());
+    for (std::size_t i = 0; i < input.size(); ++i)
+        trace[i] = copy.symuluj(input[i]);
+    return trace;
+}
+
+/// @brief Case comparing a block simulation path of a loop with its reference trace.
+/// @param name case name
+/// @param make_loop create the tested loop
+/// @param with_sine whether the input contains a sine, otherwise it is piecewise constant
+/// @param tolerance largest allowed absolute error
+/// @param prepare create the tested simulation from a copy of the loop, returns a function
+/// simulating a block
+Case loop_case(std::string name, PętlaUAR (*make_loop)(), bool with_sine, double tolerance,
+               std::function<std::function<void(std::span<const double>, std::span<double>)>(
+                   PętlaUAR &&loop)>
+                   prepare)
+{
+    return { std::move(name),
+             [=](ThreadPool &, std::size_t scale, steady_clock::duration &tested) {
+                 const auto input = loop_input(loop_samples * scale, with_sine);
+                 const auto loop = make_loop();
+                 const auto expected = reference_trace(loop, input);
+                 auto simulate = prepare(PętlaUAR{ loop.dump() });
+                 std::vector<double> actual(input.size());
+                 const auto start = steady_clock::now();
+                 for (std::size_t t0 = 0; t0 < input.size(); t0 += block_size) {
+                     const auto n = std::min(block_size, input.size() - t0);
+                     simulate(std::span{ input }.subspan(t0, n),
+                              std::span{ actual }.subspan(t0, n));
+                 }
+                 tested += steady_clock::now() - start;
+                 return compare(expected, actual, tolerance);
+             } };
+}
+
+/// Case comparing BatchLoop channels with reference traces of loops with different regulators.
+Case batch_case()
+{
+    return { "loop/batch",
+             [](ThreadPool &, std::size_t scale, steady_clock::duration &tested) {
+                 constexpr std::size_t channels = 8;
+                 const auto input = loop_input(loop_samples * scale, true);
+                 std::vector<PętlaUAR> loops;
+                 for (std::size_t k = 0; k < channels; ++k) {
+                     loops.push_back(make_noisy_loop());
+                     auto &regulator = dynamic_cast<RegulatorPID &>(loops.back().at(0));
+                     regulator.set_k(0.2 + 0.05 * static_cast<double>(k));
+                 }
+                 std::vector<const PętlaUAR *> pointers;
+                 for (const auto &loop : loops)
+                     pointers.push_back(&loop);
+                 BatchLoop batch{ pointers };
+
+                 // All channels get the same input, in the interleaved layout of BatchLoop
+                 std::vector<double> block(block_size * channels);
+                 std::vector<std::vector<double>> actual(channels,
+                                                         std::vector<double>(input.size()));
+                 const auto start = steady_clock::now();
+                 for (std::size_t t0 = 0; t0 < input.size(); t0 += block_size) {
+                     const auto n = std::min(block_size, input.size() - t0);
+                     for (std::size_t t = 0; t < n; ++t)
+                         std::fill_n(block.begin() + t * channels, channels, input[t0 + t]);
+                     const auto samples = std::span{ block }.first(n * channels);
+                     batch.simulate_block(samples, samples);
+                     for (std::size_t t = 0; t < n; ++t)
+                         for (std::size_t k = 0; k < channels; ++k)
+                             actual[k][t0 + t] = block[t * channels + k];
+                 }
+                 tested += steady_clock::now() - start;
+                 Comparison total;
+                 for (std::size_t k = 0; k < channels; ++k)
+                     total += compare(reference_trace(loops[k], input), actual[k], 0.0);
+                 return total;
+             } };
+}
+
+/// All regression cases.
+std::vector<Case> make_cases()
+{
+    using block_fn = std::function<void(std::span<const double>, std::span<double>)>;
+    std::vector<Case> cases;
+    cases.push_back(golden_generator_case(
+        "generator/sine", "./tests/sin.csv",
+        [](double a, uint32_t t) {
+            return std::make_unique<GeneratorSinus>(std::make_unique<GeneratorBaza>(), a, t);
+        },
+        1e-13));
+    cases.push_back(golden_generator_case(
+        "generator/sawtooth", "./tests/sawtooth.csv",
+        [](double a, uint32_t t) {
+            return std::make_unique<GeneratorSawtooth>(std::make_unique<GeneratorBaza>(), a, t);
+        },
+        1e-14));
+    // The block paths perform the same operations in the same order, so they match exactly
+    cases.push_back(loop_case("loop/block", make_noisy_loop, true, 0.0, [](PętlaUAR &&loop) {
+        return block_fn{ [l = std::make_shared<PętlaUAR>(std::move(loop))](
+                             std::span<const double> in, std::span<double> out) {
+            l->simulate_block(in, out);
+        } };
+    }));
+    cases.push_back(loop_case("loop/frozen", make_noisy_loop, true, 0.0, [](PętlaUAR &&loop) {
+        return block_fn{ [f = std::make_shared<FrozenLoop>(freeze(loop))](
+                             std::span<const double> in, std::span<double> out) {
+            f->simulate_block(in, out);
+        } };
+    }));
+    cases.push_back(loop_case("loop/steady-skip", make_linear_loop, false, 0.0,
+                              [](PętlaUAR &&loop) {
+                                  auto l = std::make_shared<PętlaUAR>(std::move(loop));
+                                  l->set_steady_skip(true);
+                                  return block_fn{ [l](std::span<const double> in,
+                                                       std::span<double> out) {
+                                      l->simulate_block(in, out);
+                                  } };
+                              }));
+    // Fused polynomials round differently
+    cases.push_back(loop_case("loop/fused", make_linear_loop, true, 1e-9, [](PętlaUAR &&loop) {
+        auto l = std::make_shared<PętlaUAR>(std::move(loop));
+        if (fuse_linear_chains(*l).chains == 0)
+            throw std::runtime_error{ "Nothing was fused" };
+        return block_fn{ [l](std::span<const double> in, std::span<double> out) {
+            l->simulate_block(in, out);
+        } };
+    }));
+    cases.push_back(batch_case());
+    return cases;
+}
+
+/// @brief Parse a positive integer option value.
+/// @return The value or 0 if it is invalid.
+std::size_t parse_count(std::string_view value)
+{
+    std::size_t result{};
+    const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    return ec == std::errc{} && end == value.data() + value.size() ? result : 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter;
+    std::size_t scale = 1, threads = 0;
+    const std::span args{ argv, static_cast<std::size_t>(argc) };
+    for (std::size_t i = 1; i + 1 < args.size(); i += 2) {
+        const std::string_view arg{ args[i] }, value{ args[i + 1] };
+        if (arg == "--filter") {
+            filter = value;
+        } else if (arg == "--scale" || arg == "--threads") {
+            const auto count = parse_count(value);
+            if (count == 0) {
+                std::fprintf(stderr, "Invalid value of %s: %s\n", args[i], args[i + 1]);
+                return 2;
+            }
+            (arg == "--scale" ? scale : threads) = count;
+        } else {
+            std::fprintf(stderr, "Unknown option: %s\n", args[i]);
+            return 2;
+        }
+    }
+    if (args.size() % 2 == 0) {
+        std::fprintf(stderr, "Option %s expects a value\n", args.back());
+        return 2;
+    }
+
+    std::vector<Case> cases;
+    for (auto &c : make_cases())
+        if (c.name.find(filter) != std::string::npos)
+            cases.push_back(std::move(c));
+    // Cases run in parallel and use the same pool for their own parallel parts
+    ThreadPool pool{ threads };
+    ThreadPool case_pool{ threads };
+    struct Outcome {
+        Comparison comparison;
+        steady_clock::duration tested{};
+        std::string error;
+    };
+    std::vector<Outcome> outcomes(cases.size());
+    const auto start = steady_clock::now();
+    case_pool.parallel_for(cases.size(), [&](std::size_t i) {
+        try {
+            outcomes[i].comparison = cases[i].run(pool, scale, outcomes[i].tested);
+        } catch (const std::exception &e) {
+            outcomes[i].error = e.what();
+        }
+    });
+    const std::chrono::duration<double> wall = steady_clock::now() - start;
+
+    bool failed = false;
+    std::size_t total_samples = 0;
+    std::printf("%-20s %6s %12s %10s %10s %14s\n", "case", "result", "samples", "mismatches",
+                "max error", "Msamples/s");
+    for (std::size_t i = 0; i < cases.size(); ++i) {
+        const auto &[comparison, tested, error] = outcomes[i];
+        if (!error.empty()) {
+            failed = true;
+            std::printf("%-20s %6s %s\n", cases[i].name.c_str(), "FAIL", error.c_str());
+            continue;
+        }
+        const bool ok = comparison.mismatches == 0 && comparison.samples > 0;
+        failed |= !ok;
+        total_samples += comparison.samples;
+        const std::chrono::duration<double> seconds = tested;
+        std::printf("%-20s %6s %12zu %10zu %10.3g %14.1f\n", cases[i].name.c_str(),
+                    ok ? "OK" : "FAIL", comparison.samples, comparison.mismatches,
+                    comparison.max_error,
+                    seconds.count() > 0.0 ? comparison.samples / seconds.count() / 1e6 : 0.0);
+    }
+    std::printf("%zu samples compared in %.2f s\n", total_samples, wall.count());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/// @file thread_pool.hpp
+/// @brief A small work-stealing thread pool.
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @brief Fixed-size thread pool with per-worker task queues and work stealing.
+///
+/// Tasks are distributed round-robin between worker queues. Each worker takes tasks from the back
+/// of its own queue and, when it runs out of work, steals from the front of other workers' queues,
+/// so uneven task durations do not leave cores idle.
+class ThreadPool {
+public:
+    /// Type of tasks executed by the pool.
+    using task_t = std::function<void()>;
+
+private:
+    /// Task queue owned by a single worker.
+    struct Queue {
+        /// Mutex protecting #tasks.
+        std::mutex mutex;
+        /// Queued tasks.
+        std::deque<task_t> tasks;
+    };
+
+    /// One queue per worker.
+    std::unique_ptr<Queue[]> m_queues;
+    /// Number of workers (and queues).
+    std::size_t m_n_workers;
+    /// Number of tasks waiting in queues, modified under #m_mutex when increased.
+    std::atomic<std::size_t> m_queued{};
+    /// Number of submitted tasks which have not finished yet.
+    std::atomic<std::size_t> m_pending{};
+    /// Index of the queue, which will receive the next task.
+    std::atomic<std::size_t> m_next_queue{};
+    /// Set when the pool is destroyed.
+    bool m_stop{};
+    /// Mutex used with #m_work_cv and #m_done_cv.
+    std::mutex m_mutex;
+    /// Notified when new tasks are queued or the pool is stopped.
+    std::condition_variable m_work_cv;
+    /// Notified when all pending tasks are finished.
+    std::condition_variable m_done_cv;
+    /// The first exception thrown by a task since the last wait().
+    std::exception_ptr m_exception{};
+    /// Worker threads, must be the last member, so they are joined before anything is destroyed.
+    std::vector<std::jthread> m_workers;
+
+    /// @brief Take a task from own queue or steal one from other queues.
+    /// @param worker index of the worker
+    std::optional<task_t> take(std::size_t worker)
+    {
+        for (std::size_t i = 0; i < m_n_workers; ++i) {
+            auto &q = m_queues[(worker + i) % m_n_workers];
+            std::lock_guard lock{ q.mutex };
+            if (q.tasks.empty())
+                continue;
+            task_t task;
+            if (i == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            m_queued.fetch_sub(1);
+            return task;
+        }
+        return std::nullopt;
+    }
+    /// @brief Main loop of a worker thread.
+    /// @param worker index of the worker
+    void work(std::size_t worker)
+    {
+        while (true) {
+            if (auto task = take(worker)) {
+                try {
+                    (*task)();
+                } catch (...) {
+                    std::lock_guard lock{ m_mutex };
+                    if (!m_exception)
+                        m_exception = std::current_exception();
+                }
+                if (m_pending.fetch_sub(1) == 1) {
+                    std::lock_guard lock{ m_mutex };
+                    m_done_cv.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock lock{ m_mutex };
+            m_work_cv.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+            if (m_stop && m_queued.load() == 0)
+                return;
+        }
+    }
+
+public:
+    /// @brief Start the pool.
+    /// @param n_threads number of worker threads, `0` means `std::thread::hardware_concurrency()`
+    explicit ThreadPool(std::size_t n_threads = 0)
+        : m_n_workers{ n_threads ? n_threads
+                                 : std::max<std::size_t>(1, std::thread::hardware_concurrency()) }
+    {
+        m_queues = std::make_unique<Queue[]>(m_n_workers);
+        m_workers.reserve(m_n_workers);
+        for (std::size_t i = 0; i < m_n_workers; ++i)
+            m_workers.emplace_back([this, i] { work(i); });
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    /// Finish all queued tasks and join the workers.
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock{ m_mutex };
+            m_stop = true;
+        }
+        m_work_cv.notify_all();
+        m_workers.clear();
+    }
+
+    /// Number of worker threads.
+    std::size_t size() const noexcept { return m_n_workers; }
+    /// @brief Queue a task for execution.
+    /// @param task function to execute
+    void submit(task_t task)
+    {
+        m_pending.fetch_add(1);
+        // Count the task before it becomes visible, so that taking it can't underflow the counter
+        {
+            std::lock_guard lock{ m_mutex };
+            m_queued.fetch_add(1);
+        }
+        auto &q = m_queues[m_next_queue.fetch_add(1) % m_n_workers];
+        {
+            std::lock_guard lock{ q.mutex };
+            q.tasks.push_back(std::move(task));
+        }
+        m_work_cv.notify_one();
+    }
+    /// @brief Wait until all submitted tasks are finished.
+    /// @throws The first exception thrown by any of the tasks since the last call.
+    void wait()
+    {
+        std::unique_lock lock{ m_mutex };
+        m_done_cv.wait(lock, [this] { return m_pending.load() == 0; });
+        if (auto e = std::exchange(m_exception, nullptr))
+            std::rethrow_exception(e);
+    }
+    /// @brief Call `fn(i)` for every `i` in `[0, n)` using the pool and wait for completion.
+    /// @param n number of iterations
+    /// @param fn function accepting the iteration index
+    /// @throws The first exception thrown by `fn`.
+    void parallel_for(std::size_t n, const std::function<void(std::size_t)> &fn)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            submit([&fn, i] { fn(i); });
+        wait();
+    }
+};
@@ -12,6 +12,7 @@
 #include <functional>
 #include <ostream>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <string_view>
 #include <type_traits>
@@ -89,6 +90,11 @@ concept BiendianSerializable
     = Arithmetic<T> || (std::is_bounded_array_v<T> && Arithmetic<std::remove_extent_t<T>>)
     || (IsStdArray<T> && HasArithmeticValue<T>);
 
+/// Helper for `std::visit` with multiple lambdas.
+template <typename... Fs> struct overloaded : Fs... {
+    using Fs::operator()...;
+};
+
 /// @brief User-defined literal operator producing `uint8_t`.
 constexpr uint8_t operator"" _u8(unsigned long long a) noexcept { return static_cast<uint8_t>(a); }
 
@@ -105,6 +111,18 @@ constexpr void throw_bad_neg(double x)
         throw std::runtime_error{ "parameter must be nonnegative and finite" };
 }
 
+/// @brief Check if two numbers have the same object representation.
+///
+/// Unlike `a == b` distinguishes `0.0` from `-0.0` and matches identical NaNs, so it can tell if a
+/// value is left bit-identical.
+///
+/// @param a one number
+/// @param b the other number
+constexpr bool same_bits(double a, double b) noexcept
+{
+    return std::bit_cast<std::uint64_t>(a) == std::bit_cast<std::uint64_t>(b);
+}
+
 /// `static_assert` to make sure that endianness is little or big, not mixed.
 consteval void mixed_endianness_check()
 {
@@ -290,6 +308,108 @@ constexpr bool prefix_match(const std::string_view prefix, const T &bin_data)
 #endif
 }
 
+/// @brief Sequential writer of serialized data into a caller-provided buffer.
+///
+/// Values are written with to_bytes(), so the result is the same as concatenating their
+/// representations, but nothing is allocated.
+class ByteWriter {
+private:
+    /// Part of the buffer which was not written yet.
+    std::span<uint8_t> m_rest;
+
+public:
+    /// @brief Construct a writer over `buffer`.
+    /// @param buffer output buffer, filled from the beginning
+    constexpr explicit ByteWriter(std::span<uint8_t> buffer) noexcept
+        : m_rest{ buffer }
+    {
+    }
+    /// @brief Reserve the next `n` bytes of the buffer.
+    /// @param n number of bytes
+    /// @return The reserved part of the buffer, to be filled by the caller.
+    /// @throws `std::runtime_error` if less than `n` bytes are left.
+    constexpr std::span<uint8_t> take(std::size_t n)
+    {
+        if (m_rest.size() < n)
+            throw std::runtime_error{ "Serialization buffer is too small" };
+        const auto taken = m_rest.first(n);
+        m_rest = m_rest.subspan(n);
+        return taken;
+    }
+    /// @brief Write the object representation of `value`, see to_bytes().
+    /// @param value value to write
+    template <TriviallyCopyable T> constexpr void put(const T &value)
+    {
+        const auto bytes = to_bytes(value);
+        std::ranges::copy(bytes, take(bytes.size()).begin());
+    }
+    /// @brief Write all elements of a range, see range_to_bytes().
+    /// @param r range to write
+    template <std::ranges::input_range R>
+        requires TriviallyCopyable<std::ranges::range_value_t<R>>
+    constexpr void put_range(const R &r)
+    {
+        for (const auto &e : r)
+            put(e);
+    }
+    /// Number of bytes left in the buffer.
+    constexpr std::size_t remaining() const noexcept { return m_rest.size(); }
+};
+
+/// @brief Sequential reader of serialized data from a span of bytes.
+///
+/// The counterpart of ByteWriter. Values are copied out with from_bytes(), so the data does not
+/// have to be aligned.
+class ByteReader {
+private:
+    /// Part of the data which was not read yet.
+    std::span<const uint8_t> m_rest;
+
+public:
+    /// @brief Construct a reader over `data`.
+    /// @param data serialized data, read from the beginning
+    constexpr explicit ByteReader(std::span<const uint8_t> data) noexcept
+        : m_rest{ data }
+    {
+    }
+    /// @brief Skip the next `n` bytes.
+    /// @param n number of bytes
+    /// @return The skipped bytes.
+    /// @throws `std::runtime_error` if less than `n` bytes are left.
+    constexpr std::span<const uint8_t> take(std::size_t n)
+    {
+        if (m_rest.size() < n)
+            throw std::runtime_error{ "Serialized data is too short" };
+        const auto taken = m_rest.first(n);
+        m_rest = m_rest.subspan(n);
+        return taken;
+    }
+    /// @brief Read a value written with ByteWriter::put().
+    /// @return The value.
+    /// @throws `std::runtime_error` if the data is too short.
+    template <TriviallyCopyable T> constexpr T get()
+    {
+        std::array<uint8_t, sizeof(T)> bytes;
+        std::ranges::copy(take(sizeof(T)), bytes.begin());
+        return from_bytes<T>(bytes);
+    }
+    /// @brief Read `n` consecutive values written with ByteWriter::put_range().
+    /// @param n number of values
+    /// @return Vector with the values.
+    /// @throws `std::runtime_error` if the data is too short.
+    template <Arithmetic T> std::vector<T> get_vector(std::size_t n)
+    {
+        if (n > m_rest.size() / sizeof(T))
+            throw std::runtime_error{ "Serialized data is too short" };
+        std::vector<T> values(n);
+        for (auto &v : values)
+            v = get<T>();
+        return values;
+    }
+    /// Number of bytes left.
+    constexpr std::size_t remaining() const noexcept { return m_rest.size(); }
+};
+
 #ifdef LAB_TESTS
 #include <charconv>
 #include <fstream>
@@ -0,0 +1,58 @@
+#include "waveform_cache.hpp"
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+/// Whether the cache is enabled.
+std::atomic<bool> cache_enabled{ true };
+
+/// Hash of the bit patterns of WaveformKey members.
+struct KeyHash {
+    std::size_t operator()(const WaveformKey &k) const noexcept
+    {
+        std::uint64_t h = static_cast<std::uint64_t>(k.type) << 32 | k.period;
+        for (const double d : { k.amplitude, k.duty_cycle })
+            h = (h ^ std::bit_cast<std::uint64_t>(d)) * 0x100000001b3ULL;
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
+};
+
+/// Mutex protecting #tables.
+std::mutex tables_mutex;
+/// Weak references to tables, which are used by generators.
+std::unordered_map<WaveformKey, std::weak_ptr<const std::vector<double>>, KeyHash> tables;
+}
+
+bool WaveformKey::operator==(const WaveformKey &other) const noexcept
+{
+    return type == other.type && period == other.period
+        && std::bit_cast<std::uint64_t>(amplitude) == std::bit_cast<std::uint64_t>(other.amplitude)
+        && std::bit_cast<std::uint64_t>(duty_cycle)
+        == std::bit_cast<std::uint64_t>(other.duty_cycle);
+}
+
+void set_waveform_cache(bool enabled) noexcept { cache_enabled.store(enabled); }
+bool waveform_cache_enabled() noexcept { return cache_enabled.load(); }
+
+WaveformTable waveform_table(const WaveformKey &key,
+                             const std::function<double(std::uint32_t)> &value)
+{
+    if (!waveform_cache_enabled() || key.period == 0 || key.period > max_cached_period)
+        return nullptr;
+
+    std::lock_guard lock{ tables_mutex };
+    auto &entry = tables[key];
+    if (auto table = entry.lock())
+        return table;
+
+    auto table = std::make_shared<std::vector<double>>(key.period);
+    for (std::uint32_t p = 0; p < key.period; ++p)
+        (*table)[p] = value(p);
+    entry = table;
+    // Drop entries of tables, which are no longer used
+    if (tables.size() > 64)
+        std::erase_if(tables, [](const auto &e) { return e.second.expired(); });
+    return table;
+}
@@ -0,0 +1,52 @@
+/// @file waveform_cache.hpp
+/// @brief Shared tables of one period of periodic generators' waveforms.
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// Shape of a cached waveform.
+enum class Waveform { SINE, SQUARE, SAWTOOTH };
+
+/// Parameters which fully determine one period of a waveform.
+struct WaveformKey {
+    /// Shape of the waveform.
+    Waveform type;
+    /// Amplitude of the signal.
+    double amplitude;
+    /// Period in samples.
+    std::uint32_t period;
+    /// Duty cycle, `0.0` for waveforms without one.
+    double duty_cycle;
+
+    /// Bitwise equality, so that the key of a table can be checked cheaply (and NaN matches NaN).
+    bool operator==(const WaveformKey &other) const noexcept;
+};
+
+/// Shared, immutable table of one waveform period, indexed by position in the period.
+using WaveformTable = std::shared_ptr<const std::vector<double>>;
+
+/// Longest period which is cached, tables of longer ones would not fit in CPU caches anyway.
+inline constexpr std::uint32_t max_cached_period = 1U << 16;
+
+/// @brief Enable or disable the waveform cache.
+/// @details The cache is enabled by default. Cached values are bitwise equal to computed ones.
+/// @param enabled whether waveform_table() should return tables
+void set_waveform_cache(bool enabled) noexcept;
+/// Check whether the waveform cache is enabled.
+bool waveform_cache_enabled() noexcept;
+
+/// @brief Get a table of one period of a waveform, computing it if no other generator holds one.
+///
+/// Tables are shared between all holders of equal keys. The cache keeps only weak references, so a
+/// table is freed when the last generator using it stops.
+///
+/// @param key parameters of the waveform
+/// @param value function computing the value at a given position in the period, used only when
+/// the table is not cached yet
+/// @return The table or `nullptr` if the cache is disabled or the period is 0 or longer than
+/// #max_cached_period.
+WaveformTable waveform_table(const WaveformKey &key,
+                             const std::function<double(std::uint32_t)> &value);